@@ -1,5 +1,6 @@
 #include "ACS712_handler.h"
 #include <esp_task_wdt.h>
+#include "logger.h"
 
 // Global instance
 ACS712Handler currentSensor;
@@ -20,8 +21,8 @@ void ACS712Handler::begin(MCP3208* adcInstance, uint8_t frequency, uint8_t cycle
     acFrequency = frequency;
     numCycles = cycles;
     
-    Serial.println("ACS712 Handler initialized");
-    Serial.printf("AC Frequency: %d Hz, Cycles: %d\n", acFrequency, numCycles);
+    LOGI("ACS712 Handler initialized");
+    LOGI("AC Frequency: %d Hz, Cycles: %d", acFrequency, numCycles);
 }
 
 void ACS712Handler::setCalibration(float offsetmV, float scaleValue) {
@@ -32,7 +33,7 @@ void ACS712Handler::setCalibration(float offsetmV, float scaleValue) {
     scale = scaleValue;
     isCalibrated = true;
     
-    Serial.printf("ACS712 Calibration - Global Offset: %.2f mV, Scale: %.2f\n", offsetmV, scale);
+    LOGI("ACS712 Calibration - Global Offset: %.2f mV, Scale: %.2f", offsetmV, scale);
 }
 
 void ACS712Handler::setIndividualOffsets(float offset1, float offset2, float offset3) {
@@ -41,8 +42,8 @@ void ACS712Handler::setIndividualOffsets(float offset1, float offset2, float off
     offsetL3 = offset3;
     isCalibrated = true;
     
-    Serial.printf("ACS712 Individual Offsets - L1: %.2f mV, L2: %.2f mV, L3: %.2f mV\n", 
-                  offset1, offset2, offset3);
+    LOGI("ACS712 Individual Offsets - L1: %.2f mV, L2: %.2f mV, L3: %.2f mV", 
+         offset1, offset2, offset3);
 }
 
 CalibrationData ACS712Handler::getCalibrationData() {
@@ -56,13 +57,13 @@ CalibrationData ACS712Handler::getCalibrationData() {
 
 bool ACS712Handler::performAutoCalibration(uint16_t samples) {
     if (!adc) {
-        Serial.println("Error: ADC not initialized - cannot calibrate!");
+        LOGE("Error: ADC not initialized - cannot calibrate!");
         return false;
     }
     
-    Serial.println("\n=== Starting ACS712 Auto-Calibration ===");
-    Serial.println("IMPORTANT: Motor must be OFF!");
-    Serial.printf("Taking %d samples per phase...\n", samples);
+    LOGI("=== Starting ACS712 Auto-Calibration ===");
+    LOGI("IMPORTANT: Motor must be OFF!");
+    LOGI("Taking %d samples per phase...", samples);
     
     float sumL1 = 0.0;
     float sumL2 = 0.0;
@@ -74,15 +75,13 @@ bool ACS712Handler::performAutoCalibration(uint16_t samples) {
         sumL2 += readRawRMSVoltage(ACS712_L2_CHANNEL);
         sumL3 += readRawRMSVoltage(ACS712_L3_CHANNEL);
         
-        // Progress indicator + watchdog reset (calibration blocks async_tcp task)
+        // Watchdog reset (calibration blocks async_tcp task)
         if (i % 10 == 0) {
-            Serial.print(".");
             esp_task_wdt_reset();
         }
 
         delay(10); // Small delay between samples
     }
-    Serial.println();
     
     // Calculate average RMS voltage for each phase (this is the zero-current offset)
     float avgL1 = sumL1 / samples;
@@ -97,11 +96,11 @@ bool ACS712Handler::performAutoCalibration(uint16_t samples) {
     
     isCalibrated = true;
     
-    Serial.println("=== Calibration Complete ===");
-    Serial.printf("L1 Offset: %.2f mV (RMS voltage: %.2f mV)\n", offsetL1, avgL1);
-    Serial.printf("L2 Offset: %.2f mV (RMS voltage: %.2f mV)\n", offsetL2, avgL2);
-    Serial.printf("L3 Offset: %.2f mV (RMS voltage: %.2f mV)\n", offsetL3, avgL3);
-    Serial.println("============================\n");
+    LOGI("=== Calibration Complete ===");
+    LOGI("L1 Offset: %.2f mV (RMS voltage: %.2f mV)", offsetL1, avgL1);
+    LOGI("L2 Offset: %.2f mV (RMS voltage: %.2f mV)", offsetL2, avgL2);
+    LOGI("L3 Offset: %.2f mV (RMS voltage: %.2f mV)", offsetL3, avgL3);
+    LOGI("============================");
     
     return true;
 }
@@ -149,7 +148,7 @@ float ACS712Handler::readRawRMSVoltage(uint8_t channel) {
 
 float ACS712Handler::readACCurrent(uint8_t channel, float channelOffset) {
     if (!adc) {
-        Serial.println("Error: ADC not initialized!");
+        LOGE("Error: ADC not initialized!");
         return 0.0;
     }
     
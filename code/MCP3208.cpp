@@ -16,10 +16,14 @@ void MCP3208::analogReadResolution(uint8_t bits) {
 	else this->bits = 12;
 	}
 
+void MCP3208::setClock(uint32_t hz) {
+	if (hz > 0) this->clock = hz;
+	}
+
 uint16_t MCP3208::analogRead(uint8_t channel) {
-	// MCP3208 max SPI clock: 2MHz at 5V (per datasheet)
+	// MCP3208 max SPI clock: 2MHz at 5V (per datasheet), default until tuned
 	// Using SPI_MODE0: CPOL=0, CPHA=0 (clock idle low, sample on rising edge)
-	SPISettings spiSettings(2000000, MSBFIRST, SPI_MODE0);
+	SPISettings spiSettings(clock, MSBFIRST, SPI_MODE0);
 
 	uint8_t addr = 0b01100000 | ((channel & 0b111) << 2);
 
@@ -47,10 +47,25 @@ class MCP3208 {
 		 */
 		uint16_t analogRead(uint8_t channel);
 
+		/**
+		 * @brief Set the SPI clock used for conversions
+		 * 
+		 * @param hz clock in Hz, see the datasheet limit for the supply voltage
+		 */
+		void setClock(uint32_t hz);
+
+		/**
+		 * @brief Get the SPI clock used for conversions
+		 * 
+		 * @return uint32_t clock in Hz
+		 */
+		uint32_t getClock() const { return clock; }
+
 	private:
 		SPIClass *spi;
 		uint8_t cs;
 		uint8_t bits = 12;
+		uint32_t clock = 2000000;
 	};
 
 #endif
\ No newline at end of file
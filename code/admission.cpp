@@ -0,0 +1,138 @@
+#include "admission.h"
+#include "logger.h"
+
+struct RequestClassLimits {
+    const char* name;
+    uint8_t     maxActive;      // ≤ ADMISSION_MAX_ACTIVE
+    uint8_t     maxQueued;      // ≤ ADMISSION_MAX_QUEUE
+    uint16_t    retryAfterS;
+};
+
+static const RequestClassLimits CLASS_LIMITS[REQ_CLASS_COUNT] = {
+    { "calibration", 1, 1, 5  },
+    { "upload",      1, 0, 10 },
+    { "ota",         1, 0, 30 },
+    { "listing",     2, 4, 2  },
+};
+
+struct QueuedRequest {
+    AsyncWebServerRequest *request;
+    AdmittedHandler        handler;
+    unsigned long          since;
+};
+
+struct ClassState {
+    AsyncWebServerRequest *active[ADMISSION_MAX_ACTIVE];
+    uint8_t       activeCount;
+    QueuedRequest queue[ADMISSION_MAX_QUEUE];
+    uint8_t       queueCount;
+    uint8_t       peakQueue;
+    uint32_t      admitted;
+    uint32_t      rejected;
+};
+
+// Only touched from web handlers, which all run in the async_tcp task
+static ClassState classes[REQ_CLASS_COUNT];
+
+static void dispatchNext(RequestClass cls);
+
+static void release(RequestClass cls, AsyncWebServerRequest *request) {
+    ClassState& st = classes[cls];
+    for (uint8_t i = 0; i < st.activeCount; i++) {
+        if (st.active[i] == request) {
+            st.active[i] = st.active[--st.activeCount];
+            break;
+        }
+    }
+    dispatchNext(cls);
+}
+
+static void takeSlot(RequestClass cls, AsyncWebServerRequest *request) {
+    ClassState& st = classes[cls];
+    st.active[st.activeCount++] = request;
+    st.admitted++;
+    // Fires when the response is done or the client goes away
+    request->onDisconnect([cls, request]() { release(cls, request); });
+}
+
+static void dropQueued(RequestClass cls, AsyncWebServerRequest *request) {
+    ClassState& st = classes[cls];
+    for (uint8_t i = 0; i < st.queueCount; i++) {
+        if (st.queue[i].request == request) {
+            for (uint8_t j = i + 1; j < st.queueCount; j++) st.queue[j - 1] = st.queue[j];
+            st.queue[--st.queueCount].handler = nullptr;
+            return;
+        }
+    }
+}
+
+static void dispatchNext(RequestClass cls) {
+    ClassState& st = classes[cls];
+    while (st.queueCount > 0 && st.activeCount < CLASS_LIMITS[cls].maxActive) {
+        QueuedRequest next = st.queue[0];
+        dropQueued(cls, next.request);
+
+        if (millis() - next.since > ADMISSION_MAX_WAIT_MS) {
+            sendOverloaded(next.request, cls);
+            continue;
+        }
+        takeSlot(cls, next.request);
+        next.handler(next.request);
+    }
+}
+
+void sendOverloaded(AsyncWebServerRequest *request, RequestClass cls) {
+    classes[cls].rejected++;
+    AsyncWebServerResponse *response = request->beginResponse(503, "application/json",
+        "{\"error\":\"Busy, retry later\"}");
+    response->addHeader("Retry-After", String(CLASS_LIMITS[cls].retryAfterS));
+    request->send(response);
+}
+
+void admitRequest(AsyncWebServerRequest *request, RequestClass cls, AdmittedHandler handler) {
+    ClassState& st = classes[cls];
+    const RequestClassLimits& limits = CLASS_LIMITS[cls];
+
+    if (st.activeCount < limits.maxActive && st.queueCount == 0) {
+        takeSlot(cls, request);
+        handler(request);
+        return;
+    }
+    if (st.queueCount >= limits.maxQueued) {
+        LOGW("[Admission] Rejecting %s request (%u active, %u queued)",
+             limits.name, st.activeCount, st.queueCount);
+        sendOverloaded(request, cls);
+        return;
+    }
+
+    st.queue[st.queueCount++] = { request, handler, millis() };
+    if (st.queueCount > st.peakQueue) st.peakQueue = st.queueCount;
+    request->onDisconnect([cls, request]() { dropQueued(cls, request); });
+}
+
+bool tryAdmit(AsyncWebServerRequest *request, RequestClass cls) {
+    ClassState& st = classes[cls];
+    if (st.activeCount >= CLASS_LIMITS[cls].maxActive) return false;
+    takeSlot(cls, request);
+    return true;
+}
+
+bool isAdmitted(AsyncWebServerRequest *request, RequestClass cls) {
+    ClassState& st = classes[cls];
+    for (uint8_t i = 0; i < st.activeCount; i++) {
+        if (st.active[i] == request) return true;
+    }
+    return false;
+}
+
+void addAdmissionStats(JsonObject obj) {
+    for (int c = 0; c < REQ_CLASS_COUNT; c++) {
+        const ClassState& st = classes[c];
+        JsonObject entry = obj.createNestedObject(CLASS_LIMITS[c].name);
+        entry["active"] = st.activeCount;
+        entry["queued"] = st.queueCount;
+        entry["peak_queued"] = st.peakQueue;
+        entry["admitted"] = st.admitted;
+        entry["rejected"] = st.rejected;
+    }
+}
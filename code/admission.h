@@ -0,0 +1,48 @@
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include <ESPAsyncWebServer.h>
+#include <ArduinoJson.h>
+#include <functional>
+
+// Upper bounds for the per-class tables below
+#define ADMISSION_MAX_ACTIVE   2
+#define ADMISSION_MAX_QUEUE    4
+// A queued request older than this is answered 503 instead of run
+#define ADMISSION_MAX_WAIT_MS  5000
+
+// Heavy request classes, each with its own concurrency limit
+enum RequestClass : uint8_t {
+    REQ_CLASS_CALIBRATION,  // blocks on ADC sampling for seconds
+    REQ_CLASS_UPLOAD,       // file and ZIP uploads share one SD writer
+    REQ_CLASS_OTA,          // firmware update from SD
+    REQ_CLASS_LISTING,      // holds a directory open while streaming
+    REQ_CLASS_COUNT
+};
+
+typedef std::function<void(AsyncWebServerRequest *request)> AdmittedHandler;
+
+/*
+ * Admission control for the handlers that do SD/SPI work in the async_tcp
+ * task. All functions must be called from web handlers (async_tcp).
+ *
+ * A request holds its slot until the connection closes, so streamed
+ * responses count for as long as they are being sent.
+ */
+
+// Run handler now if a slot is free, queue it if the class allows, else 503
+void admitRequest(AsyncWebServerRequest *request, RequestClass cls, AdmittedHandler handler);
+
+// Take a slot without queueing (for upload bodies, which can't be deferred)
+bool tryAdmit(AsyncWebServerRequest *request, RequestClass cls);
+
+// Whether request currently holds a slot of cls
+bool isAdmitted(AsyncWebServerRequest *request, RequestClass cls);
+
+// 503 with Retry-After for cls
+void sendOverloaded(AsyncWebServerRequest *request, RequestClass cls);
+
+// Per-class active/queued/peak/admitted/rejected counters
+void addAdmissionStats(JsonObject obj);
+
+#endif
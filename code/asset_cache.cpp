@@ -0,0 +1,174 @@
+#include "asset_cache.h"
+#include <esp_heap_caps.h>
+#include "logger.h"
+
+// Global instance
+AssetCache assetCache;
+
+AssetCache::AssetCache() :
+    mutex(NULL),
+    usePsram(false),
+    budget(ASSET_CACHE_BUDGET_INTERNAL),
+    maxFileSize(ASSET_CACHE_MAX_FILE_INTERNAL),
+    usedBytes(0),
+    hits(0),
+    misses(0),
+    evictions(0),
+    invalidations(0),
+    lowHeapSkips(0) {}
+
+void AssetCache::begin() {
+    mutex = xSemaphoreCreateMutex();
+    usePsram = psramFound();
+    if (usePsram) {
+        budget = ASSET_CACHE_BUDGET_PSRAM;
+        maxFileSize = ASSET_CACHE_MAX_FILE_PSRAM;
+    } else {
+        size_t share = (size_t)ESP.getFreeHeap() * ASSET_CACHE_HEAP_SHARE_PCT / 100;
+        budget = min((size_t)ASSET_CACHE_BUDGET_INTERNAL, share);
+        maxFileSize = min((size_t)ASSET_CACHE_MAX_FILE_INTERNAL, budget);
+    }
+    LOGI("[Cache] Asset cache: %u KB in %s",
+         (unsigned)(budget / 1024), usePsram ? "PSRAM" : "internal RAM");
+}
+
+AssetRef AssetCache::get(const char* path) {
+    if (!mutex) return nullptr;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        if ((*it)->path == path) {
+            // Move to the front (most recently used)
+            if (it != entries.begin()) entries.splice(entries.begin(), entries, it);
+            hits++;
+            AssetRef found = entries.front();
+            xSemaphoreGive(mutex);
+            return found;
+        }
+    }
+
+    misses++;
+    uint32_t skipsBefore = lowHeapSkips;
+    std::shared_ptr<CachedAsset> loaded = load(path);
+    if (lowHeapSkips != skipsBefore) {
+        // Not remembered: the body can be held once the heap recovers
+        xSemaphoreGive(mutex);
+        return loaded;
+    }
+    size_t cost = footprint(*loaded);
+    evictFor(cost);
+    entries.push_front(loaded);
+    usedBytes += cost;
+
+    xSemaphoreGive(mutex);
+    return loaded;
+}
+
+size_t AssetCache::footprint(const CachedAsset& asset) {
+    return asset.data ? asset.size : ASSET_CACHE_META_BYTES;
+}
+
+// FNV-1a, used for content ETags
+static uint32_t fnv1a(const uint8_t* data, size_t len) {
+    uint32_t h = 2166136261UL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= data[i];
+        h *= 16777619UL;
+    }
+    return h;
+}
+
+// Caller holds the mutex. Always returns an entry; failures are cached as
+// missing or body-less so the next lookup is answered from RAM.
+std::shared_ptr<CachedAsset> AssetCache::load(const char* path) {
+    std::shared_ptr<CachedAsset> asset = std::make_shared<CachedAsset>();
+    asset->path = path;
+
+    File f = SD.open(path, FILE_READ);
+    if (!f) return asset;
+    if (f.isDirectory()) {
+        f.close();
+        return asset;
+    }
+
+    asset->exists = true;
+    asset->size = f.size();
+    asset->lastWrite = f.getLastWrite();
+    if (asset->size == 0 || asset->size > maxFileSize) {
+        f.close();
+        return asset;
+    }
+
+    // Internal heap is tight once everything is running: rather stream from
+    // SD than take memory the network stack needs, or its largest block
+    if (!usePsram &&
+        (ESP.getFreeHeap() < asset->size + ASSET_CACHE_HEAP_FLOOR ||
+         heap_caps_get_largest_free_block(MALLOC_CAP_8BIT) < asset->size * 2)) {
+        lowHeapSkips++;
+        f.close();
+        return asset;
+    }
+
+    uint8_t* data = usePsram
+        ? (uint8_t*)heap_caps_malloc(asset->size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+        : (uint8_t*)malloc(asset->size);
+    if (!data) {
+        LOGE("[Cache] No memory for %s (%u bytes)", path, (unsigned)asset->size);
+        f.close();
+        return asset;
+    }
+
+    size_t got = f.read(data, asset->size);
+    f.close();
+    if (got != asset->size) {
+        LOGW("[Cache] Short read on %s", path);
+        free(data);
+        return asset;
+    }
+
+    asset->data = data;
+    asset->hash = fnv1a(data, asset->size);
+    return asset;
+}
+
+// Caller holds the mutex
+void AssetCache::evictFor(size_t needed) {
+    while (!entries.empty() && usedBytes + needed > budget) {
+        usedBytes -= footprint(*entries.back());
+        entries.pop_back();
+        evictions++;
+    }
+}
+
+void AssetCache::invalidate(const String& path) {
+    if (!mutex) return;
+    String key = path.startsWith("/") ? path : "/" + path;
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        if ((*it)->path == key) {
+            usedBytes -= footprint(**it);
+            entries.erase(it);
+            invalidations++;
+            break;
+        }
+    }
+    xSemaphoreGive(mutex);
+}
+
+void AssetCache::clear() {
+    if (!mutex) return;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    invalidations += entries.size();
+    entries.clear();
+    usedBytes = 0;
+    xSemaphoreGive(mutex);
+}
+
+size_t AssetCache::getEntryCount() {
+    if (!mutex) return 0;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    size_t count = entries.size();
+    xSemaphoreGive(mutex);
+    return count;
+}
@@ -0,0 +1,99 @@
+#ifndef ASSET_CACHE_H
+#define ASSET_CACHE_H
+
+#include <Arduino.h>
+#include <SD.h>
+#include <list>
+#include <memory>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+// Budgets for the asset cache, by where the bodies are stored. Internal RAM
+// is shared with WiFi, AsyncTCP and OTA: the budget is also capped to a
+// share of the heap free at begin(), and a body is only held while the
+// heap stays above the floor afterwards (otherwise it is streamed from SD).
+#define ASSET_CACHE_BUDGET_INTERNAL   (96 * 1024)
+#define ASSET_CACHE_MAX_FILE_INTERNAL (32 * 1024)
+#define ASSET_CACHE_HEAP_SHARE_PCT    25
+#define ASSET_CACHE_HEAP_FLOOR        (64 * 1024)
+#define ASSET_CACHE_BUDGET_PSRAM      (1024 * 1024)
+#define ASSET_CACHE_MAX_FILE_PSRAM    (256 * 1024)
+
+// Budget charged for entries that hold no body (missing or too-large files)
+#define ASSET_CACHE_META_BYTES 64
+
+// Result of an SD lookup, with the body held in RAM when it fits. Immutable
+// once loaded; responses keep a reference, so an entry evicted or invalidated
+// mid-transfer stays valid until sent.
+struct CachedAsset {
+    String   path;
+    bool     exists;
+    uint8_t* data;        // nullptr when missing or too large to hold
+    size_t   size;
+    time_t   lastWrite;
+    uint32_t hash;        // FNV-1a of the body, 0 when not held
+
+    CachedAsset() : exists(false), data(nullptr), size(0), lastWrite(0), hash(0) {}
+    ~CachedAsset() { free(data); }
+    CachedAsset(const CachedAsset&) = delete;
+    CachedAsset& operator=(const CachedAsset&) = delete;
+};
+
+typedef std::shared_ptr<const CachedAsset> AssetRef;
+
+/**
+ * Bounded LRU cache of web assets read from SD.
+ *
+ * Bodies live in PSRAM when the board has it, otherwise in internal heap with
+ * a smaller budget. Anything that writes to the SD card must call
+ * invalidate() for the path it touched.
+ */
+class AssetCache {
+private:
+    std::list<std::shared_ptr<CachedAsset>> entries;   // most recently used first
+    SemaphoreHandle_t mutex;
+    bool     usePsram;
+    size_t   budget;
+    size_t   maxFileSize;
+    size_t   usedBytes;
+
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t evictions;
+    uint32_t invalidations;
+    uint32_t lowHeapSkips;      // bodies streamed instead of held, heap too low
+
+    std::shared_ptr<CachedAsset> load(const char* path);
+    void evictFor(size_t needed);
+    static size_t footprint(const CachedAsset& asset);
+
+public:
+    AssetCache();
+
+    // Pick PSRAM or internal heap and set the byte budget
+    void begin();
+
+    // Cached lookup of path, reading it from SD on a miss. Missing files are
+    // remembered too, so repeated lookups never touch the card. Check
+    // exists/data on the result; nullptr only before begin().
+    AssetRef get(const char* path);
+
+    // Drop path from the cache (after upload, delete, extract)
+    void invalidate(const String& path);
+    void clear();
+
+    uint32_t getHits() const { return hits; }
+    uint32_t getMisses() const { return misses; }
+    uint32_t getEvictions() const { return evictions; }
+    uint32_t getInvalidations() const { return invalidations; }
+    uint32_t getLowHeapSkips() const { return lowHeapSkips; }
+    size_t   getUsedBytes() const { return usedBytes; }
+    size_t   getBudget() const { return budget; }
+    size_t   getEntryCount();
+    bool     inPsram() const { return usePsram; }
+};
+
+// Global instance
+extern AssetCache assetCache;
+
+#endif
@@ -15,6 +15,22 @@
 #include "MCP3208.h"
 #include "ACS712_handler.h"
 #include "web_routes.h"
+#include "counter_store.h"
+#include "spi_tuner.h"
+#include "asset_cache.h"
+#include "static_handler.h"
+#include "telemetry.h"
+#include "telemetry_batch.h"
+#include "modbus_server.h"
+#include "multicast_telemetry.h"
+#include "influx_exporter.h"
+#include "event_stream.h"
+#include "state_api.h"
+#include "metrics.h"
+#include "logger.h"
+#include "latency_trace.h"
+#include "pump_cluster.h"
+#include <atomic>
 
 // Device constants (not saved to config)
 const char* DEVICE_NAME = "AquaSensys C3";
@@ -97,21 +113,33 @@ const unsigned long DEBUG_DATA_INTERVAL = 30000;         // 30s — heavy JSON,
 
 // Create AsyncWebServer object on port 80
 AsyncWebServer server(80);
-AsyncEventSource events("/events");
 
 // Track Wi-Fi status
+enum WifiLinkState : uint8_t {
+    WIFI_LINK_IDLE,         // not associated; retried every wifiReconnectInterval
+    WIFI_LINK_SCANNING,     // async scan for the target BSSID
+    WIFI_LINK_CONNECTING,   // WiFi.begin() issued, waiting for WL_CONNECTED
+    WIFI_LINK_CONNECTED
+};
+WifiLinkState wifiState = WIFI_LINK_IDLE;
+unsigned long wifiStateSince = 0;
+const unsigned long WIFI_SCAN_TIMEOUT_MS = 10000;
+const unsigned long WIFI_CONNECT_TIMEOUT_MS = 15000;
 bool wifiConnected = false;
 bool apModeActive = false;
 unsigned long wifiReconnectInterval = 15000;
 unsigned long lastWifiReconnectAttempt = 0;
 
+// CFG_SECT_* bits changed via the API, applied by loop()
+std::atomic<uint32_t> pendingConfigSections(0);
+unsigned long wifiRestartAt = 0;   // deferred so the API response gets out first
+
 // Motor dry-run watchdog
 unsigned long motorNoFlowStart = 0;
 const unsigned long NO_FLOW_TIMEOUT_MS = 10000;
 
-// Motor runtime accumulator
-unsigned long motorRuntimeSeconds = 0;
-unsigned long lastRuntimeSave = 0;
+// Pumped volume not yet credited to the counter store (fraction of 1 mL)
+float pumpedVolumeRemainderMl = 0;
 
 // Data logging
 unsigned long lastLogTime = 0;
@@ -157,17 +185,22 @@ float readAmbientTemp() {
     return temperature;
 }
 
+/**
+ * Convert a pressure transducer voltage to bar
+ * For 0.5-4.5V = 0-5bar: pressure = (voltage - 0.5) * 1.25
+ */
+float pressureFromVoltage(float voltage, float offset) {
+    return (voltage - 0.5) * 1.25 + offset;
+}
+
 /**
  * Read input pressure from MCP3208
  */
 float readInPressure() {
     float voltage = readMCP3208Average(MCP_CH_PRESSURE_IN, NUM_SAMPLES);
 
-    // Convert voltage to pressure (bar)
-    // For 0.5-4.5V = 0-5bar: pressure = (voltage - 0.5) * 1.25
-    float pressure = (voltage - 0.5) * 1.25 + config.pressure_offset + config.pressure_in_offset;
-
-    return pressure;
+    ConfigGuard cfg;
+    return pressureFromVoltage(voltage, cfg->pressure_offset + cfg->pressure_in_offset);
 }
 
 /**
@@ -176,10 +209,8 @@ float readInPressure() {
 float readOutPressure() {
     float voltage = readMCP3208Average(MCP_CH_PRESSURE_OUT, NUM_SAMPLES);
 
-    // Convert voltage to pressure (bar)
-    float pressure = (voltage - 0.5) * 1.25 + config.pressure_offset + config.pressure_out_offset;
-
-    return pressure;
+    ConfigGuard cfg;
+    return pressureFromVoltage(voltage, cfg->pressure_offset + cfg->pressure_out_offset);
 }
 
 /**
@@ -205,7 +236,8 @@ float readAverageTemperature(int read) {
     countTemp++;
     
     if (read) {
-        float temp_voltage = totalTemp / countTemp * (5.0 / 4096.0) + config.temp_offset;
+        ConfigGuard cfg;
+        float temp_voltage = totalTemp / countTemp * (5.0 / 4096.0) + cfg->temp_offset;
         float temp_resistance = 100 * (1 / ((5.0 / temp_voltage) - 1));
         float temp = -26.92 * log(temp_resistance) + 0.0796 * temp_resistance + 126.29 ;
         totalTemp = 0;
@@ -237,9 +269,34 @@ void readAllSensors() {
     currentTotal = current.total;
 }
 
+/**
+ * Fill a telemetry frame (runs on the telemetry tasks, up to 50 Hz).
+ * Pressures are single conversions so transients show up; the slower
+ * channels come from the last 1 s measurement cycle.
+ */
+void sampleTelemetry(TelemetryFrame& frame) {
+    ConfigGuard cfg;
+    float vIn = adc.analogRead(MCP_CH_PRESSURE_IN) * MCP3208_VREF / 4095.0;
+    float vOut = adc.analogRead(MCP_CH_PRESSURE_OUT) * MCP3208_VREF / 4095.0;
+    frame.pressureIn = pressureFromVoltage(vIn, cfg->pressure_offset + cfg->pressure_in_offset);
+    frame.pressureOut = pressureFromVoltage(vOut, cfg->pressure_offset + cfg->pressure_out_offset);
+
+    frame.flow = flow;
+    frame.waterTemp = waterTemp;
+    frame.ambientTemp = ambientTemp;
+    frame.currentL1 = currentL1;
+    frame.currentL2 = currentL2;
+    frame.currentL3 = currentL3;
+    frame.currentTotal = currentTotal;
+
+    if (motor) frame.flags |= TLM_FLAG_MOTOR;
+    if (error) frame.flags |= TLM_FLAG_ERROR;
+    if (mainSwitch) frame.flags |= TLM_FLAG_MAIN_SWITCH;
+    if (manualOverride) frame.flags |= TLM_FLAG_MANUAL;
+}
+
 // Forward declarations for functions defined after setup()/loop()
-void loadRuntime();
-void saveRuntime();
+void migrateRuntimeFile();
 void appendLogEntry();
 
 // ============================================================
@@ -249,11 +306,12 @@ void appendLogEntry();
 void setup() {
     Serial.begin(115200);
     Serial.println("\n\n=== AquaSensys C3 Starting ===");
-    Serial.println("Version: " + String(DEVICE_VERSION));
+    // Everything after this goes through the log ring
+    setupLogger();
+    LOGI("Version: %s", DEVICE_VERSION);
     
     esp_reset_reason_t reset_reason = esp_reset_reason();
-    Serial.print("Reset reason: ");
-    Serial.println(reset_reason);
+    LOGI("Reset reason: %d", (int)reset_reason);
     
     // Initialize SPI for both SD and MCP3208
     SPI.begin(16, 17, 18, -1); // SCK, MISO, MOSI, SS
@@ -261,52 +319,61 @@ void setup() {
     // Initialize MCP3208
     adc.begin(MCP_CS_PIN);
     adc.analogReadResolution(12); // set resolution to 12 bit
-    Serial.println("MCP3208 initialized (Rodolfo Prieto library)");
+    // VREF is tied to VDD; the board has no supply sense, so use the nominal rail
+    tuneAdcClock(adc, MCP3208_VREF);
+    LOGI("MCP3208 initialized (Rodolfo Prieto library)");
     
     // NEW: Initialize ACS712 current sensor handler
     currentSensor.begin(&adc, 50, 5); // 50Hz AC frequency, 5 cycles per reading
     currentSensor.setCalibration(0.0, 1000.0); // offset in mV, scale factor
-    Serial.println("ACS712 current sensors initialized (L1, L2, L3)");
+    LOGI("ACS712 current sensors initialized (L1, L2, L3)");
     
     // Initialize SD Card
     initSDCard();
+    assetCache.begin();
     loadConfig();
-    loadRuntime();
+    counters.begin();
+    migrateRuntimeFile();
 
     // NEW: Load saved calibration or perform auto-calibration
-    if (config.current_offset_l1 != 0.0 || config.current_offset_l2 != 0.0 || config.current_offset_l3 != 0.0) {
+    Config bootCfg = configCopy();
+    if (bootCfg.current_offset_l1 != 0.0 || bootCfg.current_offset_l2 != 0.0 || bootCfg.current_offset_l3 != 0.0) {
         // Load saved calibration
         currentSensor.setIndividualOffsets(
-            config.current_offset_l1,
-            config.current_offset_l2,
-            config.current_offset_l3
+            bootCfg.current_offset_l1,
+            bootCfg.current_offset_l2,
+            bootCfg.current_offset_l3
         );
-        Serial.println("✓ Loaded saved current sensor calibration from config");
+        LOGI("✓ Loaded saved current sensor calibration from config");
     } else {
         // No saved calibration - perform auto-calibration
-        Serial.println("\n⚠ No saved calibration found");
-        Serial.println("⚠ IMPORTANT: Make sure motor is OFF!");
-        Serial.println("Starting auto-calibration in 3 seconds...");
+        LOGW("⚠ No saved calibration found");
+        LOGW("⚠ IMPORTANT: Make sure motor is OFF!");
+        LOGI("Starting auto-calibration in 3 seconds...");
         delay(3000);
 
         if (currentSensor.performAutoCalibration(100)) {
             CalibrationData cal = currentSensor.getCalibrationData();
-            config.current_offset_l1 = cal.offsetL1;
-            config.current_offset_l2 = cal.offsetL2;
-            config.current_offset_l3 = cal.offsetL3;
-            saveConfig();
-            Serial.println("✓ Calibration saved to config file");
+            bootCfg.current_offset_l1 = cal.offsetL1;
+            bootCfg.current_offset_l2 = cal.offsetL2;
+            bootCfg.current_offset_l3 = cal.offsetL3;
+            bootCfg.current_calibrated = true;
+            configCommit(bootCfg);
+            LOGI("✓ Calibration saved to config file");
         } else {
-            Serial.println("⚠ Using default calibration (0.0 mA offset)");
+            LOGW("⚠ Using default calibration (0.0 mA offset)");
         }
     }
     
+    // Config changes posted to the API are applied live by loop()
+    onConfigChange(CFG_SECT_WIFI | CFG_SECT_CONTROL | CFG_SECT_CALIBRATION | CFG_SECT_LOGGING,
+                   [](uint32_t changed) { pendingConfigSections.fetch_or(changed); });
+
     // Setup WiFi
     setupWiFi();
 
-    // MQTT runs on its own FreeRTOS task (Core 0) so blocking TCP connect()
-    // calls never stall the Arduino loop() task
-    xTaskCreatePinnedToCore(mqttTask, "mqtt", 8192, NULL, 1, NULL, 0);
+    // Request counting has to see every request first, so before any route
+    setupMetrics(server);
 
     // Setup OTA updates
     OTA.begin(&server, "/update");
@@ -315,17 +382,29 @@ void setup() {
     // Setup MQTT
     // Reduced from 2048 to 1024 bytes to free memory for OTA updates
     mqttClient.setBufferSize(1024);
-    mqttClient.setServer(config.mqtt_server.c_str(), config.mqtt_port);
     setupMQTT();
+
+    // MQTT runs on its own FreeRTOS task (Core 0) so blocking TCP connect()
+    // calls never stall the Arduino loop() task
+    xTaskCreatePinnedToCore(mqttTask, "mqtt", 8192, NULL, 1, NULL, 0);
     
     // Setup web routes
     webRoutes();
     
-    // Serve static files from SD card
-    server.serveStatic("/", SD, "/");
+    // Serve the web UI from SD (gzip, ETag, asset cache)
+    server.addHandler(new StaticAssetHandler());
     server.addHandler(&events);
+    metricsRoutes({ "/", "/events" });
+    telemetry.begin(server, sampleTelemetry);
+    telemetryBatch.begin(sampleTelemetry);
     server.begin();
-    Serial.println("Web server started");
+    LOGI("Web server started");
+
+    // SCADA polling over Modbus/TCP, served from the state snapshot
+    setupModbus();
+
+    // Long-term history to InfluxDB, pushed from its own task
+    setupInflux();
     
     // Setup GPIO pins
     setupPins();
@@ -334,7 +413,7 @@ void setup() {
     testLEDs();
     
     lastTime = millis();
-    Serial.println("=== Setup Complete ===\n");
+    LOGI("=== Setup Complete ===");
 }
 
 void loop() {
@@ -348,47 +427,24 @@ void loop() {
         if (millis() - lastDebugTime >= 2000) {  // Print every 2 seconds
             lastDebugTime = millis();
             
-            Serial.println("\n=== Sensor Debug Readings ===");
-            
             // Read all sensors
             readAllSensors();
-            
+
+            LOGI("=== Sensor Debug Readings ===");
             // Print temperature readings
-            Serial.print("Ambient Temperature: ");
-            Serial.print(ambientTemp);
-            Serial.println(" °C");
-            
-            Serial.print("Water Temperature: ");
-            Serial.print(waterTemp);
-            Serial.println(" °C");
+            LOGI("Ambient Temperature: %.2f °C", ambientTemp);
+            LOGI("Water Temperature: %.2f °C", waterTemp);
             
             // Print pressure readings
-            Serial.print("Input Pressure: ");
-            Serial.print(pressureIn);
-            Serial.println(" bar");
-            
-            Serial.print("Output Pressure: ");
-            Serial.print(pressureOut);
-            Serial.println(" bar");
+            LOGI("Input Pressure: %.2f bar", pressureIn);
+            LOGI("Output Pressure: %.2f bar", pressureOut);
             
             // Print current readings
-            Serial.print("Current L1: ");
-            Serial.print(currentL1);
-            Serial.println(" A");
-            
-            Serial.print("Current L2: ");
-            Serial.print(currentL2);
-            Serial.println(" A");
-            
-            Serial.print("Current L3: ");
-            Serial.print(currentL3);
-            Serial.println(" A");
-            
-            Serial.print("Total Current: ");
-            Serial.print(currentTotal);
-            Serial.println(" A");
-            
-            Serial.println("==============================\n");
+            LOGI("Current L1: %.2f A", currentL1);
+            LOGI("Current L2: %.2f A", currentL2);
+            LOGI("Current L3: %.2f A", currentL3);
+            LOGI("Total Current: %.2f A", currentTotal);
+            LOGI("==============================");
         }
         
         // Keep minimal system functions running in debug mode
@@ -412,21 +468,12 @@ void loop() {
         ESP.restart();
     }
 
-    if (!apModeActive) {
-        // Sync flag with actual hardware state so reconnect fires on mid-operation drops
-        if (wifiConnected && WiFi.status() != WL_CONNECTED) {
-            wifiConnected = false;
-            Serial.println("[WiFi] Connection lost");
-        }
+    uint32_t loopStart = micros();
+    uint32_t stageStart;
 
-        // WiFi reconnection
-        if (!wifiConnected && millis() - lastWifiReconnectAttempt > wifiReconnectInterval) {
-            Serial.println("Attempting to reconnect to Wi-Fi...");
-            lastWifiReconnectAttempt = millis();
-            setupWiFi();
-        }
-
-    }
+    applyConfigChanges();
+    configReclaim();
+    serviceWiFi();
     
     // Main measurement and control loop (every 1 second)
     unsigned long currentTime = millis();
@@ -439,35 +486,49 @@ void loop() {
         lastTime = millis();
         
         // Read all sensors (temperatures, pressures, currents)
+        stageStart = micros();
         readAllSensors();
+        stageLatency[STAGE_SENSORS].record(micros() - stageStart);
+        telemetrySampled();
 
         // Dry-run watchdog: motor on with no flow for > 10 s → error
         if (motor && flow == 0.0f) {
             if (motorNoFlowStart == 0) motorNoFlowStart = millis();
             else if (millis() - motorNoFlowStart > NO_FLOW_TIMEOUT_MS) {
-                error = true;
-                Serial.println("[Error] Motor running with no flow — possible dry run");
+                if (!error) LOGE("[Error] Motor running with no flow — possible dry run");
+                raiseFault(CNT_TRIP_DRY_RUN);
             }
         } else {
             motorNoFlowStart = 0;
         }
 
-        // Motor runtime accumulator
-        if (motor) motorRuntimeSeconds++;
-        if (millis() - lastRuntimeSave > 300000UL) {
-            lastRuntimeSave = millis();
-            saveRuntime();
+        // Lifetime counters: runtime and pumped volume (flow is L/min, 1 s period)
+        if (motor) counters.add(CNT_MOTOR_RUNTIME_S);
+        pumpedVolumeRemainderMl += flow * 1000.0f / 60.0f;
+        if (pumpedVolumeRemainderMl >= 1.0f) {
+            uint32_t wholeMl = (uint32_t)pumpedVolumeRemainderMl;
+            counters.add(CNT_PUMPED_VOLUME_ML, wholeMl);
+            pumpedVolumeRemainderMl -= wholeMl;
         }
+        counters.tick();
 
         // Periodic data logging to SD
-        if (config.log_interval_minutes > 0 &&
-            millis() - lastLogTime >= (unsigned long)config.log_interval_minutes * 60000UL) {
+        int logInterval = ConfigGuard()->log_interval_minutes;
+        if (logInterval > 0 &&
+            millis() - lastLogTime >= (unsigned long)logInterval * 60000UL) {
             lastLogTime = millis();
+            stageStart = micros();
             appendLogEntry();
+            stageLatency[STAGE_LOGGING].record(micros() - stageStart);
         }
 
         // Update clients and signal MQTT task to publish state
+        stageStart = micros();
+        updateStateSnapshot();
+        sendMulticastTelemetry();
+        influxRecordSample();
         notifyClients();
+        stageLatency[STAGE_NOTIFY].record(micros() - stageStart);
         if (!OTA.isUpdating()) {
             publishStatePending = true;
         }
@@ -477,17 +538,29 @@ void loop() {
     // Diagnostics at 5s, debug data at 30s — decoupled to avoid flooding async_tcp
     if (!OTA.isUpdating() && millis() - lastDiagnosticsUpdate >= DIAGNOSTICS_UPDATE_INTERVAL) {
         lastDiagnosticsUpdate = millis();
+        stageStart = micros();
         publishDiagnostics();
+        stageLatency[STAGE_DIAGNOSTICS].record(micros() - stageStart);
     }
     if (!OTA.isUpdating() && millis() - lastDebugDataUpdate >= DEBUG_DATA_INTERVAL) {
         lastDebugDataUpdate = millis();
+        stageStart = micros();
         publishDebugData();
+        stageLatency[STAGE_DIAGNOSTICS].record(micros() - stageStart);
     }
     // Check for error conditions
+    stageStart = micros();
+    uint32_t commandsSeen = commandMark();
     checkForErrors();
     // Control logic
     controlMotor();
+    commandsActuated(commandsSeen);
     updateLights();
+    stageLatency[STAGE_CONTROL].record(micros() - stageStart);
+    serviceLatencyStats();
+
+    // Loop time excludes the yield below
+    loopLatency.record(micros() - loopStart);
     delay(1);
 }
 
@@ -501,19 +574,45 @@ void controlMotor() {
             motor = manualMotorState;
         } else {
             if (!error){
-                if (pressure <= config.min_pressure) {
-                    motor = true;
-                } else if (pressure >= config.max_pressure) {
-                    motor = false;
+                int8_t demand = clusterMotorDemand();
+                if (demand >= 0) {
+                    // Lead/lag plan from the cluster coordinator
+                    motor = demand;
+                } else {
+                    ConfigGuard cfg;
+                    if (pressure <= cfg->min_pressure) {
+                        motor = true;
+                    } else if (pressure >= cfg->max_pressure) {
+                        motor = false;
+                    }
                 }
             }
         }
     } else {
         motor = false;
     }
+    driveMotorOutput();
+}
+
+// Write the motor relay and count off → on transitions
+void driveMotorOutput() {
+    static bool lastOutput = false;
+    if (motor && !lastOutput) {
+        counters.add(CNT_MOTOR_STARTS);
+    }
+    lastOutput = motor;
     digitalWrite(MOTOR_PIN, motor ? HIGH : LOW);
 }
 
+// Latch the error state; the trip is counted once per fault, not per loop pass
+void raiseFault(CounterId trip) {
+    if (!error) {
+        counters.add(trip);
+        publishFault(CounterStore::name(trip));
+    }
+    error = true;
+}
+
 void testLEDs(){
     ledcWrite(LED_RED, 255);
     delay(500);
@@ -539,23 +638,13 @@ void setupPins() {
 
 void updateSerial() {
     if (!debug) return;
-    Serial.print("Override: ");
-    Serial.println(manualOverride ? "ON" : "OFF");
-    Serial.print("Pressure In: ");
-    Serial.print(pressureIn);
-    Serial.println(" bar");
-    Serial.print("Pressure Out: ");
-    Serial.print(pressureOut);
-    Serial.println(" bar");
-    Serial.print("Temperature: ");
-    Serial.print(temperature);
-    Serial.println(" °C");
-    Serial.print("Ambient Temp: ");
-    Serial.print(ambientTemp);
-    Serial.println(" °C");
-    Serial.print("Motor status: ");
-    Serial.println(motor ? "ON" : "OFF");
-    Serial.printf("Current: L1=%.2fA, L2=%.2fA, L3=%.2fA\n", currentL1, currentL2, currentL3);
+    LOGI("Override: %s", manualOverride ? "ON" : "OFF");
+    LOGI("Pressure In: %.2f bar", pressureIn);
+    LOGI("Pressure Out: %.2f bar", pressureOut);
+    LOGI("Temperature: %.2f °C", temperature);
+    LOGI("Ambient Temp: %.2f °C", ambientTemp);
+    LOGI("Motor status: %s", motor ? "ON" : "OFF");
+    LOGI("Current: L1=%.2fA, L2=%.2fA, L3=%.2fA", currentL1, currentL2, currentL3);
 }
 
 void updateLights() {
@@ -595,19 +684,21 @@ void updateLights() {
 
 void checkForErrors() {
     if (!manualOverride) {
+        ConfigGuard cfg;
         if (pressure < 1.0 || pressure > 5.0) {
-            error = true;
+            raiseFault(CNT_TRIP_PRESSURE);
         }
-        if (motor && currentTotal > config.max_current) {
-            error = true;
-            Serial.println("[Error] Overcurrent detected");
+        if (motor && currentTotal > cfg->max_current) {
+            // Reported once per trip; this runs on every loop pass
+            if (!error) LOGE("[Error] Overcurrent detected");
+            raiseFault(CNT_TRIP_OVERCURRENT);
         }
         if (motor) {
             float maxI = max(currentL1, max(currentL2, currentL3));
             float minI = min(currentL1, min(currentL2, currentL3));
-            if (maxI - minI > config.max_phase_imbalance) {
-                error = true;
-                Serial.println("[Error] Phase imbalance detected");
+            if (maxI - minI > cfg->max_phase_imbalance) {
+                if (!error) LOGE("[Error] Phase imbalance detected");
+                raiseFault(CNT_TRIP_IMBALANCE);
             }
         }
     } else {
@@ -616,30 +707,64 @@ void checkForErrors() {
     if (error) {
         motor = false;
     }
-    digitalWrite(MOTOR_PIN, motor ? HIGH : LOW);
+    driveMotorOutput();
 }
 
 // ============================================================
 // SD Card Functions
 // ============================================================
 
-void loadRuntime() {
+// Apply config sections changed through the API without a reboot
+void applyConfigChanges() {
+    uint32_t changed = pendingConfigSections.exchange(0);
+
+    if (changed & CFG_SECT_WIFI) {
+        LOGI("[Config] WiFi settings changed, re-associating");
+        wifiRestartAt = millis() + 1000;
+        if (wifiRestartAt == 0) wifiRestartAt = 1;
+    }
+    if (wifiRestartAt && (long)(millis() - wifiRestartAt) >= 0) {
+        wifiRestartAt = 0;
+        startWiFi();
+    }
+
+    if (!(changed & (CFG_SECT_CALIBRATION | CFG_SECT_CONTROL | CFG_SECT_LOGGING))) return;
+
+    ConfigGuard cfg;
+    if (changed & CFG_SECT_CALIBRATION) {
+        currentSensor.setIndividualOffsets(
+            cfg->current_offset_l1,
+            cfg->current_offset_l2,
+            cfg->current_offset_l3
+        );
+        LOGI("[Config] Sensor offsets applied");
+    }
+    if (changed & CFG_SECT_CONTROL) {
+        // controlMotor() and checkForErrors() read thresholds every cycle
+        LOGI("[Config] Pressure window %.2f-%.2f bar, max current %.1f A",
+             cfg->min_pressure, cfg->max_pressure, cfg->max_current);
+    }
+    if (changed & CFG_SECT_LOGGING) {
+        lastLogTime = millis();
+        LOGI("[Config] Log interval now %d min", cfg->log_interval_minutes);
+    }
+}
+
+// One-time import of the motor runtime saved by older firmware. The counter
+// store owns the value from then on, so the file is removed afterwards.
+void migrateRuntimeFile() {
     File f = SD.open("/runtime.json");
     if (!f) return;
     DynamicJsonDocument doc(128);
+    unsigned long legacyRuntime = 0;
     if (deserializeJson(doc, f) == DeserializationError::Ok)
-        motorRuntimeSeconds = doc["motor_runtime_s"] | (unsigned long)0;
+        legacyRuntime = doc["motor_runtime_s"] | (unsigned long)0;
     f.close();
-    Serial.printf("[Runtime] Loaded motor runtime: %lu s\n", motorRuntimeSeconds);
-}
 
-void saveRuntime() {
-    File f = SD.open("/runtime.json", FILE_WRITE);
-    if (!f) return;
-    DynamicJsonDocument doc(128);
-    doc["motor_runtime_s"] = motorRuntimeSeconds;
-    serializeJson(doc, f);
-    f.close();
+    counters.seed(CNT_MOTOR_RUNTIME_S, legacyRuntime);
+    counters.flush();
+    SD.remove("/runtime.json");
+    LOGI("[Runtime] Migrated motor runtime from runtime.json: %lu s", legacyRuntime);
 }
 
 void appendLogEntry() {
@@ -651,33 +776,33 @@ void appendLogEntry() {
         millis() / 1000, pressureIn, pressureOut, flow,
         currentL1, currentL2, currentL3, motor ? "ON" : "OFF");
     f.close();
+    assetCache.invalidate("/log.csv");
 }
 
 void initSDCard() {
-    if (!SD.begin(TF_CS_PIN)) {
-        Serial.println("SD Card Mount Failed");
+    if (!tuneSdClock(TF_CS_PIN)) {
+        LOGE("SD Card Mount Failed");
         return;
     }
     uint8_t cardType = SD.cardType();
     
     if (cardType == CARD_NONE) {
-        Serial.println("No SD card attached");
+        LOGE("No SD card attached");
         return;
     }
     
-    Serial.print("SD Card Type: ");
+    const char* typeName = "UNKNOWN";
     if (cardType == CARD_MMC) {
-        Serial.println("MMC");
+        typeName = "MMC";
     } else if (cardType == CARD_SD) {
-        Serial.println("SDSC");
+        typeName = "SDSC";
     } else if (cardType == CARD_SDHC) {
-        Serial.println("SDHC");
-    } else {
-        Serial.println("UNKNOWN");
+        typeName = "SDHC";
     }
+    LOGI("SD Card Type: %s", typeName);
     uint64_t cardSize = SD.cardSize() / (1024 * 1024);
-    Serial.printf("SD Card Size: %lluMB\n", cardSize);
-    Serial.println("SD Card initialized successfully");
+    LOGI("SD Card Size: %lluMB", cardSize);
+    LOGI("SD Card initialized successfully");
 }
 
 // ============================================================
@@ -694,33 +819,48 @@ void setupAPMode() {
     String ssid = String("AquaSensys-") + macSuffix;
     WiFi.softAP(ssid.c_str());
     apModeActive = true;
-    Serial.println("[AP] No WiFi credentials found. Access Point started.");
-    Serial.printf("[AP] SSID: %s\n", ssid.c_str());
-    Serial.printf("[AP] IP:   %s\n", WiFi.softAPIP().toString().c_str());
-    Serial.println("[AP] Connect and open http://192.168.4.1 to configure WiFi.");
+    LOGW("[AP] No WiFi credentials found. Access Point started.");
+    LOGI("[AP] SSID: %s", ssid.c_str());
+    LOGI("[AP] IP:   %s", WiFi.softAPIP().toString().c_str());
+    LOGI("[AP] Connect and open http://192.168.4.1 to configure WiFi.");
 }
 
-void setupWiFi() {
-    if (config.wifi_ssid.isEmpty()) {
-        setupAPMode();
+// Start (or restart) association with the configured network. Non-blocking:
+// the scan and connect are advanced by serviceWiFi() from loop().
+void startWiFi() {
+    ConfigGuard cfg;
+    if (cfg->wifi_ssid.isEmpty()) {
+        if (!apModeActive) setupAPMode();
         return;
     }
+    if (apModeActive) {
+        WiFi.softAPdisconnect(true);
+        apModeActive = false;
+        LOGI("[AP] Credentials configured, leaving Access Point mode");
+    }
+
     WiFi.persistent(false);  // credentials managed via config.json, not NVS
-    WiFi.mode(WIFI_OFF);     // stop any auto-connect retained from previous session
-    delay(100);
+    WiFi.disconnect();       // stop any auto-connect retained from previous session
     WiFi.mode(WIFI_STA);
-    Serial.print("Connecting to ");
-    Serial.println(config.wifi_ssid);
+    wifiConnected = false;
+    LOGI("Connecting to %s", cfg->wifi_ssid.c_str());
 
     // Scan to find the BSSID of the target SSID so we can pin to it.
     // This bypasses band-steering on dual-band routers that share an SSID.
-    Serial.println("[WiFi] Scanning...");
-    int scanCount = WiFi.scanNetworks(false, false);
+    LOGI("[WiFi] Scanning...");
+    WiFi.scanNetworks(true, false);
+    wifiState = WIFI_LINK_SCANNING;
+    wifiStateSince = millis();
+}
+
+// Pick the strongest BSSID for our SSID from the finished scan and associate
+static void beginAssociation(int scanCount) {
+    ConfigGuard cfg;
     uint8_t targetBSSID[6] = {0};
     bool bssidFound = false;
     int bestRSSI = -100;
     for (int i = 0; i < scanCount; i++) {
-        if (WiFi.SSID(i) == config.wifi_ssid && WiFi.RSSI(i) > bestRSSI) {
+        if (WiFi.SSID(i) == cfg->wifi_ssid && WiFi.RSSI(i) > bestRSSI) {
             memcpy(targetBSSID, WiFi.BSSID(i), 6);
             bestRSSI = WiFi.RSSI(i);
             bssidFound = true;
@@ -729,43 +869,79 @@ void setupWiFi() {
     WiFi.scanDelete();
 
     if (bssidFound) {
-        Serial.printf("[WiFi] Pinning to BSSID %02X:%02X:%02X:%02X:%02X:%02X (RSSI %d)\n",
+        LOGI("[WiFi] Pinning to BSSID %02X:%02X:%02X:%02X:%02X:%02X (RSSI %d)",
             targetBSSID[0], targetBSSID[1], targetBSSID[2],
             targetBSSID[3], targetBSSID[4], targetBSSID[5], bestRSSI);
-        WiFi.begin(config.wifi_ssid.c_str(), config.wifi_password.c_str(), 0, targetBSSID);
+        WiFi.begin(cfg->wifi_ssid.c_str(), cfg->wifi_password.c_str(), 0, targetBSSID);
     } else {
-        Serial.println("[WiFi] SSID not found in scan, connecting without BSSID pin");
-        WiFi.begin(config.wifi_ssid.c_str(), config.wifi_password.c_str());
+        LOGW("[WiFi] SSID not found in scan, connecting without BSSID pin");
+        WiFi.begin(cfg->wifi_ssid.c_str(), cfg->wifi_password.c_str());
     }
-    
-    unsigned long startAttemptTime = millis();
-    while (WiFi.status() != WL_CONNECTED && millis() - startAttemptTime < 15000) {
-        delay(500);
-        Serial.print(".");
+    wifiState = WIFI_LINK_CONNECTING;
+    wifiStateSince = millis();
+}
+
+// Advance the Wi-Fi state machine; never blocks
+void serviceWiFi() {
+    switch (wifiState) {
+        case WIFI_LINK_IDLE:
+            if (!apModeActive && millis() - lastWifiReconnectAttempt > wifiReconnectInterval) {
+                LOGI("Attempting to reconnect to Wi-Fi...");
+                lastWifiReconnectAttempt = millis();
+                startWiFi();
+            }
+            break;
+
+        case WIFI_LINK_SCANNING: {
+            int scanCount = WiFi.scanComplete();
+            if (scanCount == WIFI_SCAN_RUNNING && millis() - wifiStateSince < WIFI_SCAN_TIMEOUT_MS) break;
+            beginAssociation(scanCount > 0 ? scanCount : 0);
+            break;
+        }
+
+        case WIFI_LINK_CONNECTING:
+            if (WiFi.status() == WL_CONNECTED) {
+                LOGI("Connected to %s", WiFi.SSID().c_str());
+                LOGI("IP Address: %s", WiFi.localIP().toString().c_str());
+                wifiConnected = true;
+                wifiState = WIFI_LINK_CONNECTED;
+                castDNS();
+            } else if (millis() - wifiStateSince >= WIFI_CONNECT_TIMEOUT_MS) {
+                LOGW("Failed to connect to WiFi. Running in offline mode.");
+                wifiConnected = false;
+                wifiState = WIFI_LINK_IDLE;
+                lastWifiReconnectAttempt = millis();
+            }
+            break;
+
+        case WIFI_LINK_CONNECTED:
+            // Sync flag with actual hardware state so reconnect fires on mid-operation drops
+            if (WiFi.status() != WL_CONNECTED) {
+                LOGW("[WiFi] Connection lost");
+                wifiConnected = false;
+                wifiState = WIFI_LINK_IDLE;
+            }
+            break;
     }
+}
 
-    if (WiFi.status() == WL_CONNECTED) {
-        Serial.print("\nConnected to ");
-        Serial.println(config.wifi_ssid);
-        Serial.print("IP Address: ");
-        Serial.println(WiFi.localIP());
-        wifiConnected = true;
-        castDNS();
-    } else {
-        Serial.println("\nFailed to connect to WiFi. Running in offline mode.");
-        wifiConnected = false;
+// Boot-time connect: runs the same state machine, but waits for the outcome
+void setupWiFi() {
+    startWiFi();
+    while (wifiState == WIFI_LINK_SCANNING || wifiState == WIFI_LINK_CONNECTING) {
+        serviceWiFi();
+        delay(100);
     }
+    lastWifiReconnectAttempt = millis();
 }
 
 void castDNS() {
     if (MDNS.begin(DEVICE_ID)) {
-        Serial.println("mDNS responder started");
-        Serial.print("Access your ESP32 at: http://");
-        Serial.print(DEVICE_ID);
-        Serial.println(".local");
+        LOGI("mDNS responder started");
+        LOGI("Access your ESP32 at: http://%s.local", DEVICE_ID);
         MDNS.addService("http", "tcp", 80);
     } else {
-        Serial.println("Error starting mDNS");
+        LOGE("Error starting mDNS");
     }
 }
 
@@ -1,123 +1,322 @@
 #include "config_manager.h"
-
-// Global config instance
-Config config;
+#include <Preferences.h>
+#include <rom/crc.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <atomic>
+#include "logger.h"
+
+// ─── Versioned config state ─────────────────────────────────────────────────
+//
+// Readers register in one of two counters chosen by the epoch parity. A commit
+// swaps the pointer, then flips the epoch, so only readers counted under the
+// old parity can still hold the replaced version; it is freed once that
+// counter drains. The next commit waits for this before flipping back.
+
+static Config bootConfig;                          // defaults until loadConfig()
+static std::atomic<Config*> liveConfig(&bootConfig);
+static std::atomic<uint32_t> configEpoch(0);
+static std::atomic<uint32_t> configReaders[2];
+static std::atomic<uint32_t> configVersionCounter(0);
+
+// Writer-side state, guarded by configWriteMutex
+static SemaphoreHandle_t configWriteMutex = NULL;
+static Config* retiredConfig = nullptr;
+static uint8_t retiredSlot = 0;
 
 const char* CONFIG_FILE = "/config.json";
 static const char* CONFIG_TMP  = "/config.tmp";
 
-bool loadConfig() {
-    // Recover an interrupted atomic save: if the main file is missing but the
-    // temp file exists, the device was reset between SD.remove() and SD.rename().
-    // Complete the rename now so the saved data is not lost.
-    if (!SD.exists(CONFIG_FILE) && SD.exists(CONFIG_TMP)) {
-        Serial.println("[Config] Recovering interrupted save from config.tmp");
-        SD.rename(CONFIG_TMP, CONFIG_FILE);
+// Change subscribers — registered once in setup(), never removed
+#define CONFIG_MAX_SUBSCRIBERS 8
+
+struct ConfigSubscriber {
+    uint32_t sections;
+    ConfigChangeHandler handler;
+};
+
+static ConfigSubscriber configSubscribers[CONFIG_MAX_SUBSCRIBERS];
+static uint8_t configSubscriberCount = 0;
+
+// ─── Per-type field helpers (used by the CONFIG_FIELDS expansions) ──────────
+
+static void cfgClamp(const char* key, int& value, double lo, double hi) {
+    if (value < lo || value > hi) {
+        int clamped = value < lo ? (int)lo : (int)hi;
+        LOGW("[Config] %s=%d out of range, clamped to %d", key, value, clamped);
+        value = clamped;
     }
+}
 
-    if (!SD.exists(CONFIG_FILE)) {
-        Serial.println("Config file not found, creating with defaults");
-        return saveConfig();
+static void cfgClamp(const char* key, float& value, double lo, double hi) {
+    if (isnan(value) || value < lo || value > hi) {
+        float clamped = (isnan(value) || value < lo) ? (float)lo : (float)hi;
+        LOGW("[Config] %s=%.3f out of range, clamped to %.3f", key, value, clamped);
+        value = clamped;
     }
+}
 
-    File configFile = SD.open(CONFIG_FILE);
-    if (!configFile) {
-        Serial.println("Failed to open config file");
-        return false;
+static void cfgClamp(const char* key, bool& value, double lo, double hi) {}
+
+static void cfgClamp(const char* key, String& value, double lo, double hi) {
+    if (value.length() > (unsigned int)hi) {
+        LOGW("[Config] %s longer than %u chars, truncated", key, (unsigned int)hi);
+        value = value.substring(0, (unsigned int)hi);
     }
+}
 
-    size_t size = configFile.size();
-    if (size > 2048) {
-        Serial.println("Config file too large");
-        configFile.close();
+// Apply one /api/config value; secrets are only replaced by non-empty strings
+static void cfgAssign(String& field, JsonVariant value, uint8_t flags) {
+    String str = value.as<String>();
+    if ((flags & CFG_SECRET) && str.length() == 0) return;
+    field = str;
+}
+
+template <typename T>
+static void cfgAssign(T& field, JsonVariant value, uint8_t flags) {
+    field = value.as<T>();
+}
+
+// Binary packing for the NVS snapshot: scalars verbatim, strings length-prefixed
+template <typename T>
+static bool cfgPut(uint8_t* buf, size_t cap, size_t& pos, const T& value) {
+    if (pos + sizeof(T) > cap) return false;
+    memcpy(buf + pos, &value, sizeof(T));
+    pos += sizeof(T);
+    return true;
+}
+
+static bool cfgPut(uint8_t* buf, size_t cap, size_t& pos, const String& value) {
+    uint16_t len = value.length();
+    if (!cfgPut(buf, cap, pos, len) || pos + len > cap) return false;
+    memcpy(buf + pos, value.c_str(), len);
+    pos += len;
+    return true;
+}
+
+template <typename T>
+static bool cfgGet(const uint8_t* buf, size_t len, size_t& pos, T& value) {
+    if (pos + sizeof(T) > len) return false;
+    memcpy(&value, buf + pos, sizeof(T));
+    pos += sizeof(T);
+    return true;
+}
+
+static bool cfgGet(const uint8_t* buf, size_t len, size_t& pos, String& value) {
+    uint16_t strLen;
+    if (!cfgGet(buf, len, pos, strLen) || pos + strLen > len) return false;
+    value = "";
+    value.concat((const char*)(buf + pos), strLen);
+    pos += strLen;
+    return true;
+}
+
+// ─── Binary NVS snapshot ────────────────────────────────────────────────────
+//
+// Boot normally restores the config from this snapshot instead of parsing
+// config.json. The snapshot records the size and mtime of the config.json it
+// mirrors; if the file on SD differs (edited on a PC, restored from backup)
+// the JSON is parsed again and the snapshot rewritten.
+
+#define CONFIG_SNAPSHOT_MAGIC 0x53474643  // "CFGS"
+#define CONFIG_SNAPSHOT_MAX   768
+
+struct ConfigSnapshotHeader {
+    uint32_t magic;
+    uint32_t schema;       // fingerprint of CONFIG_FIELDS names and types
+    uint32_t sourceSize;   // config.json size this snapshot mirrors
+    uint32_t sourceMtime;  // config.json last-write time
+    uint32_t length;       // payload bytes following the header
+    uint32_t crc;          // CRC-32 of the payload
+};
+
+// Changes whenever a field is added, removed, renamed or retyped
+static uint32_t configSchemaFingerprint() {
+    static const char schema[] =
+#define X(type, name, def, lo, hi, flags, sect) #type ":" #name ";"
+        CONFIG_FIELDS(X)
+#undef X
+        ;
+    return crc32_le(0, (const uint8_t*)schema, sizeof(schema) - 1);
+}
+
+static bool configFileStamp(uint32_t& size, uint32_t& mtime) {
+    File f = SD.open(CONFIG_FILE);
+    if (!f) return false;
+    size = f.size();
+    mtime = (uint32_t)f.getLastWrite();
+    f.close();
+    return true;
+}
+
+static bool loadConfigSnapshot(uint32_t fileSize, uint32_t fileMtime, Config& out) {
+    Preferences prefs;
+    if (!prefs.begin("config", true)) return false;
+
+    uint8_t blob[sizeof(ConfigSnapshotHeader) + CONFIG_SNAPSHOT_MAX];
+    size_t blobLen = prefs.getBytes("snapshot", blob, sizeof(blob));
+    prefs.end();
+    if (blobLen < sizeof(ConfigSnapshotHeader)) return false;
+
+    ConfigSnapshotHeader hdr;
+    memcpy(&hdr, blob, sizeof(hdr));
+    const uint8_t* payload = blob + sizeof(hdr);
+
+    if (hdr.magic != CONFIG_SNAPSHOT_MAGIC ||
+        hdr.schema != configSchemaFingerprint() ||
+        hdr.sourceSize != fileSize || hdr.sourceMtime != fileMtime ||
+        hdr.length != blobLen - sizeof(hdr) ||
+        hdr.crc != crc32_le(0, payload, hdr.length)) {
         return false;
     }
 
-    DynamicJsonDocument doc(2048);
-    DeserializationError error = deserializeJson(doc, configFile);
-    configFile.close();
+    Config loaded;
+    size_t pos = 0;
+    bool ok = true;
+#define X(type, name, def, lo, hi, flags, sect) ok = ok && cfgGet(payload, hdr.length, pos, loaded.name);
+    CONFIG_FIELDS(X)
+#undef X
+    if (!ok || pos != hdr.length) return false;
 
-    if (error) {
-        Serial.print("Failed to parse config file: ");
-        Serial.println(error.c_str());
+    out = loaded;
+    return true;
+}
+
+static bool saveConfigSnapshot(const Config& cfg) {
+    uint32_t fileSize, fileMtime;
+    if (!configFileStamp(fileSize, fileMtime)) return false;
+
+    uint8_t blob[sizeof(ConfigSnapshotHeader) + CONFIG_SNAPSHOT_MAX];
+    uint8_t* payload = blob + sizeof(ConfigSnapshotHeader);
+    size_t pos = 0;
+    bool ok = true;
+#define X(type, name, def, lo, hi, flags, sect) ok = ok && cfgPut(payload, CONFIG_SNAPSHOT_MAX, pos, cfg.name);
+    CONFIG_FIELDS(X)
+#undef X
+    if (!ok) {
+        LOGW("[Config] Snapshot too large, skipped");
         return false;
     }
 
-    config.wifi_ssid     = doc["wifi_ssid"]     | config.wifi_ssid;
-    config.wifi_password = doc["wifi_password"] | config.wifi_password;
-
-    config.mqtt_server   = doc["mqtt_server"]   | config.mqtt_server;
-    config.mqtt_port     = doc["mqtt_port"]     | config.mqtt_port;
-    config.mqtt_user     = doc["mqtt_user"]     | config.mqtt_user;
-    config.mqtt_password = doc["mqtt_password"] | config.mqtt_password;
+    ConfigSnapshotHeader hdr;
+    hdr.magic       = CONFIG_SNAPSHOT_MAGIC;
+    hdr.schema      = configSchemaFingerprint();
+    hdr.sourceSize  = fileSize;
+    hdr.sourceMtime = fileMtime;
+    hdr.length      = pos;
+    hdr.crc         = crc32_le(0, payload, pos);
+    memcpy(blob, &hdr, sizeof(hdr));
+
+    Preferences prefs;
+    if (!prefs.begin("config", false)) return false;
+    size_t total = sizeof(hdr) + pos;
+    bool written = prefs.putBytes("snapshot", blob, total) == total;
+    prefs.end();
+    return written;
+}
 
-    config.min_pressure    = doc["min_pressure"]    | config.min_pressure;
-    config.max_pressure    = doc["max_pressure"]    | config.max_pressure;
-    config.pressure_offset = doc["pressure_offset"] | config.pressure_offset;
-    config.temp_offset     = doc["temp_offset"]     | config.temp_offset;
+// ─── Versioned access ───────────────────────────────────────────────────────
 
-    config.pressure_in_offset  = doc["pressure_in_offset"]  | config.pressure_in_offset;
-    config.pressure_out_offset = doc["pressure_out_offset"] | config.pressure_out_offset;
-    config.pressure_calibrated = doc["pressure_calibrated"] | config.pressure_calibrated;
+const Config* configAcquire(uint8_t& slot) {
+    for (;;) {
+        uint32_t epoch = configEpoch.load();
+        slot = epoch & 1;
+        configReaders[slot].fetch_add(1);
+        if (configEpoch.load() == epoch) break;
+        // A commit flipped the epoch in between; register under the new parity
+        configReaders[slot].fetch_sub(1);
+    }
+    return liveConfig.load();
+}
 
-    config.current_offset_l1 = doc["current_offset_l1"] | config.current_offset_l1;
-    config.current_offset_l2 = doc["current_offset_l2"] | config.current_offset_l2;
-    config.current_offset_l3 = doc["current_offset_l3"] | config.current_offset_l3;
-    config.current_calibrated = doc["current_calibrated"] | config.current_calibrated;
+void configRelease(uint8_t slot) {
+    configReaders[slot].fetch_sub(1);
+}
 
-    config.max_current          = doc["max_current"]          | config.max_current;
-    config.max_phase_imbalance  = doc["max_phase_imbalance"]  | config.max_phase_imbalance;
-    config.log_interval_minutes = doc["log_interval_minutes"] | config.log_interval_minutes;
-    config.config_version       = doc["config_version"]       | 1;
+static void configLock() {
+    if (!configWriteMutex) configWriteMutex = xSemaphoreCreateMutex();
+    xSemaphoreTake(configWriteMutex, portMAX_DELAY);
+}
 
-    if (config.config_version != 1)
-        Serial.printf("[Config] Warning: unexpected config version %d\n", config.config_version);
+static void configUnlock() {
+    xSemaphoreGive(configWriteMutex);
+}
 
-    Serial.println("Config loaded successfully");
-    printConfig();
+// Caller holds configWriteMutex
+static bool reclaimRetired() {
+    if (!retiredConfig) return true;
+    if (configReaders[retiredSlot].load() != 0) return false;
+    if (retiredConfig != &bootConfig) delete retiredConfig;
+    retiredConfig = nullptr;
     return true;
 }
 
-bool saveConfig() {
-    DynamicJsonDocument doc(2048);
+// Caller holds configWriteMutex
+static void publishConfig(Config* next) {
+    // The previous version must be gone before its parity is reused
+    while (!reclaimRetired()) vTaskDelay(1);
+
+    uint32_t epoch = configEpoch.load();
+    retiredConfig = liveConfig.exchange(next);
+    retiredSlot = epoch & 1;
+    configEpoch.store(epoch + 1);
+    configVersionCounter.fetch_add(1);
+}
 
-    doc["wifi_ssid"]     = config.wifi_ssid;
-    doc["wifi_password"] = config.wifi_password;
+void configReclaim() {
+    if (!retiredConfig || !configWriteMutex) return;
+    if (xSemaphoreTake(configWriteMutex, 0) != pdTRUE) return;
+    reclaimRetired();
+    configUnlock();
+}
 
-    doc["mqtt_server"]   = config.mqtt_server;
-    doc["mqtt_port"]     = config.mqtt_port;
-    doc["mqtt_user"]     = config.mqtt_user;
-    doc["mqtt_password"] = config.mqtt_password;
+uint32_t configVersion() {
+    return configVersionCounter.load();
+}
 
-    doc["min_pressure"]    = config.min_pressure;
-    doc["max_pressure"]    = config.max_pressure;
-    doc["pressure_offset"] = config.pressure_offset;
-    doc["temp_offset"]     = config.temp_offset;
+Config configCopy() {
+    ConfigGuard cfg;
+    return *cfg;
+}
 
-    doc["pressure_in_offset"]  = config.pressure_in_offset;
-    doc["pressure_out_offset"] = config.pressure_out_offset;
-    doc["pressure_calibrated"] = config.pressure_calibrated;
+// ─── Schema migration ───────────────────────────────────────────────────────
 
-    doc["current_offset_l1"] = config.current_offset_l1;
-    doc["current_offset_l2"] = config.current_offset_l2;
-    doc["current_offset_l3"] = config.current_offset_l3;
-    doc["current_calibrated"] = config.current_calibrated;
+void migrateConfig(Config& cfg) {
+    if (cfg.config_version > CONFIG_VERSION) {
+        LOGW("[Config] Warning: config version %d is newer than firmware (%d)",
+             cfg.config_version, CONFIG_VERSION);
+        return;
+    }
 
-    doc["max_current"]          = config.max_current;
-    doc["max_phase_imbalance"]  = config.max_phase_imbalance;
-    doc["log_interval_minutes"] = config.log_interval_minutes;
-    doc["config_version"]       = config.config_version;
+    if (cfg.config_version < 2) {
+        // v1 firmware stored calibration offsets without setting the flags
+        if (cfg.current_offset_l1 != 0.0f || cfg.current_offset_l2 != 0.0f || cfg.current_offset_l3 != 0.0f)
+            cfg.current_calibrated = true;
+        if (cfg.pressure_in_offset != 0.0f || cfg.pressure_out_offset != 0.0f)
+            cfg.pressure_calibrated = true;
+        cfg.config_version = 2;
+    }
+}
+
+// ─── Load / save ────────────────────────────────────────────────────────────
+
+static bool writeConfigFile(const Config& cfg) {
+    DynamicJsonDocument doc(2048);
+
+#define X(type, name, def, lo, hi, flags, sect) doc[#name] = cfg.name;
+    CONFIG_FIELDS(X)
+#undef X
 
     // Write to temp file first; rename on success (atomic swap)
     if (SD.exists(CONFIG_TMP)) SD.remove(CONFIG_TMP);
     File tmpFile = SD.open(CONFIG_TMP, FILE_WRITE);
     if (!tmpFile) {
-        Serial.println("Failed to create temp config file");
+        LOGE("Failed to create temp config file");
         return false;
     }
 
     if (serializeJsonPretty(doc, tmpFile) == 0) {
-        Serial.println("Failed to write config file");
+        LOGE("Failed to write config file");
         tmpFile.close();
         SD.remove(CONFIG_TMP);
         return false;
@@ -127,105 +326,189 @@ bool saveConfig() {
     if (SD.exists(CONFIG_FILE)) SD.remove(CONFIG_FILE);
     SD.rename(CONFIG_TMP, CONFIG_FILE);
 
-    Serial.println("Config saved successfully");
+    if (!saveConfigSnapshot(cfg)) {
+        LOGW("[Config] Warning: NVS snapshot not updated");
+    }
+
+    LOGI("Config saved successfully");
     return true;
 }
 
-void printConfig() {
-    Serial.println("=== Current Configuration ===");
-    Serial.println("WiFi SSID: " + config.wifi_ssid);
-    Serial.println("WiFi Password: " + String(config.wifi_password.length()) + " chars");
-    Serial.println("MQTT Server: " + config.mqtt_server);
-    Serial.println("MQTT Port: " + String(config.mqtt_port));
-    Serial.println("MQTT User: " + config.mqtt_user);
-    Serial.println("MQTT Password: " + String(config.mqtt_password.length()) + " chars");
-    Serial.println("Min Pressure: " + String(config.min_pressure));
-    Serial.println("Max Pressure: " + String(config.max_pressure));
-    Serial.println("Pressure Offset: " + String(config.pressure_offset));
-    Serial.println("Temp Offset: " + String(config.temp_offset));
-    Serial.println("Current Offset L1: " + String(config.current_offset_l1));
-    Serial.println("Current Offset L2: " + String(config.current_offset_l2));
-    Serial.println("Current Offset L3: " + String(config.current_offset_l3));
-    Serial.println("Current Calibrated: " + String(config.current_calibrated ? "Yes" : "No"));
-    Serial.println("Max Current: " + String(config.max_current) + " A");
-    Serial.println("Max Phase Imbalance: " + String(config.max_phase_imbalance) + " A");
-    Serial.println("Log Interval: " + String(config.log_interval_minutes) + " min");
-    Serial.println("===========================");
-}
+// Parse config.json (or its NVS snapshot) into cfg. Sets needsSave when the
+// file is missing or was migrated from an older schema.
+static bool readConfig(Config& cfg, bool& needsSave) {
+    needsSave = false;
+
+    // Recover an interrupted atomic save: if the main file is missing but the
+    // temp file exists, the device was reset between SD.remove() and SD.rename().
+    // Complete the rename now so the saved data is not lost.
+    if (!SD.exists(CONFIG_FILE) && SD.exists(CONFIG_TMP)) {
+        LOGI("[Config] Recovering interrupted save from config.tmp");
+        SD.rename(CONFIG_TMP, CONFIG_FILE);
+    }
+
+    if (!SD.exists(CONFIG_FILE)) {
+        LOGI("Config file not found, creating with defaults");
+        needsSave = true;
+        return true;
+    }
+
+    uint32_t fileSize, fileMtime;
+    if (configFileStamp(fileSize, fileMtime) && loadConfigSnapshot(fileSize, fileMtime, cfg)) {
+        LOGI("Config loaded from NVS snapshot");
+        return true;
+    }
+
+    File configFile = SD.open(CONFIG_FILE);
+    if (!configFile) {
+        LOGE("Failed to open config file");
+        return false;
+    }
+
+    size_t size = configFile.size();
+    if (size > 2048) {
+        LOGW("Config file too large");
+        configFile.close();
+        return false;
+    }
 
-String getConfigJson() {
     DynamicJsonDocument doc(2048);
+    DeserializationError error = deserializeJson(doc, configFile);
+    configFile.close();
 
-    doc["wifi_ssid"]   = config.wifi_ssid;
-    // passwords not sent
-    doc["mqtt_server"] = config.mqtt_server;
-    doc["mqtt_port"]   = config.mqtt_port;
-    doc["mqtt_user"]   = config.mqtt_user;
+    if (error) {
+        LOGE("Failed to parse config file: %s", error.c_str());
+        return false;
+    }
 
-    doc["min_pressure"]    = config.min_pressure;
-    doc["max_pressure"]    = config.max_pressure;
-    doc["pressure_offset"] = config.pressure_offset;
-    doc["temp_offset"]     = config.temp_offset;
+#define X(type, name, def, lo, hi, flags, sect) \
+    cfg.name = doc[#name] | cfg.name; \
+    cfgClamp(#name, cfg.name, lo, hi);
+    CONFIG_FIELDS(X)
+#undef X
+    // Files written before the version field existed are v1
+    cfg.config_version = doc["config_version"] | 1;
 
-    doc["pressure_in_offset"]  = config.pressure_in_offset;
-    doc["pressure_out_offset"] = config.pressure_out_offset;
-    doc["pressure_calibrated"] = config.pressure_calibrated;
+    int loadedVersion = cfg.config_version;
+    migrateConfig(cfg);
 
-    doc["current_offset_l1"] = config.current_offset_l1;
-    doc["current_offset_l2"] = config.current_offset_l2;
-    doc["current_offset_l3"] = config.current_offset_l3;
-    doc["current_calibrated"] = config.current_calibrated;
+    LOGI("Config loaded successfully");
 
-    doc["max_current"]          = config.max_current;
-    doc["max_phase_imbalance"]  = config.max_phase_imbalance;
-    doc["log_interval_minutes"] = config.log_interval_minutes;
+    if (cfg.config_version != loadedVersion) {
+        LOGI("[Config] Migrated config from v%d to v%d", loadedVersion, cfg.config_version);
+        needsSave = true;
+    } else {
+        saveConfigSnapshot(cfg);
+    }
+    return true;
+}
+
+bool loadConfig() {
+    Config* loaded = new Config();
+    bool needsSave = false;
+    bool ok = readConfig(*loaded, needsSave);
+    if (ok && needsSave) ok = writeConfigFile(*loaded);
+
+    configLock();
+    publishConfig(loaded);
+    configUnlock();
+
+    printConfig();
+    return ok;
+}
+
+bool configCommit(const Config& next, uint32_t* changedSections) {
+    configLock();
+
+    // Only writers replace the live version, so the writer may read it unguarded
+    const Config* current = liveConfig.load();
+    uint32_t changed = 0;
+#define X(type, name, def, lo, hi, flags, sect) if (!(current->name == next.name)) changed |= (sect);
+    CONFIG_FIELDS(X)
+#undef X
+
+    bool saved = writeConfigFile(next);
+    publishConfig(new Config(next));
+    configUnlock();
+
+    if (changedSections) *changedSections = changed;
+    notifyConfigChanged(changed);
+    return saved;
+}
+
+static void printField(const char* key, const String& value, uint8_t flags) {
+    if (flags & CFG_SECRET)
+        LOGD("%s: %u chars", key, value.length());
+    else
+        LOGD("%s: %s", key, value.c_str());
+}
+
+static void printField(const char* key, int value, uint8_t flags)   { LOGD("%s: %d", key, value); }
+static void printField(const char* key, float value, uint8_t flags) { LOGD("%s: %.3f", key, value); }
+static void printField(const char* key, bool value, uint8_t flags)  { LOGD("%s: %s", key, value ? "Yes" : "No"); }
+
+void printConfig() {
+    ConfigGuard cfg;
+    LOGD("=== Current Configuration ===");
+#define X(type, name, def, lo, hi, flags, sect) printField(#name, cfg->name, flags);
+    CONFIG_FIELDS(X)
+#undef X
+    LOGD("===========================");
+}
+
+void addPublicConfigFields(JsonObject obj) {
+    // Secrets (passwords) and internal fields are not sent
+    ConfigGuard cfg;
+#define X(type, name, def, lo, hi, flags, sect) \
+    if (!((flags) & (CFG_SECRET | CFG_INTERNAL))) obj[#name] = cfg->name;
+    CONFIG_FIELDS(X)
+#undef X
+}
+
+String getConfigJson() {
+    DynamicJsonDocument doc(2048);
+    addPublicConfigFields(doc.to<JsonObject>());
 
     String output;
     serializeJson(doc, output);
     return output;
 }
 
-bool updateConfigFromJson(const String& jsonStr) {
+void onConfigChange(uint32_t sections, ConfigChangeHandler handler) {
+    if (configSubscriberCount >= CONFIG_MAX_SUBSCRIBERS) {
+        LOGW("[Config] Too many change subscribers");
+        return;
+    }
+    configSubscribers[configSubscriberCount++] = { sections, handler };
+}
+
+void notifyConfigChanged(uint32_t changedSections) {
+    if (!changedSections) return;
+    for (uint8_t i = 0; i < configSubscriberCount; i++) {
+        if (configSubscribers[i].sections & changedSections) {
+            configSubscribers[i].handler(changedSections);
+        }
+    }
+}
+
+bool updateConfigFromJson(const String& jsonStr, uint32_t* changedSections) {
     DynamicJsonDocument doc(2048);
     DeserializationError error = deserializeJson(doc, jsonStr);
 
     if (error) {
-        Serial.print("Failed to parse config update: ");
-        Serial.println(error.c_str());
+        LOGW("Failed to parse config update: %s", error.c_str());
         return false;
     }
 
-    if (doc.containsKey("wifi_ssid"))
-        config.wifi_ssid = doc["wifi_ssid"].as<String>();
-    if (doc.containsKey("wifi_password") && doc["wifi_password"].as<String>().length() > 0)
-        config.wifi_password = doc["wifi_password"].as<String>();
-
-    if (doc.containsKey("mqtt_server"))
-        config.mqtt_server = doc["mqtt_server"].as<String>();
-    if (doc.containsKey("mqtt_port"))
-        config.mqtt_port = doc["mqtt_port"];
-    if (doc.containsKey("mqtt_user"))
-        config.mqtt_user = doc["mqtt_user"].as<String>();
-    if (doc.containsKey("mqtt_password") && doc["mqtt_password"].as<String>().length() > 0)
-        config.mqtt_password = doc["mqtt_password"].as<String>();
+    Config next = configCopy();
 
-    if (doc.containsKey("min_pressure"))    config.min_pressure    = doc["min_pressure"];
-    if (doc.containsKey("max_pressure"))    config.max_pressure    = doc["max_pressure"];
-    if (doc.containsKey("pressure_offset")) config.pressure_offset = doc["pressure_offset"];
-    if (doc.containsKey("temp_offset"))     config.temp_offset     = doc["temp_offset"];
-
-    if (doc.containsKey("pressure_in_offset"))  config.pressure_in_offset  = doc["pressure_in_offset"];
-    if (doc.containsKey("pressure_out_offset")) config.pressure_out_offset = doc["pressure_out_offset"];
-    if (doc.containsKey("pressure_calibrated")) config.pressure_calibrated = doc["pressure_calibrated"];
-
-    if (doc.containsKey("current_offset_l1")) config.current_offset_l1 = doc["current_offset_l1"];
-    if (doc.containsKey("current_offset_l2")) config.current_offset_l2 = doc["current_offset_l2"];
-    if (doc.containsKey("current_offset_l3")) config.current_offset_l3 = doc["current_offset_l3"];
-    if (doc.containsKey("current_calibrated")) config.current_calibrated = doc["current_calibrated"];
-
-    if (doc.containsKey("max_current"))          config.max_current          = doc["max_current"];
-    if (doc.containsKey("max_phase_imbalance"))  config.max_phase_imbalance  = doc["max_phase_imbalance"];
-    if (doc.containsKey("log_interval_minutes")) config.log_interval_minutes = doc["log_interval_minutes"];
+#define X(type, name, def, lo, hi, flags, sect) \
+    if (!((flags) & CFG_INTERNAL) && doc.containsKey(#name)) { \
+        cfgAssign(next.name, doc[#name], flags); \
+        cfgClamp(#name, next.name, lo, hi); \
+    }
+    CONFIG_FIELDS(X)
+#undef X
 
-    return saveConfig();
+    return configCommit(next, changedSections);
 }
@@ -4,80 +4,165 @@
 #include <Arduino.h>
 #include <SD.h>
 #include <ArduinoJson.h>
+#include <functional>
+
+// Current config.json schema version (see migrateConfig())
+#define CONFIG_VERSION 2
+
+// Field flags
+#define CFG_SECRET   0x01   // never returned by getConfigJson(); empty updates are ignored
+#define CFG_INTERNAL 0x02   // persisted, but not exposed or updatable via the API
+
+// Config sections, used as a bitmask for change notifications
+#define CFG_SECT_WIFI        0x01
+#define CFG_SECT_MQTT        0x02
+#define CFG_SECT_CONTROL     0x04   // pressure and protection thresholds
+#define CFG_SECT_CALIBRATION 0x08   // sensor offsets
+#define CFG_SECT_LOGGING     0x10
+#define CFG_SECT_SYSTEM      0x20
+#define CFG_SECT_ALL         0xFF
+
+// C++ type for each schema type tag
+#define CFG_CTYPE_STRING String
+#define CFG_CTYPE_INT    int
+#define CFG_CTYPE_FLOAT  float
+#define CFG_CTYPE_BOOL   bool
+
+/*
+ * Configuration schema — the single source for the Config struct, its
+ * defaults, config.json load/save, the /api/config JSON and the NVS snapshot.
+ *
+ * X(type, name, default, min, max, flags, section)
+ *   min/max clamp numeric fields; for strings max is the maximum length.
+ *   Current offsets are in mA, pressure values in bar, currents in A.
+ */
+#define CONFIG_FIELDS(X) \
+    /* WiFi settings */ \
+    X(STRING, wifi_ssid,            "",                   0,       32,     0,            CFG_SECT_WIFI)        \
+    X(STRING, wifi_password,        "",                   0,       64,     CFG_SECRET,   CFG_SECT_WIFI)        \
+    /* MQTT settings */ \
+    X(STRING, mqtt_server,          "YOUR_MQTT_IP",       0,       64,     0,            CFG_SECT_MQTT)        \
+    X(INT,    mqtt_port,            1883,                 1,       65535,  0,            CFG_SECT_MQTT)        \
+    X(STRING, mqtt_user,            "YOUR_MQTT_USER",     0,       64,     0,            CFG_SECT_MQTT)        \
+    X(STRING, mqtt_password,        "YOUR_MQTT_PASSWORD", 0,       64,     CFG_SECRET,   CFG_SECT_MQTT)        \
+    /* System parameters */ \
+    X(FLOAT,  min_pressure,         2.5f,                 0.0,     10.0,   0,            CFG_SECT_CONTROL)     \
+    X(FLOAT,  max_pressure,         3.5f,                 0.0,     10.0,   0,            CFG_SECT_CONTROL)     \
+    X(FLOAT,  pressure_offset,      0.0f,                 -5.0,    5.0,    0,            CFG_SECT_CALIBRATION) \
+    X(FLOAT,  temp_offset,          0.16f,                -10.0,   10.0,   0,            CFG_SECT_CALIBRATION) \
+    /* Pressure sensor calibration */ \
+    X(FLOAT,  pressure_in_offset,   0.0f,                 -5.0,    5.0,    0,            CFG_SECT_CALIBRATION) \
+    X(FLOAT,  pressure_out_offset,  0.0f,                 -5.0,    5.0,    0,            CFG_SECT_CALIBRATION) \
+    X(BOOL,   pressure_calibrated,  false,                0,       1,      0,            CFG_SECT_CALIBRATION) \
+    /* Current sensor calibration */ \
+    X(FLOAT,  current_offset_l1,    0.0f,                 -100000, 100000, 0,            CFG_SECT_CALIBRATION) \
+    X(FLOAT,  current_offset_l2,    0.0f,                 -100000, 100000, 0,            CFG_SECT_CALIBRATION) \
+    X(FLOAT,  current_offset_l3,    0.0f,                 -100000, 100000, 0,            CFG_SECT_CALIBRATION) \
+    X(BOOL,   current_calibrated,   false,                0,       1,      0,            CFG_SECT_CALIBRATION) \
+    /* Protection thresholds */ \
+    X(FLOAT,  max_current,          15.0f,                0.0,     100.0,  0,            CFG_SECT_CONTROL)     \
+    X(FLOAT,  max_phase_imbalance,  3.0f,                 0.0,     50.0,   0,            CFG_SECT_CONTROL)     \
+    /* Data logging (0 = disabled) */ \
+    X(INT,    log_interval_minutes, 5,                    0,       1440,   0,            CFG_SECT_LOGGING)     \
+    /* Serial and /api/logs verbosity: 0 off, 1 error, 2 warn, 3 info, 4 debug */ \
+    X(INT,    log_level,            3,                    0,       4,      0,            CFG_SECT_LOGGING)     \
+    /* Batched MQTT telemetry (0 Hz = disabled) */ \
+    X(INT,    mqtt_batch_hz,        0,                    0,       50,     0,            CFG_SECT_LOGGING)     \
+    X(INT,    mqtt_batch_window_ms, 1000,                 100,     10000,  0,            CFG_SECT_LOGGING)     \
+    /* UDP multicast telemetry */ \
+    X(BOOL,   multicast_enabled,    false,                0,       1,      0,            CFG_SECT_LOGGING)     \
+    X(STRING, multicast_group,      "239.255.42.1",       0,       15,     0,            CFG_SECT_LOGGING)     \
+    X(INT,    multicast_port,       45454,                1,       65535,  0,            CFG_SECT_LOGGING)     \
+    /* InfluxDB export (empty URL = disabled) */ \
+    X(STRING, influx_url,           "",                   0,       160,    0,            CFG_SECT_LOGGING)     \
+    X(STRING, influx_token,         "",                   0,       128,    CFG_SECRET,   CFG_SECT_LOGGING)     \
+    X(INT,    influx_interval_s,    10,                   1,       3600,   0,            CFG_SECT_LOGGING)     \
+    /* Lead/lag across units on one manifold (pump_cluster.h); name and switch reconnect MQTT */ \
+    X(BOOL,   cluster_enabled,      false,                0,       1,      0,            CFG_SECT_MQTT)        \
+    X(STRING, cluster_name,         "manifold",           0,       24,     0,            CFG_SECT_MQTT)        \
+    X(FLOAT,  cluster_deficit,      0.3f,                 0.0,     5.0,    0,            CFG_SECT_CONTROL)     \
+    X(INT,    cluster_delay_s,      15,                   1,       600,    0,            CFG_SECT_CONTROL)     \
+    X(FLOAT,  cluster_pump_flow,    0.0f,                 0.0,     1000.0, 0,            CFG_SECT_CONTROL)     \
+    /* Schema version */ \
+    X(INT,    config_version,       CONFIG_VERSION,       1,       1000,   CFG_INTERNAL, CFG_SECT_SYSTEM)
 
 // Configuration structure
 struct Config {
-    // WiFi settings
-    String wifi_ssid;
-    String wifi_password;
-    
-    // MQTT settings
-    String mqtt_server;
-    int mqtt_port;
-    String mqtt_user;
-    String mqtt_password;
-    
-    // System parameters
-    float min_pressure;
-    float max_pressure;
-    float pressure_offset;
-    float temp_offset;
-
-    // Pressure sensor calibration
-    float pressure_in_offset;
-    float pressure_out_offset;
-    bool pressure_calibrated;
-
-    // Current sensor calibration
-    float current_offset_l1;
-    float current_offset_l2;
-    float current_offset_l3;
-    bool current_calibrated;
-
-    // Protection thresholds
-    float max_current;          // overcurrent trip point (A)
-    float max_phase_imbalance;  // max A difference across phases
-
-    // Data logging
-    int log_interval_minutes;   // 0 = disabled
-
-    // Schema version
-    int config_version;
+#define X(type, name, def, lo, hi, flags, sect) CFG_CTYPE_##type name;
+    CONFIG_FIELDS(X)
+#undef X
 
     // Constructor with default values
     Config() {
-        wifi_ssid = "";
-        wifi_password = "";
-        mqtt_server = "YOUR_MQTT_IP";
-        mqtt_port = 1883;
-        mqtt_user = "YOUR_MQTT_USER";
-        mqtt_password = "YOUR_MQTT_PASSWORD";
-        min_pressure = 2.5;
-        max_pressure = 3.5;
-        pressure_offset = 0.0;
-        temp_offset = 0.16;
-        pressure_in_offset = 0.0;
-        pressure_out_offset = 0.0;
-        pressure_calibrated = false;
-        current_offset_l1 = 0.0;
-        current_offset_l2 = 0.0;
-        current_offset_l3 = 0.0;
-        current_calibrated = false;
-        max_current = 15.0f;
-        max_phase_imbalance = 3.0f;
-        log_interval_minutes = 5;
-        config_version = 1;
+#define X(type, name, def, lo, hi, flags, sect) name = def;
+        CONFIG_FIELDS(X)
+#undef X
     }
 };
 
-// Global config object
-extern Config config;
+/*
+ * Versioned config access.
+ *
+ * The live Config is never modified in place. Writers build a new version
+ * (configCopy → edit → configCommit), which is published by swapping one
+ * atomic pointer. Readers pin whatever version is current with a ConfigGuard:
+ * two atomic increments, no lock, and every field read through the guard comes
+ * from the same version. A replaced version is freed only once all readers
+ * that could still see it have released their guards.
+ *
+ * Keep guards short-lived and copy strings out before blocking calls; never
+ * commit while holding a guard.
+ */
+const Config* configAcquire(uint8_t& slot);
+void configRelease(uint8_t slot);
+
+class ConfigGuard {
+private:
+    uint8_t slot;
+    const Config* cfg;
+
+    ConfigGuard(const ConfigGuard&) = delete;
+    ConfigGuard& operator=(const ConfigGuard&) = delete;
+
+public:
+    ConfigGuard() : cfg(configAcquire(slot)) {}
+    ~ConfigGuard() { configRelease(slot); }
+
+    const Config* operator->() const { return cfg; }
+    const Config& operator*() const { return *cfg; }
+};
+
+// Copy of the current version, to be edited and committed
+Config configCopy();
+
+// Save to SD, publish as the current version and notify subscribers.
+// The new version goes live even if the SD write fails (returns false).
+bool configCommit(const Config& next, uint32_t* changedSections = nullptr);
+
+// Free a replaced version once its readers are gone; called from loop()
+void configReclaim();
+
+// Incremented on every commit
+uint32_t configVersion();
+
+// Called with the CFG_SECT_* bits whose values changed. Handlers run in the
+// task that saved the config (usually async_tcp) and must only flag work for
+// their owning task, never block.
+typedef std::function<void(uint32_t changedSections)> ConfigChangeHandler;
 
 // Function declarations
 bool loadConfig();
-bool saveConfig();
 void printConfig();
 String getConfigJson();
-bool updateConfigFromJson(const String& jsonStr);
+// Write the non-secret, non-internal fields of the current version into obj
+void addPublicConfigFields(JsonObject obj);
+bool updateConfigFromJson(const String& jsonStr, uint32_t* changedSections = nullptr);
+
+// Subscribe to changes of the given sections
+void onConfigChange(uint32_t sections, ConfigChangeHandler handler);
+void notifyConfigChanged(uint32_t changedSections);
+
+// Upgrade a config loaded from an older schema version in place
+void migrateConfig(Config& cfg);
 
 #endif
@@ -0,0 +1,275 @@
+#include "counter_store.h"
+#include <rom/crc.h>
+#include <esp_system.h>
+#include "logger.h"
+
+// Global instance
+CounterStore counters;
+
+static const uint32_t COUNTER_BASE_MAGIC   = 0x43424153;  // "SABC"
+static const uint32_t COUNTER_RECORD_MAGIC = 0x4352454A;  // "JERC"
+static const uint32_t COUNTER_RTC_MAGIC    = 0x43525443;  // "CTRC"
+
+// Increments not yet journaled. Lives in RTC slow memory, which keeps its
+// contents across software, panic and watchdog resets (but not power loss).
+struct CounterRtc {
+    uint32_t magic;
+    uint32_t durableSeq;          // journal seq these deltas build on
+    uint32_t pending[CNT_COUNT];
+    uint32_t crc;
+};
+RTC_NOINIT_ATTR static CounterRtc rtcCounters;
+
+// Guards totals/pending: add() runs in loop(), get() from web and MQTT tasks
+static portMUX_TYPE counterMux = portMUX_INITIALIZER_UNLOCKED;
+
+template <typename T>
+static uint32_t blockCrc(const T& block) {
+    return crc32_le(0, (const uint8_t*)&block, offsetof(T, crc));
+}
+
+static void journalKey(char* key, size_t size, uint32_t seq) {
+    snprintf(key, size, "j%02u", (unsigned)(seq % COUNTER_JOURNAL_SLOTS));
+}
+
+CounterStore::CounterStore() :
+    ready(false),
+    seq(0),
+    baseSeq(0),
+    baseSlot(1),
+    urgent(false),
+    lastFlush(0),
+    journalWrites(0),
+    compactions(0) {
+    memset(totals, 0, sizeof(totals));
+    memset(pending, 0, sizeof(pending));
+}
+
+void CounterStore::begin() {
+    if (!prefs.begin("counters", false)) {
+        LOGE("[Counters] Failed to open NVS namespace");
+        return;
+    }
+    ready = true;
+
+    bool hasBase = loadBase();
+    replayJournal();
+    recoverRtc();
+
+    LOGI("[Counters] Restored seq %lu (base %lu%s), runtime %llu s, starts %llu",
+         (unsigned long)seq, (unsigned long)baseSeq, hasBase ? "" : ", new store",
+         (unsigned long long)totals[CNT_MOTOR_RUNTIME_S],
+         (unsigned long long)totals[CNT_MOTOR_STARTS]);
+
+    esp_reset_reason_t reason = esp_reset_reason();
+    if (reason == ESP_RST_POWERON || reason == ESP_RST_BROWNOUT) {
+        add(CNT_POWER_CYCLES);
+    }
+    lastFlush = millis();
+}
+
+bool CounterStore::loadBase() {
+    CounterBase best;
+    bool found = false;
+
+    for (uint8_t slot = 0; slot < 2; slot++) {
+        char key[8];
+        snprintf(key, sizeof(key), "base%u", slot);
+
+        CounterBase candidate;
+        if (prefs.getBytes(key, &candidate, sizeof(candidate)) != sizeof(candidate)) continue;
+        if (candidate.magic != COUNTER_BASE_MAGIC || candidate.crc != blockCrc(candidate)) {
+            LOGW("[Counters] Ignoring corrupt %s", key);
+            continue;
+        }
+        if (!found || candidate.seq > best.seq) {
+            best = candidate;
+            baseSlot = slot;
+            found = true;
+        }
+    }
+
+    if (found) {
+        memcpy(totals, best.totals, sizeof(totals));
+        baseSeq = best.seq;
+        seq = best.seq;
+    }
+    return found;
+}
+
+void CounterStore::replayJournal() {
+    // Records are written in seq order into slot seq % SLOTS. Walk forward from
+    // the base until a slot holds a stale, torn or missing record.
+    for (uint32_t i = 0; i < COUNTER_JOURNAL_SLOTS; i++) {
+        uint32_t expected = seq + 1;
+        char key[8];
+        journalKey(key, sizeof(key), expected);
+
+        CounterRecord rec;
+        if (prefs.getBytes(key, &rec, sizeof(rec)) != sizeof(rec)) break;
+        if (rec.magic != COUNTER_RECORD_MAGIC || rec.seq != expected) break;
+        if (rec.crc != blockCrc(rec)) {
+            LOGW("[Counters] Dropping torn journal record %lu", (unsigned long)expected);
+            break;
+        }
+
+        for (int c = 0; c < CNT_COUNT; c++) totals[c] += rec.deltas[c];
+        seq = expected;
+    }
+}
+
+void CounterStore::recoverRtc() {
+    bool valid = rtcCounters.magic == COUNTER_RTC_MAGIC &&
+                 rtcCounters.crc == blockCrc(rtcCounters) &&
+                 rtcCounters.durableSeq == seq;
+
+    if (valid) {
+        bool any = false;
+        for (int c = 0; c < CNT_COUNT; c++) {
+            pending[c] = rtcCounters.pending[c];
+            totals[c] += pending[c];
+            if (pending[c]) any = true;
+        }
+        if (any) {
+            LOGI("[Counters] Recovered unjournaled increments from RTC memory");
+            urgent = true;
+        }
+    }
+    syncRtc();
+}
+
+void CounterStore::syncRtc() {
+    rtcCounters.magic = COUNTER_RTC_MAGIC;
+    rtcCounters.durableSeq = seq;
+    memcpy(rtcCounters.pending, pending, sizeof(pending));
+    rtcCounters.crc = blockCrc(rtcCounters);
+}
+
+void CounterStore::add(CounterId id, uint32_t amount) {
+    if (id >= CNT_COUNT || amount == 0) return;
+
+    portENTER_CRITICAL(&counterMux);
+    pending[id] += amount;
+    totals[id] += amount;
+    syncRtc();
+    portEXIT_CRITICAL(&counterMux);
+
+    if (id != CNT_MOTOR_RUNTIME_S && id != CNT_PUMPED_VOLUME_ML) {
+        urgent = true;
+    }
+}
+
+uint64_t CounterStore::get(CounterId id) {
+    if (id >= CNT_COUNT) return 0;
+    portENTER_CRITICAL(&counterMux);
+    uint64_t value = totals[id];
+    portEXIT_CRITICAL(&counterMux);
+    return value;
+}
+
+void CounterStore::seed(CounterId id, uint64_t value) {
+    if (id >= CNT_COUNT || totals[id] != 0 || value == 0) return;
+    // Folded in through the journal like any other increment
+    while (value > 0) {
+        uint32_t chunk = value > 0xFFFFFFFFULL ? 0xFFFFFFFFUL : (uint32_t)value;
+        add(id, chunk);
+        value -= chunk;
+    }
+    urgent = true;
+}
+
+void CounterStore::tick() {
+    if (!ready) return;
+
+    bool due = urgent || millis() - lastFlush >= FLUSH_INTERVAL_MS;
+    if (!due) return;
+
+    flush();
+}
+
+void CounterStore::flush() {
+    if (!ready) return;
+    lastFlush = millis();
+    urgent = false;
+
+    bool any = false;
+    for (int c = 0; c < CNT_COUNT; c++) {
+        if (pending[c]) { any = true; break; }
+    }
+    if (!any) return;
+
+    writeRecord();
+}
+
+bool CounterStore::writeRecord() {
+    // The slot for seq+1 still holds record seq+1-SLOTS. If that record is not
+    // yet folded into a base, compact before overwriting it.
+    if (seq - baseSeq >= COUNTER_JOURNAL_SLOTS) {
+        if (!compact()) return false;
+    }
+
+    CounterRecord rec;
+    rec.magic = COUNTER_RECORD_MAGIC;
+    rec.seq = seq + 1;
+    portENTER_CRITICAL(&counterMux);
+    memcpy(rec.deltas, pending, sizeof(rec.deltas));
+    portEXIT_CRITICAL(&counterMux);
+    rec.crc = blockCrc(rec);
+
+    char key[8];
+    journalKey(key, sizeof(key), rec.seq);
+    if (prefs.putBytes(key, &rec, sizeof(rec)) != sizeof(rec)) {
+        LOGE("[Counters] Journal write failed");
+        return false;
+    }
+
+    // Record is durable: retire its deltas. RTC is updated last so a reset in
+    // between never applies the same increments twice.
+    portENTER_CRITICAL(&counterMux);
+    for (int c = 0; c < CNT_COUNT; c++) pending[c] -= rec.deltas[c];
+    seq = rec.seq;
+    syncRtc();
+    portEXIT_CRITICAL(&counterMux);
+
+    journalWrites++;
+    return true;
+}
+
+bool CounterStore::compact() {
+    CounterBase base;
+    base.magic = COUNTER_BASE_MAGIC;
+    base.seq = seq;
+    portENTER_CRITICAL(&counterMux);
+    for (int c = 0; c < CNT_COUNT; c++) base.totals[c] = totals[c] - pending[c];
+    portEXIT_CRITICAL(&counterMux);
+    base.crc = blockCrc(base);
+
+    // Alternate between two keys so an interrupted compaction leaves the
+    // previous base (and the journal it anchors) intact.
+    uint8_t slot = baseSlot ^ 1;
+    char key[8];
+    snprintf(key, sizeof(key), "base%u", slot);
+    if (prefs.putBytes(key, &base, sizeof(base)) != sizeof(base)) {
+        LOGE("[Counters] Compaction failed");
+        return false;
+    }
+
+    baseSlot = slot;
+    baseSeq = seq;
+    compactions++;
+    return true;
+}
+
+const char* CounterStore::name(CounterId id) {
+    switch (id) {
+        case CNT_MOTOR_RUNTIME_S:   return "motor_runtime_s";
+        case CNT_MOTOR_STARTS:      return "motor_starts";
+        case CNT_PUMPED_VOLUME_ML:  return "pumped_volume_ml";
+        case CNT_TRIP_DRY_RUN:      return "trips_dry_run";
+        case CNT_TRIP_OVERCURRENT:  return "trips_overcurrent";
+        case CNT_TRIP_IMBALANCE:    return "trips_imbalance";
+        case CNT_TRIP_PRESSURE:     return "trips_pressure";
+        case CNT_POWER_CYCLES:      return "power_cycles";
+        default:                    return "unknown";
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef COUNTER_STORE_H
+#define COUNTER_STORE_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+
+// Lifetime counters kept by the journaled store
+enum CounterId : uint8_t {
+    CNT_MOTOR_RUNTIME_S,     // seconds the motor output was on
+    CNT_MOTOR_STARTS,        // off → on transitions of the motor output
+    CNT_PUMPED_VOLUME_ML,    // integrated flow (mL)
+    CNT_TRIP_DRY_RUN,        // motor on with no flow
+    CNT_TRIP_OVERCURRENT,    // total current above max_current
+    CNT_TRIP_IMBALANCE,      // phase spread above max_phase_imbalance
+    CNT_TRIP_PRESSURE,       // pressure outside the 1-5 bar window
+    CNT_POWER_CYCLES,        // cold boots (power-on and brown-out resets)
+    CNT_COUNT
+};
+
+// Number of journal records between two compactions
+#define COUNTER_JOURNAL_SLOTS 16
+
+// Snapshot of all totals, written to one of two alternating NVS keys on compaction
+struct CounterBase {
+    uint32_t magic;
+    uint32_t seq;                 // last journal record folded into this snapshot
+    uint64_t totals[CNT_COUNT];
+    uint32_t crc;
+};
+
+// Append-only journal record holding the increments since the previous record
+struct CounterRecord {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t deltas[CNT_COUNT];
+    uint32_t crc;
+};
+
+/**
+ * Wear-aware persistent counters.
+ *
+ * Increments land in RTC memory immediately (survives watchdog and software
+ * resets) and are appended to an NVS journal every few seconds. Every
+ * COUNTER_JOURNAL_SLOTS records the journal is compacted into a new base
+ * snapshot. Each record carries a sequence number and CRC, so a write torn by
+ * a power cut is simply ignored on the next boot.
+ */
+class CounterStore {
+private:
+    Preferences prefs;
+    bool ready;
+
+    uint64_t totals[CNT_COUNT];    // durable totals + pending deltas
+    uint32_t pending[CNT_COUNT];   // not yet journaled
+    uint32_t seq;                  // last journaled record
+    uint32_t baseSeq;              // seq of the newest base snapshot
+    uint8_t  baseSlot;             // NVS key (0/1) holding the newest base
+    bool     urgent;               // flush on the next tick
+    unsigned long lastFlush;
+    uint32_t journalWrites;
+    uint32_t compactions;
+
+    bool loadBase();
+    void replayJournal();
+    void recoverRtc();
+    void syncRtc();
+    bool writeRecord();
+    bool compact();
+
+public:
+    CounterStore();
+
+    // Open NVS, rebuild totals from base + journal + RTC, count the boot
+    void begin();
+
+    // Add to a counter; rare events (starts, trips) are flushed on the next tick
+    void add(CounterId id, uint32_t amount = 1);
+
+    // Current total including not-yet-journaled increments
+    uint64_t get(CounterId id);
+
+    // Seed a counter only if it is still zero (legacy file migration)
+    void seed(CounterId id, uint64_t value);
+
+    // Called from loop(); appends a journal record when due
+    void tick();
+
+    // Append pending increments now
+    void flush();
+
+    uint32_t getJournalWrites() const { return journalWrites; }
+    uint32_t getCompactions() const { return compactions; }
+
+    static const char* name(CounterId id);
+
+    // Flush interval for runtime/volume increments
+    static const unsigned long FLUSH_INTERVAL_MS = 10000;
+};
+
+// Global instance
+extern CounterStore counters;
+
+#endif
@@ -0,0 +1,102 @@
+#include "event_stream.h"
+#include "logger.h"
+
+// Global instance
+EventStream events("/events");
+
+static const char* TOPIC_NAMES[SSE_TOPIC_COUNT] = {
+    "update",
+    "diagnostics",
+    "debug",
+};
+
+EventStream::EventStream(const char* path) :
+    url(path),
+    connectHandler(nullptr),
+    keyframeRequested(false),
+    evictions(0),
+    messagesSent(0) {
+    for (int i = 0; i < GROUPS; i++) {
+        // Never registered with the server; requests reach them through handleRequest()
+        groups[i] = new AsyncEventSource(path);
+        groups[i]->onConnect([this](AsyncEventSourceClient *client) {
+            keyframeRequested = true;
+            if (connectHandler) connectHandler(client);
+        });
+        strikes[i] = 0;
+    }
+}
+
+uint8_t EventStream::parseTopics(const String& list) {
+    uint8_t mask = 0;
+    int start = 0;
+    while (start <= (int)list.length()) {
+        int comma = list.indexOf(',', start);
+        if (comma < 0) comma = list.length();
+        String name = list.substring(start, comma);
+        name.trim();
+        for (int t = 0; t < SSE_TOPIC_COUNT; t++) {
+            if (name == TOPIC_NAMES[t]) mask |= (1 << t);
+        }
+        start = comma + 1;
+    }
+    return mask;
+}
+
+bool EventStream::canHandle(AsyncWebServerRequest *request) {
+    return request->method() == HTTP_GET && request->url() == url;
+}
+
+void EventStream::handleRequest(AsyncWebServerRequest *request) {
+    uint8_t mask = SSE_TOPIC_ALL;
+    if (request->hasParam("topics")) {
+        mask = parseTopics(request->getParam("topics")->value());
+        if (mask == 0) {
+            request->send(400, "text/plain", "Unknown topics");
+            return;
+        }
+    }
+    groups[mask - 1]->handleRequest(request);
+}
+
+size_t EventStream::count(uint8_t topics) {
+    size_t total = 0;
+    for (int i = 0; i < GROUPS; i++) {
+        if ((i + 1) & topics) total += groups[i]->count();
+    }
+    return total;
+}
+
+void EventStream::send(uint8_t topic, const char* message, const char* event) {
+    uint32_t id = millis();
+    for (int i = 0; i < GROUPS; i++) {
+        if (!((i + 1) & topic)) continue;
+        AsyncEventSource* group = groups[i];
+        if (!group->count()) {
+            strikes[i] = 0;
+            continue;
+        }
+
+        // The library doesn't expose individual clients, so a backlog is
+        // handled per group; EventSource reconnects and gets a keyframe
+        if (group->avgPacketsWaiting() >= SSE_EVICT_BACKLOG) {
+            if (++strikes[i] >= SSE_EVICT_STRIKES) {
+                LOGW("[SSE] Dropping %u backlogged client(s) (topics 0x%02x)",
+                     (unsigned)group->count(), i + 1);
+                group->close();
+                strikes[i] = 0;
+                evictions++;
+                continue;
+            }
+        } else {
+            strikes[i] = 0;
+        }
+
+        group->send(message, event, id);
+        messagesSent += group->count();
+    }
+}
+
+void EventStream::onConnect(ArEventHandlerFunction handler) {
+    connectHandler = handler;
+}
@@ -0,0 +1,72 @@
+#ifndef EVENT_STREAM_H
+#define EVENT_STREAM_H
+
+#include <ESPAsyncWebServer.h>
+#include <atomic>
+
+// SSE topics; clients pick them with /events?topics=update,diagnostics
+#define SSE_TOPIC_UPDATE       0x01
+#define SSE_TOPIC_DIAGNOSTICS  0x02
+#define SSE_TOPIC_DEBUG        0x04
+#define SSE_TOPIC_ALL          0x07
+#define SSE_TOPIC_COUNT        3
+
+// A group whose clients average this many queued messages is falling behind
+#define SSE_EVICT_BACKLOG      8
+// ...and is dropped after this many consecutive sends in that state
+#define SSE_EVICT_STRIKES      3
+
+// Full "update" frame every N updates even if nothing changed
+#define SSE_KEYFRAME_INTERVAL  30
+
+/**
+ * Server-Sent Events with per-client topic subscriptions.
+ *
+ * Each topic combination has its own AsyncEventSource, so a message is only
+ * queued for clients that asked for it, and publishers can skip building a
+ * payload nobody is subscribed to. Without a topics parameter a client gets
+ * everything, as before.
+ */
+class EventStream : public AsyncWebHandler {
+public:
+    explicit EventStream(const char* url);
+
+    bool canHandle(AsyncWebServerRequest *request) override;
+    void handleRequest(AsyncWebServerRequest *request) override;
+
+    // Connected clients subscribed to any of the given topics
+    size_t count(uint8_t topics = SSE_TOPIC_ALL);
+    bool hasSubscribers(uint8_t topic) { return count(topic) > 0; }
+
+    // Send to every client subscribed to topic
+    void send(uint8_t topic, const char* message, const char* event);
+
+    // Called (in the async_tcp task) whenever a client connects
+    void onConnect(ArEventHandlerFunction handler);
+
+    // True once after any client connected: the next update should be a keyframe
+    bool takeKeyframeRequest() { return keyframeRequested.exchange(false); }
+
+    uint32_t getEvictions() const { return evictions; }
+    // Messages queued, counted once per receiving client
+    uint32_t getMessagesSent() const { return messagesSent; }
+
+private:
+    // Index = topic mask - 1
+    static const int GROUPS = (1 << SSE_TOPIC_COUNT) - 1;
+
+    String            url;
+    AsyncEventSource* groups[GROUPS];
+    uint8_t           strikes[GROUPS];
+    ArEventHandlerFunction connectHandler;
+    std::atomic<bool> keyframeRequested;
+    uint32_t          evictions;
+    std::atomic<uint32_t> messagesSent;
+
+    static uint8_t parseTopics(const String& list);
+};
+
+// Global instance
+extern EventStream events;
+
+#endif
@@ -1,10 +1,21 @@
 #include "file_manager.h"
+#include "asset_cache.h"
+#include "template_stream.h"
+#include "admission.h"
+#include "resumable_upload.h"
+#include "sd_block_writer.h"
+#include "metrics.h"
+#include <memory>
+#include "logger.h"
 
 // External device constants
 extern const char* DEVICE_NAME;
 extern const char* DEVICE_VERSION;
 
 void setupFileManagerRoutes(AsyncWebServer& server) {
+    metricsRoutes({ "/upload", "/upload_file", "/list_files", "/delete_file", "/upload_zip",
+                    "/api/upload", "/api/upload/commit" });
+
     // File upload page
     server.on("/upload", HTTP_GET, handleUploadPage);
 
@@ -12,7 +23,9 @@ void setupFileManagerRoutes(AsyncWebServer& server) {
     server.on("/upload_file", HTTP_POST, handleFileUploadComplete, handleFileUpload);
 
     // List files endpoint
-    server.on("/list_files", HTTP_GET, handleListFiles);
+    server.on("/list_files", HTTP_GET, [](AsyncWebServerRequest *request) {
+        admitRequest(request, REQ_CLASS_LISTING, handleListFiles);
+    });
 
     // Delete file endpoint
     server.on("/delete_file", HTTP_POST, [](AsyncWebServerRequest *request) {
@@ -20,29 +33,13 @@ void setupFileManagerRoutes(AsyncWebServer& server) {
 
     // ZIP archive upload endpoint
     server.on("/upload_zip", HTTP_POST, handleZipUploadComplete, handleZipUpload);
+
+    // Resumable uploads (/api/upload, /api/upload/commit)
+    server.addHandler(new ResumableUploadHandler());
 }
 
-void handleUploadPage(AsyncWebServerRequest *request) {
-    // Try to serve the upload.html file from SD card
-    if (SD.exists("/upload.html")) {
-        // Read the file from SD card
-        File file = SD.open("/upload.html", FILE_READ);
-        if (!file) {
-            request->send(500, "text/plain", "Failed to open upload.html");
-            return;
-        }
-        
-        String html = file.readString();
-        file.close();
-        
-        // Replace placeholders with actual values
-        html.replace("%DEVICE_NAME%", DEVICE_NAME ? DEVICE_NAME : "Device");
-        html.replace("%VERSION%", DEVICE_VERSION ? DEVICE_VERSION : "Unknown");
-        
-        request->send(200, "text/html", html);
-    } else {
-        // Fallback: basic upload page if upload.html is not found
-        String html = R"rawliteral(
+// Fallback: basic upload page if upload.html is not found
+static const char UPLOAD_FALLBACK_PAGE[] PROGMEM = R"rawliteral(
 <!DOCTYPE html>
 <html>
 <head>
@@ -101,70 +98,282 @@ void handleUploadPage(AsyncWebServerRequest *request) {
 </body>
 </html>
 )rawliteral";
-        request->send(200, "text/html", html);
+
+void handleUploadPage(AsyncWebServerRequest *request) {
+    static const TemplateVar vars[] = {
+        { "DEVICE_NAME", DEVICE_NAME ? DEVICE_NAME : "Device" },
+        { "VERSION",     DEVICE_VERSION ? DEVICE_VERSION : "Unknown" },
+    };
+    const size_t varCount = sizeof(vars) / sizeof(vars[0]);
+
+    // Try to serve the upload.html file from SD card, streamed with placeholders filled in
+    if (!sendTemplateFile(request, "/upload.html", "text/html", vars, varCount)) {
+        sendTemplateFlash(request, UPLOAD_FALLBACK_PAGE, "text/html", vars, varCount);
     }
 }
 
 void handleFileUploadComplete(AsyncWebServerRequest *request) {
+    if (!isAdmitted(request, REQ_CLASS_UPLOAD)) {
+        sendOverloaded(request, REQ_CLASS_UPLOAD);
+        return;
+    }
     request->send(200, "text/plain", "Upload complete");
 }
 
+void removeStaleGzip(const String& path) {
+    if (path.endsWith(".gz")) return;
+    String gzPath = path + ".gz";
+    if (SD.exists(gzPath)) {
+        SD.remove(gzPath);
+        LOGI("Removed stale %s", gzPath.c_str());
+    }
+    assetCache.invalidate(gzPath);
+}
+
 void handleFileUpload(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final) {
-    static File uploadFile;
+    static SdBlockWriter uploadFile;
+
+    // One upload at a time: the open file above is shared
+    if (!index && !tryAdmit(request, REQ_CLASS_UPLOAD)) {
+        LOGW("Upload of %s rejected: another upload is running", filename.c_str());
+    }
+    if (!isAdmitted(request, REQ_CLASS_UPLOAD)) return;
     
     if (!index) {
         // First chunk - open file for writing
-        Serial.printf("Starting upload: %s\n", filename.c_str());
+        LOGI("Starting upload: %s", filename.c_str());
         String filepath = "/" + filename;
+        assetCache.invalidate(filepath);
         
         // Remove file if it exists
         if (SD.exists(filepath)) {
             SD.remove(filepath);
         }
+
+        // A precompressed sibling would keep serving the old content
+        removeStaleGzip(filepath);
         
-        uploadFile = SD.open(filepath, FILE_WRITE);
-        if (!uploadFile) {
-            Serial.println("Failed to open file for writing");
+        if (!uploadFile.open(filepath, FILE_WRITE)) {
+            LOGE("Failed to open file for writing");
             return;
         }
     }
     
-    // Write chunk to file
-    if (uploadFile && len) {
+    // Write chunk to file (coalesced into sector-aligned blocks)
+    if (uploadFile.isOpen() && len) {
         size_t written = uploadFile.write(data, len);
         if (written != len) {
-            Serial.println("Write failed");
+            LOGE("Write failed");
         }
     }
     
     if (final) {
         // Last chunk - close file
-        if (uploadFile) {
+        if (uploadFile.isOpen()) {
             uploadFile.close();
-            Serial.printf("Upload complete: %s\n", filename.c_str());
+            LOGI("Upload complete: %s", filename.c_str());
         }
+        // A request may have cached a partial file while the upload ran
+        assetCache.invalidate("/" + filename);
+        invalidateSdFileCount();
     }
 }
 
+// ─── Directory listing ───────────────────────────────────────────────────────
+
+enum ListPhase {
+    LIST_HEAD,
+    LIST_SKIP,
+    LIST_ENTRIES,
+    LIST_TAIL,
+    LIST_DONE
+};
+
+// Listing state for one response; owned by the response's filler callback
+struct ListingStream {
+    File      dir;
+    String    dirPath;
+    ListPhase phase;
+
+    uint32_t  cursor;       // entries consumed from the directory so far
+    uint16_t  limit;
+    uint16_t  emitted;
+    uint16_t  scanned;
+    bool      exhausted;
+
+    // Filters (files only; directories are always listed)
+    time_t    since;
+    uint32_t  minSize;
+    uint32_t  maxSize;
+
+    char      line[LIST_LINE_MAX];
+    size_t    lineLen;
+    size_t    linePos;
+
+    ListingStream() :
+        phase(LIST_HEAD), cursor(0), limit(LIST_PAGE_DEFAULT), emitted(0), scanned(0),
+        exhausted(false), since(0), minSize(0), maxSize(UINT32_MAX), lineLen(0), linePos(0) {}
+
+    ~ListingStream() {
+        if (dir) dir.close();
+    }
+
+    bool accepts(File& entry) {
+        if (entry.isDirectory()) return true;
+        if (since && entry.getLastWrite() < since) return false;
+        return entry.size() >= minSize && entry.size() <= maxSize;
+    }
+
+    // Produce the next piece of output into line; false when there is none
+    bool nextLine() {
+        lineLen = 0;
+        linePos = 0;
+
+        switch (phase) {
+        case LIST_HEAD: {
+            StaticJsonDocument<96> doc;
+            doc.set(dirPath);
+            lineLen = snprintf(line, sizeof(line), "{\"dir\":");
+            lineLen += serializeJson(doc, line + lineLen, sizeof(line) - lineLen);
+            lineLen += snprintf(line + lineLen, sizeof(line) - lineLen, ",\"files\":[");
+            phase = LIST_SKIP;
+            return true;
+        }
+
+        case LIST_SKIP:
+            // Resume after the previous page without opening each entry
+            for (uint32_t i = 0; i < cursor; i++) {
+                if (dir.getNextFileName().isEmpty()) {
+                    exhausted = true;
+                    break;
+                }
+            }
+            phase = exhausted ? LIST_TAIL : LIST_ENTRIES;
+            return nextLine();
+
+        case LIST_ENTRIES:
+            while (emitted < limit && scanned < LIST_SCAN_BUDGET) {
+                File entry = dir.openNextFile();
+                if (!entry) {
+                    exhausted = true;
+                    break;
+                }
+                cursor++;
+                scanned++;
+                if (!accepts(entry)) continue;
+
+                // The document keeps a pointer to the name, which close() frees:
+                // serialize while the entry is still open
+                StaticJsonDocument<160> doc;
+                doc["name"] = entry.name();
+                if (entry.isDirectory()) {
+                    doc["dir"] = true;
+                } else {
+                    doc["size"] = entry.size();
+                    doc["mtime"] = (uint32_t)entry.getLastWrite();
+                }
+
+                // A truncated entry would break the whole listing; leave it out
+                size_t needed = measureJson(doc) + (emitted > 0 ? 1 : 0);
+                if (needed >= sizeof(line)) {
+                    LOGW("[Files] Name too long to list: %s", entry.name());
+                    entry.close();
+                    continue;
+                }
+                if (emitted > 0) line[lineLen++] = ',';
+                lineLen += serializeJson(doc, line + lineLen, sizeof(line) - lineLen);
+                entry.close();
+                emitted++;
+                return true;
+            }
+            phase = LIST_TAIL;
+            return nextLine();
+
+        case LIST_TAIL:
+            if (exhausted) {
+                lineLen = snprintf(line, sizeof(line), "],\"next\":null}");
+            } else {
+                lineLen = snprintf(line, sizeof(line), "],\"next\":%lu}", (unsigned long)cursor);
+            }
+            phase = LIST_DONE;
+            return true;
+
+        default:
+            return false;
+        }
+    }
+
+    size_t fill(uint8_t* buffer, size_t maxLen) {
+        size_t written = 0;
+        while (written < maxLen) {
+            if (linePos >= lineLen && !nextLine()) break;
+            size_t n = min(lineLen - linePos, maxLen - written);
+            memcpy(buffer + written, line + linePos, n);
+            linePos += n;
+            written += n;
+        }
+        return written;
+    }
+};
+
+/*
+ * GET /list_files[?dir=/logs][&cursor=N][&limit=N][&since=T][&min_size=N][&max_size=N]
+ *
+ * Streams {"dir":..,"files":[..],"next":N|null} one entry at a time, so memory
+ * use doesn't grow with the number of files. Pass "next" back as "cursor" to
+ * get the following page. The cursor is a position in directory order, so
+ * entries added or removed between pages can shift it.
+ */
 void handleListFiles(AsyncWebServerRequest *request) {
-    DynamicJsonDocument doc(2048);
-    JsonArray files = doc.to<JsonArray>();
-    
+    std::shared_ptr<ListingStream> listing = std::make_shared<ListingStream>();
+
+    listing->dirPath = request->hasParam("dir") ? request->getParam("dir")->value() : "/";
+    if (!listing->dirPath.startsWith("/") || listing->dirPath.indexOf("..") >= 0) {
+        request->send(400, "application/json", "{\"error\":\"Invalid directory\"}");
+        return;
+    }
+    if (listing->dirPath.length() > 1 && listing->dirPath.endsWith("/")) {
+        listing->dirPath.remove(listing->dirPath.length() - 1);
+    }
+
+    if (request->hasParam("cursor"))   listing->cursor  = request->getParam("cursor")->value().toInt();
+    if (request->hasParam("limit"))    listing->limit   = constrain(request->getParam("limit")->value().toInt(), 1, LIST_PAGE_MAX);
+    if (request->hasParam("since"))    listing->since   = request->getParam("since")->value().toInt();
+    if (request->hasParam("min_size")) listing->minSize = request->getParam("min_size")->value().toInt();
+    if (request->hasParam("max_size")) listing->maxSize = request->getParam("max_size")->value().toInt();
+
+    listing->dir = SD.open(listing->dirPath);
+    if (!listing->dir || !listing->dir.isDirectory()) {
+        request->send(404, "application/json", "{\"error\":\"Directory not found\"}");
+        return;
+    }
+
+    request->send(request->beginChunkedResponse("application/json",
+        [listing](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+            return listing->fill(buffer, maxLen);
+        }));
+}
+
+static volatile int sdFileCount = -1;
+static unsigned long sdFileCountAt = 0;
+
+int getSdFileCount() {
+    if (sdFileCount >= 0 && millis() - sdFileCountAt < SD_FILE_COUNT_TTL_MS) return sdFileCount;
+
+    // Names only: no per-file open
+    int count = 0;
     File root = SD.open("/");
     if (root) {
-        File file = root.openNextFile();
-        while (file) {
-            JsonObject fileObj = files.createNestedObject();
-            fileObj["name"] = String(file.name());
-            fileObj["size"] = file.size();
-            file = root.openNextFile();
-        }
+        while (!root.getNextFileName().isEmpty()) count++;
         root.close();
     }
-    
-    String response;
-    serializeJson(doc, response);
-    request->send(200, "application/json", response);
+    sdFileCount = count;
+    sdFileCountAt = millis();
+    return count;
+}
+
+void invalidateSdFileCount() {
+    sdFileCount = -1;
 }
 
 void handleDeleteFile(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
@@ -176,7 +385,10 @@ void handleDeleteFile(AsyncWebServerRequest *request, uint8_t *data, size_t len,
         String filepath = "/" + filename;
 
         if (SD.exists(filepath)) {
+            assetCache.invalidate(filepath);
             if (SD.remove(filepath)) {
+                removeStaleGzip(filepath);
+                invalidateSdFileCount();
                 request->send(200, "application/json", "{\"status\":\"success\"}");
             } else {
                 request->send(500, "application/json", "{\"error\":\"Failed to delete file\"}");
@@ -300,10 +512,18 @@ static size_t zipFeedBytes(const uint8_t *buf, size_t avail) {
             bool isConfig = (strcmp(zipState.filename, "config.json") == 0);
             zipState.skipFile = isDir || isConfig;
 
+            if (!zipState.skipFile && zipState.extractedCount >= ZIP_MAX_FILES) {
+                zipState.hasError = true;
+                zipState.errorMsg = "Too many files in archive (max " + String(ZIP_MAX_FILES) + ")";
+                return take;
+            }
+
             if (!zipState.skipFile) {
                 String path = "/" + String(zipState.filename);
+                assetCache.invalidate(path);
                 if (SD.exists(path)) SD.remove(path);
                 zipState.outFile = SD.open(path, FILE_WRITE);
+                invalidateSdFileCount();
                 if (!zipState.outFile) {
                     zipState.hasError = true;
                     zipState.errorMsg = "Cannot open: " + path;
@@ -340,12 +560,11 @@ static size_t zipFeedBytes(const uint8_t *buf, size_t avail) {
         if (zipState.dataRemaining == 0) {
             if (!zipState.skipFile) {
                 if (zipState.outFile) zipState.outFile.close();
-                if (zipState.extractedCount < 32) {
-                    zipState.extractedFiles[zipState.extractedCount++] = String(zipState.filename);
-                }
-                Serial.printf("[ZIP] Extracted: %s\n", zipState.filename);
+                assetCache.invalidate("/" + String(zipState.filename));
+                zipState.extractedFiles[zipState.extractedCount++] = String(zipState.filename);
+                LOGI("[ZIP] Extracted: %s", zipState.filename);
             } else if (strcmp(zipState.filename, "config.json") == 0) {
-                Serial.println("[ZIP] Skipped config.json");
+                LOGW("[ZIP] Skipped config.json");
             }
 
             zipState.sigFill = 0;
@@ -359,13 +578,36 @@ static size_t zipFeedBytes(const uint8_t *buf, size_t avail) {
     }
 }
 
+static bool zipExtracted(const String& name) {
+    for (uint8_t i = 0; i < zipState.extractedCount; i++) {
+        if (zipState.extractedFiles[i] == name) return true;
+    }
+    return false;
+}
+
+// A precompressed sibling would keep serving the old content, unless the
+// archive brought a new one itself (it may come before or after the file)
+static void removeZipStaleGzips() {
+    for (uint8_t i = 0; i < zipState.extractedCount; i++) {
+        const String& name = zipState.extractedFiles[i];
+        if (name.endsWith(".gz") || zipExtracted(name + ".gz")) continue;
+        removeStaleGzip("/" + name);
+    }
+}
+
 void handleZipUpload(AsyncWebServerRequest *request, String filename,
                      size_t index, uint8_t *data, size_t len, bool final) {
+    // Shares the upload slot: zipState and the SD writer are single-instance
+    if (index == 0 && !tryAdmit(request, REQ_CLASS_UPLOAD)) {
+        LOGW("[ZIP] Rejected: another upload is running");
+    }
+    if (!isAdmitted(request, REQ_CLASS_UPLOAD)) return;
+
     if (index == 0) {
         if (zipState.outFile) zipState.outFile.close();
         zipState = ZipUploadState();
         zipState.state = ZIP_FIND_SIG;
-        Serial.println("[ZIP] Upload started");
+        LOGI("[ZIP] Upload started");
     }
 
     if (!zipState.hasError && zipState.state != ZIP_DONE) {
@@ -377,11 +619,16 @@ void handleZipUpload(AsyncWebServerRequest *request, String filename,
 
     if (final) {
         if (zipState.outFile) zipState.outFile.close();
-        Serial.printf("[ZIP] Upload complete, %d file(s) extracted\n", zipState.extractedCount);
+        removeZipStaleGzips();
+        LOGI("[ZIP] Upload complete, %d file(s) extracted", zipState.extractedCount);
     }
 }
 
 void handleZipUploadComplete(AsyncWebServerRequest *request) {
+    if (!isAdmitted(request, REQ_CLASS_UPLOAD)) {
+        sendOverloaded(request, REQ_CLASS_UPLOAD);
+        return;
+    }
     if (zipState.hasError) {
         String body = "{\"success\":false,\"error\":\"" + zipState.errorMsg + "\"}";
         request->send(400, "application/json", body);
@@ -6,6 +6,19 @@
 #include <ArduinoJson.h>
 
 #define ZIP_MAX_FILENAME 128
+// Files one archive may extract; all are tracked for the stale .gz cleanup
+#define ZIP_MAX_FILES    64
+
+// Directory listing pages: default and maximum entries per response
+#define LIST_PAGE_DEFAULT  50
+#define LIST_PAGE_MAX      200
+// Entries examined per page (filters may reject many); the page ends early
+// with a cursor so one request never walks the whole card
+#define LIST_SCAN_BUDGET   256
+// One serialized entry, including the separating comma; fits a 255-byte FAT name
+#define LIST_LINE_MAX      320
+// How long the root file count used by the debug views stays valid
+#define SD_FILE_COUNT_TTL_MS 60000
 
 enum ZipParseState {
     ZIP_IDLE,
@@ -40,7 +53,7 @@ struct ZipUploadState {
     File     outFile;
     bool     skipFile;
 
-    String   extractedFiles[32];
+    String   extractedFiles[ZIP_MAX_FILES];
     uint8_t  extractedCount;
 
     uint8_t  sigBuf[4];
@@ -60,6 +73,14 @@ void handleFileUploadComplete(AsyncWebServerRequest *request);
 void handleListFiles(AsyncWebServerRequest *request);
 void handleDeleteFile(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total);
 
+// Drop the precompressed sibling of path, which would keep serving old content
+void removeStaleGzip(const String& path);
+
+// Number of entries in the SD root, recounted at most every SD_FILE_COUNT_TTL_MS
+int getSdFileCount();
+// Force a recount on the next getSdFileCount() (after creating/removing files)
+void invalidateSdFileCount();
+
 // ZIP archive upload handlers
 void handleZipUpload(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final);
 void handleZipUploadComplete(AsyncWebServerRequest *request);
@@ -0,0 +1,136 @@
+#include "gzip_encoder.h"
+#include <rom/crc.h>
+
+#define GZIP_MIN_MATCH  3
+#define GZIP_MAX_MATCH  258
+
+static const uint16_t LENGTH_BASE[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t LENGTH_EXTRA[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t DIST_BASE[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t DIST_EXTRA[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// Deflate packs bits LSB first; Huffman codes go in MSB first
+struct BitWriter {
+    uint8_t* out;
+    size_t   cap;
+    size_t   pos;
+    uint32_t bits;
+    uint8_t  count;
+    bool     overflow;
+
+    void put(uint32_t value, uint8_t n) {
+        bits |= value << count;
+        count += n;
+        while (count >= 8) {
+            if (pos < cap) out[pos++] = bits;
+            else overflow = true;
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+
+    void putCode(uint32_t code, uint8_t n) {
+        uint32_t reversed = 0;
+        for (uint8_t i = 0; i < n; i++) {
+            reversed = (reversed << 1) | ((code >> i) & 1);
+        }
+        put(reversed, n);
+    }
+
+    void alignByte() {
+        if (count) put(0, 8 - count);
+    }
+};
+
+// Fixed literal/length code (RFC 1951 3.2.6)
+static void putSymbol(BitWriter& w, uint16_t sym) {
+    if (sym < 144)      w.putCode(0x30 + sym, 8);
+    else if (sym < 256) w.putCode(0x190 + sym - 144, 9);
+    else if (sym < 280) w.putCode(sym - 256, 7);
+    else                w.putCode(0xC0 + sym - 280, 8);
+}
+
+static void putMatch(BitWriter& w, uint16_t length, uint16_t dist) {
+    int li = 28;
+    while (LENGTH_BASE[li] > length) li--;
+    putSymbol(w, 257 + li);
+    w.put(length - LENGTH_BASE[li], LENGTH_EXTRA[li]);
+
+    int di = 29;
+    while (DIST_BASE[di] > dist) di--;
+    w.putCode(di, 5);
+    w.put(dist - DIST_BASE[di], DIST_EXTRA[di]);
+}
+
+static uint32_t hash3(const uint8_t* p) {
+    uint32_t v = (p[0] << 16) | (p[1] << 8) | p[2];
+    return (v * 2654435761u) >> (32 - GZIP_HASH_BITS);
+}
+
+size_t gzipCompress(const uint8_t* in, size_t len, uint8_t* out, size_t cap) {
+    if (cap < 18) return 0;
+    // Last position seen per hash, low 16 bits; stale entries fail the compare below
+    uint16_t* table = (uint16_t*)malloc(sizeof(uint16_t) << GZIP_HASH_BITS);
+    if (!table) return 0;
+    memset(table, 0xFF, sizeof(uint16_t) << GZIP_HASH_BITS);
+
+    // Header: magic, deflate, no flags, no mtime, unknown OS
+    static const uint8_t HEADER[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff };
+    memcpy(out, HEADER, sizeof(HEADER));
+    BitWriter w = { out, cap - 8, sizeof(HEADER), 0, 0, false };
+
+    w.put(1, 1);    // BFINAL
+    w.put(1, 2);    // BTYPE = fixed Huffman
+
+    size_t i = 0;
+    while (i < len && !w.overflow) {
+        size_t best = 0;
+        uint16_t dist = 0;
+        if (i + GZIP_MIN_MATCH <= len) {
+            uint32_t h = hash3(in + i);
+            dist = (uint16_t)(i - table[h]);
+            table[h] = i;
+            if (dist > 0 && dist <= GZIP_WINDOW && dist <= i) {
+                const uint8_t* a = in + i;
+                const uint8_t* b = a - dist;
+                size_t limit = min(len - i, (size_t)GZIP_MAX_MATCH);
+                while (best < limit && a[best] == b[best]) best++;
+            }
+        }
+
+        if (best >= GZIP_MIN_MATCH) {
+            putMatch(w, best, dist);
+            // Index the covered positions so later matches can start inside this one
+            for (size_t j = i + 1; j < i + best && j + GZIP_MIN_MATCH <= len; j++) {
+                table[hash3(in + j)] = j;
+            }
+            i += best;
+        } else {
+            putSymbol(w, in[i]);
+            i++;
+        }
+    }
+    putSymbol(w, 256);  // end of block
+    w.alignByte();
+    free(table);
+    if (w.overflow) return 0;
+
+    // Trailer: CRC-32 and length of the input, little-endian
+    size_t pos = w.pos;
+    uint32_t crc = crc32_le(0, in, len);
+    for (int b = 0; b < 4; b++) out[pos++] = crc >> (8 * b);
+    for (int b = 0; b < 4; b++) out[pos++] = (uint32_t)len >> (8 * b);
+    return pos;
+}
@@ -0,0 +1,21 @@
+#ifndef GZIP_ENCODER_H
+#define GZIP_ENCODER_H
+
+#include <Arduino.h>
+
+// Match finder: hash buckets (2 bytes each) and the furthest match distance
+#define GZIP_HASH_BITS  11
+#define GZIP_WINDOW     4096
+
+/*
+ * One-shot gzip of a buffer: greedy LZ77 into a single fixed-Huffman
+ * deflate block. Far from zlib's ratio on arbitrary data, but repetitive
+ * text like line protocol or JSON shrinks 4-8×, and it needs only a
+ * 4 KB scratch table instead of miniz's ~300 KB compressor state.
+ *
+ * Returns the gzip length, or 0 if it would not fit in `cap` (send the
+ * data uncompressed then) or the scratch table couldn't be allocated.
+ */
+size_t gzipCompress(const uint8_t* in, size_t len, uint8_t* out, size_t cap);
+
+#endif
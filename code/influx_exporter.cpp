@@ -0,0 +1,357 @@
+#include "influx_exporter.h"
+#include <HTTPClient.h>
+#include <WiFiClient.h>
+#include <SD.h>
+#include <time.h>
+#include "config_manager.h"
+#include "gzip_encoder.h"
+#include "state_api.h"
+#include "telemetry.h"
+#include "logger.h"
+#include "pump_cluster.h"
+
+extern bool wifiConnected;
+
+// Control flags from code.ino
+extern volatile bool motor, manualOverride, mainSwitch, error;
+
+// Anything earlier means SNTP hasn't set the clock yet
+#define INFLUX_MIN_EPOCH 1700000000UL
+
+struct InfluxSample {
+    uint32_t time;              // epoch seconds
+    float    channels[9];       // snapshot order
+    uint8_t  flags;             // TLM_FLAG_*
+};
+
+// Queue by absolute index: slot = index % INFLUX_RING_LEN. loop() advances
+// head, the task advances tail; a full queue drops its oldest sample.
+static InfluxSample ring[INFLUX_RING_LEN];
+static uint32_t ringHead = 0;
+static uint32_t ringTail = 0;
+static portMUX_TYPE ringMux = portMUX_INITIALIZER_UNLOCKED;
+
+static InfluxStats stats;
+static unsigned long lastRecord = 0;
+
+// Exporter task state
+static char*    lineBuf = nullptr;  // INFLUX_BATCH_BYTES, allocated when first enabled
+static uint8_t* gzipBuf = nullptr;
+static InfluxSample batch[INFLUX_BATCH_SAMPLES];
+static uint32_t spoolSize = 0;
+static uint32_t spoolPos = 0;
+static uint32_t backoffMs = 0;
+static unsigned long nextAttempt = 0;
+
+enum PostResult { POST_OK, POST_RETRY, POST_REJECTED };
+
+// ─── Recording (loop) ───────────────────────────────────────────────────────
+
+void influxRecordSample() {
+    unsigned long intervalMs;
+    {
+        ConfigGuard cfg;
+        if (cfg->influx_url.length() == 0) return;
+        intervalMs = cfg->influx_interval_s * 1000UL;
+    }
+    if (lastRecord != 0 && millis() - lastRecord < intervalMs) return;
+    time_t now = time(nullptr);
+    if (now < (time_t)INFLUX_MIN_EPOCH) return;
+    lastRecord = millis();
+
+    StateSnapshot snap = getStateSnapshot();
+    InfluxSample s;
+    s.time = now;
+    s.channels[0] = snap.pressureIn;
+    s.channels[1] = snap.pressureOut;
+    s.channels[2] = snap.flow;
+    s.channels[3] = snap.waterTemp;
+    s.channels[4] = snap.ambientTemp;
+    s.channels[5] = snap.currentL1;
+    s.channels[6] = snap.currentL2;
+    s.channels[7] = snap.currentL3;
+    s.channels[8] = snap.currentTotal;
+    s.flags = (motor ? TLM_FLAG_MOTOR : 0) | (error ? TLM_FLAG_ERROR : 0) |
+              (mainSwitch ? TLM_FLAG_MAIN_SWITCH : 0) | (manualOverride ? TLM_FLAG_MANUAL : 0);
+
+    portENTER_CRITICAL(&ringMux);
+    ring[ringHead % INFLUX_RING_LEN] = s;
+    ringHead++;
+    if (ringHead - ringTail > INFLUX_RING_LEN) {
+        ringTail = ringHead - INFLUX_RING_LEN;
+        stats.samplesDropped++;
+    }
+    stats.queued = ringHead - ringTail;
+    portEXIT_CRITICAL(&ringMux);
+}
+
+// Copy up to INFLUX_BATCH_SAMPLES of the oldest samples; returns the count
+static size_t peekBatch(uint32_t& first) {
+    portENTER_CRITICAL(&ringMux);
+    first = ringTail;
+    size_t n = min((size_t)(ringHead - ringTail), (size_t)INFLUX_BATCH_SAMPLES);
+    for (size_t i = 0; i < n; i++) batch[i] = ring[(first + i) % INFLUX_RING_LEN];
+    portEXIT_CRITICAL(&ringMux);
+    return n;
+}
+
+// Drop samples up to first + n, unless loop() already overwrote them
+static void popBatch(uint32_t first, size_t n) {
+    portENTER_CRITICAL(&ringMux);
+    if ((int32_t)(first + n - ringTail) > 0) ringTail = first + n;
+    stats.queued = ringHead - ringTail;
+    portEXIT_CRITICAL(&ringMux);
+}
+
+// ─── Line protocol ──────────────────────────────────────────────────────────
+
+// Format batch[0..n) into lineBuf; n becomes the number that fit
+static size_t formatBatch(size_t& n) {
+    size_t len = 0;
+    size_t i = 0;
+    for (; i < n; i++) {
+        const InfluxSample& s = batch[i];
+        int w = snprintf(lineBuf + len, INFLUX_BATCH_BYTES - len,
+            INFLUX_MEASUREMENT ",device=%s pressure_in=%.3f,pressure_out=%.3f,flow=%.2f,"
+            "temp_water=%.2f,temp_ambient=%.2f,current_l1=%.2f,current_l2=%.2f,current_l3=%.2f,"
+            "current_total=%.2f,motor=%di,error=%di,main_switch=%di,override=%di %lu\n",
+            clusterDeviceId(), s.channels[0], s.channels[1], s.channels[2], s.channels[3], s.channels[4],
+            s.channels[5], s.channels[6], s.channels[7], s.channels[8],
+            (s.flags & TLM_FLAG_MOTOR) ? 1 : 0, (s.flags & TLM_FLAG_ERROR) ? 1 : 0,
+            (s.flags & TLM_FLAG_MAIN_SWITCH) ? 1 : 0, (s.flags & TLM_FLAG_MANUAL) ? 1 : 0,
+            (unsigned long)s.time);
+        if (w < 0 || len + w >= INFLUX_BATCH_BYTES) break;  // the rest goes next time
+        len += w;
+    }
+    n = i;
+    return len;
+}
+
+// ─── HTTP ───────────────────────────────────────────────────────────────────
+
+static WiFiClient tcp;
+static HTTPClient http;
+
+static PostResult postBody(const String& url, const String& token, size_t len) {
+    size_t gzLen = gzipCompress((const uint8_t*)lineBuf, len, gzipBuf, INFLUX_BATCH_BYTES);
+
+    if (!http.begin(tcp, url)) {
+        LOGI("[Influx] Bad URL %s", url.c_str());
+        return POST_RETRY;
+    }
+    http.addHeader("Content-Type", "text/plain; charset=utf-8");
+    if (gzLen) http.addHeader("Content-Encoding", "gzip");
+    if (token.length()) http.addHeader("Authorization", "Token " + token);
+
+    int code = gzLen ? http.POST(gzipBuf, gzLen) : http.POST((uint8_t*)lineBuf, len);
+    if (code >= 200 && code < 300) {
+        http.end();     // connection stays open for the next batch (setReuse)
+        stats.batchesSent++;
+        return POST_OK;
+    }
+
+    // 4xx means this data will never be accepted; 408 and 429 are worth retrying
+    if (code >= 400 && code < 500 && code != 408 && code != 429) {
+        LOGW("[Influx] Endpoint rejected %u bytes: %d %s", (unsigned)len, code, http.getString().c_str());
+        http.end();
+        stats.batchesRejected++;
+        return POST_REJECTED;
+    }
+    LOGE("[Influx] POST failed: %d %s", code, code < 0 ? HTTPClient::errorToString(code).c_str() : "");
+    http.end();
+    stats.batchesFailed++;
+    return POST_RETRY;
+}
+
+// ─── SD spool ───────────────────────────────────────────────────────────────
+
+static bool spoolPending() {
+    return spoolPos < spoolSize;
+}
+
+static void clearSpool() {
+    SD.remove(INFLUX_SPOOL_PATH);
+    SD.remove(INFLUX_SPOOL_POS_PATH);
+    spoolSize = 0;
+    spoolPos = 0;
+    stats.spoolBytes = 0;
+}
+
+static void saveSpoolPos() {
+    File f = SD.open(INFLUX_SPOOL_POS_PATH, FILE_WRITE);
+    if (!f) return;
+    f.write((const uint8_t*)&spoolPos, sizeof(spoolPos));
+    f.close();
+}
+
+// Move the oldest batch from RAM to the spool
+static void spillBatch() {
+    uint32_t first;
+    size_t n = peekBatch(first);
+    size_t len = formatBatch(n);
+    if (len == 0) return;
+
+    bool ok = false;
+    if (spoolSize + len <= INFLUX_SPOOL_MAX_BYTES) {
+        File f = SD.open(INFLUX_SPOOL_PATH, FILE_APPEND);
+        if (f) {
+            ok = f.write((const uint8_t*)lineBuf, len) == len;
+            f.close();
+        }
+    }
+    if (ok) {
+        spoolSize += len;
+        stats.spoolBytes = spoolSize - spoolPos;
+    } else {
+        stats.samplesDropped += n;
+    }
+    popBatch(first, n);
+}
+
+// Send the next whole lines from the spool
+static PostResult sendSpoolChunk(const String& url, const String& token) {
+    File f = SD.open(INFLUX_SPOOL_PATH);
+    if (!f || !f.seek(spoolPos)) {
+        if (f) f.close();
+        LOGE("[Influx] Spool unreadable, discarding it");
+        clearSpool();
+        return POST_OK;
+    }
+    size_t got = f.read((uint8_t*)lineBuf, min((size_t)INFLUX_BATCH_BYTES, (size_t)(spoolSize - spoolPos)));
+    f.close();
+
+    size_t len = got;
+    while (len > 0 && lineBuf[len - 1] != '\n') len--;
+    if (len == 0) {
+        // A torn write at the end; nothing more to recover
+        clearSpool();
+        return POST_OK;
+    }
+
+    PostResult result = postBody(url, token, len);
+    if (result != POST_RETRY) {
+        spoolPos += len;
+        if (spoolPending()) {
+            saveSpoolPos();
+            stats.spoolBytes = spoolSize - spoolPos;
+        } else {
+            LOGI("[Influx] Spool replayed (%lu bytes)", (unsigned long)spoolSize);
+            clearSpool();
+        }
+    }
+    return result;
+}
+
+// ─── Task ───────────────────────────────────────────────────────────────────
+
+// Append precision=s unless the URL already sets one
+static String writeUrl(const String& base) {
+    if (base.indexOf("precision=") >= 0) return base;
+    return base + (base.indexOf('?') >= 0 ? "&" : "?") + "precision=s";
+}
+
+static void influxTask(void*) {
+    bool ntpStarted = false;
+
+    for (;;) {
+        String url, token;
+        {
+            ConfigGuard cfg;
+            url = cfg->influx_url;
+            token = cfg->influx_token;
+        }
+        if (url.length() == 0) {
+            vTaskDelay(pdMS_TO_TICKS(1000));
+            continue;
+        }
+        if (!lineBuf) {
+            lineBuf = (char*)malloc(INFLUX_BATCH_BYTES);
+            gzipBuf = (uint8_t*)malloc(INFLUX_BATCH_BYTES);
+            if (!lineBuf || !gzipBuf) {
+                free(lineBuf);
+                free(gzipBuf);
+                lineBuf = nullptr;
+                gzipBuf = nullptr;
+                vTaskDelay(pdMS_TO_TICKS(10000));
+                continue;
+            }
+        }
+        if (!ntpStarted && wifiConnected) {
+            configTime(0, 0, "pool.ntp.org", "time.google.com");
+            ntpStarted = true;
+        }
+
+        uint32_t queued;
+        uint32_t oldest = 0;
+        portENTER_CRITICAL(&ringMux);
+        queued = ringHead - ringTail;
+        if (queued) oldest = ring[ringTail % INFLUX_RING_LEN].time;
+        portEXIT_CRITICAL(&ringMux);
+
+        // Endpoint or network down: keep RAM for the newest samples
+        bool failing = backoffMs > 0 || !wifiConnected;
+        if (failing && queued >= INFLUX_SPILL_AT) {
+            spillBatch();
+            continue;
+        }
+        if (!wifiConnected || (long)(millis() - nextAttempt) < 0) {
+            vTaskDelay(pdMS_TO_TICKS(250));
+            continue;
+        }
+
+        // Live samples first; the spool drains whenever there's nothing due
+        bool batchDue = queued >= INFLUX_BATCH_SAMPLES ||
+                        (queued > 0 && (uint32_t)time(nullptr) - oldest >= INFLUX_FLUSH_S);
+        PostResult result;
+        if (batchDue) {
+            uint32_t first;
+            size_t n = peekBatch(first);
+            size_t len = formatBatch(n);
+            result = postBody(writeUrl(url), token, len);
+            if (result != POST_RETRY) popBatch(first, n);
+        } else if (spoolPending()) {
+            result = sendSpoolChunk(writeUrl(url), token);
+        } else {
+            vTaskDelay(pdMS_TO_TICKS(500));
+            continue;
+        }
+
+        if (result == POST_RETRY) {
+            backoffMs = backoffMs ? min(backoffMs * 2, (uint32_t)INFLUX_BACKOFF_MAX_MS) : INFLUX_BACKOFF_MIN_MS;
+            nextAttempt = millis() + backoffMs;
+        } else {
+            backoffMs = 0;
+        }
+    }
+}
+
+void setupInflux() {
+    File spool = SD.open(INFLUX_SPOOL_PATH);
+    if (spool) {
+        spoolSize = spool.size();
+        spool.close();
+        File pos = SD.open(INFLUX_SPOOL_POS_PATH);
+        if (pos) {
+            if (pos.read((uint8_t*)&spoolPos, sizeof(spoolPos)) != sizeof(spoolPos)) spoolPos = 0;
+            pos.close();
+        }
+        if (spoolPos > spoolSize) spoolPos = 0;
+        stats.spoolBytes = spoolSize - spoolPos;
+        if (spoolPending()) {
+            LOGI("[Influx] %lu spooled bytes waiting for replay", (unsigned long)stats.spoolBytes);
+        } else {
+            clearSpool();
+        }
+    }
+
+    http.setReuse(true);
+    http.setTimeout(INFLUX_HTTP_TIMEOUT_MS);
+    http.setConnectTimeout(INFLUX_HTTP_TIMEOUT_MS);
+
+    // Core 0 next to the MQTT task; HTTPClient and snprintf of floats need the stack
+    xTaskCreatePinnedToCore(influxTask, "influx", 8192, NULL, 1, NULL, 0);
+}
+
+InfluxStats influxStats() {
+    return stats;
+}
@@ -0,0 +1,55 @@
+#ifndef INFLUX_EXPORTER_H
+#define INFLUX_EXPORTER_H
+
+#include <Arduino.h>
+
+// RAM queue, and how much of it goes into one POST
+#define INFLUX_RING_LEN         240
+#define INFLUX_BATCH_SAMPLES    30
+#define INFLUX_BATCH_BYTES      8192    // line protocol per POST; also the gzip buffer
+// A partial batch is sent once its oldest sample is this old (seconds)
+#define INFLUX_FLUSH_S          60
+// While the endpoint is failing, the oldest samples above this go to SD
+#define INFLUX_SPILL_AT         (INFLUX_RING_LEN * 3 / 4)
+#define INFLUX_SPOOL_PATH       "/influx_spool.lp"
+#define INFLUX_SPOOL_POS_PATH   "/influx_spool.pos"
+#define INFLUX_SPOOL_MAX_BYTES  (4UL * 1024UL * 1024UL)
+// Retry delay after a failed POST doubles from MIN up to MAX
+#define INFLUX_BACKOFF_MIN_MS   2000
+#define INFLUX_BACKOFF_MAX_MS   300000
+#define INFLUX_HTTP_TIMEOUT_MS  5000
+#define INFLUX_MEASUREMENT      "aquasensys"
+
+struct InfluxStats {
+    uint32_t batchesSent;
+    uint32_t batchesFailed;     // POSTs that will be retried
+    uint32_t batchesRejected;   // 4xx from the endpoint; the data is dropped
+    uint32_t samplesDropped;    // RAM queue and spool both full
+    uint32_t queued;            // samples in RAM
+    uint32_t spoolBytes;        // spooled line protocol not yet sent
+};
+
+/*
+ * Pushes samples to an InfluxDB write endpoint (influx_url, e.g.
+ * http://host:8086/api/v2/write?org=o&bucket=b, or a v1 /write?db=x)
+ * every influx_interval_s, as gzipped line protocol with second precision:
+ *
+ *   aquasensys,device=<id> pressure_in=3.120,...,motor=1i,... 1760000000
+ *
+ * loop() only copies the snapshot into a RAM queue; a task on core 0 does
+ * the formatting, compression and HTTP over a kept-alive connection, so a
+ * slow endpoint never reaches loop(). Failed POSTs back off exponentially,
+ * and while failing the oldest samples are spilled to an SD spool that is
+ * replayed once the endpoint answers again. Timestamps come from SNTP;
+ * nothing is recorded until the clock is set. Plain HTTP only.
+ */
+
+// Load a spool left from before a reboot and start the exporter task
+void setupInflux();
+
+// Called from loop() after updateStateSnapshot(); records every influx_interval_s
+void influxRecordSample();
+
+InfluxStats influxStats();
+
+#endif
@@ -0,0 +1,197 @@
+#include "latency_trace.h"
+#include "event_stream.h"
+#include "mqtt_outbox.h"
+#include "logger.h"
+#include "pump_cluster.h"
+
+LatencyHistogram pathLatency[PATH_COUNT];
+
+static const char* PATH_NAMES[PATH_COUNT] = {
+    "cmd_mqtt",
+    "cmd_http",
+    "cmd_modbus",
+    "tlm_sse",
+    "tlm_mqtt",
+    "tlm_ws",
+};
+
+const char* latencyPathName(uint8_t path) {
+    return path < PATH_COUNT ? PATH_NAMES[path] : "unknown";
+}
+
+// Commands and telemetry stamps are shared by loop(), async_tcp, MQTT and telemetry tasks
+static portMUX_TYPE traceMux = portMUX_INITIALIZER_UNLOCKED;
+
+// ─── Commands ───────────────────────────────────────────────────────────────
+
+struct PendingCommand {
+    uint32_t    seq;
+    uint32_t    receivedUs;
+    LatencyPath path;
+    bool        used;
+    char        cid[LATENCY_CID_LEN];
+};
+
+static PendingCommand pending[LATENCY_PENDING];
+static uint32_t commandSeq = 0;
+
+void commandReceived(LatencyPath path, uint32_t receivedUs, const char* cid) {
+    portENTER_CRITICAL(&traceMux);
+    for (PendingCommand& p : pending) {
+        if (p.used) continue;
+        p.used = true;
+        p.seq = commandSeq++;
+        p.receivedUs = receivedUs;
+        p.path = path;
+        strlcpy(p.cid, cid ? cid : "", sizeof(p.cid));
+        break;
+    }
+    // Table full: a burst of commands in one loop pass; the rest go untimed
+    portEXIT_CRITICAL(&traceMux);
+}
+
+uint32_t commandMark() {
+    portENTER_CRITICAL(&traceMux);
+    uint32_t mark = commandSeq;
+    portEXIT_CRITICAL(&traceMux);
+    return mark;
+}
+
+static void sendAck(const PendingCommand& cmd, uint32_t latencyUs) {
+    StaticJsonDocument<192> doc;
+    doc["cid"] = cmd.cid;
+    doc["path"] = PATH_NAMES[cmd.path];
+    doc["latency_us"] = latencyUs;
+    doc["uptime_ms"] = millis();
+    char json[160];
+    serializeJson(doc, json, sizeof(json));
+
+    if (events.hasSubscribers(SSE_TOPIC_DIAGNOSTICS)) {
+        events.send(SSE_TOPIC_DIAGNOSTICS, json, "ack");
+    }
+    char topic[64];
+    snprintf(topic, sizeof(topic), "homeassistant/%s/ack", clusterDeviceId());
+    mqttEnqueue(topic, json, 0);
+    LOGD("[Latency] %s %s applied after %lu us", PATH_NAMES[cmd.path], cmd.cid, (unsigned long)latencyUs);
+}
+
+void commandsActuated(uint32_t mark) {
+    uint32_t now = micros();
+    for (PendingCommand& p : pending) {
+        PendingCommand done;
+        bool complete = false;
+        portENTER_CRITICAL(&traceMux);
+        if (p.used && (int32_t)(p.seq - mark) < 0) {
+            done = p;
+            p.used = false;
+            complete = true;
+        }
+        portEXIT_CRITICAL(&traceMux);
+        if (!complete) continue;
+
+        uint32_t latencyUs = now - done.receivedUs;
+        pathLatency[done.path].record(latencyUs);
+        if (done.cid[0]) sendAck(done, latencyUs);
+    }
+}
+
+// ─── Telemetry ──────────────────────────────────────────────────────────────
+
+static volatile uint32_t lastSampleUs = 0;
+// Sample last recorded per path, so only its first message counts
+static uint32_t lastRecorded[PATH_COUNT];
+
+void telemetrySampled() {
+    uint32_t now = micros();
+    lastSampleUs = now ? now : 1;   // 0 means "not stamped"
+}
+
+uint32_t telemetrySampleUs() {
+    return lastSampleUs;
+}
+
+void telemetrySent(LatencyPath path, uint32_t sampledUs) {
+    if (!sampledUs) return;
+    uint32_t now = micros();
+    portENTER_CRITICAL(&traceMux);
+    bool first = lastRecorded[path] != sampledUs;
+    lastRecorded[path] = sampledUs;
+    portEXIT_CRITICAL(&traceMux);
+    if (first) pathLatency[path].record(now - sampledUs);
+}
+
+// ─── Rolling window (loop only) ─────────────────────────────────────────────
+
+// Histogram snapshots taken every LATENCY_SLOT_MS; the oldest is the window start
+static LatencyHistogram::Snapshot slots[LATENCY_WINDOW_SLOTS][PATH_COUNT];
+static uint8_t slotNext = 0;
+static uint8_t slotsFilled = 0;
+static unsigned long lastSlotAt = 0;
+
+static const LatencyHistogram::Snapshot& windowStart(uint8_t path) {
+    uint8_t oldest = (slotsFilled < LATENCY_WINDOW_SLOTS) ? 0 : slotNext;
+    return slots[oldest][path];
+}
+
+// Value below which fraction q of the window falls, interpolated in its bucket
+static uint32_t percentile(const uint32_t* counts, uint32_t total, float q) {
+    float rank = q * total;
+    uint32_t below = 0;
+    for (uint8_t i = 0; i <= LATENCY_BUCKETS; i++) {
+        if (counts[i] == 0 || below + counts[i] < rank) {
+            below += counts[i];
+            continue;
+        }
+        uint32_t lower = (i == 0) ? 0 : LatencyHistogram::BOUNDS_US[i - 1];
+        // Beyond the last bound all we know is "more than"
+        if (i == LATENCY_BUCKETS) return lower;
+        uint32_t upper = LatencyHistogram::BOUNDS_US[i];
+        return lower + (uint32_t)((upper - lower) * ((rank - below) / counts[i]));
+    }
+    return 0;
+}
+
+// Adds {"n","mean_us","p50_us","p95_us","p99_us"} for every path with samples; true if any
+static bool addWindow(JsonObject obj) {
+    bool any = false;
+    for (uint8_t p = 0; p < PATH_COUNT; p++) {
+        LatencyHistogram::Snapshot now;
+        pathLatency[p].snapshot(now);
+        const LatencyHistogram::Snapshot& start = windowStart(p);
+        uint32_t n = now.total - start.total;
+        if (n == 0) continue;
+
+        uint32_t counts[LATENCY_BUCKETS + 1];
+        for (uint8_t i = 0; i <= LATENCY_BUCKETS; i++) counts[i] = now.counts[i] - start.counts[i];
+
+        JsonObject path = obj.createNestedObject(PATH_NAMES[p]);
+        path["n"] = n;
+        path["mean_us"] = (uint32_t)((now.sumUs - start.sumUs) / n);
+        path["p50_us"] = percentile(counts, n, 0.50f);
+        path["p95_us"] = percentile(counts, n, 0.95f);
+        path["p99_us"] = percentile(counts, n, 0.99f);
+        any = true;
+    }
+    return any;
+}
+
+void addLatencyJson(JsonObject obj) {
+    addWindow(obj);
+}
+
+void serviceLatencyStats() {
+    if (slotsFilled > 0 && millis() - lastSlotAt < LATENCY_SLOT_MS) return;
+    lastSlotAt = millis();
+
+    for (uint8_t p = 0; p < PATH_COUNT; p++) pathLatency[p].snapshot(slots[slotNext][p]);
+    slotNext = (slotNext + 1) % LATENCY_WINDOW_SLOTS;
+    if (slotsFilled < LATENCY_WINDOW_SLOTS) slotsFilled++;
+
+    StaticJsonDocument<768> doc;
+    if (!addWindow(doc.to<JsonObject>())) return;
+    char json[MQTT_MAX_MESSAGE - 64];
+    size_t len = serializeJson(doc, json, sizeof(json));
+    char topic[64];
+    snprintf(topic, sizeof(topic), "homeassistant/%s/latency", clusterDeviceId());
+    mqttEnqueue(topic, (const uint8_t*)json, len, 0);
+}
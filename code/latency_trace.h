@@ -0,0 +1,73 @@
+#ifndef LATENCY_TRACE_H
+#define LATENCY_TRACE_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "metrics.h"
+
+// Optional client correlation ID, including the terminator
+#define LATENCY_CID_LEN       32
+// Commands received but not yet seen by a control pass
+#define LATENCY_PENDING       8
+// Rolling window: LATENCY_WINDOW_SLOTS slots of LATENCY_SLOT_MS each (60 s)
+#define LATENCY_SLOT_MS       10000
+#define LATENCY_WINDOW_SLOTS  6
+
+// End-to-end paths, each with its own histogram
+enum LatencyPath : uint8_t {
+    PATH_CMD_MQTT,      // command topic received → motor output written
+    PATH_CMD_HTTP,      // POST /command
+    PATH_CMD_MODBUS,    // coil write
+    PATH_TLM_SSE,       // sensor sample → "update" event queued
+    PATH_TLM_MQTT,      // sensor sample → state topic published
+    PATH_TLM_WS,        // telemetry tick → WebSocket frames queued
+    PATH_COUNT
+};
+
+// Since boot; /metrics exports these as aquasensys_e2e_latency_seconds
+extern LatencyHistogram pathLatency[PATH_COUNT];
+
+const char* latencyPathName(uint8_t path);
+
+/*
+ * End-to-end latency, stamped with micros() where work enters and leaves.
+ *
+ * Commands are stamped on receipt and complete at the end of the first
+ * control pass that could have seen them, right after digitalWrite(MOTOR_PIN).
+ * A command carrying a correlation ID ("cid" in the /command body, or an
+ * MQTT payload of {"value":"ON","cid":"..."}) is acknowledged once applied,
+ * as an "ack" event on the diagnostics SSE topic and on
+ * homeassistant/<id>/ack:
+ *
+ *   {"cid":"probe-17","path":"cmd_http","latency_us":1840,"uptime_ms":912345}
+ *
+ * so a harness can time the full round trip and see the device's share.
+ *
+ * Telemetry is stamped when loop() samples the sensors and recorded the
+ * first time a message carrying that sample leaves on each path.
+ *
+ * Histograms count since boot; the diagnostics stream and the MQTT summary
+ * (homeassistant/<id>/latency, every LATENCY_SLOT_MS while anything was
+ * recorded) report the last minute.
+ */
+
+// After a command has been applied to the control flags. cid may be null.
+void commandReceived(LatencyPath path, uint32_t receivedUs, const char* cid);
+// loop(): before the control stage reads the flags...
+uint32_t commandMark();
+// ...and after it wrote the motor output; completes commands taken before mark
+void commandsActuated(uint32_t mark);
+
+// loop(): right after the sensors were read
+void telemetrySampled();
+// Stamp of the latest sample, for producers on other tasks
+uint32_t telemetrySampleUs();
+// A message carrying the sample stamped sampledUs went out on path
+void telemetrySent(LatencyPath path, uint32_t sampledUs);
+
+// loop(): roll the window and publish the MQTT summary
+void serviceLatencyStats();
+// loop(): last-minute summary per path with any samples
+void addLatencyJson(JsonObject obj);
+
+#endif
@@ -0,0 +1,252 @@
+#include "logger.h"
+#include <atomic>
+#include <memory>
+#include <stdarg.h>
+#include "config_manager.h"
+#include "metrics.h"
+
+volatile uint8_t logLevel = LOG_LEVEL_INFO;
+
+// A slot is valid for line N while seq == N + 1; 0 means a writer is in it.
+// Readers check seq before and after copying, like a seqlock.
+struct LogSlot {
+    std::atomic<uint32_t> seq;
+    uint32_t ms;
+    uint8_t  level;
+    char     text[LOG_LINE_MAX];
+};
+
+static LogSlot slots[LOG_RING_LEN];
+static std::atomic<uint32_t> nextSeq(0);
+static uint32_t dropped = 0;
+
+static const char* LEVEL_NAMES[] = { "none", "error", "warn", "info", "debug" };
+
+enum LogRead { LOG_READ_OK, LOG_READ_PENDING, LOG_READ_LOST };
+
+struct LogLine {
+    uint32_t ms;
+    uint8_t  level;
+    char     text[LOG_LINE_MAX];
+};
+
+// ─── Writing (any task) ─────────────────────────────────────────────────────
+
+void logWrite(uint8_t level, const char* fmt, ...) {
+    uint32_t seq = nextSeq.fetch_add(1, std::memory_order_relaxed);
+    LogSlot& slot = slots[seq % LOG_RING_LEN];
+
+    slot.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.ms = millis();
+    slot.level = level;
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(slot.text, sizeof(slot.text), fmt, args);
+    va_end(args);
+    // Callers used to end lines with \n for Serial; the drain adds its own
+    size_t len = (n < 0) ? 0 : min((size_t)n, sizeof(slot.text) - 1);
+    if ((size_t)n > len) {
+        // Truncated: don't leave half a UTF-8 character for the JSON reader
+        while (len > 0 && (slot.text[len - 1] & 0xC0) == 0x80) len--;
+        if (len > 0 && (slot.text[len - 1] & 0xC0) == 0xC0) len--;
+    }
+    while (len > 0 && (slot.text[len - 1] == '\n' || slot.text[len - 1] == '\r')) len--;
+    slot.text[len] = '\0';
+    slot.seq.store(seq + 1, std::memory_order_release);
+}
+
+// ─── Reading ────────────────────────────────────────────────────────────────
+
+static uint32_t oldestSeq(uint32_t head) {
+    return head > LOG_RING_LEN ? head - LOG_RING_LEN : 0;
+}
+
+// Copy line `seq` out of the ring
+static LogRead readLine(uint32_t seq, LogLine& out) {
+    const LogSlot& slot = slots[seq % LOG_RING_LEN];
+    uint32_t before = slot.seq.load(std::memory_order_acquire);
+    if (before != seq + 1) {
+        // Not committed yet, or already reused for a later line
+        return (before == 0 || (int32_t)(before - (seq + 1)) < 0) ? LOG_READ_PENDING : LOG_READ_LOST;
+    }
+    out.ms = slot.ms;
+    out.level = slot.level;
+    memcpy(out.text, slot.text, sizeof(out.text));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.seq.load(std::memory_order_relaxed) != before) return LOG_READ_LOST;
+    out.text[sizeof(out.text) - 1] = '\0';
+    return LOG_READ_OK;
+}
+
+// ─── Drain task ─────────────────────────────────────────────────────────────
+
+static void applyLogLevel() {
+    static uint32_t seenVersion = 0;
+    uint32_t version = configVersion();
+    if (version == seenVersion) return;
+    seenVersion = version;
+    ConfigGuard cfg;
+    logLevel = cfg->log_level;
+}
+
+static void logTask(void*) {
+    uint32_t cursor = 0;
+    uint32_t lost = 0;
+    LogLine line;
+
+    for (;;) {
+        applyLogLevel();
+
+        uint32_t head = nextSeq.load(std::memory_order_acquire);
+        if (cursor == head) {
+            vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_MS));
+            continue;
+        }
+        if ((int32_t)(oldestSeq(head) - cursor) > 0) {
+            lost += oldestSeq(head) - cursor;
+            cursor = oldestSeq(head);
+        }
+
+        LogRead r = readLine(cursor, line);
+        if (r == LOG_READ_PENDING) {
+            // A writer was preempted mid-line; it finishes before we run again
+            vTaskDelay(1);
+            continue;
+        }
+        cursor++;
+        if (r == LOG_READ_LOST) {
+            lost++;
+            continue;
+        }
+        if (lost) {
+            dropped += lost;
+            Serial.printf("[Log] %lu lines dropped\n", (unsigned long)lost);
+            lost = 0;
+        }
+        Serial.println(line.text);
+    }
+}
+
+void setupLogger() {
+    // Lowest non-idle priority on core 0: the UART wait happens here, off the control loop
+    xTaskCreatePinnedToCore(logTask, "log", 3072, NULL, 1, NULL, 0);
+}
+
+uint32_t getLogDropped() {
+    return dropped;
+}
+
+// ─── /api/logs ──────────────────────────────────────────────────────────────
+
+struct LogRender {
+    uint32_t cursor;
+    uint32_t end;           // newest line when the request came in
+    uint32_t lost;
+    uint8_t  step;          // 0 = opening, 1 = entries, 2 = trailer, 3 = done
+    bool     first;
+    LogLine  entry;
+    char     buf[LOG_LINE_MAX * 2 + 96];
+    size_t   len;
+    size_t   pos;
+};
+
+// Append s as a JSON string body; stops early rather than overrun
+static size_t escapeJson(char* out, size_t size, const char* s) {
+    size_t n = 0;
+    for (; *s && n + 7 < size; s++) {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\') {
+            out[n++] = '\\';
+            out[n++] = c;
+        } else if (c < 0x20) {
+            n += snprintf(out + n, size - n, "\\u%04x", c);
+        } else {
+            out[n++] = c;
+        }
+    }
+    out[n] = '\0';
+    return n;
+}
+
+// Render the next piece of the body into r.buf; false when done
+static bool nextPiece(LogRender& r) {
+    if (r.step == 0) {
+        r.len = strlcpy(r.buf, "{\"entries\":[", sizeof(r.buf));
+        r.step = 1;
+        return true;
+    }
+    while (r.step == 1) {
+        if (r.cursor == r.end) {
+            r.step = 2;
+            break;
+        }
+        LogRead result = readLine(r.cursor, r.entry);
+        if (result == LOG_READ_PENDING) {
+            // Stop here; the client picks it up with the next since
+            r.step = 2;
+            break;
+        }
+        uint32_t seq = r.cursor++;
+        if (result == LOG_READ_LOST) {
+            r.lost++;
+            continue;
+        }
+        int n = snprintf(r.buf, sizeof(r.buf), "%s{\"seq\":%lu,\"ms\":%lu,\"level\":\"%s\",\"msg\":\"",
+                         r.first ? "" : ",", (unsigned long)seq, (unsigned long)r.entry.ms,
+                         LEVEL_NAMES[min(r.entry.level, (uint8_t)LOG_LEVEL_DEBUG)]);
+        n += escapeJson(r.buf + n, sizeof(r.buf) - n - 3, r.entry.text);
+        n += snprintf(r.buf + n, sizeof(r.buf) - n, "\"}");
+        r.len = n;
+        r.first = false;
+        return true;
+    }
+    if (r.step == 2) {
+        r.len = snprintf(r.buf, sizeof(r.buf), "],\"dropped\":%lu,\"next\":%lu}",
+                         (unsigned long)r.lost, (unsigned long)r.cursor);
+        r.step = 3;
+        return true;
+    }
+    return false;
+}
+
+static size_t fillLogs(LogRender& r, uint8_t* buffer, size_t maxLen) {
+    size_t written = 0;
+    while (written < maxLen) {
+        if (r.pos == r.len) {
+            if (!nextPiece(r)) break;
+            r.pos = 0;
+        }
+        size_t n = min(maxLen - written, r.len - r.pos);
+        memcpy(buffer + written, r.buf + r.pos, n);
+        r.pos += n;
+        written += n;
+    }
+    return written;
+}
+
+void setupLogRoutes(AsyncWebServer& server) {
+    metricsRoutes({ "/api/logs" });
+    server.on("/api/logs", HTTP_GET, [](AsyncWebServerRequest *request) {
+        std::shared_ptr<LogRender> render = std::make_shared<LogRender>();
+        uint32_t head = nextSeq.load(std::memory_order_acquire);
+        uint32_t oldest = oldestSeq(head);
+        uint32_t since = 0;
+        if (request->hasParam("since")) since = strtoul(request->getParam("since")->value().c_str(), NULL, 10);
+
+        render->end = head;
+        render->cursor = (since < oldest || since > head) ? oldest : since;
+        render->lost = (since < oldest) ? oldest - since : 0;
+        render->step = 0;
+        render->first = true;
+        render->len = 0;
+        render->pos = 0;
+
+        AsyncWebServerResponse *response = request->beginChunkedResponse("application/json",
+            [render](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+                return fillLogs(*render, buffer, maxLen);
+            });
+        response->addHeader("Cache-Control", "no-store");
+        request->send(response);
+    });
+}
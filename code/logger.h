@@ -0,0 +1,69 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+// Levels; log_level in the config picks the most verbose one kept
+#define LOG_LEVEL_NONE   0
+#define LOG_LEVEL_ERROR  1
+#define LOG_LEVEL_WARN   2
+#define LOG_LEVEL_INFO   3
+#define LOG_LEVEL_DEBUG  4
+
+// Calls above this level are compiled out (e.g. -DLOG_MAX_LEVEL=LOG_LEVEL_INFO)
+#ifndef LOG_MAX_LEVEL
+#define LOG_MAX_LEVEL    LOG_LEVEL_DEBUG
+#endif
+
+// Lines kept in RAM, and the longest line (longer ones are truncated)
+#define LOG_RING_LEN     64
+#define LOG_LINE_MAX     160
+// How often the drain task looks for new lines
+#define LOG_DRAIN_MS     10
+
+/*
+ * Leveled logging that never waits for the UART.
+ *
+ * A call formats its line straight into a slot of a RAM ring: one atomic
+ * increment reserves the slot, no lock is taken, and a full ring overwrites
+ * its oldest lines. A low-priority task on core 0 drains the ring to Serial,
+ * so a 300-byte line costs loop() the vsnprintf, not 26 ms at 115200 baud.
+ * Lines keep the usual "[Tag] message" form and need no trailing newline.
+ *
+ * The same ring serves GET /api/logs?since=<seq>:
+ *
+ *   {"entries":[{"seq":41,"ms":12034,"level":"info","msg":"[MQTT] Connected"},...],
+ *    "dropped":0,"next":42}
+ *
+ * Pass "next" back as since to get only newer lines; "dropped" counts lines
+ * overwritten before they could be returned. A since beyond the newest line
+ * (the device rebooted) starts again from the oldest.
+ *
+ * Not for ISRs or critical sections.
+ */
+
+#define LOG_AT(level, fmt, ...) do { \
+        if ((level) <= LOG_MAX_LEVEL && (level) <= logLevel) logWrite((level), fmt, ##__VA_ARGS__); \
+    } while (0)
+
+#define LOGE(fmt, ...) LOG_AT(LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#define LOGW(fmt, ...) LOG_AT(LOG_LEVEL_WARN,  fmt, ##__VA_ARGS__)
+#define LOGI(fmt, ...) LOG_AT(LOG_LEVEL_INFO,  fmt, ##__VA_ARGS__)
+#define LOGD(fmt, ...) LOG_AT(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+
+// Runtime level, from log_level; read without a ConfigGuard on every call
+extern volatile uint8_t logLevel;
+
+void logWrite(uint8_t level, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+// Start the drain task; call right after Serial.begin()
+void setupLogger();
+
+// GET /api/logs
+void setupLogRoutes(AsyncWebServer& server);
+
+// Lines overwritten before the drain task reached them
+uint32_t getLogDropped();
+
+#endif
@@ -0,0 +1,406 @@
+#include "metrics.h"
+#include <WiFi.h>
+#include <memory>
+#include "counter_store.h"
+#include "event_stream.h"
+#include "telemetry.h"
+#include "mqtt_handler.h"
+#include "mqtt_outbox.h"
+#include "latency_trace.h"
+#include "logger.h"
+
+// Sensor readings from code.ino
+extern float pressureIn, pressureOut;
+extern float ambientTemp, waterTemp;
+extern float currentL1, currentL2, currentL3, currentTotal;
+
+// ─── Latency histograms ────────────────────────────────────────────────────
+
+// Loop stages run from ~100 µs (idle) to seconds (SD stalls, calibration)
+const uint32_t LatencyHistogram::BOUNDS_US[LATENCY_BUCKETS] = {
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 1000000
+};
+
+LatencyHistogram loopLatency;
+LatencyHistogram stageLatency[STAGE_COUNT];
+
+static const char* STAGE_NAMES[STAGE_COUNT] = {
+    "sensors",
+    "logging",
+    "notify",
+    "diagnostics",
+    "control",
+};
+
+LatencyHistogram::LatencyHistogram() :
+    sumUs(0),
+    total(0),
+    mux(portMUX_INITIALIZER_UNLOCKED) {
+    memset(counts, 0, sizeof(counts));
+}
+
+void LatencyHistogram::record(uint32_t us) {
+    uint8_t bucket = 0;
+    while (bucket < LATENCY_BUCKETS && us > BOUNDS_US[bucket]) bucket++;
+
+    portENTER_CRITICAL(&mux);
+    counts[bucket]++;
+    sumUs += us;
+    total++;
+    portEXIT_CRITICAL(&mux);
+}
+
+void LatencyHistogram::snapshot(Snapshot& out) {
+    portENTER_CRITICAL(&mux);
+    memcpy(out.counts, counts, sizeof(counts));
+    out.sumUs = sumUs;
+    out.total = total;
+    portEXIT_CRITICAL(&mux);
+}
+
+// ─── HTTP requests by route ────────────────────────────────────────────────
+
+struct RouteCount {
+    char     route[METRICS_ROUTE_LEN];
+    uint32_t count;
+};
+
+// Filled during setup; counts only touched from web handlers, which all run
+// in the async_tcp task
+static RouteCount routes[METRICS_MAX_ROUTES];
+static uint8_t  routeCount = 0;
+static uint32_t staticRequests = 0;     // any path whose last segment has an extension
+static uint32_t notFoundRequests = 0;   // no declared route
+
+void metricsRoutes(std::initializer_list<const char*> paths) {
+    for (const char* path : paths) {
+        if (routeCount >= METRICS_MAX_ROUTES || strlen(path) >= METRICS_ROUTE_LEN) {
+            LOGW("[Metrics] Route %s not counted separately", path);
+            continue;
+        }
+        bool known = false;
+        for (uint8_t i = 0; i < routeCount && !known; i++) known = strcmp(routes[i].route, path) == 0;
+        if (known) continue;
+        strlcpy(routes[routeCount].route, path, sizeof(routes[routeCount].route));
+        routes[routeCount].count = 0;
+        routeCount++;
+    }
+}
+
+static void countRequest(const String& url) {
+    int slash = url.lastIndexOf('/');
+    if (url.indexOf('.', slash) >= 0) {
+        staticRequests++;
+        return;
+    }
+
+    for (uint8_t i = 0; i < routeCount; i++) {
+        if (url == routes[i].route) {
+            routes[i].count++;
+            return;
+        }
+    }
+    notFoundRequests++;
+}
+
+// Sees every request before the real handlers and never claims one
+class RequestCounter : public AsyncWebHandler {
+public:
+    bool canHandle(AsyncWebServerRequest *request) override {
+        countRequest(request->url());
+        return false;
+    }
+};
+
+// ─── Metric families ───────────────────────────────────────────────────────
+
+enum MetricType : uint8_t { METRIC_GAUGE, METRIC_COUNTER, METRIC_HISTOGRAM };
+
+static const char* TYPE_NAMES[] = { "gauge", "counter", "histogram" };
+
+struct MetricSample {
+    const char*       labelName;    // nullptr for an unlabelled series
+    const char*       labelValue;
+    double            value;
+    LatencyHistogram* histogram;
+};
+
+// Fills series `index` of a family; false once past the last one
+typedef bool (*MetricSampler)(uint8_t index, MetricSample& s);
+
+struct MetricFamily {
+    const char*   name;
+    MetricType    type;
+    const char*   help;
+    MetricSampler sample;
+};
+
+static bool series(MetricSample& s, const char* label, const char* value, double v) {
+    s.labelName = label;
+    s.labelValue = value;
+    s.value = v;
+    return true;
+}
+
+static bool histogramSeries(MetricSample& s, const char* label, const char* value, LatencyHistogram* h) {
+    s.labelName = label;
+    s.labelValue = value;
+    s.histogram = h;
+    return true;
+}
+
+static const MetricFamily FAMILIES[] = {
+    // Sensors
+    { "aquasensys_pressure_bar", METRIC_GAUGE, "Water pressure",
+      [](uint8_t i, MetricSample& s) {
+          switch (i) {
+              case 0: return series(s, "port", "in", pressureIn);
+              case 1: return series(s, "port", "out", pressureOut);
+          }
+          return false;
+      } },
+    { "aquasensys_flow_lpm", METRIC_GAUGE, "Water flow in L/min",
+      [](uint8_t i, MetricSample& s) { return i == 0 && series(s, nullptr, nullptr, flow); } },
+    { "aquasensys_temperature_celsius", METRIC_GAUGE, "Temperature",
+      [](uint8_t i, MetricSample& s) {
+          switch (i) {
+              case 0: return series(s, "sensor", "water", waterTemp);
+              case 1: return series(s, "sensor", "ambient", ambientTemp);
+          }
+          return false;
+      } },
+    { "aquasensys_current_amperes", METRIC_GAUGE, "Motor phase current (RMS)",
+      [](uint8_t i, MetricSample& s) {
+          switch (i) {
+              case 0: return series(s, "phase", "l1", currentL1);
+              case 1: return series(s, "phase", "l2", currentL2);
+              case 2: return series(s, "phase", "l3", currentL3);
+              case 3: return series(s, "phase", "total", currentTotal);
+          }
+          return false;
+      } },
+    { "aquasensys_control_flag", METRIC_GAUGE, "Control state (1 = on)",
+      [](uint8_t i, MetricSample& s) {
+          switch (i) {
+              case 0: return series(s, "flag", "motor", motor);
+              case 1: return series(s, "flag", "main_switch", mainSwitch);
+              case 2: return series(s, "flag", "manual_override", manualOverride);
+              case 3: return series(s, "flag", "error", error);
+          }
+          return false;
+      } },
+
+    // System
+    { "aquasensys_uptime_seconds", METRIC_GAUGE, "Seconds since boot",
+      [](uint8_t i, MetricSample& s) { return i == 0 && series(s, nullptr, nullptr, millis() / 1000); } },
+    { "aquasensys_free_heap_bytes", METRIC_GAUGE, "Free heap",
+      [](uint8_t i, MetricSample& s) { return i == 0 && series(s, nullptr, nullptr, ESP.getFreeHeap()); } },
+    { "aquasensys_wifi_rssi_dbm", METRIC_GAUGE, "WiFi signal strength",
+      [](uint8_t i, MetricSample& s) { return i == 0 && series(s, nullptr, nullptr, WiFi.RSSI()); } },
+    { "aquasensys_stream_clients", METRIC_GAUGE, "Connected streaming clients",
+      [](uint8_t i, MetricSample& s) {
+          switch (i) {
+              case 0: return series(s, "stream", "sse", events.count());
+              case 1: return series(s, "stream", "telemetry", telemetry.getClientCount());
+          }
+          return false;
+      } },
+
+    // Lifetime counters (persisted across reboots)
+    { "aquasensys_motor_runtime_seconds_total", METRIC_COUNTER, "Motor running time",
+      [](uint8_t i, MetricSample& s) { return i == 0 && series(s, nullptr, nullptr, counters.get(CNT_MOTOR_RUNTIME_S)); } },
+    { "aquasensys_motor_starts_total", METRIC_COUNTER, "Motor starts",
+      [](uint8_t i, MetricSample& s) { return i == 0 && series(s, nullptr, nullptr, counters.get(CNT_MOTOR_STARTS)); } },
+    { "aquasensys_pumped_volume_liters_total", METRIC_COUNTER, "Integrated flow",
+      [](uint8_t i, MetricSample& s) {
+          return i == 0 && series(s, nullptr, nullptr, counters.get(CNT_PUMPED_VOLUME_ML) / 1000.0);
+      } },
+    { "aquasensys_trips_total", METRIC_COUNTER, "Protection trips by cause",
+      [](uint8_t i, MetricSample& s) {
+          switch (i) {
+              case 0: return series(s, "reason", "dry_run", counters.get(CNT_TRIP_DRY_RUN));
+              case 1: return series(s, "reason", "overcurrent", counters.get(CNT_TRIP_OVERCURRENT));
+              case 2: return series(s, "reason", "imbalance", counters.get(CNT_TRIP_IMBALANCE));
+              case 3: return series(s, "reason", "pressure", counters.get(CNT_TRIP_PRESSURE));
+          }
+          return false;
+      } },
+    { "aquasensys_power_cycles_total", METRIC_COUNTER, "Cold boots",
+      [](uint8_t i, MetricSample& s) { return i == 0 && series(s, nullptr, nullptr, counters.get(CNT_POWER_CYCLES)); } },
+
+    // Service counters (since boot)
+    { "aquasensys_mqtt_connects_total", METRIC_COUNTER, "MQTT connection attempts by result",
+      [](uint8_t i, MetricSample& s) {
+          switch (i) {
+              case 0: return series(s, "result", "ok", mqttReconnects);
+              case 1: return series(s, "result", "failed", mqttReconnectFailures);
+          }
+          return false;
+      } },
+    { "aquasensys_mqtt_messages_total", METRIC_COUNTER, "MQTT messages by outcome",
+      [](uint8_t i, MetricSample& s) {
+          MqttOutboxStats st = mqttOutboxStats();
+          switch (i) {
+              case 0: return series(s, "result", "published", st.published);
+              case 1: return series(s, "result", "spooled", st.spooled);
+              case 2: return series(s, "result", "replayed", st.replayed);
+              case 3: return series(s, "result", "dropped", st.dropped);
+          }
+          return false;
+      } },
+    { "aquasensys_mqtt_spool_bytes", METRIC_GAUGE, "MQTT journal bytes awaiting replay",
+      [](uint8_t i, MetricSample& s) { return i == 0 && series(s, nullptr, nullptr, mqttOutboxStats().spoolBytes); } },
+    { "aquasensys_sse_messages_total", METRIC_COUNTER, "SSE messages queued to clients",
+      [](uint8_t i, MetricSample& s) { return i == 0 && series(s, nullptr, nullptr, events.getMessagesSent()); } },
+    { "aquasensys_sse_evictions_total", METRIC_COUNTER, "SSE client groups dropped for backlog",
+      [](uint8_t i, MetricSample& s) { return i == 0 && series(s, nullptr, nullptr, events.getEvictions()); } },
+    { "aquasensys_telemetry_frames_total", METRIC_COUNTER, "Telemetry frames by result",
+      [](uint8_t i, MetricSample& s) {
+          switch (i) {
+              case 0: return series(s, "result", "sent", telemetry.getFramesSent());
+              case 1: return series(s, "result", "dropped", telemetry.getFramesDropped());
+          }
+          return false;
+      } },
+    { "aquasensys_http_requests_total", METRIC_COUNTER, "HTTP requests by route",
+      [](uint8_t i, MetricSample& s) {
+          if (i < routeCount) return series(s, "route", routes[i].route, routes[i].count);
+          if (i == routeCount) return series(s, "route", "static", staticRequests);
+          if (i == routeCount + 1) return series(s, "route", "not_found", notFoundRequests);
+          return false;
+      } },
+
+    // Latency
+    { "aquasensys_loop_duration_seconds", METRIC_HISTOGRAM, "Main loop iteration time",
+      [](uint8_t i, MetricSample& s) { return i == 0 && histogramSeries(s, nullptr, nullptr, &loopLatency); } },
+    { "aquasensys_stage_duration_seconds", METRIC_HISTOGRAM, "Main loop stage time",
+      [](uint8_t i, MetricSample& s) {
+          return i < STAGE_COUNT && histogramSeries(s, "stage", STAGE_NAMES[i], &stageLatency[i]);
+      } },
+    { "aquasensys_e2e_latency_seconds", METRIC_HISTOGRAM, "Command receipt to actuation, sensor sample to send",
+      [](uint8_t i, MetricSample& s) {
+          return i < PATH_COUNT && histogramSeries(s, "path", latencyPathName(i), &pathLatency[i]);
+      } },
+};
+
+static const uint8_t FAMILY_COUNT = sizeof(FAMILIES) / sizeof(FAMILIES[0]);
+
+// ─── Streaming renderer ────────────────────────────────────────────────────
+
+struct MetricsRender {
+    uint8_t  family;
+    uint8_t  series;
+    uint8_t  step;          // 0 = HELP, 1 = TYPE, 2 = series lines
+    uint8_t  bucket;        // histogram line within the current series
+    uint32_t cumulative;
+    LatencyHistogram::Snapshot hist;    // held across one series' lines
+    char     line[METRICS_LINE_MAX];
+    size_t   len;
+    size_t   pos;
+};
+
+// {label="value",le="x"}, or empty
+static void formatLabels(char* out, size_t size, const MetricSample& s, const char* le) {
+    out[0] = '\0';
+    if (!s.labelName && !le) return;
+    int n = snprintf(out, size, "{");
+    if (s.labelName) n += snprintf(out + n, size - n, "%s=\"%s\"%s", s.labelName, s.labelValue, le ? "," : "");
+    if (le) n += snprintf(out + n, size - n, "le=\"%s\"", le);
+    snprintf(out + n, size - n, "}");
+}
+
+static void setLine(MetricsRender& r, int n) {
+    r.len = (n < 0) ? 0 : min((size_t)n, sizeof(r.line) - 1);
+    r.pos = 0;
+}
+
+// Render the next exposition line into r.line; false when done
+static bool nextLine(MetricsRender& r) {
+    char labels[80];
+
+    while (r.family < FAMILY_COUNT) {
+        const MetricFamily& fam = FAMILIES[r.family];
+
+        if (r.step == 0) {
+            setLine(r, snprintf(r.line, sizeof(r.line), "# HELP %s %s\n", fam.name, fam.help));
+            r.step = 1;
+            return true;
+        }
+        if (r.step == 1) {
+            setLine(r, snprintf(r.line, sizeof(r.line), "# TYPE %s %s\n", fam.name, TYPE_NAMES[fam.type]));
+            r.step = 2;
+            return true;
+        }
+
+        MetricSample s = {};
+        if (!fam.sample(r.series, s)) {
+            r.family++;
+            r.series = 0;
+            r.step = 0;
+            continue;
+        }
+
+        if (fam.type != METRIC_HISTOGRAM) {
+            formatLabels(labels, sizeof(labels), s, nullptr);
+            setLine(r, snprintf(r.line, sizeof(r.line), fam.type == METRIC_COUNTER ? "%s%s %.10g\n" : "%s%s %.6g\n",
+                                fam.name, labels, s.value));
+            r.series++;
+            return true;
+        }
+
+        // Histogram: cumulative buckets, +Inf, _sum, _count from one snapshot
+        if (r.bucket == 0) {
+            s.histogram->snapshot(r.hist);
+            r.cumulative = 0;
+        }
+        if (r.bucket <= LATENCY_BUCKETS) {
+            char le[16];
+            if (r.bucket < LATENCY_BUCKETS) snprintf(le, sizeof(le), "%g", LatencyHistogram::BOUNDS_US[r.bucket] / 1e6);
+            else strlcpy(le, "+Inf", sizeof(le));
+            r.cumulative += r.hist.counts[r.bucket];
+            formatLabels(labels, sizeof(labels), s, le);
+            setLine(r, snprintf(r.line, sizeof(r.line), "%s_bucket%s %lu\n",
+                                fam.name, labels, (unsigned long)r.cumulative));
+        } else if (r.bucket == LATENCY_BUCKETS + 1) {
+            formatLabels(labels, sizeof(labels), s, nullptr);
+            setLine(r, snprintf(r.line, sizeof(r.line), "%s_sum%s %.6f\n",
+                                fam.name, labels, r.hist.sumUs / 1e6));
+        } else {
+            formatLabels(labels, sizeof(labels), s, nullptr);
+            setLine(r, snprintf(r.line, sizeof(r.line), "%s_count%s %lu\n",
+                                fam.name, labels, (unsigned long)r.hist.total));
+            r.bucket = 0;
+            r.series++;
+            return true;
+        }
+        r.bucket++;
+        return true;
+    }
+    return false;
+}
+
+static size_t fillMetrics(MetricsRender& r, uint8_t* buffer, size_t maxLen) {
+    size_t written = 0;
+    while (written < maxLen) {
+        if (r.pos == r.len && !nextLine(r)) break;
+        size_t n = min(maxLen - written, r.len - r.pos);
+        memcpy(buffer + written, r.line + r.pos, n);
+        r.pos += n;
+        written += n;
+    }
+    return written;
+}
+
+void setupMetrics(AsyncWebServer& server) {
+    server.addHandler(new RequestCounter());
+    metricsRoutes({ "/metrics" });
+
+    server.on("/metrics", HTTP_GET, [](AsyncWebServerRequest *request) {
+        std::shared_ptr<MetricsRender> render = std::make_shared<MetricsRender>();
+        AsyncWebServerResponse *response = request->beginChunkedResponse("text/plain; version=0.0.4",
+            [render](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+                return fillMetrics(*render, buffer, maxLen);
+            });
+        request->send(response);
+    });
+}
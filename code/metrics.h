@@ -0,0 +1,73 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <ESPAsyncWebServer.h>
+#include <initializer_list>
+
+// Histogram bucket upper bounds (µs) are in metrics.cpp; one extra for +Inf
+#define LATENCY_BUCKETS      12
+
+// Routes counted by name (see metricsRoutes())
+#define METRICS_MAX_ROUTES   32
+#define METRICS_ROUTE_LEN    32
+// Longest rendered exposition line
+#define METRICS_LINE_MAX     160
+
+/**
+ * Fixed-bucket latency histogram. record() is cheap enough for loop() and
+ * may be called from any task; readers take a consistent snapshot.
+ */
+class LatencyHistogram {
+public:
+    struct Snapshot {
+        uint32_t counts[LATENCY_BUCKETS + 1];   // per bucket, not cumulative
+        uint64_t sumUs;
+        uint32_t total;
+    };
+
+    LatencyHistogram();
+
+    void record(uint32_t us);
+    void snapshot(Snapshot& out);
+
+    static const uint32_t BOUNDS_US[LATENCY_BUCKETS];
+
+private:
+    uint32_t     counts[LATENCY_BUCKETS + 1];
+    uint64_t     sumUs;
+    uint32_t     total;
+    portMUX_TYPE mux;
+};
+
+// Stages of the main loop timed separately
+enum LoopStage : uint8_t {
+    STAGE_SENSORS,       // ADC, temperature and current reads
+    STAGE_LOGGING,       // SD data log append
+    STAGE_NOTIFY,        // state snapshot and SSE update
+    STAGE_DIAGNOSTICS,   // diagnostics and debug SSE payloads
+    STAGE_CONTROL,       // error checks, motor control, LEDs
+    STAGE_COUNT
+};
+
+extern LatencyHistogram loopLatency;
+extern LatencyHistogram stageLatency[STAGE_COUNT];
+
+/*
+ * GET /metrics in Prometheus text format: sensor gauges, lifetime and
+ * service counters, HTTP requests by route and the loop histograms.
+ *
+ * The body is generated one line at a time into a fixed buffer as the
+ * chunked response drains, so a scrape costs one small allocation no matter
+ * how many series there are.
+ *
+ * Must be called before any other handler is added: request counting is a
+ * handler that sees every request first and then declines it.
+ */
+void setupMetrics(AsyncWebServer& server);
+
+// Declare the paths a module registers, each counted under its own route
+// label. Any other URL without a file extension (404s, scanners probing
+// /wp-login) is counted as route="not_found", so it can't take the slots.
+void metricsRoutes(std::initializer_list<const char*> paths);
+
+#endif
@@ -0,0 +1,325 @@
+#include "modbus_server.h"
+#include <AsyncTCP.h>
+#include "config_manager.h"
+#include "counter_store.h"
+#include "state_api.h"
+#include "web_routes.h"
+#include "logger.h"
+#include "latency_trace.h"
+
+// Control flags from code.ino
+extern volatile bool motor, manualOverride, manualMotorState;
+extern volatile bool mainSwitch, error;
+
+// Function codes
+#define MB_READ_COILS           0x01
+#define MB_READ_DISCRETE        0x02
+#define MB_READ_HOLDING         0x03
+#define MB_READ_INPUT           0x04
+#define MB_WRITE_COIL           0x05
+#define MB_WRITE_COILS          0x0F
+
+// Exception codes
+#define MB_ILLEGAL_FUNCTION     0x01
+#define MB_ILLEGAL_ADDRESS      0x02
+#define MB_ILLEGAL_VALUE        0x03
+
+// Register blocks (see modbus_server.h)
+#define REG_SCALED      0
+#define REG_STATUS      9
+#define REG_FLOAT       100
+#define REG_COUNTERS    200
+#define REG_SYSTEM      216
+#define REG_CONFIG      300
+
+#define CHANNEL_COUNT   9
+#define THRESHOLD_COUNT 4
+#define COIL_COUNT      3
+#define DISCRETE_COUNT  5
+
+static_assert(REG_COUNTERS + 2 * CNT_COUNT <= REG_SYSTEM, "counter block overlaps system registers");
+
+// int16 scale per channel, in snapshot order
+static const float CHANNEL_SCALE[CHANNEL_COUNT] = {
+    100.0f, 100.0f, 10.0f, 10.0f, 10.0f, 100.0f, 100.0f, 100.0f, 100.0f
+};
+
+// Everything a read can return, captured once per request
+struct RegisterImage {
+    float    channels[CHANNEL_COUNT];
+    uint16_t status;
+    uint32_t counters[CNT_COUNT];
+    uint32_t uptime;
+    uint32_t freeHeap;
+    float    thresholds[THRESHOLD_COUNT];
+    bool     sdPresent;
+};
+
+static void captureImage(RegisterImage& img) {
+    StateSnapshot snap = getStateSnapshot();
+    const float channels[CHANNEL_COUNT] = {
+        snap.pressureIn, snap.pressureOut, snap.flow, snap.waterTemp, snap.ambientTemp,
+        snap.currentL1, snap.currentL2, snap.currentL3, snap.currentTotal
+    };
+    memcpy(img.channels, channels, sizeof(channels));
+    img.status = (motor ? 0x01 : 0) | (manualOverride ? 0x02 : 0) | (manualMotorState ? 0x04 : 0) |
+                 (mainSwitch ? 0x08 : 0) | (error ? 0x10 : 0);
+    for (int i = 0; i < CNT_COUNT; i++) {
+        img.counters[i] = (uint32_t)counters.get((CounterId)i);
+    }
+    img.uptime = snap.uptime;
+    img.freeHeap = snap.freeHeap;
+    img.sdPresent = snap.sdPresent;
+
+    ConfigGuard cfg;
+    img.thresholds[0] = cfg->min_pressure;
+    img.thresholds[1] = cfg->max_pressure;
+    img.thresholds[2] = cfg->max_current;
+    img.thresholds[3] = cfg->max_phase_imbalance;
+}
+
+static uint16_t scaled(float value, float scale) {
+    long v = lroundf(value * scale);
+    return (uint16_t)(int16_t)constrain(v, -32768L, 32767L);
+}
+
+static uint16_t floatWord(float value, bool low) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return low ? (bits & 0xFFFF) : (bits >> 16);
+}
+
+static uint16_t uint32Word(uint32_t value, bool low) {
+    return low ? (value & 0xFFFF) : (value >> 16);
+}
+
+// False for an unmapped address
+static bool readRegister(const RegisterImage& img, uint16_t addr, uint16_t& value) {
+    if (addr < REG_SCALED + CHANNEL_COUNT) {
+        value = scaled(img.channels[addr], CHANNEL_SCALE[addr]);
+    } else if (addr == REG_STATUS) {
+        value = img.status;
+    } else if (addr >= REG_FLOAT && addr < REG_FLOAT + 2 * CHANNEL_COUNT) {
+        uint16_t off = addr - REG_FLOAT;
+        value = floatWord(img.channels[off / 2], off & 1);
+    } else if (addr >= REG_COUNTERS && addr < REG_COUNTERS + 2 * CNT_COUNT) {
+        uint16_t off = addr - REG_COUNTERS;
+        value = uint32Word(img.counters[off / 2], off & 1);
+    } else if (addr >= REG_SYSTEM && addr < REG_SYSTEM + 4) {
+        uint16_t off = addr - REG_SYSTEM;
+        value = uint32Word(off < 2 ? img.uptime : img.freeHeap, off & 1);
+    } else if (addr >= REG_CONFIG && addr < REG_CONFIG + 2 * THRESHOLD_COUNT) {
+        uint16_t off = addr - REG_CONFIG;
+        value = floatWord(img.thresholds[off / 2], off & 1);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool readCoil(uint16_t addr) {
+    switch (addr) {
+        case 0:  return mainSwitch;
+        case 1:  return manualOverride;
+        default: return manualMotorState;
+    }
+}
+
+static void writeCoil(uint16_t addr, bool on) {
+    switch (addr) {
+        case 0:  setMainSwitch(on); break;
+        case 1:  setManualOverride(on); break;
+        default: setManualMotor(on); break;
+    }
+}
+
+static bool readDiscrete(const RegisterImage& img, uint16_t addr) {
+    switch (addr) {
+        case 0:  return img.status & 0x01;
+        case 1:  return img.status & 0x10;
+        case 2:  return img.status & 0x08;
+        case 3:  return img.status & 0x02;
+        default: return img.sdPresent;
+    }
+}
+
+// ─── Frame processing ───────────────────────────────────────────────────────
+
+static uint16_t be16(const uint8_t* p) {
+    return (p[0] << 8) | p[1];
+}
+
+static void putBe16(uint8_t* p, uint16_t v) {
+    p[0] = v >> 8;
+    p[1] = v;
+}
+
+// Fill in the MBAP header for a reply PDU of pduLen bytes; returns the frame length
+static size_t finishReply(const uint8_t* req, uint8_t* resp, size_t pduLen) {
+    memcpy(resp, req, 4);               // transaction and protocol id
+    putBe16(resp + 4, pduLen + 1);      // unit id + PDU
+    resp[6] = req[6];
+    return 7 + pduLen;
+}
+
+static size_t exceptionReply(const uint8_t* req, uint8_t* resp, uint8_t code) {
+    resp[7] = req[7] | 0x80;
+    resp[8] = code;
+    return finishReply(req, resp, 2);
+}
+
+size_t modbusProcess(const uint8_t* req, size_t len, uint8_t* resp) {
+    // MBAP: transaction id, protocol id (0), length, unit id
+    if (len < 8 || be16(req + 2) != 0 || (size_t)be16(req + 4) + 6 != len) return 0;
+
+    const uint8_t fn = req[7];
+    const uint8_t* pdu = req + 8;
+    const size_t pduLen = len - 8;
+    uint8_t* out = resp + 7;
+
+    switch (fn) {
+    case MB_READ_COILS:
+    case MB_READ_DISCRETE: {
+        if (pduLen != 4) return exceptionReply(req, resp, MB_ILLEGAL_VALUE);
+        uint16_t start = be16(pdu), count = be16(pdu + 2);
+        uint16_t limit = fn == MB_READ_COILS ? COIL_COUNT : DISCRETE_COUNT;
+        if (count == 0 || count > 2000) return exceptionReply(req, resp, MB_ILLEGAL_VALUE);
+        if (start + count > limit) return exceptionReply(req, resp, MB_ILLEGAL_ADDRESS);
+
+        RegisterImage img;
+        if (fn == MB_READ_DISCRETE) captureImage(img);
+        uint8_t bytes = (count + 7) / 8;
+        out[0] = fn;
+        out[1] = bytes;
+        memset(out + 2, 0, bytes);
+        for (uint16_t i = 0; i < count; i++) {
+            bool on = fn == MB_READ_COILS ? readCoil(start + i) : readDiscrete(img, start + i);
+            if (on) out[2 + i / 8] |= 1 << (i % 8);
+        }
+        return finishReply(req, resp, 2 + bytes);
+    }
+
+    case MB_READ_HOLDING:
+    case MB_READ_INPUT: {
+        if (pduLen != 4) return exceptionReply(req, resp, MB_ILLEGAL_VALUE);
+        uint16_t start = be16(pdu), count = be16(pdu + 2);
+        if (count == 0 || count > 125) return exceptionReply(req, resp, MB_ILLEGAL_VALUE);
+
+        RegisterImage img;
+        captureImage(img);
+        out[0] = fn;
+        out[1] = count * 2;
+        for (uint16_t i = 0; i < count; i++) {
+            uint16_t value;
+            if (!readRegister(img, start + i, value)) return exceptionReply(req, resp, MB_ILLEGAL_ADDRESS);
+            putBe16(out + 2 + i * 2, value);
+        }
+        return finishReply(req, resp, 2 + count * 2);
+    }
+
+    case MB_WRITE_COIL: {
+        if (pduLen != 4) return exceptionReply(req, resp, MB_ILLEGAL_VALUE);
+        uint16_t addr = be16(pdu), value = be16(pdu + 2);
+        if (value != 0xFF00 && value != 0x0000) return exceptionReply(req, resp, MB_ILLEGAL_VALUE);
+        if (addr >= COIL_COUNT) return exceptionReply(req, resp, MB_ILLEGAL_ADDRESS);
+
+        writeCoil(addr, value == 0xFF00);
+        commandReceived(PATH_CMD_MODBUS, micros(), nullptr);
+        notifyClients();
+        out[0] = fn;
+        memcpy(out + 1, pdu, 4);        // echo address and value
+        return finishReply(req, resp, 5);
+    }
+
+    case MB_WRITE_COILS: {
+        if (pduLen < 5) return exceptionReply(req, resp, MB_ILLEGAL_VALUE);
+        uint16_t start = be16(pdu), count = be16(pdu + 2);
+        uint8_t bytes = pdu[4];
+        if (count == 0 || count > 1968 || bytes != (count + 7) / 8 || pduLen != 5u + bytes) {
+            return exceptionReply(req, resp, MB_ILLEGAL_VALUE);
+        }
+        if (start + count > COIL_COUNT) return exceptionReply(req, resp, MB_ILLEGAL_ADDRESS);
+
+        for (uint16_t i = 0; i < count; i++) {
+            writeCoil(start + i, pdu[5 + i / 8] & (1 << (i % 8)));
+        }
+        commandReceived(PATH_CMD_MODBUS, micros(), nullptr);
+        notifyClients();
+        out[0] = fn;
+        memcpy(out + 1, pdu, 4);        // echo start and quantity
+        return finishReply(req, resp, 5);
+    }
+
+    default:
+        return exceptionReply(req, resp, MB_ILLEGAL_FUNCTION);
+    }
+}
+
+// ─── TCP transport ──────────────────────────────────────────────────────────
+
+// Partial frame per client; only touched from the async_tcp task
+struct ModbusConnection {
+    uint8_t rx[MODBUS_MAX_ADU];
+    size_t  len;
+};
+
+static AsyncServer* modbusServer = nullptr;
+static uint8_t modbusClients = 0;
+
+static void onModbusData(ModbusConnection* conn, AsyncClient* client, const uint8_t* data, size_t len) {
+    while (len > 0) {
+        size_t n = min(len, sizeof(conn->rx) - conn->len);
+        memcpy(conn->rx + conn->len, data, n);
+        conn->len += n;
+        data += n;
+        len -= n;
+
+        // Requests may be pipelined or split across segments
+        while (conn->len >= 7) {
+            size_t frameLen = 6 + be16(conn->rx + 4);
+            if (frameLen < 8 || frameLen > MODBUS_MAX_ADU) {
+                // Not Modbus/TCP, or out of sync; nothing to resynchronize on
+                client->close(true);
+                return;
+            }
+            if (conn->len < frameLen) break;
+
+            uint8_t resp[MODBUS_MAX_ADU];
+            size_t respLen = modbusProcess(conn->rx, frameLen, resp);
+            if (respLen) client->write((const char*)resp, respLen);
+
+            conn->len -= frameLen;
+            memmove(conn->rx, conn->rx + frameLen, conn->len);
+        }
+    }
+}
+
+void setupModbus() {
+    modbusServer = new AsyncServer(MODBUS_PORT);
+    modbusServer->onClient([](void*, AsyncClient* client) {
+        if (modbusClients >= MODBUS_MAX_CLIENTS) {
+            client->onDisconnect([](void*, AsyncClient* c) { delete c; }, nullptr);
+            client->close(true);
+            return;
+        }
+
+        ModbusConnection* conn = new ModbusConnection();
+        conn->len = 0;
+        modbusClients++;
+        LOGI("[Modbus] Client %s connected", client->remoteIP().toString().c_str());
+
+        client->setNoDelay(true);
+        client->setRxTimeout(MODBUS_IDLE_TIMEOUT);
+        client->onData([](void* arg, AsyncClient* c, void* data, size_t len) {
+            onModbusData((ModbusConnection*)arg, c, (const uint8_t*)data, len);
+        }, conn);
+        client->onDisconnect([](void* arg, AsyncClient* c) {
+            delete (ModbusConnection*)arg;
+            modbusClients--;
+            delete c;
+        }, conn);
+    }, nullptr);
+    modbusServer->setNoDelay(true);
+    modbusServer->begin();
+    LOGI("[Modbus] Listening on port %d", MODBUS_PORT);
+}
@@ -0,0 +1,46 @@
+#ifndef MODBUS_SERVER_H
+#define MODBUS_SERVER_H
+
+#include <Arduino.h>
+
+#define MODBUS_PORT         502
+#define MODBUS_MAX_CLIENTS  4
+#define MODBUS_IDLE_TIMEOUT 60      // seconds without a request before a client is closed
+// MBAP header (7) + function code + 252 data bytes
+#define MODBUS_MAX_ADU      260
+
+/*
+ * Register map. Input registers (FC04) and holding registers (FC03) are the
+ * same read-only table; 32-bit values are two registers, high word first,
+ * float32 in IEEE 754 big-endian (ABCD).
+ *
+ *   0..8      int16 scaled: pressure in/out (bar ×100), flow (L/min ×10),
+ *             water/ambient temperature (°C ×10), current L1/L2/L3/total (A ×100)
+ *   9         status bits: motor, override, manual motor, main switch, error
+ *   100..117  float32: the same nine channels, unscaled
+ *   200..215  uint32: lifetime counters in CounterId order (low 32 bits)
+ *   216..219  uint32: uptime (s), free heap (bytes)
+ *   300..307  float32: min_pressure, max_pressure, max_current, max_phase_imbalance
+ *
+ * Discrete inputs (FC02): 0 motor, 1 error, 2 main switch, 3 override, 4 SD present.
+ * Coils (FC01/05/15): 0 main switch, 1 manual override, 2 manual motor;
+ * writes go through the same setters as POST /command.
+ *
+ * Reads come from the state snapshot taken by loop() once a second and
+ * never touch the ADC or SD. Any unit id is accepted. From a host:
+ *
+ *   mbpoll -m tcp -a 1 -t 3 -r 1 -c 10 -0 <ip>      (scaled block)
+ *   tools/modbus_probe.py <ip>                      (whole map, decoded)
+ */
+
+// Start listening on MODBUS_PORT; clients are served in the async_tcp task
+void setupModbus();
+
+/*
+ * Handle one complete Modbus/TCP frame (MBAP header included) and write
+ * the reply frame to `resp` (MODBUS_MAX_ADU bytes). Returns the reply
+ * length, or 0 if the frame gets no reply.
+ */
+size_t modbusProcess(const uint8_t* req, size_t len, uint8_t* resp);
+
+#endif
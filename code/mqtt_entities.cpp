@@ -0,0 +1,76 @@
+#include "mqtt_entities.h"
+#include <WiFi.h>
+#include "counter_store.h"
+
+// Sensor readings from code.ino
+extern float pressureIn, pressureOut, flow;
+extern float ambientTemp, waterTemp;
+extern float currentL1, currentL2, currentL3, currentTotal;
+
+// Control flags from code.ino
+extern volatile bool motor, manualOverride, manualMotorState;
+extern volatile bool mainSwitch, error, rebootRequested;
+
+// Intervals are seconds; sensor deadbands are in the sensor's unit unless relative
+const MqttEntity MQTT_ENTITIES[] = {
+    // Hydraulics
+    { "pressure", "Pressure", ENTITY_SENSOR, "bar", "pressure", "measurement", "mdi:gauge",
+      2, 2, 300, DEADBAND_ABS, 0.05f, [] { return pressureIn; }, nullptr },
+    { "pressure_out", "Outlet Pressure", ENTITY_SENSOR, "bar", "pressure", "measurement", "mdi:gauge",
+      2, 2, 300, DEADBAND_ABS, 0.05f, [] { return pressureOut; }, nullptr },
+    { "flow", "Flow Rate", ENTITY_SENSOR, "L/min", nullptr, "measurement", "mdi:water",
+      1, 2, 300, DEADBAND_ABS, 0.2f, [] { return flow; }, nullptr },
+
+    // Temperatures change slowly; the ADC readings jitter by ~0.1 °C
+    { "temperature", "Temperature", ENTITY_SENSOR, "°C", "temperature", "measurement", "mdi:thermometer",
+      1, 10, 600, DEADBAND_ABS, 0.2f, [] { return waterTemp; }, nullptr },
+    { "temperature_ambient", "Ambient Temperature", ENTITY_SENSOR, "°C", "temperature", "measurement", "mdi:home-thermometer",
+      1, 10, 600, DEADBAND_ABS, 0.2f, [] { return ambientTemp; }, nullptr },
+
+    // Motor
+    { "current_l1", "Current L1", ENTITY_SENSOR, "A", "current", "measurement", "mdi:current-ac",
+      2, 2, 300, DEADBAND_REL, 0.05f, [] { return currentL1; }, nullptr },
+    { "current_l2", "Current L2", ENTITY_SENSOR, "A", "current", "measurement", "mdi:current-ac",
+      2, 2, 300, DEADBAND_REL, 0.05f, [] { return currentL2; }, nullptr },
+    { "current_l3", "Current L3", ENTITY_SENSOR, "A", "current", "measurement", "mdi:current-ac",
+      2, 2, 300, DEADBAND_REL, 0.05f, [] { return currentL3; }, nullptr },
+    { "current_total", "Total Current", ENTITY_SENSOR, "A", "current", "measurement", "mdi:current-ac",
+      2, 2, 300, DEADBAND_REL, 0.05f, [] { return currentTotal; }, nullptr },
+    { "motor_runtime", "Motor Runtime", ENTITY_SENSOR, "s", "duration", "total_increasing", "mdi:timer-outline",
+      0, 60, 900, DEADBAND_ABS, 60.0f, [] { return (float)counters.get(CNT_MOTOR_RUNTIME_S); }, nullptr },
+
+    // System
+    { "uptime", "Uptime", ENTITY_SENSOR, "s", "duration", "total_increasing", "mdi:clock-outline",
+      0, 60, 600, DEADBAND_ABS, 60.0f, [] { return (float)(millis() / 1000); }, nullptr },
+    { "heap", "Free Memory", ENTITY_SENSOR, "bytes", nullptr, "measurement", "mdi:memory",
+      0, 30, 600, DEADBAND_REL, 0.1f, [] { return (float)ESP.getFreeHeap(); }, nullptr },
+    { "wifi_strength", "WiFi Signal", ENTITY_SENSOR, "dBm", "signal_strength", "measurement", "mdi:wifi",
+      0, 30, 600, DEADBAND_ABS, 3.0f, [] { return (float)WiFi.RSSI(); }, nullptr },
+
+    // Controls: any change is published right away
+    { "motor", "Pump Motor", ENTITY_SWITCH, nullptr, nullptr, nullptr, "mdi:pump",
+      0, 0, 600, DEADBAND_ABS, 0.5f, [] { return motor ? 1.0f : 0.0f; },
+      [](bool on) { manualMotorState = on; } },
+    { "main", "Main Power", ENTITY_SWITCH, nullptr, nullptr, nullptr, "mdi:power",
+      0, 0, 600, DEADBAND_ABS, 0.5f, [] { return mainSwitch ? 1.0f : 0.0f; },
+      [](bool on) { mainSwitch = on; } },
+    { "override", "Manual Override", ENTITY_SWITCH, nullptr, nullptr, nullptr, "mdi:account-wrench",
+      0, 0, 600, DEADBAND_ABS, 0.5f, [] { return manualOverride ? 1.0f : 0.0f; },
+      [](bool on) { manualOverride = on; } },
+    { "error", "System Error", ENTITY_SWITCH, nullptr, nullptr, nullptr, "mdi:alert",
+      0, 0, 600, DEADBAND_ABS, 0.5f, [] { return error ? 1.0f : 0.0f; },
+      [](bool on) { error = on; } },
+    { "reboot", "Reboot Device", ENTITY_BUTTON, nullptr, nullptr, nullptr, "mdi:restart",
+      0, 0, 0, DEADBAND_ABS, 0.0f, nullptr,
+      [](bool) { rebootRequested = true; } },
+};
+
+const uint8_t MQTT_ENTITY_COUNT = sizeof(MQTT_ENTITIES) / sizeof(MQTT_ENTITIES[0]);
+
+const MqttEntity* findMqttEntity(const char* id, size_t len) {
+    for (uint8_t i = 0; i < MQTT_ENTITY_COUNT; i++) {
+        const char* name = MQTT_ENTITIES[i].id;
+        if (strlen(name) == len && strncmp(name, id, len) == 0) return &MQTT_ENTITIES[i];
+    }
+    return nullptr;
+}
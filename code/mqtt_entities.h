@@ -0,0 +1,49 @@
+#ifndef MQTT_ENTITIES_H
+#define MQTT_ENTITIES_H
+
+#include <Arduino.h>
+
+enum EntityKind : uint8_t {
+    ENTITY_SENSOR,
+    ENTITY_SWITCH,      // state ON/OFF, command ON/OFF
+    ENTITY_BUTTON,      // command PRESS, no state
+};
+
+enum DeadbandMode : uint8_t {
+    DEADBAND_ABS,       // change of at least `deadband` units
+    DEADBAND_REL,       // change of at least `deadband` × |last published|
+};
+
+/**
+ * One Home Assistant entity. The table drives discovery, state publishing
+ * and command dispatch.
+ *
+ * State goes to homeassistant/<device>/<id>/state as a plain value, and
+ * commands arrive on homeassistant/<device>/<id>/set. A value is published
+ * when it moved past the deadband (at the published precision) and at least
+ * minIntervalS has passed, or unchanged once maxIntervalS has passed.
+ */
+struct MqttEntity {
+    const char*  id;            // unique_id suffix and topic segment
+    const char*  name;
+    EntityKind   kind;
+    const char*  unit;
+    const char*  deviceClass;
+    const char*  stateClass;
+    const char*  icon;
+    uint8_t      precision;     // decimals published
+    uint16_t     minIntervalS;
+    uint16_t     maxIntervalS;
+    DeadbandMode deadbandMode;
+    float        deadband;
+    float      (*read)();       // sensors and switches (switches: 0/1)
+    void       (*command)(bool on);     // switches and buttons
+};
+
+extern const MqttEntity MQTT_ENTITIES[];
+extern const uint8_t MQTT_ENTITY_COUNT;
+
+// Entity whose id is the given topic segment, or nullptr
+const MqttEntity* findMqttEntity(const char* id, size_t len);
+
+#endif
@@ -1,8 +1,14 @@
 #include "mqtt_handler.h"
 #include "config_manager.h"
+#include "mqtt_outbox.h"
+#include "mqtt_entities.h"
+#include "logger.h"
+#include "latency_trace.h"
+#include "pump_cluster.h"
 #include <PubSubClient.h>
 #include <ArduinoJson.h>
 #include <WiFi.h>
+#include <Preferences.h>
 
 // MQTT client object
 extern PubSubClient mqttClient;
@@ -10,219 +16,384 @@ extern bool wifiConnected;
 extern unsigned long lastMqttReconnectAttempt;
 
 volatile bool publishStatePending = false;
+volatile uint32_t mqttReconnects = 0;
+volatile uint32_t mqttReconnectFailures = 0;
+
+// Pre-built topic strings — populated in buildTopics(), reused everywhere
+static char mqttDeviceId[CLUSTER_ID_LEN];   // clusterDeviceId() the topics were built for
+static char mqttTopicBase[48];      // homeassistant/<device>/ (entity topics follow)
+static char mqttTopicCommands[64];  // homeassistant/<device>/+/set
+static char mqttTopicEvent[64];
+// Home Assistant announces itself here ("online") after it starts
+static const char* HA_STATUS_TOPIC = "homeassistant/status";
+
+// Retained discovery configs, serialized once in setupMQTT()
+struct DiscoveryEntry {
+    char  topic[96];
+    char* payload;
+};
+static DiscoveryEntry discovery[DISCOVERY_MAX_ENTRIES];
+static uint8_t discoveryCount = 0;
+// Next entry to (re)publish; == discoveryCount when nothing is pending
+static uint8_t discoveryNext = 0;
+// Set by the HA birth message; applied by mqttTask
+static volatile bool discoveryRequested = false;
+
+// Last published value per entity; MQTT task only
+struct EntityPublishState {
+    float         value;
+    unsigned long at;
+    bool          sent;
+};
+static EntityPublishState entityState[DISCOVERY_MAX_ENTRIES];
+
+// Firmware version plus a hash of the configs, so a changed entity table is republished
+static String discoveryVersion() {
+    uint32_t hash = 2166136261u;
+    for (uint8_t i = 0; i < discoveryCount; i++) {
+        for (const char* p = discovery[i].payload; *p; p++) {
+            hash = (hash ^ (uint8_t)*p) * 16777619u;
+        }
+    }
+    char version[48];
+    snprintf(version, sizeof(version), "%s:%08lx", DEVICE_VERSION, (unsigned long)hash);
+    return String(version);
+}
+
+// PubSubClient keeps the host pointer, so it must outlive config versions
+static char mqttServerHost[65];
+static int mqttServerPort = 0;
+
+// Set from the config change handler, applied by mqttTask
+static volatile bool mqttReconfigurePending = false;
 
-// Pre-built topic strings — populated once in setupMQTT(), reused everywhere
-static char mqttTopicMotor[64];
-static char mqttTopicOverride[64];
-static char mqttTopicMain[64];
-static char mqttTopicError[64];
-static char mqttTopicReboot[64];
-static char mqttTopicState[64];
+static void applyMqttServer() {
+    {
+        ConfigGuard cfg;
+        strlcpy(mqttServerHost, cfg->mqtt_server.c_str(), sizeof(mqttServerHost));
+        mqttServerPort = cfg->mqtt_port;
+    }
+    mqttClient.setServer(mqttServerHost, mqttServerPort);
+}
+
+static void buildTopics() {
+    strlcpy(mqttDeviceId, clusterDeviceId(), sizeof(mqttDeviceId));
+    snprintf(mqttTopicBase,     sizeof(mqttTopicBase),     "homeassistant/%s/",      mqttDeviceId);
+    snprintf(mqttTopicCommands, sizeof(mqttTopicCommands), "homeassistant/%s/+/set", mqttDeviceId);
+    snprintf(mqttTopicEvent,    sizeof(mqttTopicEvent),    "homeassistant/%s/event", mqttDeviceId);
+}
+
+// Cluster mode was switched, so the unit now publishes under another ID.
+// Clear the old retained discovery configs (Home Assistant then removes that
+// device) and rebuild the table for the new one. MQTT task only.
+static void changeDeviceId() {
+    for (uint8_t i = 0; i < discoveryCount; i++) {
+        mqttEnqueue(discovery[i].topic, "", MQTT_MSG_RETAIN | MQTT_MSG_DURABLE);
+        free(discovery[i].payload);
+    }
+    discoveryCount = 0;
+
+    buildTopics();
+    buildDiscoveryConfigs();
+    for (EntityPublishState& st : entityState) st.sent = false;
+    LOGI("[MQTT] Publishing as %s", mqttDeviceId);
+}
 
 void setupMQTT() {
-    snprintf(mqttTopicMotor,    sizeof(mqttTopicMotor),    "homeassistant/%s/motor/set",    DEVICE_ID);
-    snprintf(mqttTopicOverride, sizeof(mqttTopicOverride),  "homeassistant/%s/override/set", DEVICE_ID);
-    snprintf(mqttTopicMain,     sizeof(mqttTopicMain),      "homeassistant/%s/main/set",     DEVICE_ID);
-    snprintf(mqttTopicError,    sizeof(mqttTopicError),     "homeassistant/%s/error/set",    DEVICE_ID);
-    snprintf(mqttTopicReboot,   sizeof(mqttTopicReboot),    "homeassistant/%s/reboot/set",   DEVICE_ID);
-    snprintf(mqttTopicState,    sizeof(mqttTopicState),     "homeassistant/%s/state",        DEVICE_ID);
-
-    mqttClient.setServer(config.mqtt_server.c_str(), config.mqtt_port);
+    applyMqttServer();
+    clusterConfigure();
+    buildTopics();
     mqttClient.setCallback(mqttCallback);
+    // Bound how long a dead broker can hold the MQTT task in connect()
+    mqttClient.setSocketTimeout(MQTT_SOCKET_TIMEOUT_S);
+    mqttOutboxBegin();
+
+    buildDiscoveryConfigs();
+    // The broker keeps retained configs; only a new firmware has new ones to send
+    Preferences prefs;
+    String sentVersion;
+    if (prefs.begin("mqtt", true)) {
+        sentVersion = prefs.getString("disc_ver", "");
+        prefs.end();
+    }
+    discoveryNext = (sentVersion == discoveryVersion()) ? discoveryCount : 0;
+
+    onConfigChange(CFG_SECT_MQTT, [](uint32_t) { mqttReconfigurePending = true; });
 }
 
 void mqttCallback(char* topic, byte* payload, unsigned int length) {
+    uint32_t receivedUs = micros();
+
     // Build message string with length guard
     if (length > 256) {
-        Serial.println("MQTT message too long, ignoring");
+        LOGW("[MQTT] Message too long, ignoring");
         return;
     }
     char message[257];
     memcpy(message, payload, length);
     message[length] = '\0';
 
-    Serial.printf("MQTT [%s]: %s\n", topic, message);
-
-    if (strcmp(topic, mqttTopicMotor) == 0) {
-        manualMotorState = (strcmp(message, "ON") == 0);
-        Serial.printf("Manual motor: %s\n", manualMotorState ? "ON" : "OFF");
-    } else if (strcmp(topic, mqttTopicOverride) == 0) {
-        manualOverride = (strcmp(message, "ON") == 0);
-        Serial.printf("Manual override: %s\n", manualOverride ? "ON" : "OFF");
-    } else if (strcmp(topic, mqttTopicMain) == 0) {
-        mainSwitch = (strcmp(message, "ON") == 0);
-        Serial.printf("Main switch: %s\n", mainSwitch ? "ON" : "OFF");
-    } else if (strcmp(topic, mqttTopicError) == 0) {
-        error = (strcmp(message, "ON") == 0);
-        Serial.printf("Error state: %s\n", error ? "ON" : "OFF");
-    } else if (strcmp(topic, mqttTopicReboot) == 0 && strcmp(message, "PRESS") == 0) {
-        Serial.println("Reboot requested via MQTT");
-        rebootRequested = true;
+    // Peer heartbeats and plans arrive every few seconds; keep them out of the log
+    if (clusterHandleMessage(topic, message)) return;
+
+    LOGD("[MQTT] %s: %s", topic, message);
+
+    if (strcmp(topic, HA_STATUS_TOPIC) == 0) {
+        // HA restarted and may have lost its view of the device
+        if (strcmp(message, "online") == 0) discoveryRequested = true;
+        return;
+    }
+
+    // homeassistant/<device>/<entity>/set
+    size_t baseLen = strlen(mqttTopicBase);
+    size_t topicLen = strlen(topic);
+    if (topicLen <= baseLen + 4 || strncmp(topic, mqttTopicBase, baseLen) != 0 ||
+        strcmp(topic + topicLen - 4, "/set") != 0) return;
+    const MqttEntity* entity = findMqttEntity(topic + baseLen, topicLen - baseLen - 4);
+    if (!entity || !entity->command) return;
+
+    // Plain "ON"/"OFF"/"PRESS", or {"value":"ON","cid":"..."} to get an ack (latency_trace.h)
+    const char* value = message;
+    const char* cid = nullptr;
+    StaticJsonDocument<128> doc;
+    if (message[0] == '{') {
+        if (deserializeJson(doc, message) || !doc["value"].is<const char*>()) return;
+        value = doc["value"];
+        cid = doc["cid"];
     }
 
+    if (entity->kind == ENTITY_BUTTON) {
+        if (strcmp(value, "PRESS") != 0) return;
+        entity->command(true);
+    } else {
+        entity->command(strcmp(value, "ON") == 0);
+    }
+    commandReceived(PATH_CMD_MQTT, receivedUs, cid);
+    LOGI("[MQTT] %s: %s", entity->name, value);
+
     publishState();
 }
 
 bool reconnectMQTT() {
-    if (mqttClient.connect(DEVICE_ID, config.mqtt_user.c_str(), config.mqtt_password.c_str())) {
-        Serial.println("MQTT connected");
+    // connect() blocks for seconds; don't hold a config version across it
+    String user, password;
+    {
+        ConfigGuard cfg;
+        user = cfg->mqtt_user;
+        password = cfg->mqtt_password;
+    }
 
-        mqttClient.subscribe(mqttTopicMotor);
-        mqttClient.subscribe(mqttTopicOverride);
-        mqttClient.subscribe(mqttTopicMain);
-        mqttClient.subscribe(mqttTopicError);
-        mqttClient.subscribe(mqttTopicReboot);
+    // Clustered units connect under their node ID; a shared one would have the
+    // broker keep kicking one of them off
+    if (mqttClient.connect(mqttDeviceId, user.c_str(), password.c_str(),
+                           clusterWillTopic(), 0, false, clusterWillMessage())) {
+        LOGI("[MQTT] Connected");
+        mqttReconnects++;
 
-        Serial.println("Subscribed to command topics");
+        mqttClient.subscribe(mqttTopicCommands);
+        mqttClient.subscribe(HA_STATUS_TOPIC);
+        clusterConnected();
 
-        sendAutoDiscoveryConfigs();
+        LOGD("[MQTT] Subscribed to command topics");
         return true;
     }
-    Serial.printf("MQTT connection failed, rc=%d\n", mqttClient.state());
+    LOGW("[MQTT] Connection failed, rc=%d", mqttClient.state());
+    mqttReconnectFailures++;
     return false;
 }
 
 bool isMqttConfigured() {
-    return !config.mqtt_server.isEmpty() &&
-           config.mqtt_server != "YOUR_MQTT_IP" &&
-           config.mqtt_port > 0;
+    ConfigGuard cfg;
+    return !cfg->mqtt_server.isEmpty() &&
+           cfg->mqtt_server != "YOUR_MQTT_IP" &&
+           cfg->mqtt_port > 0;
+}
+
+static bool exceedsDeadband(const MqttEntity& entity, float value, float last) {
+    // Equal at the published precision is no change, whatever the deadband
+    float scale = powf(10.0f, entity.precision);
+    if (roundf(value * scale) == roundf(last * scale)) return false;
+
+    float delta = fabsf(value - last);
+    if (entity.deadbandMode == DEADBAND_REL) return delta >= entity.deadband * fabsf(last);
+    return delta >= entity.deadband;
 }
 
 void publishState() {
-    if (!mqttClient.connected()) return;
+    unsigned long now = millis();
+    uint32_t sampledUs = telemetrySampleUs();
+    char topic[96];
+    char value[24];
+
+    for (uint8_t i = 0; i < MQTT_ENTITY_COUNT && i < DISCOVERY_MAX_ENTRIES; i++) {
+        const MqttEntity& entity = MQTT_ENTITIES[i];
+        if (!entity.read) continue;
+        EntityPublishState& st = entityState[i];
+
+        float current = entity.read();
+        unsigned long elapsed = now - st.at;
+        if (st.sent) {
+            if (elapsed < entity.minIntervalS * 1000UL) continue;
+            if (elapsed < entity.maxIntervalS * 1000UL && !exceedsDeadband(entity, current, st.value)) continue;
+        }
+
+        if (entity.kind == ENTITY_SWITCH) {
+            strlcpy(value, current != 0.0f ? "ON" : "OFF", sizeof(value));
+        } else {
+            snprintf(value, sizeof(value), "%.*f", entity.precision, current);
+        }
+        snprintf(topic, sizeof(topic), "%s%s/state", mqttTopicBase, entity.id);
+        // Spooled while the broker is away, so Home Assistant sees no gap
+        if (!mqttEnqueue(topic, value, MQTT_MSG_RETAIN | MQTT_MSG_DURABLE, sampledUs)) continue;
+
+        st.value = current;
+        st.at = now;
+        st.sent = true;
+    }
+}
 
-    StaticJsonDocument<512> doc;
-    doc["pressure"]         = pressure;
-    doc["temperature"]      = temperature;
-    doc["flow"]             = flow;
-    doc["motor"]            = motor ? "ON" : "OFF";
-    doc["override"]         = manualOverride ? "ON" : "OFF";
-    doc["main"]             = mainSwitch ? "ON" : "OFF";
-    doc["error"]            = error ? "ON" : "OFF";
-    doc["reboot_requested"] = rebootRequested;
-    doc["uptime"]           = millis() / 1000;
-    doc["free_heap"]        = ESP.getFreeHeap();
-    doc["wifi_rssi"]        = WiFi.RSSI();
+void publishFault(const char* reason) {
+    char event[128];
+    snprintf(event, sizeof(event), "{\"fault\":\"%s\",\"uptime\":%lu}", reason, millis() / 1000);
+    mqttEnqueue(mqttTopicEvent, event, MQTT_MSG_DURABLE);
+}
+
+// Publish one pending discovery config per call; resumes after a reconnect
+static void serviceDiscovery() {
+    if (discoveryRequested) {
+        discoveryRequested = false;
+        discoveryNext = 0;
+    }
+    if (discoveryNext >= discoveryCount) return;
 
-    char state[512];
-    serializeJson(doc, state, sizeof(state));
-    mqttClient.publish(mqttTopicState, state, true);
+    if (discoveryNext == 0) LOGI("[MQTT] Sending auto-discovery configs...");
+    const DiscoveryEntry& entry = discovery[discoveryNext];
+    if (!mqttClient.publish(entry.topic, entry.payload, true)) {
+        LOGW("[MQTT] Discovery publish failed");
+        return;
+    }
+    if (++discoveryNext < discoveryCount) return;
 
-    Serial.printf("Published state: %s\n", state);
+    Preferences prefs;
+    if (prefs.begin("mqtt", false)) {
+        prefs.putString("disc_ver", discoveryVersion());
+        prefs.end();
+    }
+    LOGI("[MQTT] Published %u discovery configs", discoveryCount);
+
+    // HA may have (re)subscribed without our retained states: send them all again
+    for (EntityPublishState& st : entityState) st.sent = false;
 }
 
 void mqttTask(void* pvParameters) {
     for (;;) {
-        if (wifiConnected && isMqttConfigured()) {
-            if (!mqttClient.connected()) {
-                if (millis() - lastMqttReconnectAttempt > 5000UL) {
-                    lastMqttReconnectAttempt = millis();
-                    reconnectMQTT();
-                }
-            } else {
-                mqttClient.loop();
-                if (publishStatePending) {
-                    publishStatePending = false;
-                    publishState();
+        if (mqttReconfigurePending) {
+            // New broker or credentials: drop the session and reconnect right away
+            mqttReconfigurePending = false;
+            if (mqttClient.connected()) {
+                clusterLeave();
+                mqttClient.disconnect();
+            }
+            applyMqttServer();
+            clusterConfigure();
+            if (strcmp(mqttDeviceId, clusterDeviceId()) != 0) changeDeviceId();
+            // A different broker won't have our retained configs
+            discoveryNext = 0;
+            lastMqttReconnectAttempt = millis() - 5001UL;
+            LOGI("[MQTT] Settings changed, reconnecting to %s:%d", mqttServerHost, mqttServerPort);
+        }
+
+        if (!isMqttConfigured()) {
+            mqttOutboxDiscard();
+        } else {
+            if (wifiConnected) {
+                if (!mqttClient.connected()) {
+                    if (millis() - lastMqttReconnectAttempt > 5000UL) {
+                        lastMqttReconnectAttempt = millis();
+                        reconnectMQTT();
+                    }
+                } else {
+                    mqttClient.loop();
+                    serviceDiscovery();
                 }
             }
+            // State is produced while offline too; the outbox spools it
+            if (publishStatePending) {
+                publishStatePending = false;
+                publishState();
+            }
+            clusterService(wifiConnected && mqttClient.connected());
+            mqttOutboxService(wifiConnected && mqttClient.connected());
         }
         vTaskDelay(10 / portTICK_PERIOD_MS);
     }
 }
 
-void sendAutoDiscoveryConfigs() {
-    if (!mqttClient.connected()) return;
-
-    Serial.println("Sending auto-discovery configs...");
-
+void buildDiscoveryConfigs() {
     DynamicJsonDocument deviceDoc(256);
-    deviceDoc["identifiers"] = DEVICE_ID;
-    deviceDoc["name"]        = DEVICE_NAME;
+    // Clustered units are separate devices: "AquaSensys a1b2c3"
+    String name = DEVICE_NAME;
+    if (strcmp(mqttDeviceId, DEVICE_ID) != 0) name += " " + String(mqttDeviceId + strlen(DEVICE_ID) + 1);
+
+    deviceDoc["identifiers"] = mqttDeviceId;
+    deviceDoc["name"]        = name;
     deviceDoc["manufacturer"] = DEVICE_MANUFACTURER;
     deviceDoc["model"]       = DEVICE_MODEL;
     deviceDoc["sw_version"]  = DEVICE_VERSION;
 
-    String stateTopic = mqttTopicState;
-
-    createSensorConfig("pressure",    "Pressure",      "bar",   "pressure",         "mdi:gauge",         deviceDoc, stateTopic, "pressure");
-    createSensorConfig("temperature", "Temperature",   "°C",    "temperature",       "mdi:thermometer",   deviceDoc, stateTopic, "temperature");
-    createSensorConfig("flow",        "Flow Rate",     "L/min", nullptr,             "mdi:water",         deviceDoc, stateTopic, "flow");
-    createSensorConfig("uptime",      "Uptime",        "s",     "duration",          "mdi:clock-outline", deviceDoc, stateTopic, "uptime");
-    createSensorConfig("heap",        "Free Memory",   "bytes", nullptr,             "mdi:memory",        deviceDoc, stateTopic, "free_heap");
-    createSensorConfig("wifi_strength","WiFi Signal",  "dBm",   "signal_strength",   "mdi:wifi",          deviceDoc, stateTopic, "wifi_rssi");
-
-    createSwitchConfig("motor",    "Pump Motor",      "mdi:pump",          deviceDoc, stateTopic, "motor",    mqttTopicMotor);
-    createSwitchConfig("main",     "Main Power",      "mdi:power",         deviceDoc, stateTopic, "main",     mqttTopicMain);
-    createSwitchConfig("override", "Manual Override", "mdi:account-wrench",deviceDoc, stateTopic, "override", mqttTopicOverride);
-    createSwitchConfig("error",    "System Error",    "mdi:alert",         deviceDoc, stateTopic, "error",    mqttTopicError);
-
-    createButtonConfig("reboot", "Reboot Device", "mdi:restart", deviceDoc, mqttTopicReboot);
-}
-
-void createSensorConfig(const char* sensorId, const char* name, const char* unit,
-                        const char* deviceClass, const char* icon,
-                        JsonDocument& deviceDoc, const String& stateTopic,
-                        const char* valueKey) {
-    char configTopic[96];
-    snprintf(configTopic, sizeof(configTopic), "homeassistant/sensor/%s_%s/config", DEVICE_ID, sensorId);
-
-    DynamicJsonDocument doc(512);
-    doc["name"]        = name;
-    doc["unique_id"]   = String(DEVICE_ID) + "_" + sensorId;
-    doc["state_topic"] = stateTopic;
-    doc["value_template"] = String("{{ value_json.") + valueKey + " }}";
-    if (unit)        doc["unit_of_measurement"] = unit;
-    if (deviceClass) doc["device_class"]        = deviceClass;
-    if (icon)        doc["icon"]                = icon;
-    doc["device"]    = deviceDoc;
-
-    publishDiscovery(configTopic, doc);
-}
-
-void createSwitchConfig(const char* switchId, const char* name, const char* icon,
-                        JsonDocument& deviceDoc, const String& stateTopic,
-                        const char* valueKey, const char* commandTopic) {
-    char configTopic[96];
-    snprintf(configTopic, sizeof(configTopic), "homeassistant/switch/%s_%s/config", DEVICE_ID, switchId);
-
-    DynamicJsonDocument doc(512);
-    doc["name"]           = name;
-    doc["unique_id"]      = String(DEVICE_ID) + "_" + switchId;
-    doc["state_topic"]    = stateTopic;
-    doc["command_topic"]  = commandTopic;
-    doc["value_template"] = String("{{ value_json.") + valueKey + " }}";
-    doc["payload_on"]     = "ON";
-    doc["payload_off"]    = "OFF";
-    if (icon) doc["icon"] = icon;
-    doc["device"]         = deviceDoc;
+    for (uint8_t i = 0; i < MQTT_ENTITY_COUNT; i++) {
+        createEntityConfig(MQTT_ENTITIES[i], deviceDoc);
+    }
 
-    publishDiscovery(configTopic, doc);
+    size_t bytes = 0;
+    for (uint8_t i = 0; i < discoveryCount; i++) bytes += strlen(discovery[i].payload);
+    LOGD("[MQTT] Built %u discovery configs (%u bytes)", discoveryCount, (unsigned)bytes);
 }
 
-void createButtonConfig(const char* buttonId, const char* name, const char* icon,
-                        JsonDocument& deviceDoc, const char* commandTopic) {
+void createEntityConfig(const MqttEntity& entity, JsonDocument& deviceDoc) {
+    static const char* const COMPONENTS[] = { "sensor", "switch", "button" };
     char configTopic[96];
-    snprintf(configTopic, sizeof(configTopic), "homeassistant/button/%s_%s/config", DEVICE_ID, buttonId);
-
-    DynamicJsonDocument doc(512);
-    doc["name"]           = name;
-    doc["unique_id"]      = String(DEVICE_ID) + "_" + buttonId;
-    doc["command_topic"]  = commandTopic;
-    doc["payload_press"]  = "PRESS";
-    if (icon) doc["icon"] = icon;
-    doc["device"]         = deviceDoc;
+    char stateTopic[96];
+    char commandTopic[96];
+    snprintf(configTopic, sizeof(configTopic), "homeassistant/%s/%s_%s/config",
+             COMPONENTS[entity.kind], mqttDeviceId, entity.id);
+    snprintf(stateTopic, sizeof(stateTopic), "%s%s/state", mqttTopicBase, entity.id);
+    snprintf(commandTopic, sizeof(commandTopic), "%s%s/set", mqttTopicBase, entity.id);
+
+    DynamicJsonDocument doc(640);
+    doc["name"]      = entity.name;
+    doc["unique_id"] = String(mqttDeviceId) + "_" + entity.id;
+    if (entity.read)    doc["state_topic"]   = stateTopic;
+    if (entity.command) doc["command_topic"] = commandTopic;
+
+    if (entity.kind == ENTITY_SENSOR) {
+        if (entity.unit)        doc["unit_of_measurement"] = entity.unit;
+        if (entity.deviceClass) doc["device_class"]        = entity.deviceClass;
+        if (entity.stateClass)  doc["state_class"]         = entity.stateClass;
+        doc["suggested_display_precision"] = entity.precision;
+    } else if (entity.kind == ENTITY_SWITCH) {
+        doc["payload_on"]  = "ON";
+        doc["payload_off"] = "OFF";
+    } else {
+        doc["payload_press"] = "PRESS";
+    }
+    if (entity.icon) doc["icon"] = entity.icon;
+    doc["device"] = deviceDoc;
 
-    publishDiscovery(configTopic, doc);
+    addDiscovery(configTopic, doc);
 }
 
-void publishDiscovery(const String& topic, JsonDocument& config) {
-    String payload;
-    serializeJson(config, payload);
-
-    Serial.printf("Publishing discovery: %s\n", topic.c_str());
-
-    if (!mqttClient.publish(topic.c_str(), payload.c_str(), true)) {
-        Serial.println("Discovery publish failed!");
+void addDiscovery(const char* topic, JsonDocument& config) {
+    if (discoveryCount >= DISCOVERY_MAX_ENTRIES) {
+        LOGE("[MQTT] Discovery table full, skipping %s", topic);
+        return;
     }
+    size_t len = measureJson(config);
+    char* payload = (char*)malloc(len + 1);
+    if (!payload) return;
+    serializeJson(config, payload, len + 1);
+
+    DiscoveryEntry& entry = discovery[discoveryCount++];
+    strlcpy(entry.topic, topic, sizeof(entry.topic));
+    entry.payload = payload;
 }
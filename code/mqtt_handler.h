@@ -4,6 +4,7 @@
 #include <PubSubClient.h>
 #include <WiFiClient.h>
 #include <ArduinoJson.h>
+#include "mqtt_entities.h"
 
 // Device information - extern declarations to access from main file
 extern const char* DEVICE_NAME;
@@ -26,27 +27,33 @@ extern volatile bool rebootRequested;
 // Set true by loop() when sensor state changes; MQTT task reads and publishes
 extern volatile bool publishStatePending;
 
+// Broker connection attempts since boot, written by the MQTT task
+extern volatile uint32_t mqttReconnects;
+extern volatile uint32_t mqttReconnectFailures;
+
+// Discovery configs kept for republishing
+#define DISCOVERY_MAX_ENTRIES 24
+
+// PubSubClient wait for the broker (connect, CONNACK), in seconds
+#define MQTT_SOCKET_TIMEOUT_S 5
+
 // Function declarations
 void setupMQTT();
 void mqttCallback(char* topic, byte* payload, unsigned int length);
 bool reconnectMQTT();
 void publishState();
-void sendAutoDiscoveryConfigs();
+// Fault event on homeassistant/<id>/event; callable from any task
+void publishFault(const char* reason);
+// Serialize every discovery config into the retained table (at boot, and
+// again when cluster mode changes the device ID)
+void buildDiscoveryConfigs();
 
 // Only attempt MQTT when server is configured
 bool isMqttConfigured();
 
 // FreeRTOS task — created in setup(), runs on Core 0
 void mqttTask(void* pvParameters);
-void publishDiscovery(const String& topic, JsonDocument& config);
-void createSensorConfig(const char* sensorId, const char* name, const char* unit, 
-                      const char* deviceClass, const char* icon,
-                      JsonDocument& deviceDoc, const String& stateTopic,
-                      const char* valueKey);
-void createSwitchConfig(const char* switchId, const char* name, const char* icon,
-                      JsonDocument& deviceDoc, const String& stateTopic,
-                      const char* valueKey, const char* commandTopic);
-void createButtonConfig(const char* buttonId, const char* name, const char* icon,
-                      JsonDocument& deviceDoc, const char* commandTopic);
+void addDiscovery(const char* topic, JsonDocument& config);
+void createEntityConfig(const MqttEntity& entity, JsonDocument& deviceDoc);
 
 #endif
\ No newline at end of file
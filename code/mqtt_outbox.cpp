@@ -0,0 +1,227 @@
+#include "mqtt_outbox.h"
+#include <PubSubClient.h>
+#include <SD.h>
+#include "logger.h"
+#include "latency_trace.h"
+
+extern PubSubClient mqttClient;
+
+// Queued message: header followed by "topic\0payload\0" in one allocation
+struct MqttMessage {
+    uint8_t  flags;
+    uint16_t topicLen;
+    uint16_t payloadLen;
+    uint32_t sampledUs;     // telemetry stamp, 0 if none
+
+    char* topic() { return (char*)(this + 1); }
+    char* payload() { return topic() + topicLen + 1; }
+};
+
+// Journal record header, followed by topic and payload without terminators
+struct __attribute__((packed)) SpoolRecord {
+    uint16_t topicLen;
+    uint16_t payloadLen;
+    uint8_t  flags;
+};
+
+static QueueHandle_t outbox = NULL;
+static MqttOutboxStats stats;
+
+// Journal state; MQTT task only
+static uint32_t spoolSize = 0;      // bytes in the journal file
+static uint32_t replayPos = 0;      // next record to replay
+static uint16_t replaySinceSave = 0;
+static unsigned long lastReplay = 0;
+static bool spoolFullLogged = false;
+static char replayBuf[MQTT_MAX_MESSAGE + 2];     // "topic\0payload"
+
+static bool spoolPending() {
+    return replayPos < spoolSize;
+}
+
+static void saveReplayPos() {
+    File f = SD.open(MQTT_SPOOL_POS_PATH, FILE_WRITE);
+    if (!f) return;
+    f.write((const uint8_t*)&replayPos, sizeof(replayPos));
+    f.close();
+    replaySinceSave = 0;
+}
+
+static void clearSpool() {
+    SD.remove(MQTT_SPOOL_PATH);
+    SD.remove(MQTT_SPOOL_POS_PATH);
+    spoolSize = 0;
+    replayPos = 0;
+    replaySinceSave = 0;
+    spoolFullLogged = false;
+}
+
+static void updateSpoolStat() {
+    stats.spoolBytes = spoolSize - replayPos;
+}
+
+void mqttOutboxBegin() {
+    outbox = xQueueCreate(MQTT_OUTBOX_LEN, sizeof(MqttMessage*));
+
+    File spool = SD.open(MQTT_SPOOL_PATH);
+    if (!spool) return;
+    spoolSize = spool.size();
+    spool.close();
+
+    File pos = SD.open(MQTT_SPOOL_POS_PATH);
+    if (pos) {
+        if (pos.read((uint8_t*)&replayPos, sizeof(replayPos)) != sizeof(replayPos)) replayPos = 0;
+        pos.close();
+    }
+    if (replayPos > spoolSize) replayPos = 0;
+    updateSpoolStat();
+    if (spoolPending()) {
+        LOGI("[MQTT] %lu spooled bytes waiting for replay", (unsigned long)(spoolSize - replayPos));
+    } else {
+        clearSpool();
+    }
+}
+
+bool mqttEnqueue(const char* topic, const char* payload, uint8_t flags, uint32_t sampledUs) {
+    return mqttEnqueue(topic, (const uint8_t*)payload, strlen(payload), flags, sampledUs);
+}
+
+bool mqttEnqueue(const char* topic, const uint8_t* payload, size_t payloadLen, uint8_t flags,
+                 uint32_t sampledUs) {
+    size_t topicLen = strlen(topic);
+    if (!outbox || topicLen + payloadLen > MQTT_MAX_MESSAGE) {
+        stats.dropped++;
+        return false;
+    }
+
+    MqttMessage* msg = (MqttMessage*)malloc(sizeof(MqttMessage) + topicLen + payloadLen + 2);
+    if (!msg) {
+        stats.dropped++;
+        return false;
+    }
+    msg->flags = flags;
+    msg->topicLen = topicLen;
+    msg->payloadLen = payloadLen;
+    msg->sampledUs = sampledUs;
+    memcpy(msg->topic(), topic, topicLen + 1);
+    memcpy(msg->payload(), payload, payloadLen);
+    msg->payload()[payloadLen] = '\0';
+
+    if (xQueueSend(outbox, &msg, 0) != pdTRUE) {
+        free(msg);
+        stats.dropped++;
+        return false;
+    }
+    return true;
+}
+
+static bool spoolAppend(MqttMessage* msg) {
+    size_t recordLen = sizeof(SpoolRecord) + msg->topicLen + msg->payloadLen;
+    if (spoolSize + recordLen > MQTT_SPOOL_MAX_BYTES) {
+        if (!spoolFullLogged) {
+            LOGW("[MQTT] Spool full, dropping durable messages until replayed");
+            spoolFullLogged = true;
+        }
+        return false;
+    }
+
+    File spool = SD.open(MQTT_SPOOL_PATH, FILE_APPEND);
+    if (!spool) return false;
+    SpoolRecord rec = { msg->topicLen, msg->payloadLen, msg->flags };
+    size_t written = spool.write((const uint8_t*)&rec, sizeof(rec));
+    written += spool.write((const uint8_t*)msg->topic(), msg->topicLen);
+    written += spool.write((const uint8_t*)msg->payload(), msg->payloadLen);
+    spool.close();
+
+    // There's no truncate, and a torn record would derail the replay
+    if (written != recordLen) {
+        LOGE("[MQTT] Spool write failed, discarding the journal");
+        clearSpool();
+        updateSpoolStat();
+        return false;
+    }
+    spoolSize += recordLen;
+    updateSpoolStat();
+    return true;
+}
+
+// Publish the record at replayPos; false to try again later
+static bool replayOne() {
+    File spool = SD.open(MQTT_SPOOL_PATH);
+    if (!spool) {
+        clearSpool();
+        updateSpoolStat();
+        return false;
+    }
+
+    SpoolRecord rec;
+    char* payload = nullptr;
+    bool ok = spool.seek(replayPos) &&
+              spool.read((uint8_t*)&rec, sizeof(rec)) == sizeof(rec) &&
+              rec.topicLen + rec.payloadLen <= MQTT_MAX_MESSAGE &&
+              spool.read((uint8_t*)replayBuf, rec.topicLen) == rec.topicLen;
+    if (ok) {
+        replayBuf[rec.topicLen] = '\0';
+        payload = replayBuf + rec.topicLen + 1;
+        ok = spool.read((uint8_t*)payload, rec.payloadLen) == rec.payloadLen;
+    }
+    spool.close();
+    if (!ok) {
+        LOGE("[MQTT] Spool unreadable at %lu, discarding the rest", (unsigned long)replayPos);
+        clearSpool();
+        updateSpoolStat();
+        return false;
+    }
+
+    if (!mqttClient.publish(replayBuf, (const uint8_t*)payload, rec.payloadLen, rec.flags & MQTT_MSG_RETAIN)) {
+        return false;
+    }
+
+    stats.replayed++;
+    replayPos += sizeof(rec) + rec.topicLen + rec.payloadLen;
+    if (!spoolPending()) {
+        LOGI("[MQTT] Spool replayed (%lu bytes)", (unsigned long)spoolSize);
+        clearSpool();
+    } else if (++replaySinceSave >= MQTT_REPLAY_SAVE_EVERY) {
+        saveReplayPos();
+    }
+    updateSpoolStat();
+    return true;
+}
+
+void mqttOutboxService(bool connected) {
+    MqttMessage* msg;
+    while (outbox && xQueueReceive(outbox, &msg, 0) == pdTRUE) {
+        bool sent = false;
+        // Durable sends wait behind the journal so their order holds
+        if (connected && !(spoolPending() && (msg->flags & MQTT_MSG_DURABLE))) {
+            sent = mqttClient.publish(msg->topic(), (const uint8_t*)msg->payload(), msg->payloadLen,
+                                      msg->flags & MQTT_MSG_RETAIN);
+            if (sent) {
+                stats.published++;
+                telemetrySent(PATH_TLM_MQTT, msg->sampledUs);
+            }
+        }
+        if (!sent) {
+            if ((msg->flags & MQTT_MSG_DURABLE) && spoolAppend(msg)) stats.spooled++;
+            else stats.dropped++;
+        }
+        free(msg);
+    }
+
+    if (connected && spoolPending() && millis() - lastReplay >= MQTT_REPLAY_INTERVAL_MS) {
+        lastReplay = millis();
+        if (!replayOne() && replaySinceSave) saveReplayPos();
+    }
+}
+
+void mqttOutboxDiscard() {
+    MqttMessage* msg;
+    while (outbox && xQueueReceive(outbox, &msg, 0) == pdTRUE) {
+        free(msg);
+    }
+}
+
+MqttOutboxStats mqttOutboxStats() {
+    return stats;
+}
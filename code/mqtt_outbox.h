@@ -0,0 +1,66 @@
+#ifndef MQTT_OUTBOX_H
+#define MQTT_OUTBOX_H
+
+#include <Arduino.h>
+
+// Messages waiting for the MQTT task; producers never block on a full queue
+#define MQTT_OUTBOX_LEN          32
+// Offline journal of durable messages, and the replay position in it
+#define MQTT_SPOOL_PATH          "/mqtt_spool.bin"
+#define MQTT_SPOOL_POS_PATH      "/mqtt_spool.pos"
+#define MQTT_SPOOL_MAX_BYTES     (1024UL * 1024UL)
+// Replay pacing after a reconnect (20 msg/s), and how often progress is saved
+#define MQTT_REPLAY_INTERVAL_MS  50
+#define MQTT_REPLAY_SAVE_EVERY   16
+// Largest topic + payload accepted; must fit the PubSubClient buffer
+#define MQTT_MAX_MESSAGE         900
+
+// Message flags
+#define MQTT_MSG_RETAIN   0x01
+#define MQTT_MSG_DURABLE  0x02  // spooled to SD while offline, replayed on reconnect
+
+struct MqttOutboxStats {
+    uint32_t published;     // sent live
+    uint32_t spooled;       // written to the journal
+    uint32_t replayed;      // sent from the journal
+    uint32_t dropped;       // queue full, too large, journal full, or offline and not durable
+    uint32_t spoolBytes;    // journal bytes not yet replayed
+};
+
+/*
+ * Outbound MQTT path. Any task queues with mqttEnqueue(); only the MQTT task
+ * talks to PubSubClient and the journal.
+ *
+ * Once anything is in the journal, durable messages keep going there until
+ * the replay catches up, so the broker sees them in the order they were made.
+ *
+ * This is not at-least-once delivery. PubSubClient publishes at QoS 0, so
+ * publish() returning true only means the TCP stack took the bytes, and a
+ * message leaves the journal at that point. Whatever was written in the
+ * seconds before a dead connection is noticed (broker crash, Wi-Fi drop) can
+ * be lost, live or replayed. What the journal does guarantee is that durable
+ * messages made while the client knows it is offline arrive in order once it
+ * reconnects. After a reboot, a replay resumes from the last saved position,
+ * so up to MQTT_REPLAY_SAVE_EVERY messages may be sent twice.
+ * tools/mqtt_standin.py checks this against a broker that crashes on schedule.
+ */
+
+// Create the queue and pick up a journal left from before a reboot
+void mqttOutboxBegin();
+
+// Queue a message from any task; false if it was dropped. sampledUs, if set,
+// is the telemetry stamp the payload carries (see latency_trace.h)
+bool mqttEnqueue(const char* topic, const char* payload, uint8_t flags, uint32_t sampledUs = 0);
+// Same for a binary payload
+bool mqttEnqueue(const char* topic, const uint8_t* payload, size_t len, uint8_t flags,
+                 uint32_t sampledUs = 0);
+
+// MQTT task: send or spool what was queued, and replay the journal when connected
+void mqttOutboxService(bool connected);
+
+// MQTT task: discard queued messages (MQTT not configured)
+void mqttOutboxDiscard();
+
+MqttOutboxStats mqttOutboxStats();
+
+#endif
@@ -0,0 +1,75 @@
+#include "multicast_telemetry.h"
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include <rom/crc.h>
+#include "config_manager.h"
+#include "state_api.h"
+#include "telemetry.h"
+#include "logger.h"
+
+// Control flags from code.ino
+extern volatile bool motor, manualOverride, mainSwitch, error;
+extern bool wifiConnected;
+
+static WiFiUDP udp;
+static uint32_t seq = 0;
+static uint32_t sent = 0;
+static uint8_t mac[6];
+static bool macRead = false;
+
+// Group parsed from the config; refreshed when the config version moves
+static IPAddress group;
+static uint32_t groupConfigVersion = UINT32_MAX;
+static bool groupValid = false;
+
+void sendMulticastTelemetry() {
+    uint16_t port;
+    {
+        ConfigGuard cfg;
+        if (!cfg->multicast_enabled) return;
+        if (configVersion() != groupConfigVersion) {
+            groupConfigVersion = configVersion();
+            groupValid = group.fromString(cfg->multicast_group) && group[0] >= 224 && group[0] <= 239;
+            if (!groupValid) {
+                LOGW("[Multicast] '%s' is not a multicast address", cfg->multicast_group.c_str());
+            }
+        }
+        port = cfg->multicast_port;
+    }
+    if (!groupValid || !wifiConnected) return;
+
+    if (!macRead) {
+        WiFi.macAddress(mac);
+        macRead = true;
+    }
+
+    StateSnapshot snap = getStateSnapshot();
+    MulticastDatagram dg;
+    dg.magic = MCAST_MAGIC;
+    dg.version = MCAST_VERSION;
+    dg.flags = (motor ? TLM_FLAG_MOTOR : 0) | (error ? TLM_FLAG_ERROR : 0) |
+               (mainSwitch ? TLM_FLAG_MAIN_SWITCH : 0) | (manualOverride ? TLM_FLAG_MANUAL : 0);
+    memcpy(dg.mac, mac, sizeof(dg.mac));
+    dg.seq = seq++;
+    dg.uptimeMs = millis();
+    dg.pressureIn = snap.pressureIn;
+    dg.pressureOut = snap.pressureOut;
+    dg.flow = snap.flow;
+    dg.waterTemp = snap.waterTemp;
+    dg.ambientTemp = snap.ambientTemp;
+    dg.currentL1 = snap.currentL1;
+    dg.currentL2 = snap.currentL2;
+    dg.currentL3 = snap.currentL3;
+    dg.currentTotal = snap.currentTotal;
+    dg.crc = crc32_le(0, (const uint8_t*)&dg, offsetof(MulticastDatagram, crc));
+
+    // lwIP queues the datagram; this never waits for the network
+    if (udp.beginPacket(group, port) && udp.write((const uint8_t*)&dg, sizeof(dg)) == sizeof(dg) &&
+        udp.endPacket()) {
+        sent++;
+    }
+}
+
+uint32_t getMulticastSent() {
+    return sent;
+}
@@ -0,0 +1,44 @@
+#ifndef MULTICAST_TELEMETRY_H
+#define MULTICAST_TELEMETRY_H
+
+#include <Arduino.h>
+
+#define MCAST_MAGIC     0x4D545141  // "AQTM" on the wire
+#define MCAST_VERSION   1
+
+/*
+ * One datagram per measurement cycle. Little-endian, no padding;
+ * tools/multicast_listen.py decodes the same layout, so bump MCAST_VERSION
+ * on any change. flags are the TLM_FLAG_* bits of the WebSocket stream.
+ */
+struct __attribute__((packed)) MulticastDatagram {
+    uint32_t magic;
+    uint8_t  version;
+    uint8_t  flags;
+    uint8_t  mac[6];        // sender, to tell controllers apart on a shared group
+    uint32_t seq;           // per boot; gaps mean lost datagrams
+    uint32_t uptimeMs;
+    float    pressureIn;
+    float    pressureOut;
+    float    flow;
+    float    waterTemp;
+    float    ambientTemp;
+    float    currentL1;
+    float    currentL2;
+    float    currentL3;
+    float    currentTotal;
+    uint32_t crc;           // CRC-32 (IEEE) of every byte before it
+};
+
+/*
+ * Optional UDP multicast of the state snapshot (multicast_enabled,
+ * multicast_group, multicast_port). Sent once per measurement cycle whatever
+ * the number of listeners; TTL 1, so it stays on the local network.
+ */
+
+// Called from loop() after updateStateSnapshot()
+void sendMulticastTelemetry();
+
+uint32_t getMulticastSent();
+
+#endif
@@ -1,56 +1,11 @@
 #include "ota_handler.h"
+#include "template_stream.h"
+#include "admission.h"
+#include "logger.h"
+#include "metrics.h"
 
-// Global OTA instance
-OTAHandler OTA;
-
-OTAHandler::OTAHandler() : 
-    _server(nullptr),
-    _status(OTA_IDLE),
-    _totalSize(0),
-    _currentSize(0),
-    _startTime(0),
-    _isUpdating(false),
-    _createBackup(true),
-    _backupPath("/backup"),
-    _progressCallback(nullptr) {
-}
-
-OTAHandler::~OTAHandler() {
-    cleanup();
-}
-
-void OTAHandler::begin(AsyncWebServer* server, const String& updatePath) {
-    _server = server;
-    
-    // Serve update page
-    _server->on(updatePath.c_str(), HTTP_GET, [this](AsyncWebServerRequest *request) {
-        if (!_updateToken.isEmpty()) {
-            if (!request->hasParam("token") || request->getParam("token")->value() != _updateToken) {
-                request->send(403, "text/plain", "Unauthorized");
-                return;
-            }
-        }
-        
-        // Check if custom update.html exists on SD
-        if (SD.exists("/update.html")) {
-            // Read the file from SD card
-            File file = SD.open("/update.html", FILE_READ);
-            if (!file) {
-                request->send(500, "text/plain", "Failed to open update.html");
-                return;
-            }
-            
-            String html = file.readString();
-            file.close();
-            
-            // Replace placeholders with actual values
-            html.replace("%VERSION%", DEVICE_VERSION ? DEVICE_VERSION : "Unknown");
-            html.replace("%DEVICE_NAME%", DEVICE_NAME ? DEVICE_NAME : "Device");
-            
-            request->send(200, "text/html", html);
-        } else {
-            // Serve built-in update page
-            String html = R"rawliteral(
+// Built-in update page, used when update.html is not on SD
+static const char OTA_BUILTIN_PAGE[] PROGMEM = R"rawliteral(
 <!DOCTYPE html>
 <html>
 <head>
@@ -333,9 +288,49 @@ void OTAHandler::begin(AsyncWebServer* server, const String& updatePath) {
 </body>
 </html>
 )rawliteral";
-            // Replace version placeholder in built-in page too
-            html.replace("%VERSION%", DEVICE_VERSION ? DEVICE_VERSION : "Unknown");
-            request->send(200, "text/html", html);
+
+// Global OTA instance
+OTAHandler OTA;
+
+OTAHandler::OTAHandler() : 
+    _server(nullptr),
+    _status(OTA_IDLE),
+    _totalSize(0),
+    _currentSize(0),
+    _startTime(0),
+    _isUpdating(false),
+    _createBackup(true),
+    _backupPath("/backup"),
+    _progressCallback(nullptr) {
+}
+
+OTAHandler::~OTAHandler() {
+    cleanup();
+}
+
+void OTAHandler::begin(AsyncWebServer* server, const String& updatePath) {
+    _server = server;
+    metricsRoutes({ updatePath.c_str(), "/update/upload", "/update/status", "/api/ota/status",
+                    "/api/ota/update-from-file" });
+    
+    // Serve update page
+    _server->on(updatePath.c_str(), HTTP_GET, [this](AsyncWebServerRequest *request) {
+        if (!_updateToken.isEmpty()) {
+            if (!request->hasParam("token") || request->getParam("token")->value() != _updateToken) {
+                request->send(403, "text/plain", "Unauthorized");
+                return;
+            }
+        }
+        
+        static const TemplateVar vars[] = {
+            { "VERSION",     DEVICE_VERSION ? DEVICE_VERSION : "Unknown" },
+            { "DEVICE_NAME", DEVICE_NAME ? DEVICE_NAME : "Device" },
+        };
+        const size_t varCount = sizeof(vars) / sizeof(vars[0]);
+
+        // Custom update.html on SD if present, otherwise the built-in page
+        if (!sendTemplateFile(request, "/update.html", "text/html", vars, varCount)) {
+            sendTemplateFlash(request, OTA_BUILTIN_PAGE, "text/html", vars, varCount);
         }
     });
     
@@ -383,16 +378,18 @@ void OTAHandler::begin(AsyncWebServer* server, const String& updatePath) {
     
     // Add API endpoint to update from SD card file
     _server->on("/api/ota/update-from-file", HTTP_POST, [this](AsyncWebServerRequest *request) {
-        if (_isUpdating) {
-            request->send(503, "application/json", "{\"error\":\"Update already in progress\"}");
-            return;
-        }
+        admitRequest(request, REQ_CLASS_OTA, [this](AsyncWebServerRequest *request) {
+            if (_isUpdating) {
+                request->send(503, "application/json", "{\"error\":\"Update already in progress\"}");
+                return;
+            }
         
-        if (updateFromFile("/update.bin")) {
-            request->send(200, "application/json", "{\"status\":\"success\"}");
-        } else {
-            request->send(500, "application/json", "{\"error\":\"Update from file failed\"}");
-        }
+            if (updateFromFile("/update.bin")) {
+                request->send(200, "application/json", "{\"status\":\"success\"}");
+            } else {
+                request->send(500, "application/json", "{\"error\":\"Update from file failed\"}");
+            }
+        });
     });
 }
 
@@ -410,8 +407,8 @@ void OTAHandler::handleUploadStart(AsyncWebServerRequest *request, String filena
         }
     }
     
-    Serial.println("OTA: Update started");
-    Serial.printf("OTA: Filename: %s\n", filename.c_str());
+    LOGI("OTA: Update started");
+    LOGI("OTA: Filename: %s", filename.c_str());
     
     // Initialize update
     _status = OTA_UPLOADING;
@@ -425,13 +422,13 @@ void OTAHandler::handleUploadStart(AsyncWebServerRequest *request, String filena
     // Get expected MD5 if provided
     if (request->hasParam("md5")) {
         _expectedMD5 = request->getParam("md5")->value();
-        Serial.printf("OTA: Expected MD5: %s\n", _expectedMD5.c_str());
+        LOGI("OTA: Expected MD5: %s", _expectedMD5.c_str());
     }
     
     // Create backup if enabled
     if (_createBackup) {
         if (!createConfigBackup()) {
-            Serial.println("OTA: Warning - Failed to create config backup");
+            LOGW("OTA: Warning - Failed to create config backup");
         }
     }
     
@@ -453,7 +450,7 @@ void OTAHandler::handleUploadStart(AsyncWebServerRequest *request, String filena
         return;
     }
     
-    Serial.printf("OTA: Update size: %u bytes\n", _totalSize);
+    LOGI("OTA: Update size: %u bytes", _totalSize);
 }
 
 void OTAHandler::handleUploadData(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final) {
@@ -483,7 +480,7 @@ void OTAHandler::handleUploadData(AsyncWebServerRequest *request, String filenam
     static uint8_t lastProgress = 0;
     uint8_t currentProgress = getProgress();
     if (currentProgress != lastProgress && currentProgress % 10 == 0) {
-        Serial.printf("OTA: Progress: %u%%\n", currentProgress);
+        LOGI("OTA: Progress: %u%%", currentProgress);
         lastProgress = currentProgress;
     }
 }
@@ -491,7 +488,7 @@ void OTAHandler::handleUploadData(AsyncWebServerRequest *request, String filenam
 void OTAHandler::handleUploadEnd(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final) {
     if (!_isUpdating) return;
     
-    Serial.println("OTA: Upload complete");
+    LOGI("OTA: Upload complete");
     
     // Calculate MD5
     _md5.calculate();
@@ -504,16 +501,16 @@ void OTAHandler::handleUploadEnd(AsyncWebServerRequest *request, String filename
         _isUpdating = false;
         Update.abort();
         request->send(400, "text/plain", _errorMessage);
-        Serial.printf("OTA: MD5 mismatch - Expected: %s, Got: %s\n", 
-                     _expectedMD5.c_str(), calculatedMD5.c_str());
+        LOGE("OTA: MD5 mismatch - Expected: %s, Got: %s", 
+            _expectedMD5.c_str(), calculatedMD5.c_str());
         return;
     }
     
     // Finish update
     if (Update.end(true)) {
         _status = OTA_SUCCESS;
-        Serial.printf("OTA: Update success in %u seconds\n", getElapsedTime());
-        Serial.printf("OTA: MD5: %s\n", calculatedMD5.c_str());
+        LOGI("OTA: Update success in %u seconds", getElapsedTime());
+        LOGI("OTA: MD5: %s", calculatedMD5.c_str());
         
         // Send success response immediately
         request->send(200, "text/plain", "Update successful");
@@ -525,13 +522,13 @@ void OTAHandler::handleUploadEnd(AsyncWebServerRequest *request, String filename
         delay(100);
         
         // Schedule restart with a flag in NVS or just restart
-        Serial.println("OTA: Restarting device...");
+        LOGI("OTA: Restarting device...");
         delay(500);
         ESP.restart();
     } else {
         _status = OTA_ERROR_UNKNOWN;
         _errorMessage = Update.errorString();
-        Serial.printf("OTA: Update failed: %s\n", _errorMessage.c_str());
+        LOGE("OTA: Update failed: %s", _errorMessage.c_str());
         request->send(500, "text/plain", "Update failed: " + _errorMessage);
         _isUpdating = false;
     }
@@ -594,7 +591,7 @@ bool OTAHandler::createConfigBackup() {
     source.close();
     dest.close();
     
-    Serial.printf("OTA: Config backed up to %s\n", backupFile.c_str());
+    LOGI("OTA: Config backed up to %s", backupFile.c_str());
     return true;
 }
 
@@ -602,18 +599,18 @@ bool OTAHandler::updateFromFile(const String& filepath) {
     if (_isUpdating) return false;
     
     if (!SD.exists(filepath)) {
-        Serial.printf("OTA: Update file not found: %s\n", filepath.c_str());
+        LOGW("OTA: Update file not found: %s", filepath.c_str());
         return false;
     }
     
     File updateFile = SD.open(filepath, FILE_READ);
     if (!updateFile) {
-        Serial.println("OTA: Failed to open update file");
+        LOGE("OTA: Failed to open update file");
         return false;
     }
     
     size_t fileSize = updateFile.size();
-    Serial.printf("OTA: Updating from file: %s (%u bytes)\n", filepath.c_str(), fileSize);
+    LOGI("OTA: Updating from file: %s (%u bytes)", filepath.c_str(), fileSize);
     
     // Verify and begin update
     uint8_t header[4];
@@ -621,13 +618,13 @@ bool OTAHandler::updateFromFile(const String& filepath) {
     updateFile.seek(0);
     
     if (!verifyUpdateHeader(header, 4)) {
-        Serial.println("OTA: Invalid firmware file");
+        LOGE("OTA: Invalid firmware file");
         updateFile.close();
         return false;
     }
     
     if (!Update.begin(fileSize)) {
-        Serial.printf("OTA: Not enough space: %s\n", Update.errorString());
+        LOGE("OTA: Not enough space: %s", Update.errorString());
         updateFile.close();
         return false;
     }
@@ -652,7 +649,7 @@ bool OTAHandler::updateFromFile(const String& filepath) {
         _md5.add(buffer, bytesRead);
         
         if (Update.write(buffer, bytesRead) != bytesRead) {
-            Serial.printf("OTA: Write failed: %s\n", Update.errorString());
+            LOGE("OTA: Write failed: %s", Update.errorString());
             Update.abort();
             updateFile.close();
             _status = OTA_ERROR_WRITE;
@@ -675,8 +672,8 @@ bool OTAHandler::updateFromFile(const String& filepath) {
     
     if (Update.end(true)) {
         _status = OTA_SUCCESS;
-        Serial.printf("OTA: Update from file successful\n");
-        Serial.printf("OTA: MD5: %s\n", _md5.toString().c_str());
+        LOGI("OTA: Update from file successful");
+        LOGI("OTA: MD5: %s", _md5.toString().c_str());
         
         // Remove update file after successful update
         SD.remove(filepath);
@@ -687,7 +684,7 @@ bool OTAHandler::updateFromFile(const String& filepath) {
     } else {
         _status = OTA_ERROR_UNKNOWN;
         _errorMessage = Update.errorString();
-        Serial.printf("OTA: Update failed: %s\n", _errorMessage.c_str());
+        LOGE("OTA: Update failed: %s", _errorMessage.c_str());
     }
     
     _isUpdating = false;
@@ -727,7 +724,7 @@ bool OTAHandler::attemptRecovery() {
     }
     
     // Restore backup
-    Serial.printf("OTA: Restoring config from %s\n", latestBackup.c_str());
+    LOGI("OTA: Restoring config from %s", latestBackup.c_str());
     
     // Remove current config
     if (SD.exists("/config.json")) {
@@ -753,7 +750,7 @@ bool OTAHandler::attemptRecovery() {
     source.close();
     dest.close();
     
-    Serial.println("OTA: Config restored successfully");
+    LOGI("OTA: Config restored successfully");
     return true;
 }
 
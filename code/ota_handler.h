@@ -52,7 +52,6 @@ private:
     void handleUploadData(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final);
     void handleUploadEnd(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final);
     bool verifyUpdateHeader(uint8_t *data, size_t len);
-    String getErrorString(OTAStatus status);
     void cleanup();
     bool createConfigBackup();
     
@@ -77,6 +76,7 @@ public:
     
     // Get current status
     OTAStatus getStatus() const { return _status; }
+    String getErrorString(OTAStatus status);
     bool isUpdating() const { return _isUpdating; }
     
     // Get progress info
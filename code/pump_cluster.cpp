@@ -0,0 +1,436 @@
+#include "pump_cluster.h"
+#include <ArduinoJson.h>
+#include <PubSubClient.h>
+#include "config_manager.h"
+#include "counter_store.h"
+#include "mqtt_outbox.h"
+#include "logger.h"
+
+extern PubSubClient mqttClient;
+extern const char* DEVICE_ID;
+extern float pressure;
+extern float flow;
+extern volatile bool motor;
+extern volatile bool manualOverride;
+extern volatile bool mainSwitch;
+extern volatile bool error;
+
+struct ClusterNode {
+    char          id[CLUSTER_ID_LEN];
+    unsigned long seenAt;
+    bool          eligible;
+    bool          motor;
+    uint32_t      runtimeS;
+    float         flow;
+};
+
+static char nodeId[CLUSTER_ID_LEN];
+static volatile bool enabled = false;   // read by clusterDeviceId() from any task
+static char topicPrefix[64];            // aquasensys/cluster/<name>/
+static char nodeTopic[96];
+static char planTopic[72];
+static char willMessage[64];
+
+// Everything below is MQTT task only, except the volatile outputs
+
+static ClusterNode self;
+// Other units heard from
+static ClusterNode peers[CLUSTER_MAX_NODES - 1];
+static uint8_t peerCount = 0;
+static bool peersFullLogged = false;
+
+// The plan in force, received or made here
+static char     planCoord[CLUSTER_ID_LEN];
+static uint32_t planTerm = 0;
+static char     planOrder[CLUSTER_MAX_NODES][CLUSTER_ID_LEN];
+static uint8_t  planOrderLen = 0;
+static uint8_t  planRun = 0;
+static unsigned long planAt = 0;
+
+// Coordinator: last change of planRun, and whether it was a start/stage-up
+static unsigned long stagedAt = 0;
+static bool lastStageUp = false;
+static unsigned long lastPlanSent = 0;
+
+static bool online = false;
+static unsigned long joinedAt = 0;
+static unsigned long lastHeartbeat = 0;
+
+static volatile int8_t demand = -1;
+static volatile ClusterRole role = CLUSTER_OFF;
+static volatile uint8_t statNodes = 0;
+static volatile uint8_t statRun = 0;
+
+static bool isSelf(const char* id) {
+    return strcmp(id, nodeId) == 0;
+}
+
+static void resetCluster() {
+    peerCount = 0;
+    peersFullLogged = false;
+    planCoord[0] = '\0';
+    planTerm = 0;
+    planOrderLen = 0;
+    planRun = 0;
+    online = false;
+    demand = -1;
+    role = enabled ? CLUSTER_STANDALONE : CLUSTER_OFF;
+    statNodes = 0;
+    statRun = 0;
+}
+
+const char* clusterNodeId() {
+    return nodeId;
+}
+
+bool clusterEnabled() {
+    return enabled;
+}
+
+const char* clusterDeviceId() {
+    return enabled ? nodeId : DEVICE_ID;
+}
+
+void clusterConfigure() {
+    if (!nodeId[0]) {
+        uint64_t mac = ESP.getEfuseMac();
+        snprintf(nodeId, sizeof(nodeId), "%s-%06lx", DEVICE_ID, (unsigned long)((mac >> 24) & 0xFFFFFF));
+        strlcpy(self.id, nodeId, sizeof(self.id));
+    }
+
+    String name;
+    {
+        ConfigGuard cfg;
+        enabled = cfg->cluster_enabled;
+        name = cfg->cluster_name;
+    }
+    if (enabled && (name.isEmpty() || strpbrk(name.c_str(), "/+#"))) {
+        LOGW("[Cluster] Invalid cluster name \"%s\", cluster mode off", name.c_str());
+        enabled = false;
+    }
+
+    snprintf(topicPrefix, sizeof(topicPrefix), "aquasensys/cluster/%s/", name.c_str());
+    snprintf(nodeTopic, sizeof(nodeTopic), "%snode/%s", topicPrefix, nodeId);
+    snprintf(planTopic, sizeof(planTopic), "%splan", topicPrefix);
+    snprintf(willMessage, sizeof(willMessage), "{\"id\":\"%s\",\"up\":false}", nodeId);
+    resetCluster();
+    if (enabled) LOGI("[Cluster] Node %s in cluster \"%s\"", nodeId, name.c_str());
+}
+
+const char* clusterWillTopic() {
+    return enabled ? nodeTopic : nullptr;
+}
+
+const char* clusterWillMessage() {
+    return willMessage;
+}
+
+void clusterConnected() {
+    if (!enabled) return;
+    char filter[72];
+    snprintf(filter, sizeof(filter), "%s#", topicPrefix);
+    mqttClient.subscribe(filter);
+    resetCluster();
+    online = true;
+    joinedAt = millis();
+    lastHeartbeat = millis() - CLUSTER_HEARTBEAT_MS;
+}
+
+void clusterLeave() {
+    if (!enabled || !online) return;
+    // A clean disconnect discards the last will, so say it ourselves
+    mqttClient.publish(nodeTopic, willMessage);
+    resetCluster();
+}
+
+// ─── Membership ─────────────────────────────────────────────────────────────
+
+static ClusterNode* findPeer(const char* id) {
+    for (uint8_t i = 0; i < peerCount; i++) {
+        if (strcmp(peers[i].id, id) == 0) return &peers[i];
+    }
+    return nullptr;
+}
+
+static void removePeer(uint8_t i, const char* why) {
+    LOGI("[Cluster] %s %s", peers[i].id, why);
+    peers[i] = peers[--peerCount];
+}
+
+static void onNodeStatus(JsonDocument& doc) {
+    const char* id = doc["id"];
+    if (!id || isSelf(id)) return;
+    ClusterNode* node = findPeer(id);
+
+    if (!doc["up"].as<bool>()) {
+        if (node) removePeer(node - peers, "left");
+        return;
+    }
+    if (!node) {
+        if (peerCount >= CLUSTER_MAX_NODES - 1) {
+            if (!peersFullLogged) LOGW("[Cluster] More than %d nodes, ignoring %s", CLUSTER_MAX_NODES, id);
+            peersFullLogged = true;
+            return;
+        }
+        node = &peers[peerCount++];
+        strlcpy(node->id, id, sizeof(node->id));
+        LOGI("[Cluster] %s joined", id);
+    }
+    node->seenAt = millis();
+    node->eligible = doc["eligible"];
+    node->motor = doc["motor"];
+    node->runtimeS = doc["runtime_s"];
+    node->flow = doc["flow"];
+}
+
+static void expirePeers(unsigned long now) {
+    for (uint8_t i = peerCount; i-- > 0;) {
+        if (now - peers[i].seenAt > CLUSTER_NODE_TIMEOUT_MS) removePeer(i, "timed out");
+    }
+}
+
+static void updateSelf() {
+    bool eligible = mainSwitch && !manualOverride && !error;
+    // Tell the coordinator right away rather than at the next heartbeat
+    if (eligible != self.eligible) lastHeartbeat = millis() - CLUSTER_HEARTBEAT_MS;
+    self.eligible = eligible;
+    self.motor = motor;
+    self.runtimeS = (uint32_t)counters.get(CNT_MOTOR_RUNTIME_S);
+    self.flow = flow;
+}
+
+static void publishStatus() {
+    StaticJsonDocument<192> doc;
+    doc["id"] = nodeId;
+    doc["up"] = true;
+    doc["eligible"] = self.eligible;
+    doc["motor"] = self.motor;
+    doc["runtime_s"] = self.runtimeS;
+    doc["flow"] = roundf(self.flow * 10.0f) / 10.0f;
+    char json[192];
+    serializeJson(doc, json, sizeof(json));
+    mqttEnqueue(nodeTopic, json, 0);
+}
+
+// ─── Plan ───────────────────────────────────────────────────────────────────
+
+static void onPlan(JsonDocument& doc) {
+    const char* coord = doc["coord"];
+    uint32_t term = doc["term"];
+    // Our own plans come back through the subscription
+    if (!coord || isSelf(coord)) return;
+    bool wins = term > planTerm ||
+                (term == planTerm && (!planCoord[0] || strcmp(coord, planCoord) <= 0));
+    if (!wins) return;
+
+    if (strcmp(coord, planCoord) != 0) {
+        LOGI("[Cluster] %s coordinates (term %lu)", coord, (unsigned long)term);
+    }
+    strlcpy(planCoord, coord, sizeof(planCoord));
+    planTerm = term;
+    planRun = doc["run"];
+    planOrderLen = 0;
+    for (JsonVariant id : doc["order"].as<JsonArray>()) {
+        if (planOrderLen >= CLUSTER_MAX_NODES || !id.is<const char*>()) break;
+        strlcpy(planOrder[planOrderLen++], id.as<const char*>(), CLUSTER_ID_LEN);
+    }
+    planAt = millis();
+}
+
+static void publishPlan() {
+    StaticJsonDocument<256> doc;
+    doc["coord"] = nodeId;
+    doc["term"] = planTerm;
+    doc["run"] = planRun;
+    JsonArray order = doc.createNestedArray("order");
+    for (uint8_t i = 0; i < planOrderLen; i++) order.add(planOrder[i]);
+    char json[224];
+    serializeJson(doc, json, sizeof(json));
+    mqttEnqueue(planTopic, json, 0);
+    lastPlanSent = millis();
+}
+
+// True while this unit is (or just became) the coordinator
+static bool shouldCoordinate(unsigned long now) {
+    if (now - joinedAt < CLUSTER_JOIN_GRACE_MS) return false;
+    if (isSelf(planCoord)) return true;
+
+    // Leave a working coordinator alone, even when a lower ID joins
+    if (planCoord[0] && findPeer(planCoord) && now - planAt < CLUSTER_PLAN_TIMEOUT_MS) return false;
+    for (uint8_t i = 0; i < peerCount; i++) {
+        if (strcmp(peers[i].id, nodeId) < 0) return false;
+    }
+
+    // Keep the inherited plan; the next pass adjusts it
+    planTerm++;
+    strlcpy(planCoord, nodeId, sizeof(planCoord));
+    stagedAt = now;
+    lastStageUp = false;
+    lastPlanSent = 0;
+    LOGI("[Cluster] Taking over as coordinator (term %lu)", (unsigned long)planTerm);
+    return true;
+}
+
+static bool runsLonger(const ClusterNode* a, const ClusterNode* b) {
+    if (a->runtimeS != b->runtimeS) return a->runtimeS > b->runtimeS;
+    return strcmp(a->id, b->id) > 0;
+}
+
+static void coordinate(unsigned long now) {
+    // Eligible units in the current duty order; newcomers go to the back
+    const ClusterNode* ranked[CLUSTER_MAX_NODES];
+    uint8_t n = 0;
+    auto eligibleNode = [](const char* id) -> const ClusterNode* {
+        const ClusterNode* node = isSelf(id) ? &self : findPeer(id);
+        return (node && node->eligible) ? node : nullptr;
+    };
+    for (uint8_t i = 0; i < planOrderLen; i++) {
+        const ClusterNode* node = eligibleNode(planOrder[i]);
+        if (node) ranked[n++] = node;
+    }
+    auto addIfNew = [&](const ClusterNode* node) {
+        if (!node->eligible) return;
+        for (uint8_t i = 0; i < n; i++) if (ranked[i] == node) return;
+        ranked[n++] = node;
+    };
+    addIfNew(&self);
+    for (uint8_t i = 0; i < peerCount; i++) addIfNew(&peers[i]);
+
+    float runningFlow = 0.0f;
+    uint8_t run = min(planRun, n);
+    for (uint8_t i = 0; i < run; i++) runningFlow += ranked[i]->flow;
+
+    float minPressure, maxPressure, deficit, pumpFlow;
+    unsigned long delayMs;
+    {
+        ConfigGuard cfg;
+        minPressure = cfg->min_pressure;
+        maxPressure = cfg->max_pressure;
+        deficit = cfg->cluster_deficit;
+        pumpFlow = cfg->cluster_pump_flow;
+        delayMs = cfg->cluster_delay_s * 1000UL;
+    }
+    bool settled = now - stagedAt >= delayMs;
+
+    uint8_t next = run;
+    if (run == 0) {
+        if (n > 0 && pressure <= minPressure) {
+            // New demand cycle: least runtime leads
+            for (uint8_t i = 1; i < n; i++) {
+                for (uint8_t j = i; j > 0 && runsLonger(ranked[j - 1], ranked[j]); j--) {
+                    const ClusterNode* t = ranked[j];
+                    ranked[j] = ranked[j - 1];
+                    ranked[j - 1] = t;
+                }
+            }
+            next = 1;
+        }
+    } else if (pressure >= maxPressure + deficit) {
+        next = 0;
+    } else if (pressure >= maxPressure) {
+        // The first unit off follows the hysteresis; the rest are paced
+        if (settled || lastStageUp) next = run - 1;
+    } else if (run < n && settled) {
+        if (pressure <= minPressure - deficit || (pumpFlow > 0.0f && runningFlow >= run * pumpFlow)) {
+            next = run + 1;
+        }
+    }
+
+    bool changed = next != planRun || n != planOrderLen;
+    for (uint8_t i = 0; i < n && !changed; i++) changed = strcmp(planOrder[i], ranked[i]->id) != 0;
+
+    if (next != planRun) {
+        lastStageUp = next > planRun;
+        stagedAt = now;
+        if (next > 0) {
+            LOGI("[Cluster] Running %u of %u, lead %s", next, n, ranked[0]->id);
+        } else {
+            LOGI("[Cluster] All units standing by");
+        }
+    }
+    planRun = next;
+    planOrderLen = n;
+    for (uint8_t i = 0; i < n; i++) strlcpy(planOrder[i], ranked[i]->id, CLUSTER_ID_LEN);
+    planAt = now;
+
+    if (changed || now - lastPlanSent >= CLUSTER_HEARTBEAT_MS) publishPlan();
+}
+
+static void updateDemand(unsigned long now) {
+    if (!planCoord[0] || now - planAt >= CLUSTER_PLAN_TIMEOUT_MS) {
+        demand = -1;
+        role = CLUSTER_STANDALONE;
+        statRun = 0;
+        return;
+    }
+    int8_t run = 0;
+    for (uint8_t i = 0; i < planOrderLen && i < planRun; i++) {
+        if (isSelf(planOrder[i])) run = 1;
+    }
+    demand = run;
+    role = isSelf(planCoord) ? CLUSTER_COORDINATOR : CLUSTER_FOLLOWER;
+    statRun = planRun;
+}
+
+// ─── MQTT task entry points ─────────────────────────────────────────────────
+
+bool clusterHandleMessage(const char* topic, char* payload) {
+    if (!enabled) return false;
+    size_t prefixLen = strlen(topicPrefix);
+    if (strncmp(topic, topicPrefix, prefixLen) != 0) return false;
+    if (!online) return true;
+
+    const char* sub = topic + prefixLen;
+    StaticJsonDocument<384> doc;
+    if (deserializeJson(doc, payload)) return true;
+    if (strncmp(sub, "node/", 5) == 0) {
+        onNodeStatus(doc);
+    } else if (strcmp(sub, "plan") == 0) {
+        onPlan(doc);
+    }
+    return true;
+}
+
+void clusterService(bool connected) {
+    if (!enabled) return;
+    if (!connected) {
+        if (online) {
+            LOGW("[Cluster] Broker lost, running standalone");
+            resetCluster();
+        }
+        return;
+    }
+    if (!online) return;
+
+    unsigned long now = millis();
+    updateSelf();
+    expirePeers(now);
+    statNodes = peerCount + 1;
+    if (now - lastHeartbeat >= CLUSTER_HEARTBEAT_MS) {
+        lastHeartbeat = now;
+        publishStatus();
+    }
+    if (shouldCoordinate(now)) coordinate(now);
+    updateDemand(now);
+}
+
+int8_t clusterMotorDemand() {
+    return demand;
+}
+
+ClusterRole clusterRole() {
+    return role;
+}
+
+const char* clusterRoleName(ClusterRole r) {
+    static const char* const NAMES[] = { "off", "standalone", "follower", "coordinator" };
+    return r <= CLUSTER_COORDINATOR ? NAMES[r] : "unknown";
+}
+
+uint8_t clusterNodeCount() {
+    return statNodes;
+}
+
+uint8_t clusterRunCount() {
+    return statRun;
+}
@@ -0,0 +1,86 @@
+#ifndef PUMP_CLUSTER_H
+#define PUMP_CLUSTER_H
+
+#include <Arduino.h>
+
+// Units on one manifold, this one included
+#define CLUSTER_MAX_NODES        4
+#define CLUSTER_ID_LEN           24
+// Node status period, and how long a silent node still counts as present
+#define CLUSTER_HEARTBEAT_MS     2000
+#define CLUSTER_NODE_TIMEOUT_MS  7000
+// After (re)connecting, listen this long before taking over as coordinator
+#define CLUSTER_JOIN_GRACE_MS    CLUSTER_NODE_TIMEOUT_MS
+// Without a fresh plan for this long, a unit falls back to its own hysteresis
+#define CLUSTER_PLAN_TIMEOUT_MS  10000
+
+enum ClusterRole : uint8_t {
+    CLUSTER_OFF,            // cluster_enabled is false
+    CLUSTER_STANDALONE,     // enabled, but no plan in force (broker away, joining)
+    CLUSTER_FOLLOWER,
+    CLUSTER_COORDINATOR
+};
+
+/*
+ * Lead/lag for several units on a shared manifold, over the MQTT broker
+ * they already use. Topics live under aquasensys/cluster/<cluster_name>/:
+ *
+ *   node/<id>  every CLUSTER_HEARTBEAT_MS, and as the connection's last will:
+ *              {"id":..,"up":true,"eligible":true,"motor":false,"runtime_s":N,"flow":F}
+ *   plan       from the coordinator, on change and every heartbeat:
+ *              {"coord":..,"term":N,"run":K,"order":[id,id,..]}
+ *
+ * A unit is eligible in auto mode with the main switch on and no fault.
+ * The first K eligible units of "order" run; the rest stand by.
+ *
+ * The coordinator stays in charge until it drops out (last will, or no
+ * heartbeat for CLUSTER_NODE_TIMEOUT_MS). The lowest node ID still present
+ * then takes over with the next term and keeps the plan it inherited;
+ * a plan with a higher term, or the same term from a lower ID, always wins.
+ *
+ * The coordinator stages on its own pressure reading (the manifold's):
+ *   - idle, at min_pressure: start the eligible unit with the least runtime;
+ *     duty rotates because the order is re-sorted at every start
+ *   - below min_pressure - cluster_deficit, or total flow at
+ *     K * cluster_pump_flow: add a unit, at most every cluster_delay_s
+ *   - at max_pressure: drop the last unit, then one more per cluster_delay_s
+ *   - at max_pressure + cluster_deficit: stop all
+ *
+ * Each unit keeps its own Home Assistant device under homeassistant/<node id>/
+ * (see clusterDeviceId()), so every pump can be watched and switched alone.
+ *
+ * Protection (checkForErrors) stays local, and a unit that loses the
+ * broker or the plan runs its own min/max hysteresis again.
+ * tools/cluster_sim.py runs simulated nodes against a local broker.
+ */
+
+// "aquasensys-a1b2c3", from the MAC; the MQTT client ID in cluster mode
+const char* clusterNodeId();
+bool clusterEnabled();
+// ID this unit publishes under (client ID, homeassistant/<id>/ topics,
+// discovery unique_ids, Influx device tag): clusterNodeId() in cluster mode,
+// so units on one broker don't overwrite each other; DEVICE_ID otherwise
+const char* clusterDeviceId();
+
+// MQTT task: at setup and after the MQTT settings changed, before connecting
+void clusterConfigure();
+// Last will for connect(); topic is null when cluster mode is off
+const char* clusterWillTopic();
+const char* clusterWillMessage();
+// MQTT task: after connect() succeeded, and before a deliberate disconnect()
+void clusterConnected();
+void clusterLeave();
+// MQTT task, from the message callback; true if the topic was a cluster one
+bool clusterHandleMessage(const char* topic, char* payload);
+// MQTT task, every pass
+void clusterService(bool connected);
+
+// loop(): 1 run, 0 stand by, -1 no plan (use the local hysteresis)
+int8_t clusterMotorDemand();
+
+ClusterRole clusterRole();
+const char* clusterRoleName(ClusterRole role);
+uint8_t clusterNodeCount();
+uint8_t clusterRunCount();
+
+#endif
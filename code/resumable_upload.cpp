@@ -0,0 +1,330 @@
+#include "resumable_upload.h"
+#include <SD.h>
+#include <esp_system.h>
+#include "admission.h"
+#include "asset_cache.h"
+#include "file_manager.h"
+#include "sd_block_writer.h"
+#include "logger.h"
+
+struct UploadSession {
+    char          id[9];                    // empty = free slot
+    char          path[UPLOAD_PATH_MAX];    // final location
+    uint32_t      size;                     // declared length
+    uint32_t      received;                 // accepted so far (on card or buffered)
+    unsigned long lastActivity;
+    bool          failed;                   // a card write failed; abort and start over
+};
+
+// Per-PUT state, kept in request->_tempObject (freed with the request)
+struct PutState {
+    int status;
+    int session;
+};
+
+// Only touched from web handlers, which all run in the async_tcp task
+static UploadSession sessions[UPLOAD_MAX_SESSIONS];
+// One staging file is open at a time; uploads hold the single upload slot
+static SdBlockWriter writer;
+static int writerSession = -1;
+
+static String stagingPath(const UploadSession& s) {
+    return String(UPLOAD_STAGING_DIR "/") + s.id + ".part";
+}
+
+static int findSession(AsyncWebServerRequest *request) {
+    if (!request->hasParam("id")) return -1;
+    const String& id = request->getParam("id")->value();
+    for (int i = 0; i < UPLOAD_MAX_SESSIONS; i++) {
+        if (sessions[i].id[0] && id == sessions[i].id) return i;
+    }
+    return -1;
+}
+
+static void releaseWriter() {
+    if (writerSession < 0) return;
+    // received counts the buffered tail too; if it never reached the card the
+    // staged file is short and the session has to start over
+    if (!writer.close()) sessions[writerSession].failed = true;
+    writerSession = -1;
+}
+
+static void dropSession(int i) {
+    if (writerSession == i) releaseWriter();
+    SD.remove(stagingPath(sessions[i]));
+    sessions[i].id[0] = '\0';
+}
+
+static void expireSessions() {
+    for (int i = 0; i < UPLOAD_MAX_SESSIONS; i++) {
+        if (sessions[i].id[0] && millis() - sessions[i].lastActivity > UPLOAD_SESSION_TTL_MS) {
+            LOGI("[Upload] Session %s for %s expired", sessions[i].id, sessions[i].path);
+            dropSession(i);
+        }
+    }
+}
+
+// Staging files from before a reboot have no session and can't be resumed
+static void clearStaging() {
+    static bool cleared = false;
+    if (cleared) return;
+    cleared = true;
+
+    File dir = SD.open(UPLOAD_STAGING_DIR);
+    if (!dir) {
+        SD.mkdir(UPLOAD_STAGING_DIR);
+        return;
+    }
+    File entry = dir.openNextFile();
+    while (entry) {
+        String path = entry.path();
+        entry.close();
+        SD.remove(path);
+        entry = dir.openNextFile();
+    }
+    dir.close();
+}
+
+static bool validTarget(const String& path) {
+    return path.startsWith("/") && path.length() < UPLOAD_PATH_MAX &&
+           path.indexOf("..") < 0 && !path.startsWith(UPLOAD_STAGING_DIR);
+}
+
+// Current offset in the headers and, except for HEAD, the body
+static void sendOffset(AsyncWebServerRequest *request, int code, const UploadSession& s) {
+    AsyncWebServerResponse *response;
+    if (request->method() == HTTP_HEAD) {
+        response = request->beginResponse(code);
+    } else {
+        char body[64];
+        snprintf(body, sizeof(body), "{\"offset\":%lu,\"length\":%lu}",
+                 (unsigned long)s.received, (unsigned long)s.size);
+        response = request->beginResponse(code, "application/json", body);
+    }
+    response->addHeader("Upload-Offset", String(s.received));
+    response->addHeader("Upload-Length", String(s.size));
+    response->addHeader("Cache-Control", "no-store");
+    request->send(response);
+}
+
+static void sendError(AsyncWebServerRequest *request, int code, const char* message) {
+    char body[96];
+    snprintf(body, sizeof(body), "{\"error\":\"%s\"}", message);
+    request->send(code, "application/json", body);
+}
+
+static void handleCreate(AsyncWebServerRequest *request) {
+    if (!request->hasParam("path") || !request->hasParam("size")) {
+        sendError(request, 400, "path and size required");
+        return;
+    }
+    String path = request->getParam("path")->value();
+    long size = request->getParam("size")->value().toInt();
+    if (!validTarget(path) || size < 0) {
+        sendError(request, 400, "Invalid path or size");
+        return;
+    }
+
+    clearStaging();
+    expireSessions();
+
+    int slot = -1;
+    for (int i = 0; i < UPLOAD_MAX_SESSIONS; i++) {
+        if (!sessions[i].id[0]) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) {
+        sendError(request, 503, "Too many open uploads");
+        return;
+    }
+
+    UploadSession& s = sessions[slot];
+    snprintf(s.id, sizeof(s.id), "%08lx", (unsigned long)esp_random());
+    File staged = SD.open(stagingPath(s), FILE_WRITE);
+    if (!staged) {
+        s.id[0] = '\0';
+        sendError(request, 500, "Cannot create staging file");
+        return;
+    }
+    staged.close();
+
+    strlcpy(s.path, path.c_str(), sizeof(s.path));
+    s.size = size;
+    s.received = 0;
+    s.lastActivity = millis();
+    s.failed = false;
+    LOGI("[Upload] Session %s for %s (%ld bytes)", s.id, s.path, size);
+
+    char body[64];
+    snprintf(body, sizeof(body), "{\"id\":\"%s\",\"offset\":0}", s.id);
+    request->send(201, "application/json", body);
+}
+
+static void handleCommit(AsyncWebServerRequest *request) {
+    int i = findSession(request);
+    if (i < 0) {
+        sendError(request, 404, "Unknown upload");
+        return;
+    }
+    UploadSession& s = sessions[i];
+    // Closing flushes the last block, which can still fail
+    if (writerSession == i) releaseWriter();
+    if (s.failed) {
+        sendError(request, 500, "Staging write failed");
+        return;
+    }
+    if (s.received != s.size) {
+        sendOffset(request, 409, s);
+        return;
+    }
+
+    String staged = stagingPath(s);
+    File check = SD.open(staged);
+    size_t onCard = check ? check.size() : 0;
+    if (check) check.close();
+    if (onCard != s.size) {
+        // Resume from what the card actually holds
+        LOGW("[Upload] %s: staged %u of %lu bytes", s.id, (unsigned)onCard, (unsigned long)s.size);
+        s.received = onCard;
+        sendOffset(request, 409, s);
+        return;
+    }
+
+    // FAT rename won't replace a file: move the old one aside first so the
+    // target is always either the old or the complete new content
+    String target = s.path;
+    String backup = target + ".bak";
+    bool hadOld = SD.exists(target);
+    assetCache.invalidate(target);
+    if (hadOld) {
+        SD.remove(backup);
+        if (!SD.rename(target, backup)) {
+            sendError(request, 500, "Cannot replace existing file");
+            return;
+        }
+    }
+    if (!SD.rename(staged, target)) {
+        if (hadOld) SD.rename(backup, target);
+        sendError(request, 500, "Rename failed");
+        return;
+    }
+    if (hadOld) SD.remove(backup);
+    removeStaleGzip(target);
+    invalidateSdFileCount();
+
+    LOGI("[Upload] Committed %s (%lu bytes)", s.path, (unsigned long)s.size);
+    s.id[0] = '\0';
+    request->send(200, "application/json", "{\"success\":true}");
+}
+
+bool ResumableUploadHandler::canHandle(AsyncWebServerRequest *request) {
+    const String& url = request->url();
+    if (url == "/api/upload") {
+        return request->method() & (HTTP_POST | HTTP_HEAD | HTTP_PUT | HTTP_DELETE);
+    }
+    return url == "/api/upload/commit" && request->method() == HTTP_POST;
+}
+
+void ResumableUploadHandler::handleBody(AsyncWebServerRequest *request, uint8_t *data, size_t len,
+                                        size_t index, size_t total) {
+    if (request->method() != HTTP_PUT) return;
+
+    if (index == 0) {
+        // Holds the upload slot until the connection closes
+        if (!tryAdmit(request, REQ_CLASS_UPLOAD)) return;
+
+        PutState* put = (PutState*)malloc(sizeof(PutState));
+        if (!put) return;
+        request->_tempObject = put;
+        put->session = findSession(request);
+
+        if (put->session < 0) {
+            put->status = 404;
+        } else {
+            UploadSession& s = sessions[put->session];
+            long offset = request->hasParam("offset") ? request->getParam("offset")->value().toInt() : -1;
+            if (s.failed) {
+                put->status = 500;
+            } else if (offset != (long)s.received) {
+                put->status = 409;
+            } else if (s.received + total > s.size) {
+                put->status = 413;
+            } else if (writerSession != put->session) {
+                releaseWriter();
+                if (writer.open(stagingPath(s), FILE_APPEND)) {
+                    writerSession = put->session;
+                    put->status = 200;
+                } else {
+                    put->status = 500;
+                }
+            } else {
+                put->status = 200;
+            }
+        }
+    }
+
+    PutState* put = (PutState*)request->_tempObject;
+    if (!put || put->status != 200) return;
+
+    UploadSession& s = sessions[put->session];
+    if (writer.write(data, len) != len) {
+        s.failed = true;
+        put->status = 500;
+        return;
+    }
+    s.received += len;
+    s.lastActivity = millis();
+}
+
+void ResumableUploadHandler::handleRequest(AsyncWebServerRequest *request) {
+    WebRequestMethodComposite method = request->method();
+
+    if (method == HTTP_PUT) {
+        PutState* put = (PutState*)request->_tempObject;
+        if (!put && request->contentLength() > 0) {
+            sendOverloaded(request, REQ_CLASS_UPLOAD);
+            return;
+        }
+        // An empty PUT just reports the offset
+        int i = put ? put->session : findSession(request);
+        int status = put ? put->status : (i < 0 ? 404 : 200);
+        switch (status) {
+            case 200:
+            case 409: sendOffset(request, status, sessions[i]); break;
+            case 404: sendError(request, 404, "Unknown upload"); break;
+            case 413: sendError(request, 413, "Data beyond declared size"); break;
+            default:  sendError(request, 500, "Staging write failed"); break;
+        }
+        return;
+    }
+
+    if (method == HTTP_HEAD) {
+        int i = findSession(request);
+        if (i < 0) {
+            request->send(404);
+            return;
+        }
+        sendOffset(request, 200, sessions[i]);
+        return;
+    }
+
+    // Everything else touches the card; wait for any upload in progress
+    admitRequest(request, REQ_CLASS_UPLOAD, [](AsyncWebServerRequest *request) {
+        if (request->url() == "/api/upload/commit") {
+            handleCommit(request);
+        } else if (request->method() == HTTP_POST) {
+            handleCreate(request);
+        } else {
+            int i = findSession(request);
+            if (i < 0) {
+                sendError(request, 404, "Unknown upload");
+                return;
+            }
+            LOGI("[Upload] Session %s for %s aborted", sessions[i].id, sessions[i].path);
+            dropSession(i);
+            request->send(200, "application/json", "{\"success\":true}");
+        }
+    });
+}
@@ -0,0 +1,40 @@
+#ifndef RESUMABLE_UPLOAD_H
+#define RESUMABLE_UPLOAD_H
+
+#include <ESPAsyncWebServer.h>
+
+// Uploads that can be open (created, not yet committed) at once
+#define UPLOAD_MAX_SESSIONS    4
+// An untouched session is discarded after this long
+#define UPLOAD_SESSION_TTL_MS  (30UL * 60UL * 1000UL)
+// Staged data lives here until the commit renames it into place
+#define UPLOAD_STAGING_DIR     "/.uploads"
+#define UPLOAD_PATH_MAX        64
+
+/**
+ * Resumable uploads:
+ *
+ *   POST   /api/upload?path=/index.html&size=N    → 201 {"id":"…","offset":0}
+ *   HEAD   /api/upload?id=…                       → Upload-Offset, Upload-Length
+ *   PUT    /api/upload?id=…&offset=N              raw bytes (application/octet-stream)
+ *   POST   /api/upload/commit?id=…                → rename into place once complete
+ *   DELETE /api/upload?id=…                       → abort
+ *
+ * A PUT must start at the current offset (409 with Upload-Offset otherwise)
+ * and may carry any amount of the remaining data. Bytes that arrived before
+ * a connection dropped are kept, so the client asks HEAD for the offset and
+ * carries on from there. Sessions live in RAM and don't survive a reboot.
+ *
+ * Commit answers 409 with the offset when the staged file turns out shorter
+ * than what was accepted; the client resends from there and commits again.
+ * A write the card refused fails the session (500): start a new one.
+ */
+class ResumableUploadHandler : public AsyncWebHandler {
+public:
+    bool canHandle(AsyncWebServerRequest *request) override;
+    void handleRequest(AsyncWebServerRequest *request) override;
+    void handleBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) override;
+    bool isRequestHandlerTrivial() override { return false; }
+};
+
+#endif
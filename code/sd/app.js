@@ -43,7 +43,7 @@ function connectSSE() {
     eventSource.close();
   }
 
-  eventSource = new EventSource('/events');
+  eventSource = new EventSource('/events?topics=update');
   
   eventSource.onopen = () => {
     console.log('SSE connection opened');
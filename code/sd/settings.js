@@ -21,7 +21,8 @@ function connectSSE() {
     eventSource.close();
   }
 
-  eventSource = new EventSource('/events');
+  // Only used as a connection indicator: take the lightest topic
+  eventSource = new EventSource('/events?topics=update');
   
   eventSource.onopen = () => {
     console.log('SSE connection opened');
@@ -79,6 +80,8 @@ function populateFormFields(config) {
   document.getElementById('mqtt_server').value = config.mqtt_server || '';
   document.getElementById('mqtt_port').value = config.mqtt_port || 1883;
   document.getElementById('mqtt_user').value = config.mqtt_user || '';
+  document.getElementById('mqtt_batch_hz').value = config.mqtt_batch_hz || 0;
+  document.getElementById('mqtt_batch_window_ms').value = config.mqtt_batch_window_ms || 1000;
   // Password is not filled for security reasons
   
   // System parameters
@@ -86,6 +89,7 @@ function populateFormFields(config) {
   document.getElementById('max_pressure').value = config.max_pressure || 3.5;
   document.getElementById('pressure_offset').value = config.pressure_offset || 0;
   document.getElementById('temp_offset').value = config.temp_offset || 0;
+  document.getElementById('log_level').value = config.log_level !== undefined ? config.log_level : 3;
 }
 
 function saveConfiguration(formId, event) {
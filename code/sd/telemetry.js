@@ -0,0 +1,150 @@
+// Binary telemetry stream (/ws/telemetry) — decoder and rolling chart
+//
+// Frame layout (little-endian, matches TelemetryFrame in telemetry.h):
+//   u8 version, u8 flags, u16 rateHz, u32 seq, u32 timestampMs,
+//   f32 pressureIn, pressureOut, flow, waterTemp, ambientTemp,
+//       currentL1, currentL2, currentL3, currentTotal
+
+const TELEMETRY_FRAME_VERSION = 1;
+const TELEMETRY_FRAME_SIZE = 48;
+
+const TELEMETRY_FLAGS = {
+  motor: 0x01,
+  error: 0x02,
+  mainSwitch: 0x04,
+  manual: 0x08
+};
+
+function decodeTelemetryFrame(buffer) {
+  if (buffer.byteLength < TELEMETRY_FRAME_SIZE) return null;
+  const v = new DataView(buffer);
+  if (v.getUint8(0) !== TELEMETRY_FRAME_VERSION) return null;
+
+  const flags = v.getUint8(1);
+  return {
+    rateHz: v.getUint16(2, true),
+    seq: v.getUint32(4, true),
+    timestampMs: v.getUint32(8, true),
+    pressureIn: v.getFloat32(12, true),
+    pressureOut: v.getFloat32(16, true),
+    flow: v.getFloat32(20, true),
+    waterTemp: v.getFloat32(24, true),
+    ambientTemp: v.getFloat32(28, true),
+    currentL1: v.getFloat32(32, true),
+    currentL2: v.getFloat32(36, true),
+    currentL3: v.getFloat32(40, true),
+    currentTotal: v.getFloat32(44, true),
+    motor: (flags & TELEMETRY_FLAGS.motor) !== 0,
+    error: (flags & TELEMETRY_FLAGS.error) !== 0,
+    mainSwitch: (flags & TELEMETRY_FLAGS.mainSwitch) !== 0,
+    manual: (flags & TELEMETRY_FLAGS.manual) !== 0
+  };
+}
+
+// WebSocket client; calls onFrame(frame) per decoded frame and reconnects on loss
+class TelemetryClient {
+  constructor(onFrame, rateHz = 10) {
+    this.onFrame = onFrame;
+    this.rateHz = rateHz;
+    this.ws = null;
+    this.maxRate = 50;
+    this.lastSeq = null;
+    this.gaps = 0;
+    this.connect();
+  }
+
+  connect() {
+    const proto = location.protocol === 'https:' ? 'wss://' : 'ws://';
+    this.ws = new WebSocket(proto + location.host + '/ws/telemetry');
+    this.ws.binaryType = 'arraybuffer';
+
+    this.ws.onopen = () => this.setRate(this.rateHz);
+    this.ws.onclose = () => setTimeout(() => this.connect(), 3000);
+    this.ws.onmessage = (e) => {
+      if (typeof e.data === 'string') {
+        // Hello message: {"version","frame_size","rate","max_rate"}
+        try { this.maxRate = JSON.parse(e.data).max_rate || this.maxRate; } catch (err) {}
+        return;
+      }
+      const frame = decodeTelemetryFrame(e.data);
+      if (!frame) return;
+
+      // seq counts sampler ticks; a jump well past this client's spacing means dropped frames
+      const step = Math.ceil(this.maxRate / frame.rateHz);
+      if (this.lastSeq !== null && frame.seq - this.lastSeq > step + 1) this.gaps++;
+      this.lastSeq = frame.seq;
+      this.onFrame(frame);
+    };
+  }
+
+  setRate(hz) {
+    this.rateHz = hz;
+    this.lastSeq = null;
+    if (this.ws && this.ws.readyState === WebSocket.OPEN) {
+      this.ws.send(JSON.stringify({ rate: hz }));
+    }
+  }
+}
+
+// Rolling line chart on a <canvas>; series: [{ key, color, label }]
+class RollingChart {
+  constructor(canvas, series, windowSeconds = 10) {
+    this.canvas = canvas;
+    this.ctx = canvas.getContext('2d');
+    this.series = series;
+    this.windowMs = windowSeconds * 1000;
+    this.points = [];
+    this.pending = false;
+  }
+
+  push(frame) {
+    this.points.push(frame);
+    const cutoff = frame.timestampMs - this.windowMs;
+    while (this.points.length && this.points[0].timestampMs < cutoff) this.points.shift();
+
+    // Draw at most once per animation frame
+    if (!this.pending) {
+      this.pending = true;
+      requestAnimationFrame(() => {
+        this.pending = false;
+        this.draw();
+      });
+    }
+  }
+
+  draw() {
+    const { ctx, canvas } = this;
+    const w = canvas.width = canvas.clientWidth;
+    const h = canvas.height = canvas.clientHeight;
+    ctx.clearRect(0, 0, w, h);
+    if (this.points.length < 2) return;
+
+    let min = Infinity, max = -Infinity;
+    this.points.forEach(p => this.series.forEach(s => {
+      min = Math.min(min, p[s.key]);
+      max = Math.max(max, p[s.key]);
+    }));
+    if (max - min < 0.1) { max += 0.05; min -= 0.05; }
+
+    const t1 = this.points[this.points.length - 1].timestampMs;
+    const t0 = t1 - this.windowMs;
+    const x = t => (t - t0) / this.windowMs * w;
+    const y = v => h - 14 - (v - min) / (max - min) * (h - 28);
+
+    this.series.forEach(s => {
+      ctx.strokeStyle = s.color;
+      ctx.lineWidth = 1.5;
+      ctx.beginPath();
+      this.points.forEach((p, i) => {
+        if (i === 0) ctx.moveTo(x(p.timestampMs), y(p[s.key]));
+        else ctx.lineTo(x(p.timestampMs), y(p[s.key]));
+      });
+      ctx.stroke();
+    });
+
+    ctx.fillStyle = '#666';
+    ctx.font = '11px sans-serif';
+    ctx.fillText(max.toFixed(2), 4, 12);
+    ctx.fillText(min.toFixed(2), 4, h - 2);
+  }
+}
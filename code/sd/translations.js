@@ -65,6 +65,8 @@ const translations = {
     "mqttPort": "MQTT Port:",
     "mqttUsername": "MQTT Username:",
     "mqttPassword": "MQTT Password:",
+    "mqttBatchHz": "Batched Telemetry Rate (Hz, 0 = off):",
+    "mqttBatchWindow": "Batch Window (ms):",
     
     // Settings page - System Parameters
     "systemParameters": "System Parameters",
@@ -72,6 +74,12 @@ const translations = {
     "maxPressureBar": "Maximum Pressure (bar):",
     "pressureOffset": "Pressure Offset:",
     "tempOffset": "Temperature Offset:",
+    "logLevel": "Log Level:",
+    "logLevelOff": "Off",
+    "logLevelError": "Errors",
+    "logLevelWarn": "Warnings",
+    "logLevelInfo": "Info",
+    "logLevelDebug": "Debug",
     "saveParameters": "Save Parameters",
     
     // Settings page - System Actions
@@ -212,11 +220,20 @@ const translations = {
     "cardType": "Card Type",
     "cardSize": "Card Size",
     "filesCount": "Files Count",
+    "sdClock": "SPI Clock",
+    "assetCache": "Asset Cache",
+    "cacheUsage": "Usage",
+    "cacheHits": "Hits",
+    "cacheMisses": "Misses",
+    "cacheEvictions": "Evictions",
+    "liveChart": "Live Chart",
+    "droppedFrames": "Dropped frames",
     "mcpStatus": "MCP3208 ADC Status",
     "mcpInitialized": "Initialized",
     "mcpVref": "Reference Voltage",
     "mcpReadErrors": "Read Errors",
     "spiStatus": "SPI Status",
+    "adcClock": "SPI Clock",
     "rawAdcValues": "Raw ADC Values (0-4095)",
     "currentL1": "Current L1",
     "currentL2": "Current L2",
@@ -316,6 +333,8 @@ const translations = {
     "mqttPort": "Porta MQTT:",
     "mqttUsername": "Nome de Utilizador MQTT:",
     "mqttPassword": "Palavra-passe MQTT:",
+    "mqttBatchHz": "Taxa de Telemetria em Lote (Hz, 0 = desligada):",
+    "mqttBatchWindow": "Janela do Lote (ms):",
     
     // Settings page - System Parameters
     "systemParameters": "Parâmetros do Sistema",
@@ -323,6 +342,12 @@ const translations = {
     "maxPressureBar": "Pressão Máxima (bar):",
     "pressureOffset": "Offset de Pressão:",
     "tempOffset": "Offset de Temperatura:",
+    "logLevel": "Nível de Registo:",
+    "logLevelOff": "Desligado",
+    "logLevelError": "Erros",
+    "logLevelWarn": "Avisos",
+    "logLevelInfo": "Informação",
+    "logLevelDebug": "Depuração",
     "saveParameters": "Guardar Parâmetros",
     
     // Settings page - System Actions
@@ -463,11 +488,20 @@ const translations = {
     "cardType": "Tipo de Cartão",
     "cardSize": "Tamanho do Cartão",
     "filesCount": "Contagem de Ficheiros",
+    "sdClock": "Relógio SPI",
+    "assetCache": "Cache de Ficheiros",
+    "cacheUsage": "Utilização",
+    "cacheHits": "Acertos",
+    "cacheMisses": "Falhas",
+    "cacheEvictions": "Remoções",
+    "liveChart": "Gráfico em Tempo Real",
+    "droppedFrames": "Tramas perdidas",
     "mcpStatus": "Estado do MCP3208 ADC",
     "mcpInitialized": "Inicializado",
     "mcpVref": "Tensão de Referência",
     "mcpReadErrors": "Erros de Leitura",
     "spiStatus": "Estado SPI",
+    "adcClock": "Relógio SPI",
     "rawAdcValues": "Valores ADC Brutos (0-4095)",
     "currentL1": "Corrente L1",
     "currentL2": "Corrente L2",
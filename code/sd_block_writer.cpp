@@ -0,0 +1,74 @@
+#include "sd_block_writer.h"
+#include "logger.h"
+
+SdBlockWriter::SdBlockWriter() :
+    buf(nullptr),
+    fill(0),
+    limit(SD_WRITE_BLOCK),
+    opened(false),
+    error(false) {
+}
+
+SdBlockWriter::~SdBlockWriter() {
+    close();
+}
+
+bool SdBlockWriter::open(const String& path, const char* mode) {
+    close();
+    file = SD.open(path, mode);
+    if (!file) return false;
+
+    if (!buf) buf = (uint8_t*)malloc(SD_WRITE_BLOCK);
+    if (!buf) LOGW("[SD] No memory for write buffer, writing unbuffered");
+
+    // An appended file may end mid-block: the first flush only tops it up
+    fill = 0;
+    limit = SD_WRITE_BLOCK - (file.size() % SD_WRITE_BLOCK);
+    opened = true;
+    error = false;
+    return true;
+}
+
+size_t SdBlockWriter::write(const uint8_t* data, size_t len) {
+    if (!opened || error) return 0;
+
+    if (!buf) {
+        if (file.write(data, len) != len) error = true;
+        return error ? 0 : len;
+    }
+
+    size_t done = 0;
+    while (done < len) {
+        size_t n = min(len - done, limit - fill);
+        memcpy(buf + fill, data + done, n);
+        fill += n;
+        done += n;
+        if (fill == limit && !flush()) return 0;
+    }
+    return len;
+}
+
+bool SdBlockWriter::flush() {
+    if (!opened || error) return false;
+    if (fill == 0) return true;
+
+    if (file.write(buf, fill) != fill) {
+        LOGE("[SD] Write of %u bytes failed", (unsigned)fill);
+        error = true;
+    }
+    fill = 0;
+    limit = SD_WRITE_BLOCK;
+    return !error;
+}
+
+bool SdBlockWriter::close() {
+    bool ok = !error;
+    if (opened) {
+        ok = flush();
+        file.close();
+        opened = false;
+    }
+    free(buf);
+    buf = nullptr;
+    return ok;
+}
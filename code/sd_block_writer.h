@@ -0,0 +1,43 @@
+#ifndef SD_BLOCK_WRITER_H
+#define SD_BLOCK_WRITER_H
+
+#include <SD.h>
+
+// Coalescing block: a multiple of the 512-byte sector
+#define SD_WRITE_BLOCK 4096
+
+/**
+ * Sequential SD file writer that gathers small writes (TCP-sized upload
+ * chunks) into SD_WRITE_BLOCK blocks aligned to the file offset, so the card
+ * sees whole-sector writes instead of read-modify-write of partial sectors.
+ *
+ * The block buffer is only allocated while a file is open. If it can't be
+ * allocated, writes go straight to the file.
+ */
+class SdBlockWriter {
+public:
+    SdBlockWriter();
+    ~SdBlockWriter();
+
+    // mode is FILE_WRITE (truncate) or FILE_APPEND (resume at the end)
+    bool open(const String& path, const char* mode);
+    // Returns len, or 0 once a write to the card has failed
+    size_t write(const uint8_t* data, size_t len);
+    bool flush();
+    // Flush and release the file and buffer; false if any write to the card
+    // failed, so the file is shorter than what write() accepted
+    bool close();
+
+    bool isOpen() const { return opened; }
+    bool failed() const { return error; }
+
+private:
+    File     file;
+    uint8_t* buf;
+    size_t   fill;
+    size_t   limit;     // bytes until the next block boundary
+    bool     opened;
+    bool     error;
+};
+
+#endif
@@ -0,0 +1,200 @@
+#include "spi_tuner.h"
+#include <SD.h>
+#include <Preferences.h>
+#include "logger.h"
+
+// SD clocks, slowest first. 4 MHz is the library default; SPI-mode cards are
+// specified up to 25 MHz and these are exact ESP32 dividers of 80 MHz.
+static const uint32_t SD_CLOCKS[] = { 4000000, 8000000, 10000000, 16000000, 20000000 };
+#define SD_CLOCK_COUNT (sizeof(SD_CLOCKS) / sizeof(SD_CLOCKS[0]))
+
+// MCP3208 clocks, fastest first; candidates above the datasheet limit are skipped
+static const uint32_t ADC_CLOCKS[] = { 2000000, 1800000, 1600000, 1350000, 1000000, 800000 };
+#define ADC_CLOCK_COUNT (sizeof(ADC_CLOCKS) / sizeof(ADC_CLOCKS[0]))
+static const uint32_t ADC_REFERENCE_HZ = 500000;
+
+// Channels with slow-moving signals (temperatures, pressures). The current
+// channels carry 50 Hz AC and would not compare cleanly between two reads.
+static const uint8_t ADC_CHECK_CHANNELS[] = { 0, 1, 2, 3 };
+#define ADC_CHECK_SAMPLES  32
+#define ADC_MAX_DEVIATION  8    // allowed mean difference from the reference (LSB)
+
+// Read-back test file, filled with a generated pattern
+static const char* PROBE_FILE = "/.spiprobe";
+#define PROBE_SIZE  4096
+#define PROBE_BLOCK 512
+#define PROBE_SEED  0x5A17C0DEUL
+
+static uint32_t sdClockHz = 0;
+static uint32_t adcClockHz = 0;
+
+uint32_t getSdClockHz()  { return sdClockHz; }
+uint32_t getAdcClockHz() { return adcClockHz; }
+
+static uint32_t loadStoredClock(const char* key) {
+    Preferences prefs;
+    if (!prefs.begin("spi", true)) return 0;
+    uint32_t hz = prefs.getUInt(key, 0);
+    prefs.end();
+    return hz;
+}
+
+static void storeClock(const char* key, uint32_t hz) {
+    if (loadStoredClock(key) == hz) return;  // spare the flash
+    Preferences prefs;
+    if (!prefs.begin("spi", false)) return;
+    prefs.putUInt(key, hz);
+    prefs.end();
+}
+
+// ─── SD card ────────────────────────────────────────────────────────────────
+
+// xorshift32 stream, so verification needs no stored copy of the data
+static void nextPattern(uint8_t* buf, size_t len, uint32_t& state) {
+    for (size_t i = 0; i < len; i++) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        buf[i] = (uint8_t)state;
+    }
+}
+
+static bool mountAt(uint8_t csPin, SPIClass& spi, uint32_t hz) {
+    SD.end();
+    return SD.begin(csPin, spi, hz) && SD.cardType() != CARD_NONE;
+}
+
+static bool writeProbeFile() {
+    File f = SD.open(PROBE_FILE, FILE_WRITE);
+    if (!f) return false;
+
+    uint8_t block[PROBE_BLOCK];
+    uint32_t state = PROBE_SEED;
+    bool ok = true;
+    for (size_t off = 0; off < PROBE_SIZE && ok; off += PROBE_BLOCK) {
+        nextPattern(block, sizeof(block), state);
+        ok = f.write(block, sizeof(block)) == sizeof(block);
+    }
+    f.close();
+    return ok;
+}
+
+static bool verifyProbeFile() {
+    File f = SD.open(PROBE_FILE, FILE_READ);
+    if (!f) return false;
+    if (f.size() != PROBE_SIZE) {
+        f.close();
+        return false;
+    }
+
+    uint8_t expected[PROBE_BLOCK];
+    uint8_t actual[PROBE_BLOCK];
+    uint32_t state = PROBE_SEED;
+    bool ok = true;
+    for (size_t off = 0; off < PROBE_SIZE && ok; off += PROBE_BLOCK) {
+        nextPattern(expected, sizeof(expected), state);
+        ok = f.read(actual, sizeof(actual)) == sizeof(actual) &&
+             memcmp(expected, actual, sizeof(actual)) == 0;
+    }
+    f.close();
+    return ok;
+}
+
+// Read the probe file back at hz; the remount keeps the FAT cache out of it
+static bool probeSdClock(uint8_t csPin, SPIClass& spi, uint32_t hz) {
+    return mountAt(csPin, spi, hz) && verifyProbeFile();
+}
+
+bool tuneSdClock(uint8_t csPin, SPIClass& spi) {
+    // Fast path: the stored clock still reads the probe file back intact
+    uint32_t stored = loadStoredClock("sd_hz");
+    if (stored && mountAt(csPin, spi, stored) && verifyProbeFile()) {
+        sdClockHz = stored;
+        LOGI("[SPI] SD clock %lu Hz (stored, verified)", (unsigned long)stored);
+        return true;
+    }
+
+    // The probe file is only ever written at the slowest clock. Faster clocks
+    // are tried read-only, so a clock that fails never gets to write the FAT.
+    LOGI("[SPI] Probing SD clock...");
+    uint32_t best = 0;
+    if (mountAt(csPin, spi, SD_CLOCKS[0]) && writeProbeFile() &&
+        probeSdClock(csPin, spi, SD_CLOCKS[0])) {
+        best = SD_CLOCKS[0];
+        for (size_t i = 1; i < SD_CLOCK_COUNT; i++) {
+            if (!probeSdClock(csPin, spi, SD_CLOCKS[i])) {
+                LOGE("[SPI] SD verification failed at %lu Hz", (unsigned long)SD_CLOCKS[i]);
+                break;
+            }
+            best = SD_CLOCKS[i];
+        }
+    }
+
+    if (best == 0) {
+        // No card, or the card can't be written (full, locked): mount at the
+        // library default like before and don't store anything
+        sdClockHz = SD_CLOCKS[0];
+        return mountAt(csPin, spi, SD_CLOCKS[0]);
+    }
+
+    if (!mountAt(csPin, spi, best)) return false;
+    sdClockHz = best;
+    storeClock("sd_hz", best);
+    LOGI("[SPI] SD clock %lu Hz", (unsigned long)best);
+    return true;
+}
+
+// ─── MCP3208 ────────────────────────────────────────────────────────────────
+
+// Datasheet: fCLK max 2.0 MHz at VDD = 5 V, 1.0 MHz at VDD = 2.7 V
+static uint32_t adcClockLimit(float vddVolts) {
+    if (vddVolts >= 5.0f) return 2000000;
+    if (vddVolts <= 2.7f) return 1000000;
+    return 1000000 + (uint32_t)((vddVolts - 2.7f) / (5.0f - 2.7f) * 1000000.0f);
+}
+
+// Interleave reads at the reference and test clocks so slow drift cancels out
+static bool adcMatchesReference(MCP3208& adc, uint32_t hz) {
+    for (size_t c = 0; c < sizeof(ADC_CHECK_CHANNELS); c++) {
+        uint8_t ch = ADC_CHECK_CHANNELS[c];
+        int32_t refSum = 0, testSum = 0;
+        for (int s = 0; s < ADC_CHECK_SAMPLES; s++) {
+            adc.setClock(ADC_REFERENCE_HZ);
+            refSum += adc.analogRead(ch);
+            adc.setClock(hz);
+            testSum += adc.analogRead(ch);
+        }
+        int32_t deviation = abs(testSum - refSum) / ADC_CHECK_SAMPLES;
+        if (deviation > ADC_MAX_DEVIATION) {
+            LOGD("[SPI] ADC ch%u off by %ld LSB at %lu Hz", ch, (long)deviation, (unsigned long)hz);
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t tuneAdcClock(MCP3208& adc, float vddVolts) {
+    uint32_t limit = adcClockLimit(vddVolts);
+
+    uint32_t chosen = 0;
+    uint32_t stored = loadStoredClock("adc_hz");
+    if (stored && stored <= limit && adcMatchesReference(adc, stored)) {
+        chosen = stored;
+    } else {
+        for (size_t i = 0; i < ADC_CLOCK_COUNT && !chosen; i++) {
+            if (ADC_CLOCKS[i] > limit) continue;
+            if (adcMatchesReference(adc, ADC_CLOCKS[i])) chosen = ADC_CLOCKS[i];
+        }
+        if (!chosen) {
+            LOGW("[SPI] No ADC clock matched the reference, staying at reference clock");
+            chosen = ADC_REFERENCE_HZ;
+        }
+        storeClock("adc_hz", chosen);
+    }
+
+    adc.setClock(chosen);
+    adcClockHz = chosen;
+    LOGI("[SPI] ADC clock %lu Hz (limit %lu Hz at %.2f V)",
+         (unsigned long)chosen, (unsigned long)limit, vddVolts);
+    return chosen;
+}
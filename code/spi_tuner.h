@@ -0,0 +1,28 @@
+#ifndef SPI_TUNER_H
+#define SPI_TUNER_H
+
+#include <Arduino.h>
+#include <SPI.h>
+#include "MCP3208.h"
+
+/*
+ * Startup SPI clock tuning for the shared bus (SD card + MCP3208).
+ *
+ * Board wiring differs, so the fastest reliable clock is measured rather than
+ * assumed. Results are kept in NVS (namespace "spi") and re-verified on every
+ * boot; a full probe only runs when the stored clock no longer verifies.
+ */
+
+// Mount the SD card at the fastest clock that reads back a probe file written
+// at the slowest one. Returns false if the card cannot be mounted at all.
+bool tuneSdClock(uint8_t csPin, SPIClass& spi = SPI);
+
+// Pick the fastest MCP3208 clock within the datasheet limit for vddVolts
+// whose conversions match a slow reference read, and apply it to adc.
+uint32_t tuneAdcClock(MCP3208& adc, float vddVolts);
+
+// Clocks in use (0 until tuned)
+uint32_t getSdClockHz();
+uint32_t getAdcClockHz();
+
+#endif
@@ -0,0 +1,220 @@
+#include "state_api.h"
+#include <ArduinoJson.h>
+#include <SD.h>
+#include <WiFi.h>
+#include <memory>
+#include "config_manager.h"
+#include "ota_handler.h"
+
+// Sensor readings from code.ino
+extern float pressureIn, pressureOut, flow;
+extern float ambientTemp, waterTemp;
+extern float currentL1, currentL2, currentL3, currentTotal;
+
+// Control flags from code.ino
+extern volatile bool motor, manualOverride, manualMotorState;
+extern volatile bool mainSwitch, error;
+
+static const char* GROUP_NAMES[STATE_GROUPS] = {
+    "sensors",
+    "control",
+    "system",
+    "config",
+    "ota",
+};
+
+static StateSnapshot snapshot;
+static portMUX_TYPE snapshotMux = portMUX_INITIALIZER_UNLOCKED;
+
+struct RenderedState {
+    uint8_t mask;
+    char    etag[64];
+    std::shared_ptr<String> body;
+};
+
+// Only touched from web handlers, which all run in the async_tcp task
+static RenderedState renderCache[STATE_RENDER_CACHE];
+static uint8_t renderNext = 0;
+static DynamicJsonDocument stateDoc(STATE_DOC_SIZE);
+
+static bool sameReading(float a, float b) {
+    return roundf(a * 100.0f) == roundf(b * 100.0f);
+}
+
+void updateStateSnapshot() {
+    StateSnapshot next;
+    next.pressureIn = pressureIn;
+    next.pressureOut = pressureOut;
+    next.flow = flow;
+    next.waterTemp = waterTemp;
+    next.ambientTemp = ambientTemp;
+    next.currentL1 = currentL1;
+    next.currentL2 = currentL2;
+    next.currentL3 = currentL3;
+    next.currentTotal = currentTotal;
+    next.uptime = millis() / 1000;
+    next.freeHeap = ESP.getFreeHeap();
+    next.rssi = WiFi.RSSI();
+    next.sdPresent = SD.cardType() != CARD_NONE;
+
+    portENTER_CRITICAL(&snapshotMux);
+    bool sensorsChanged =
+        !sameReading(next.pressureIn, snapshot.pressureIn) ||
+        !sameReading(next.pressureOut, snapshot.pressureOut) ||
+        !sameReading(next.flow, snapshot.flow) ||
+        !sameReading(next.waterTemp, snapshot.waterTemp) ||
+        !sameReading(next.ambientTemp, snapshot.ambientTemp) ||
+        !sameReading(next.currentL1, snapshot.currentL1) ||
+        !sameReading(next.currentL2, snapshot.currentL2) ||
+        !sameReading(next.currentL3, snapshot.currentL3) ||
+        !sameReading(next.currentTotal, snapshot.currentTotal);
+    next.sensorsVersion = snapshot.sensorsVersion + (sensorsChanged ? 1 : 0);
+    next.systemVersion = snapshot.systemVersion + 1;
+    snapshot = next;
+    portEXIT_CRITICAL(&snapshotMux);
+}
+
+StateSnapshot getStateSnapshot() {
+    StateSnapshot snap;
+    portENTER_CRITICAL(&snapshotMux);
+    snap = snapshot;
+    portEXIT_CRITICAL(&snapshotMux);
+    return snap;
+}
+
+static uint8_t controlBits() {
+    return (motor ? 0x01 : 0) | (manualOverride ? 0x02 : 0) | (manualMotorState ? 0x04 : 0) |
+           (mainSwitch ? 0x08 : 0) | (error ? 0x10 : 0);
+}
+
+static uint8_t parseFields(const String& list) {
+    uint8_t mask = 0;
+    int start = 0;
+    while (start <= (int)list.length()) {
+        int comma = list.indexOf(',', start);
+        if (comma < 0) comma = list.length();
+        String name = list.substring(start, comma);
+        name.trim();
+        for (int g = 0; g < STATE_GROUPS; g++) {
+            if (name == GROUP_NAMES[g]) mask |= (1 << g);
+        }
+        start = comma + 1;
+    }
+    return mask;
+}
+
+// ETag from the versions of the selected groups only
+static void buildEtag(uint8_t mask, const StateSnapshot& snap, char* etag, size_t size) {
+    int n = snprintf(etag, size, "\"%02x", mask);
+    if (mask & STATE_SENSORS) n += snprintf(etag + n, size - n, "-%lx", (unsigned long)snap.sensorsVersion);
+    if (mask & STATE_CONTROL) n += snprintf(etag + n, size - n, "-%x", controlBits());
+    if (mask & STATE_SYSTEM)  n += snprintf(etag + n, size - n, "-%lx", (unsigned long)snap.systemVersion);
+    if (mask & STATE_CONFIG)  n += snprintf(etag + n, size - n, "-%lx", (unsigned long)configVersion());
+    if (mask & STATE_OTA)     n += snprintf(etag + n, size - n, "-%x.%x", (unsigned)OTA.getStatus(), OTA.getProgress());
+    snprintf(etag + n, size - n, "\"");
+}
+
+static std::shared_ptr<String> renderState(uint8_t mask, const StateSnapshot& snap) {
+    stateDoc.clear();
+
+    if (mask & STATE_SENSORS) {
+        JsonObject sensors = stateDoc.createNestedObject("sensors");
+        sensors["pressure_in"] = snap.pressureIn;
+        sensors["pressure_out"] = snap.pressureOut;
+        sensors["flow"] = snap.flow;
+        sensors["temp_water"] = snap.waterTemp;
+        sensors["temp_ambient"] = snap.ambientTemp;
+        sensors["current_l1"] = snap.currentL1;
+        sensors["current_l2"] = snap.currentL2;
+        sensors["current_l3"] = snap.currentL3;
+        sensors["current_total"] = snap.currentTotal;
+    }
+    if (mask & STATE_CONTROL) {
+        JsonObject control = stateDoc.createNestedObject("control");
+        control["motor"] = (bool)motor;
+        control["manual_override"] = (bool)manualOverride;
+        control["manual_motor_state"] = (bool)manualMotorState;
+        control["main_switch"] = (bool)mainSwitch;
+        control["error"] = (bool)error;
+    }
+    if (mask & STATE_SYSTEM) {
+        JsonObject system = stateDoc.createNestedObject("system");
+        system["uptime"] = snap.uptime;
+        system["free_heap"] = snap.freeHeap;
+        system["wifi_rssi"] = snap.rssi;
+        system["sd_present"] = snap.sdPresent;
+    }
+    if (mask & STATE_CONFIG) {
+        addPublicConfigFields(stateDoc.createNestedObject("config"));
+    }
+    if (mask & STATE_OTA) {
+        JsonObject ota = stateDoc.createNestedObject("ota");
+        ota["status"] = OTA.getErrorString(OTA.getStatus());
+        ota["progress"] = OTA.getProgress();
+        ota["is_updating"] = OTA.isUpdating();
+    }
+
+    std::shared_ptr<String> body = std::make_shared<String>();
+    body->reserve(measureJson(stateDoc) + 1);
+    serializeJson(stateDoc, *body);
+    return body;
+}
+
+bool StateHandler::canHandle(AsyncWebServerRequest *request) {
+    if (request->method() != HTTP_GET || request->url() != "/api/state") return false;
+    request->addInterestingHeader("If-None-Match");
+    return true;
+}
+
+void StateHandler::handleRequest(AsyncWebServerRequest *request) {
+    uint8_t mask = STATE_ALL;
+    if (request->hasParam("fields")) {
+        mask = parseFields(request->getParam("fields")->value());
+        if (mask == 0) {
+            request->send(400, "application/json", "{\"error\":\"Unknown fields\"}");
+            return;
+        }
+    }
+
+    StateSnapshot snap = getStateSnapshot();
+
+    char etag[64];
+    buildEtag(mask, snap, etag, sizeof(etag));
+
+    AsyncWebServerResponse *response;
+    if (request->hasHeader("If-None-Match") && request->getHeader("If-None-Match")->value() == etag) {
+        response = request->beginResponse(304);
+    } else {
+        // Reuse the body rendered for this selection if its version still matches
+        RenderedState* slot = nullptr;
+        for (RenderedState& cached : renderCache) {
+            if (cached.body && cached.mask == mask) {
+                slot = &cached;
+                break;
+            }
+        }
+        std::shared_ptr<String> body;
+        if (slot && strcmp(slot->etag, etag) == 0) {
+            body = slot->body;
+        } else {
+            body = renderState(mask, snap);
+            if (!slot) {
+                slot = &renderCache[renderNext];
+                renderNext = (renderNext + 1) % STATE_RENDER_CACHE;
+            }
+            slot->mask = mask;
+            strlcpy(slot->etag, etag, sizeof(slot->etag));
+            slot->body = body;
+        }
+        response = request->beginResponse("application/json", body->length(),
+            [body](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+                size_t n = min(maxLen, body->length() - index);
+                memcpy(buffer, body->c_str() + index, n);
+                return n;
+            });
+    }
+
+    response->addHeader("ETag", etag);
+    response->addHeader("Cache-Control", "no-cache");
+    request->send(response);
+}
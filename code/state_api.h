@@ -0,0 +1,61 @@
+#ifndef STATE_API_H
+#define STATE_API_H
+
+#include <ESPAsyncWebServer.h>
+
+// Field groups for /api/state?fields=sensors,control
+#define STATE_SENSORS   0x01
+#define STATE_CONTROL   0x02
+#define STATE_SYSTEM    0x04
+#define STATE_CONFIG    0x08
+#define STATE_OTA       0x10
+#define STATE_ALL       0x1F
+#define STATE_GROUPS    5
+
+// Distinct field selections whose rendered bodies are kept
+#define STATE_RENDER_CACHE 4
+// Serialization document, reused for every render
+#define STATE_DOC_SIZE     2560
+
+/**
+ * GET /api/state[?fields=sensors,control,system,config,ota]
+ *
+ * One snapshot of everything the separate status endpoints report. Each
+ * group has its own version and the ETag covers only the selected groups, so
+ * a poller of "sensors" gets 304 until a reading changes. Rendered bodies are
+ * shared by all requests until their version moves on.
+ */
+class StateHandler : public AsyncWebHandler {
+public:
+    bool canHandle(AsyncWebServerRequest *request) override;
+    void handleRequest(AsyncWebServerRequest *request) override;
+};
+
+// Readings as of the last measurement cycle
+struct StateSnapshot {
+    float    pressureIn;
+    float    pressureOut;
+    float    flow;
+    float    waterTemp;
+    float    ambientTemp;
+    float    currentL1;
+    float    currentL2;
+    float    currentL3;
+    float    currentTotal;
+
+    uint32_t uptime;
+    uint32_t freeHeap;
+    int8_t   rssi;
+    bool     sdPresent;
+
+    uint32_t sensorsVersion;    // bumped when a reading changes at 0.01 resolution
+    uint32_t systemVersion;     // bumped every cycle (uptime)
+};
+
+// Capture the latest readings; called from loop() after each measurement cycle
+void updateStateSnapshot();
+
+// Copy of the latest snapshot, from any task; never touches the ADC or SD
+StateSnapshot getStateSnapshot();
+
+#endif
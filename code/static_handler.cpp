@@ -0,0 +1,149 @@
+#include "static_handler.h"
+#include "asset_cache.h"
+#include <SD.h>
+
+struct StaticAlias {
+    const char* url;
+    const char* path;
+};
+
+// URLs that don't map 1:1 to a file on SD
+static const StaticAlias STATIC_ALIASES[] = {
+    { "/",            "/index.html" },
+    { "/index.htm",   "/index.html" },
+};
+
+struct ContentTypeEntry {
+    const char* ext;
+    const char* type;
+};
+
+// Servable extensions; anything else is left to the other handlers
+static const ContentTypeEntry CONTENT_TYPES[] = {
+    { ".html",  "text/html" },
+    { ".htm",   "text/html" },
+    { ".js",    "application/javascript" },
+    { ".css",   "text/css" },
+    { ".json",  "application/json" },
+    { ".csv",   "text/csv" },
+    { ".txt",   "text/plain" },
+    { ".svg",   "image/svg+xml" },
+    { ".png",   "image/png" },
+    { ".jpg",   "image/jpeg" },
+    { ".ico",   "image/x-icon" },
+    { ".woff2", "font/woff2" },
+    { ".webmanifest", "application/manifest+json" },
+};
+
+// Never served: the config and its copies hold credentials. FAT matches
+// names case-insensitively, so "/Config.json" opens the same file.
+static bool isBlocked(const String& url) {
+    String lower = url;
+    lower.toLowerCase();
+    // OTAHandler::createConfigBackup() writes /backup/config_<millis>.json
+    if (lower.startsWith("/backup/")) return true;
+    String name = lower.substring(lower.lastIndexOf('/') + 1);
+    return name.startsWith("config") && (name.endsWith(".json") || name.endsWith(".tmp"));
+}
+
+const char* contentTypeFor(const String& path) {
+    for (const ContentTypeEntry& entry : CONTENT_TYPES) {
+        if (path.endsWith(entry.ext)) return entry.type;
+    }
+    return nullptr;
+}
+
+// Map a request URL to an SD path; empty if this handler shouldn't serve it
+static String resolvePath(const String& url) {
+    for (const StaticAlias& alias : STATIC_ALIASES) {
+        if (url == alias.url) return alias.path;
+    }
+    if (!url.startsWith("/") || url.startsWith("/api/")) return String();
+    if (url.indexOf("/.") >= 0 || url.indexOf("..") >= 0) return String();  // dotfiles, traversal
+    if (isBlocked(url)) return String();
+    if (!contentTypeFor(url)) return String();
+    return url;
+}
+
+static bool acceptsGzip(AsyncWebServerRequest *request) {
+    if (!request->hasHeader("Accept-Encoding")) return false;
+    return request->getHeader("Accept-Encoding")->value().indexOf("gzip") >= 0;
+}
+
+static void addCachingHeaders(AsyncWebServerRequest *request, AsyncWebServerResponse *response,
+                              const String& etag, bool gzipped) {
+    response->addHeader("ETag", etag);
+    response->addHeader("Cache-Control", request->hasParam("v") ? STATIC_MAX_AGE_VERSIONED : STATIC_CACHE_DEFAULT);
+    response->addHeader("Vary", "Accept-Encoding");
+    if (gzipped) response->addHeader("Content-Encoding", "gzip");
+}
+
+static bool etagMatches(AsyncWebServerRequest *request, const String& etag) {
+    return request->hasHeader("If-None-Match") &&
+           request->getHeader("If-None-Match")->value() == etag;
+}
+
+bool sendStaticAsset(AsyncWebServerRequest *request, const char* path) {
+    const char* contentType = contentTypeFor(path);
+    if (!contentType) contentType = "application/octet-stream";
+
+    // Prefer the precompressed sibling; the lookup is answered from the
+    // cache, including "doesn't exist", after the first request
+    AssetRef asset;
+    bool gzipped = false;
+    if (acceptsGzip(request)) {
+        asset = assetCache.get((String(path) + ".gz").c_str());
+        gzipped = asset && asset->exists;
+    }
+    if (!gzipped) asset = assetCache.get(path);
+    if (!asset || !asset->exists) return false;
+
+    char etag[32];
+    File file;
+    if (asset->data) {
+        snprintf(etag, sizeof(etag), "\"%x-%08lx%s\"", (unsigned)asset->size,
+                 (unsigned long)asset->hash, gzipped ? "-gz" : "");
+    } else {
+        // Too large to hold in RAM: stream it, tagged by the file's current stamp
+        file = SD.open(asset->path, FILE_READ);
+        if (!file) return false;
+        snprintf(etag, sizeof(etag), "\"%x-%lx%s\"", (unsigned)file.size(),
+                 (unsigned long)file.getLastWrite(), gzipped ? "-gz" : "");
+    }
+
+    AsyncWebServerResponse *response;
+    if (etagMatches(request, etag)) {
+        if (file) file.close();
+        response = request->beginResponse(304);
+    } else if (asset->data) {
+        response = request->beginResponse(contentType, asset->size,
+            [asset](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+                size_t n = min(maxLen, asset->size - index);
+                memcpy(buffer, asset->data + index, n);
+                return n;
+            });
+    } else {
+        response = request->beginResponse(file, asset->path, contentType);
+    }
+
+    addCachingHeaders(request, response, etag, gzipped);
+    request->send(response);
+    return true;
+}
+
+bool StaticAssetHandler::canHandle(AsyncWebServerRequest *request) {
+    if (request->method() != HTTP_GET) return false;
+    if (resolvePath(request->url()).isEmpty()) return false;
+
+    // Headers are discarded after routing unless a handler asks for them
+    request->addInterestingHeader("Accept-Encoding");
+    request->addInterestingHeader("If-None-Match");
+    return true;
+}
+
+void StaticAssetHandler::handleRequest(AsyncWebServerRequest *request) {
+    String path = resolvePath(request->url());
+    if (!sendStaticAsset(request, path.c_str())) {
+        request->send(404, "text/plain", path.substring(1) + " not found on SD card");
+    }
+}
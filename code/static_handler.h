@@ -0,0 +1,33 @@
+#ifndef STATIC_HANDLER_H
+#define STATIC_HANDLER_H
+
+#include <ESPAsyncWebServer.h>
+
+// Cache-Control for "?v=" requests (the URL changes with the content)
+#define STATIC_MAX_AGE_VERSIONED "public, max-age=31536000, immutable"
+// Everything else: keep a copy but revalidate with the ETag every time
+#define STATIC_CACHE_DEFAULT     "no-cache"
+
+/**
+ * Single handler for the web UI files on SD.
+ *
+ * URLs resolve through an alias table ("/" → /index.html) or map 1:1 to SD
+ * paths; the content type comes from the file extension. When the client
+ * accepts gzip and a ".gz" sibling exists it is sent instead. Responses carry
+ * an ETag (content hash for cached bodies, size + mtime for large files) and
+ * a matching If-None-Match is answered with 304.
+ */
+class StaticAssetHandler : public AsyncWebHandler {
+public:
+    bool canHandle(AsyncWebServerRequest *request) override;
+    void handleRequest(AsyncWebServerRequest *request) override;
+};
+
+// Send an SD file with the handler's compression and caching rules.
+// Returns false (nothing sent) if the file does not exist.
+bool sendStaticAsset(AsyncWebServerRequest *request, const char* path);
+
+// Content type for a path, by extension; nullptr if not a servable type
+const char* contentTypeFor(const String& path);
+
+#endif
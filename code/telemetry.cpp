@@ -0,0 +1,170 @@
+#include "telemetry.h"
+#include <ArduinoJson.h>
+#include "logger.h"
+#include "latency_trace.h"
+#include "metrics.h"
+
+// Global instance
+TelemetryStream telemetry;
+
+TelemetryStream::TelemetryStream() :
+    ws(TELEMETRY_PATH),
+    sampler(nullptr),
+    slotMux(portMUX_INITIALIZER_UNLOCKED),
+    seq(0),
+    framesSent(0),
+    framesDropped(0) {
+    memset(slots, 0, sizeof(slots));
+}
+
+void TelemetryStream::begin(AsyncWebServer& server, TelemetrySampler samplerFn) {
+    sampler = samplerFn;
+    ws.onEvent([this](AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type,
+                      void* arg, uint8_t* data, size_t len) {
+        onEvent(client, type, arg, data, len);
+    });
+    server.addHandler(&ws);
+    metricsRoutes({ TELEMETRY_PATH });
+
+    // Core 1 alongside loop(), one priority above it so ticks stay evenly spaced;
+    // each tick is two ADC conversions and a few small sends
+    xTaskCreatePinnedToCore(taskEntry, "telemetry", 4096, this, 2, NULL, 1);
+    LOGI("[Telemetry] Streaming on %s (up to %d Hz)", TELEMETRY_PATH, TELEMETRY_MAX_HZ);
+}
+
+size_t TelemetryStream::getClientCount() {
+    return ws.count();
+}
+
+void TelemetryStream::onEvent(AsyncWebSocketClient* client, AwsEventType type, void* arg,
+                              uint8_t* data, size_t len) {
+    if (type == WS_EVT_CONNECT) {
+        bool placed = false;
+        portENTER_CRITICAL(&slotMux);
+        for (ClientSlot& slot : slots) {
+            if (slot.id == 0) {
+                slot.id = client->id();
+                slot.rateHz = TELEMETRY_DEFAULT_HZ;
+                slot.intervalMs = 1000 / TELEMETRY_DEFAULT_HZ;
+                slot.nextDue = millis();
+                placed = true;
+                break;
+            }
+        }
+        portEXIT_CRITICAL(&slotMux);
+
+        if (!placed) {
+            client->close(1013, "Too many telemetry clients");
+            return;
+        }
+
+        // Tell the decoder what it's about to receive
+        char hello[96];
+        snprintf(hello, sizeof(hello), "{\"version\":%d,\"frame_size\":%u,\"rate\":%d,\"max_rate\":%d}",
+                 TELEMETRY_FRAME_VERSION, (unsigned)sizeof(TelemetryFrame),
+                 TELEMETRY_DEFAULT_HZ, TELEMETRY_MAX_HZ);
+        client->text(hello);
+        LOGI("[Telemetry] Client %u connected", client->id());
+
+    } else if (type == WS_EVT_DISCONNECT) {
+        portENTER_CRITICAL(&slotMux);
+        for (ClientSlot& slot : slots) {
+            if (slot.id == client->id()) slot.id = 0;
+        }
+        portEXIT_CRITICAL(&slotMux);
+        LOGI("[Telemetry] Client %u disconnected", client->id());
+
+    } else if (type == WS_EVT_DATA) {
+        // Only whole, single-frame text messages: {"rate":N}
+        AwsFrameInfo* info = (AwsFrameInfo*)arg;
+        if (!info->final || info->index != 0 || info->len != len || info->opcode != WS_TEXT) return;
+
+        StaticJsonDocument<64> doc;
+        if (deserializeJson(doc, data, len)) return;
+        if (doc.containsKey("rate")) setRate(client->id(), doc["rate"].as<int>());
+    }
+}
+
+void TelemetryStream::setRate(uint32_t clientId, int hz) {
+    hz = constrain(hz, 1, TELEMETRY_MAX_HZ);
+    portENTER_CRITICAL(&slotMux);
+    for (ClientSlot& slot : slots) {
+        if (slot.id == clientId) {
+            slot.rateHz = hz;
+            slot.intervalMs = 1000 / hz;
+            slot.nextDue = millis();
+        }
+    }
+    portEXIT_CRITICAL(&slotMux);
+}
+
+void TelemetryStream::tick() {
+    uint32_t now = millis();
+
+    // Pick the clients due this tick; sends happen outside the spinlock
+    uint32_t dueIds[TELEMETRY_MAX_CLIENTS];
+    uint16_t dueRates[TELEMETRY_MAX_CLIENTS];
+    size_t dueCount = 0;
+
+    portENTER_CRITICAL(&slotMux);
+    for (ClientSlot& slot : slots) {
+        if (slot.id == 0 || (int32_t)(now - slot.nextDue) < 0) continue;
+        slot.nextDue += slot.intervalMs;
+        // Don't burst to catch up after a stall
+        if ((int32_t)(now - slot.nextDue) >= 0) slot.nextDue = now + slot.intervalMs;
+        dueIds[dueCount] = slot.id;
+        dueRates[dueCount] = slot.rateHz;
+        dueCount++;
+    }
+    portEXIT_CRITICAL(&slotMux);
+
+    seq++;
+    if (dueCount == 0) return;
+
+    uint32_t sampledUs = micros();
+    TelemetryFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.version = TELEMETRY_FRAME_VERSION;
+    frame.seq = seq;
+    frame.timestampMs = now;
+    if (sampler) sampler(frame);
+
+    bool sent = false;
+    for (size_t i = 0; i < dueCount; i++) {
+        // Backpressure: drop rather than queue behind a slow client
+        if (!ws.availableForWrite(dueIds[i])) {
+            framesDropped++;
+            continue;
+        }
+        frame.rateHz = dueRates[i];
+        ws.binary(dueIds[i], (const uint8_t*)&frame, sizeof(frame));
+        framesSent++;
+        sent = true;
+    }
+    // The WebSocket samples its own ADC reads, so it carries its own stamp
+    if (sent) telemetrySent(PATH_TLM_WS, sampledUs);
+}
+
+void TelemetryStream::taskEntry(void* param) {
+    TelemetryStream* self = (TelemetryStream*)param;
+    const TickType_t period = pdMS_TO_TICKS(1000 / TELEMETRY_MAX_HZ);
+    TickType_t lastWake = xTaskGetTickCount();
+    uint32_t lastCleanup = 0;
+
+    for (;;) {
+        if (self->ws.count() == 0) {
+            // Nobody listening: don't touch the ADC
+            vTaskDelay(pdMS_TO_TICKS(250));
+            lastWake = xTaskGetTickCount();
+            continue;
+        }
+
+        self->tick();
+
+        if (millis() - lastCleanup >= 1000) {
+            lastCleanup = millis();
+            self->ws.cleanupClients(TELEMETRY_MAX_CLIENTS);
+        }
+        vTaskDelayUntil(&lastWake, period);
+    }
+}
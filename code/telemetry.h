@@ -0,0 +1,87 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+#define TELEMETRY_PATH          "/ws/telemetry"
+#define TELEMETRY_FRAME_VERSION 1
+#define TELEMETRY_MAX_HZ        50
+#define TELEMETRY_DEFAULT_HZ    10
+#define TELEMETRY_MAX_CLIENTS   4
+
+// Frame flags
+#define TLM_FLAG_MOTOR          0x01
+#define TLM_FLAG_ERROR          0x02
+#define TLM_FLAG_MAIN_SWITCH    0x04
+#define TLM_FLAG_MANUAL         0x08
+
+/*
+ * One binary WebSocket message. Little-endian, no padding; sd/telemetry.js
+ * decodes the same layout, so bump TELEMETRY_FRAME_VERSION on any change.
+ */
+struct __attribute__((packed)) TelemetryFrame {
+    uint8_t  version;
+    uint8_t  flags;         // TLM_FLAG_*
+    uint16_t rateHz;        // rate this client is being sent
+    uint32_t seq;           // sampler tick; gaps mean dropped frames
+    uint32_t timestampMs;   // millis() at sampling
+    float    pressureIn;    // bar, sampled every tick
+    float    pressureOut;   // bar, sampled every tick
+    float    flow;          // L/min, from the 1 s measurement cycle
+    float    waterTemp;     // °C
+    float    ambientTemp;   // °C
+    float    currentL1;     // A RMS, from the 1 s measurement cycle
+    float    currentL2;
+    float    currentL3;
+    float    currentTotal;
+};
+
+// Fills the channel fields of a frame; runs on the telemetry task
+typedef void (*TelemetrySampler)(TelemetryFrame& frame);
+
+/**
+ * High-rate binary telemetry over WebSocket.
+ *
+ * A sampler task ticks at TELEMETRY_MAX_HZ while at least one client is
+ * connected. Each client picks its own rate by sending {"rate":N}; a client
+ * whose send queue is full has frames dropped rather than queued, so a slow
+ * link never delays the others or grows memory.
+ */
+class TelemetryStream {
+public:
+    TelemetryStream();
+
+    void begin(AsyncWebServer& server, TelemetrySampler sampler);
+
+    size_t   getClientCount();
+    uint32_t getFramesSent() const { return framesSent; }
+    uint32_t getFramesDropped() const { return framesDropped; }
+
+private:
+    struct ClientSlot {
+        uint32_t id;            // 0 = free
+        uint16_t rateHz;
+        uint32_t intervalMs;
+        uint32_t nextDue;
+    };
+
+    AsyncWebSocket   ws;
+    TelemetrySampler sampler;
+    ClientSlot       slots[TELEMETRY_MAX_CLIENTS];
+    portMUX_TYPE     slotMux;
+    uint32_t         seq;
+    uint32_t         framesSent;
+    uint32_t         framesDropped;
+
+    void onEvent(AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len);
+    void setRate(uint32_t clientId, int hz);
+    void tick();
+
+    static void taskEntry(void* param);
+};
+
+// Global instance
+extern TelemetryStream telemetry;
+
+#endif
@@ -0,0 +1,153 @@
+#include "telemetry_batch.h"
+#include "config_manager.h"
+#include "mqtt_handler.h"
+#include "pump_cluster.h"
+
+// Global instance
+TelemetryBatcher telemetryBatch;
+
+// Channel names, in the order the values follow dt and flags in a sample
+static const char* const CHANNELS[TLM_BATCH_CHANNELS] = {
+    "p_in", "p_out", "flow", "t_water", "t_amb", "i_l1", "i_l2", "i_l3", "i_total"
+};
+
+// ─── MessagePack writers (big-endian, return bytes written) ─────────────────
+
+static size_t mpUint(uint8_t* p, uint32_t v) {
+    if (v < 0x80) {
+        p[0] = v;
+        return 1;
+    }
+    if (v <= 0xFF) {
+        p[0] = 0xcc; p[1] = v;
+        return 2;
+    }
+    if (v <= 0xFFFF) {
+        p[0] = 0xcd; p[1] = v >> 8; p[2] = v;
+        return 3;
+    }
+    p[0] = 0xce; p[1] = v >> 24; p[2] = v >> 16; p[3] = v >> 8; p[4] = v;
+    return 5;
+}
+
+static size_t mpFloat(uint8_t* p, float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    p[0] = 0xca; p[1] = bits >> 24; p[2] = bits >> 16; p[3] = bits >> 8; p[4] = bits;
+    return 5;
+}
+
+// Short strings only (fixstr, up to 31 bytes)
+static size_t mpStr(uint8_t* p, const char* s) {
+    size_t n = strlen(s);
+    p[0] = 0xa0 | n;
+    memcpy(p + 1, s, n);
+    return n + 1;
+}
+
+// ─── Batcher ────────────────────────────────────────────────────────────────
+
+TelemetryBatcher::TelemetryBatcher() :
+    sampler(nullptr),
+    len(0),
+    countPos(0),
+    count(0),
+    rateHz(0),
+    seq(0),
+    t0(0),
+    batchesSent(0),
+    batchesDropped(0) {
+    topic[0] = '\0';
+}
+
+void TelemetryBatcher::begin(TelemetrySampler samplerFn) {
+    sampler = samplerFn;
+
+    // Same core and priority as the WebSocket sampler; idle while disabled
+    xTaskCreatePinnedToCore(taskEntry, "tlm_batch", 3072, this, 2, NULL, 1);
+}
+
+void TelemetryBatcher::addSample(uint16_t hz) {
+    TelemetryFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.timestampMs = millis();
+    if (sampler) sampler(frame);
+
+    if (len == 0) {
+        // Open a batch: the header, then an array16 whose length is patched in flush()
+        rateHz = hz;
+        t0 = frame.timestampMs;
+        count = 0;
+        uint8_t* p = buf;
+        *p++ = 0x86;                            // fixmap, 6 entries
+        p += mpStr(p, "v");   p += mpUint(p, TLM_BATCH_VERSION);
+        p += mpStr(p, "seq"); p += mpUint(p, seq);
+        p += mpStr(p, "t0");  p += mpUint(p, t0);
+        p += mpStr(p, "hz");  p += mpUint(p, hz);
+        p += mpStr(p, "ch");
+        *p++ = 0x90 | TLM_BATCH_CHANNELS;       // fixarray
+        for (const char* name : CHANNELS) p += mpStr(p, name);
+        p += mpStr(p, "s");
+        *p++ = 0xdc;                            // array16
+        countPos = p - buf;
+        p += 2;
+        len = p - buf;
+    }
+
+    const float values[TLM_BATCH_CHANNELS] = {
+        frame.pressureIn, frame.pressureOut, frame.flow, frame.waterTemp, frame.ambientTemp,
+        frame.currentL1, frame.currentL2, frame.currentL3, frame.currentTotal
+    };
+    uint8_t* p = buf + len;
+    *p++ = 0x90 | (2 + TLM_BATCH_CHANNELS);
+    p += mpUint(p, frame.timestampMs - t0);
+    p += mpUint(p, frame.flags);
+    for (float v : values) p += mpFloat(p, v);
+    len = p - buf;
+    count++;
+    seq++;
+}
+
+void TelemetryBatcher::flush() {
+    if (len == 0) return;
+    buf[countPos] = count >> 8;
+    buf[countPos + 1] = count;
+    // Per batch: the ID changes when cluster mode is switched
+    snprintf(topic, sizeof(topic), "homeassistant/%s/telemetry", clusterDeviceId());
+    if (mqttEnqueue(topic, buf, len, 0)) batchesSent++;
+    else batchesDropped++;
+    len = 0;
+}
+
+void TelemetryBatcher::taskEntry(void* param) {
+    TelemetryBatcher* self = (TelemetryBatcher*)param;
+    TickType_t lastWake = xTaskGetTickCount();
+
+    for (;;) {
+        int hz, windowMs;
+        {
+            ConfigGuard cfg;
+            hz = cfg->mqtt_batch_hz;
+            windowMs = cfg->mqtt_batch_window_ms;
+        }
+
+        if (hz <= 0 || !isMqttConfigured()) {
+            // Disabled: drop a partial batch and leave the ADC alone
+            self->len = 0;
+            vTaskDelay(pdMS_TO_TICKS(500));
+            lastWake = xTaskGetTickCount();
+            continue;
+        }
+        hz = min(hz, TELEMETRY_MAX_HZ);
+
+        // A window ends before the sample that would overrun it, so batches
+        // hold windowMs × hz samples; a rate change starts a new one
+        if (self->len && ((int)(millis() - self->t0) >= windowMs || hz != self->rateHz)) {
+            self->flush();
+        }
+        self->addSample(hz);
+        if (self->len + TLM_BATCH_ROW_MAX > TLM_BATCH_MAX_BYTES) self->flush();
+
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(1000 / hz));
+    }
+}
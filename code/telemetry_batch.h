@@ -0,0 +1,60 @@
+#ifndef TELEMETRY_BATCH_H
+#define TELEMETRY_BATCH_H
+
+#include <Arduino.h>
+#include "telemetry.h"
+#include "mqtt_outbox.h"
+
+#define TLM_BATCH_VERSION   1
+#define TLM_BATCH_CHANNELS  9
+// Largest encoded sample: fixarray, uint32 dt, flags, 9 × float32
+#define TLM_BATCH_ROW_MAX   (1 + 5 + 1 + TLM_BATCH_CHANNELS * 5)
+// Payload room left in an outbox message after the topic
+#define TLM_BATCH_MAX_BYTES (MQTT_MAX_MESSAGE - 64)
+
+/*
+ * Batched telemetry over MQTT, on homeassistant/<device>/telemetry.
+ *
+ * Samples every channel at mqtt_batch_hz and publishes one MessagePack map
+ * per mqtt_batch_window_ms, or sooner when a message is full:
+ *
+ *   { "v": 1, "seq": <first sample>, "t0": <millis of first sample>,
+ *     "hz": <rate>, "ch": ["p_in", "p_out", "flow", ...],
+ *     "s": [[dt_ms, flags, p_in, p_out, flow, ...], ...] }
+ *
+ * dt_ms is relative to t0, flags are TLM_FLAG_*, channel values float32 in
+ * the order of "ch". tools/decode_telemetry.py decodes it. Batches aren't
+ * durable: while the broker is away they are dropped, not spooled.
+ */
+class TelemetryBatcher {
+public:
+    TelemetryBatcher();
+
+    void begin(TelemetrySampler sampler);
+
+    uint32_t getBatchesSent() const { return batchesSent; }
+    uint32_t getBatchesDropped() const { return batchesDropped; }
+
+private:
+    TelemetrySampler sampler;
+    char     topic[64];
+    uint8_t  buf[TLM_BATCH_MAX_BYTES];
+    size_t   len;               // bytes encoded so far, 0 = no open batch
+    size_t   countPos;          // offset of the "s" array length
+    uint16_t count;
+    uint16_t rateHz;
+    uint32_t seq;
+    uint32_t t0;
+    uint32_t batchesSent;
+    uint32_t batchesDropped;
+
+    void addSample(uint16_t hz);
+    void flush();
+
+    static void taskEntry(void* param);
+};
+
+// Global instance
+extern TelemetryBatcher telemetryBatch;
+
+#endif
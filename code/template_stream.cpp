@@ -0,0 +1,168 @@
+#include "template_stream.h"
+#include <memory>
+
+// Render state for one response; owned by the response's filler callback
+struct TemplateStream {
+    File        file;           // SD source, or
+    const char* flash;          // flash source
+    size_t      flashLen;
+    size_t      flashPos;
+
+    const TemplateVar* vars;
+    size_t      varCount;
+
+    uint8_t     block[TEMPLATE_BLOCK];
+    size_t      blockLen;
+    size_t      blockPos;
+    bool        sourceDone;
+
+    // Placeholder being collected after a '%'
+    bool        inName;
+    char        name[TEMPLATE_MAX_NAME + 2];
+    uint8_t     nameLen;
+
+    // Output queued for the next fill: a substituted value or unmatched text
+    const char* out;
+    size_t      outLen;
+    char        literal[TEMPLATE_MAX_NAME + 2];
+
+    // Character to process again after flushing an unmatched '%...'
+    int         carry;
+
+    TemplateStream() :
+        flash(nullptr), flashLen(0), flashPos(0),
+        vars(nullptr), varCount(0),
+        blockLen(0), blockPos(0), sourceDone(false),
+        inName(false), nameLen(0),
+        out(nullptr), outLen(0),
+        carry(-1) {}
+
+    ~TemplateStream() {
+        if (file) file.close();
+    }
+
+    // Next source byte, or -1 at the end
+    int next() {
+        if (carry >= 0) {
+            int c = carry;
+            carry = -1;
+            return c;
+        }
+        if (blockPos >= blockLen) {
+            if (sourceDone) return -1;
+            if (flash) {
+                blockLen = min(sizeof(block), flashLen - flashPos);
+                memcpy_P(block, flash + flashPos, blockLen);
+                flashPos += blockLen;
+            } else {
+                blockLen = file.read(block, sizeof(block));
+            }
+            blockPos = 0;
+            if (blockLen == 0) {
+                sourceDone = true;
+                return -1;
+            }
+        }
+        return block[blockPos++];
+    }
+
+    // Queue "%name" as plain text (the placeholder didn't match)
+    void emitUnmatched() {
+        literal[0] = '%';
+        memcpy(literal + 1, name, nameLen);
+        out = literal;
+        outLen = nameLen + 1;
+        inName = false;
+        nameLen = 0;
+    }
+
+    const char* lookup() {
+        name[nameLen] = '\0';
+        for (size_t i = 0; i < varCount; i++) {
+            if (strcmp(vars[i].name, name) == 0) return vars[i].value ? vars[i].value : "";
+        }
+        return nullptr;
+    }
+
+    size_t fill(uint8_t* buffer, size_t maxLen) {
+        size_t written = 0;
+        while (written < maxLen) {
+            if (outLen > 0) {
+                size_t n = min(outLen, maxLen - written);
+                memcpy(buffer + written, out, n);
+                out += n;
+                outLen -= n;
+                written += n;
+                continue;
+            }
+
+            int c = next();
+            if (c < 0) {
+                if (inName) {
+                    emitUnmatched();
+                    continue;
+                }
+                break;
+            }
+
+            if (!inName) {
+                if (c == '%') {
+                    inName = true;
+                    nameLen = 0;
+                } else {
+                    buffer[written++] = (uint8_t)c;
+                }
+                continue;
+            }
+
+            if (c == '%') {
+                const char* value = lookup();
+                if (value) {
+                    out = value;
+                    outLen = strlen(value);
+                    inName = false;
+                    nameLen = 0;
+                } else {
+                    // Not one of ours; the closing '%' may open the next one
+                    emitUnmatched();
+                    carry = c;
+                }
+            } else if ((isupper(c) || isdigit(c) || c == '_') && nameLen < TEMPLATE_MAX_NAME) {
+                name[nameLen++] = (char)c;
+            } else {
+                emitUnmatched();
+                carry = c;
+            }
+        }
+        return written;
+    }
+};
+
+static void sendTemplate(AsyncWebServerRequest *request, std::shared_ptr<TemplateStream> stream,
+                         const char* contentType) {
+    request->send(request->beginChunkedResponse(contentType,
+        [stream](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+            return stream->fill(buffer, maxLen);
+        }));
+}
+
+bool sendTemplateFile(AsyncWebServerRequest *request, const char* path, const char* contentType,
+                      const TemplateVar* vars, size_t varCount) {
+    std::shared_ptr<TemplateStream> stream = std::make_shared<TemplateStream>();
+    stream->file = SD.open(path, FILE_READ);
+    if (!stream->file || stream->file.isDirectory()) return false;
+    stream->vars = vars;
+    stream->varCount = varCount;
+    sendTemplate(request, stream, contentType);
+    return true;
+}
+
+void sendTemplateFlash(AsyncWebServerRequest *request, const char* page, const char* contentType,
+                       const TemplateVar* vars, size_t varCount) {
+    std::shared_ptr<TemplateStream> stream = std::make_shared<TemplateStream>();
+    stream->flash = page;
+    stream->flashLen = strlen_P(page);
+    stream->vars = vars;
+    stream->varCount = varCount;
+    sendTemplate(request, stream, contentType);
+}
@@ -0,0 +1,35 @@
+#ifndef TEMPLATE_STREAM_H
+#define TEMPLATE_STREAM_H
+
+#include <ESPAsyncWebServer.h>
+#include <SD.h>
+
+// Longest placeholder name, e.g. DEVICE_NAME
+#define TEMPLATE_MAX_NAME 24
+// Source read size; the whole render uses one block plus a small state struct
+#define TEMPLATE_BLOCK    512
+
+// One %NAME% placeholder and its replacement
+struct TemplateVar {
+    const char* name;
+    const char* value;
+};
+
+/*
+ * Chunked template responses with constant memory use.
+ *
+ * The source is read in TEMPLATE_BLOCK pieces and %NAME% placeholders are
+ * replaced on the fly. Only names in vars are substituted; any other '%'
+ * (CSS percentages, JS modulo) passes through untouched. vars and the source
+ * must stay valid until the response completes, so pass static tables.
+ */
+
+// Stream an SD file; returns false (nothing sent) if it can't be opened
+bool sendTemplateFile(AsyncWebServerRequest *request, const char* path, const char* contentType,
+                      const TemplateVar* vars, size_t varCount);
+
+// Stream a page compiled into flash
+void sendTemplateFlash(AsyncWebServerRequest *request, const char* page, const char* contentType,
+                       const TemplateVar* vars, size_t varCount);
+
+#endif
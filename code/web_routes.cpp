@@ -10,13 +10,27 @@
 #include "ota_handler.h"
 #include "file_manager.h"
 #include "MCP3208.h"
+#include "counter_store.h"
+#include "spi_tuner.h"
+#include "asset_cache.h"
+#include "static_handler.h"
+#include "telemetry.h"
+#include "event_stream.h"
+#include "state_api.h"
+#include "admission.h"
+#include "mqtt_outbox.h"
+#include "telemetry_batch.h"
+#include "multicast_telemetry.h"
+#include "influx_exporter.h"
+#include "logger.h"
+#include "latency_trace.h"
+#include "pump_cluster.h"
+#include "metrics.h"
 
 // Globals from code.ino
 extern AsyncWebServer server;
-extern AsyncEventSource events;
 extern bool wifiConnected;
 extern bool apModeActive;
-extern unsigned long motorRuntimeSeconds;
 extern unsigned long lastMqttReconnectAttempt;
 extern PubSubClient mqttClient;
 extern MCP3208 adc;
@@ -40,31 +54,79 @@ extern volatile bool mainSwitch, error, rebootRequested;
 // Helper function defined in code.ino
 float readMCP3208Average(int channel, int samples);
 
+// ─── Operator controls ──────────────────────────────────────────────────────
+
+void setManualMotor(bool on) {
+    // Commanding the motor implies manual control
+    manualOverride = true;
+    manualMotorState = on;
+}
+
+void setManualOverride(bool on) {
+    manualOverride = on;
+}
+
+void setMainSwitch(bool on) {
+    mainSwitch = on;
+    // Switching back on acknowledges a fault
+    if (on) error = false;
+}
+
+// notifyClients() runs from loop() and from control requests; the delta state is shared
+static SemaphoreHandle_t notifyMutex = NULL;
+
 void notifyClients() {
     // Skip if no clients, or if STA WiFi is down (avoids zombie-client watchdog)
     // In AP mode the network is up, so SSE sends are safe
-    if (!events.count()) return;
+    if (!events.hasSubscribers(SSE_TOPIC_UPDATE)) return;
     if (!apModeActive && !wifiConnected) return;
-    StaticJsonDocument<256> doc;
-    doc["pressure"] = pressure;
-    doc["temperature"] = temperature;
-    doc["ambientTemp"] = ambientTemp;
-    doc["flow"] = flow;
-    doc["motor"] = motor;
-    doc["manualOverride"] = manualOverride;
-    doc["mainSwitch"] = mainSwitch;
-    doc["error"] = error;
 
-    String json;
-    serializeJson(doc, json);
+    // Only fields that changed since the last frame (at display precision),
+    // with a full keyframe periodically and whenever a client joins
+    static float lastPressure, lastTemperature, lastAmbient, lastFlow;
+    static int8_t lastMotor = -1, lastOverride = -1, lastMainSwitch = -1, lastError = -1;
+    static uint8_t sinceKeyframe = SSE_KEYFRAME_INTERVAL;
+
+    if (!notifyMutex || xSemaphoreTake(notifyMutex, pdMS_TO_TICKS(100)) != pdTRUE) return;
+    bool keyframe = events.takeKeyframeRequest() || ++sinceKeyframe >= SSE_KEYFRAME_INTERVAL;
+    if (keyframe) sinceKeyframe = 0;
+
+    auto changedFloat = [keyframe](float& last, float value) {
+        float rounded = roundf(value * 100.0f) / 100.0f;
+        if (!keyframe && rounded == last) return false;
+        last = rounded;
+        return true;
+    };
+    auto changedFlag = [keyframe](int8_t& last, bool value) {
+        if (!keyframe && last == (int8_t)value) return false;
+        last = value;
+        return true;
+    };
 
-    events.send(json.c_str(), "update", millis());
+    StaticJsonDocument<256> doc;
+    if (changedFloat(lastPressure, pressure)) doc["pressure"] = pressure;
+    if (changedFloat(lastTemperature, temperature)) doc["temperature"] = temperature;
+    if (changedFloat(lastAmbient, ambientTemp)) doc["ambientTemp"] = ambientTemp;
+    if (changedFloat(lastFlow, flow)) doc["flow"] = flow;
+    if (changedFlag(lastMotor, motor)) doc["motor"] = motor;
+    if (changedFlag(lastOverride, manualOverride)) doc["manualOverride"] = manualOverride;
+    if (changedFlag(lastMainSwitch, mainSwitch)) doc["mainSwitch"] = mainSwitch;
+    if (changedFlag(lastError, error)) doc["error"] = error;
+    if (keyframe) doc["keyframe"] = true;
+
+    if (!doc.isNull()) {
+        String json;
+        serializeJson(doc, json);
+        events.send(SSE_TOPIC_UPDATE, json.c_str(), "update");
+        telemetrySent(PATH_TLM_SSE, telemetrySampleUs());
+    }
+    xSemaphoreGive(notifyMutex);
 }
 
 void publishDiagnostics() {
-    if (!events.count()) return;
+    if (!events.hasSubscribers(SSE_TOPIC_DIAGNOSTICS)) return;
 
-    StaticJsonDocument<512> doc;
+    StaticJsonDocument<1024> doc;
 
     doc["current_l1"] = currentL1;
     doc["current_l2"] = currentL2;
@@ -80,18 +142,23 @@ void publishDiagnostics() {
     doc["uptime"] = millis() / 1000;
     doc["free_heap"] = ESP.getFreeHeap();
     doc["wifi_rssi"] = WiFi.RSSI();
-    doc["motor_runtime_s"] = motorRuntimeSeconds;
+    doc["motor_runtime_s"] = (unsigned long)counters.get(CNT_MOTOR_RUNTIME_S);
+    doc["motor_starts"] = (unsigned long)counters.get(CNT_MOTOR_STARTS);
+    doc["pumped_volume_l"] = counters.get(CNT_PUMPED_VOLUME_ML) / 1000.0;
+    doc["power_cycles"] = (unsigned long)counters.get(CNT_POWER_CYCLES);
+    addLatencyJson(doc.createNestedObject("latency"));
 
     String json;
     serializeJson(doc, json);
 
-    events.send(json.c_str(), "diagnostics", millis());
+    events.send(SSE_TOPIC_DIAGNOSTICS, json.c_str(), "diagnostics");
 }
 
 void publishDebugData() {
-    if (!events.count()) return;
+    // Heavy payload: only built when a debug page is open
+    if (!events.hasSubscribers(SSE_TOPIC_DEBUG)) return;
 
-    DynamicJsonDocument doc(1536);
+    DynamicJsonDocument doc(2048);
 
     // SD Card Status
     doc["sd_detected"] = (SD.cardType() != CARD_NONE);
@@ -100,24 +167,61 @@ void publishDebugData() {
                      (SD.cardType() == CARD_SDHC) ? "SDHC" : "UNKNOWN";
     doc["sd_size"] = SD.cardSize();
 
-    // Count files on SD
-    int fileCount = 0;
-    File root = SD.open("/");
-    if (root) {
-        File file = root.openNextFile();
-        while (file) {
-            fileCount++;
-            file = root.openNextFile();
-        }
-        root.close();
-    }
-    doc["sd_files"] = fileCount;
+    doc["sd_files"] = getSdFileCount();
+    doc["sd_clock_hz"] = getSdClockHz();
+
+    // Asset cache
+    doc["cache_entries"] = assetCache.getEntryCount();
+    doc["cache_bytes"] = assetCache.getUsedBytes();
+    doc["cache_budget"] = assetCache.getBudget();
+    doc["cache_hits"] = assetCache.getHits();
+    doc["cache_misses"] = assetCache.getMisses();
+    doc["cache_evictions"] = assetCache.getEvictions();
+    doc["cache_low_heap_skips"] = assetCache.getLowHeapSkips();
+
+    // Binary telemetry stream
+    doc["telemetry_clients"] = telemetry.getClientCount();
+    doc["telemetry_sent"] = telemetry.getFramesSent();
+    doc["telemetry_dropped"] = telemetry.getFramesDropped();
+    doc["multicast_sent"] = getMulticastSent();
+    doc["sse_clients"] = events.count();
+    doc["sse_evictions"] = events.getEvictions();
+
+    // MQTT outbox and offline spool
+    MqttOutboxStats mqttStats = mqttOutboxStats();
+    doc["mqtt_published"] = mqttStats.published;
+    doc["mqtt_spooled"] = mqttStats.spooled;
+    doc["mqtt_replayed"] = mqttStats.replayed;
+    doc["mqtt_dropped"] = mqttStats.dropped;
+    doc["mqtt_spool_bytes"] = mqttStats.spoolBytes;
+    doc["mqtt_batches_sent"] = telemetryBatch.getBatchesSent();
+    doc["mqtt_batches_dropped"] = telemetryBatch.getBatchesDropped();
+
+    // InfluxDB exporter
+    InfluxStats influx = influxStats();
+    doc["influx_sent"] = influx.batchesSent;
+    doc["influx_failed"] = influx.batchesFailed;
+    doc["influx_rejected"] = influx.batchesRejected;
+    doc["influx_dropped"] = influx.samplesDropped;
+    doc["influx_queued"] = influx.queued;
+    doc["influx_spool_bytes"] = influx.spoolBytes;
+    doc["log_dropped"] = getLogDropped();
+
+    // Lead/lag cluster
+    doc["cluster_node"] = clusterNodeId();
+    doc["cluster_role"] = clusterRoleName(clusterRole());
+    doc["cluster_nodes"] = clusterNodeCount();
+    doc["cluster_running"] = clusterRunCount();
+
+    // Heavy request admission (per class: active, queued, rejected...)
+    addAdmissionStats(doc.createNestedObject("admission"));
 
     // MCP3208 Status
     doc["mcp_init"] = true;
     doc["mcp_vref"] = 5.0f;  // MCP3208_VREF
     doc["mcp_errors"] = 0;
     doc["spi_status"] = "OK";
+    doc["adc_clock_hz"] = getAdcClockHz();
 
     // Raw ADC Values (0-4095)
     for (int i = 0; i < 8; i++) {
@@ -135,12 +239,14 @@ void publishDebugData() {
     doc["temp_ambient"] = ambientTemp;
     doc["temp_water"] = waterTemp;
 
+    ConfigGuard cfg;
+
     // Calibration Offsets
-    doc["cal_press_in"] = config.pressure_in_offset;
-    doc["cal_press_out"] = config.pressure_out_offset;
-    doc["cal_curr_l1"] = config.current_offset_l1;
-    doc["cal_curr_l2"] = config.current_offset_l2;
-    doc["cal_curr_l3"] = config.current_offset_l3;
+    doc["cal_press_in"] = cfg->pressure_in_offset;
+    doc["cal_press_out"] = cfg->pressure_out_offset;
+    doc["cal_curr_l1"] = cfg->current_offset_l1;
+    doc["cal_curr_l2"] = cfg->current_offset_l2;
+    doc["cal_curr_l3"] = cfg->current_offset_l3;
 
     // System Information
     doc["free_heap"] = ESP.getFreeHeap();
@@ -156,8 +262,8 @@ void publishDebugData() {
 
     // MQTT Status
     doc["mqtt_connected"] = mqttClient.connected();
-    doc["mqtt_server"] = config.mqtt_server;
-    doc["mqtt_port"] = config.mqtt_port;
+    doc["mqtt_server"] = cfg->mqtt_server;
+    doc["mqtt_port"] = cfg->mqtt_port;
     doc["mqtt_last"] = (millis() - lastMqttReconnectAttempt) / 1000;
 
     // Motor & Control State
@@ -169,78 +275,25 @@ void publishDebugData() {
     String json;
     serializeJson(doc, json);
 
-    events.send(json.c_str(), "debug", millis());
+    events.send(SSE_TOPIC_DEBUG, json.c_str(), "debug");
 }
 
 void webRoutes() {
+    notifyMutex = xSemaphoreCreateMutex();
+
     // Setup file manager routes
     setupFileManagerRoutes(server);
 
-    // Route for root / web page
-    server.on("/", HTTP_GET, [](AsyncWebServerRequest *request) {
-        if (SD.exists("/index.html")) {
-            request->send(SD, "/index.html", "text/html");
-        } else {
-            request->send(404, "text/plain", "index.html not found on SD card");
-        }
-    });
+    // Consolidated state snapshot with ETag / 304
+    server.addHandler(new StateHandler());
 
-    // Static file routes
-    server.on("/app.js", HTTP_GET, [](AsyncWebServerRequest *request) {
-        if (SD.exists("/app.js")) {
-            request->send(SD, "/app.js", "application/javascript");
-        } else {
-            request->send(404, "text/plain", "app.js not found on SD card");
-        }
-    });
+    // Recent log lines from the RAM ring
+    setupLogRoutes(server);
 
-    server.on("/style.css", HTTP_GET, [](AsyncWebServerRequest *request) {
-        if (SD.exists("/style.css")) {
-            request->send(SD, "/style.css", "text/css");
-        } else {
-            request->send(404, "text/plain", "style.css not found on SD card");
-        }
-    });
+    // Web UI files are served by StaticAssetHandler (see static_handler.cpp)
 
-    server.on("/settings.html", HTTP_GET, [](AsyncWebServerRequest *request) {
-        if (SD.exists("/settings.html")) {
-            request->send(SD, "/settings.html", "text/html");
-        } else {
-            request->send(404, "text/plain", "settings.html not found on SD card");
-        }
-    });
-
-    server.on("/settings.js", HTTP_GET, [](AsyncWebServerRequest *request) {
-        if (SD.exists("/settings.js")) {
-            request->send(SD, "/settings.js", "application/javascript");
-        } else {
-            request->send(404, "text/plain", "settings.js not found on SD card");
-        }
-    });
-
-    server.on("/translations.js", HTTP_GET, [](AsyncWebServerRequest *request) {
-        if (SD.exists("/translations.js")) {
-            request->send(SD, "/translations.js", "application/javascript");
-        } else {
-            request->send(404, "text/plain", "translations.js not found on SD card");
-        }
-    });
-
-    server.on("/language.js", HTTP_GET, [](AsyncWebServerRequest *request) {
-        if (SD.exists("/language.js")) {
-            request->send(SD, "/language.js", "application/javascript");
-        } else {
-            request->send(404, "text/plain", "language.js not found on SD card");
-        }
-    });
-
-    server.on("/diagnostics.html", HTTP_GET, [](AsyncWebServerRequest *request) {
-        if (SD.exists("/diagnostics.html")) {
-            request->send(SD, "/diagnostics.html", "text/html");
-        } else {
-            request->send(404, "text/plain", "diagnostics.html not found on SD card");
-        }
-    });
+    metricsRoutes({ "/api/state", "/api/config", "/api/factory-reset", "/api/calibrate-current",
+                    "/api/calibrate-pressure", "/diagnostics", "/reboot", "/command", "/debug" });
 
     // API endpoint to get current configuration
     server.on("/api/config", HTTP_GET, [](AsyncWebServerRequest *request) {
@@ -252,16 +305,15 @@ void webRoutes() {
     }, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
         String jsonStr = String((char*)data).substring(0, len);
 
-        if (updateConfigFromJson(jsonStr)) {
-            DynamicJsonDocument doc(256);
-            deserializeJson(doc, jsonStr);
-            bool wifiChanged = doc.containsKey("wifi_ssid") || doc.containsKey("wifi_password");
-
-            request->send(200, "application/json", "{\"status\":\"success\",\"wifi_changed\":" + String(wifiChanged ? "true" : "false") + "}");
-
-            if (wifiChanged) {
-                rebootRequested = true;
-            }
+        // Changed sections are applied live by their owners — no reboot needed
+        uint32_t changed = 0;
+        if (updateConfigFromJson(jsonStr, &changed)) {
+            String response = "{\"status\":\"success\",\"wifi_changed\":";
+            response += (changed & CFG_SECT_WIFI) ? "true" : "false";
+            response += ",\"mqtt_changed\":";
+            response += (changed & CFG_SECT_MQTT) ? "true" : "false";
+            response += "}";
+            request->send(200, "application/json", response);
         } else {
             request->send(500, "application/json", "{\"error\":\"Failed to save configuration\"}");
         }
@@ -273,8 +325,7 @@ void webRoutes() {
             SD.remove("/config.json");
         }
 
-        config = Config();
-        saveConfig();
+        configCommit(Config());
 
         request->send(200, "application/json", "{\"status\":\"success\"}");
         rebootRequested = true;
@@ -282,69 +333,75 @@ void webRoutes() {
 
     // Manual current sensor calibration endpoint
     server.on("/api/calibrate-current", HTTP_POST, [](AsyncWebServerRequest *request) {
-        if (motor) {
-            request->send(400, "application/json",
-                "{\"error\":\"Motor must be OFF for calibration\",\"motor_status\":\"ON\"}");
-            return;
-        }
+        admitRequest(request, REQ_CLASS_CALIBRATION, [](AsyncWebServerRequest *request) {
+            if (motor) {
+                request->send(400, "application/json",
+                    "{\"error\":\"Motor must be OFF for calibration\",\"motor_status\":\"ON\"}");
+                return;
+            }
 
-        Serial.println("\n=== Manual Calibration Requested via API ===");
-        if (currentSensor.performAutoCalibration(100)) {
-            CalibrationData cal = currentSensor.getCalibrationData();
-            config.current_offset_l1 = cal.offsetL1;
-            config.current_offset_l2 = cal.offsetL2;
-            config.current_offset_l3 = cal.offsetL3;
-            saveConfig();
-
-            DynamicJsonDocument doc(256);
-            doc["status"] = "success";
-            doc["offset_l1"] = config.current_offset_l1;
-            doc["offset_l2"] = config.current_offset_l2;
-            doc["offset_l3"] = config.current_offset_l3;
-
-            String response;
-            serializeJson(doc, response);
-            request->send(200, "application/json", response);
-        } else {
-            request->send(500, "application/json",
-                "{\"error\":\"Calibration failed - check motor is OFF and retry\"}");
-        }
+            LOGI("=== Manual Calibration Requested via API ===");
+            if (currentSensor.performAutoCalibration(100)) {
+                CalibrationData cal = currentSensor.getCalibrationData();
+                Config next = configCopy();
+                next.current_offset_l1 = cal.offsetL1;
+                next.current_offset_l2 = cal.offsetL2;
+                next.current_offset_l3 = cal.offsetL3;
+                next.current_calibrated = true;
+                configCommit(next);
+
+                DynamicJsonDocument doc(256);
+                doc["status"] = "success";
+                doc["offset_l1"] = next.current_offset_l1;
+                doc["offset_l2"] = next.current_offset_l2;
+                doc["offset_l3"] = next.current_offset_l3;
+
+                String response;
+                serializeJson(doc, response);
+                request->send(200, "application/json", response);
+            } else {
+                request->send(500, "application/json",
+                    "{\"error\":\"Calibration failed - check motor is OFF and retry\"}");
+            }
+        });
     });
 
     // Pressure sensor calibration endpoint
     server.on("/api/calibrate-pressure", HTTP_POST, [](AsyncWebServerRequest *request) {
-        Serial.println("\n=== Pressure Calibration Requested via API ===");
-
-        // MCP_CH_PRESSURE_IN = 2, MCP_CH_PRESSURE_OUT = 1, NUM_SAMPLES = 10
-        float voltageIn  = readMCP3208Average(2, 10);
-        float voltageOut = readMCP3208Average(1, 10);
-
-        float rawPressureIn  = (voltageIn  - 0.5) * 1.25;
-        float rawPressureOut = (voltageOut - 0.5) * 1.25;
-
-        config.pressure_in_offset  = -(rawPressureIn  + config.pressure_offset);
-        config.pressure_out_offset = -(rawPressureOut + config.pressure_offset);
-        config.pressure_calibrated = true;
-
-        if (saveConfig()) {
-            Serial.printf("Pressure calibration successful:\n");
-            Serial.printf("  Inlet offset: %.3f bar\n", config.pressure_in_offset);
-            Serial.printf("  Outlet offset: %.3f bar\n", config.pressure_out_offset);
-
-            DynamicJsonDocument doc(256);
-            doc["status"] = "success";
-            doc["offset_in"] = config.pressure_in_offset;
-            doc["offset_out"] = config.pressure_out_offset;
-            doc["raw_in"] = rawPressureIn;
-            doc["raw_out"] = rawPressureOut;
-
-            String response;
-            serializeJson(doc, response);
-            request->send(200, "application/json", response);
-        } else {
-            request->send(500, "application/json",
-                "{\"error\":\"Failed to save calibration to config\"}");
-        }
+        admitRequest(request, REQ_CLASS_CALIBRATION, [](AsyncWebServerRequest *request) {
+            LOGI("=== Pressure Calibration Requested via API ===");
+
+            // MCP_CH_PRESSURE_IN = 2, MCP_CH_PRESSURE_OUT = 1, NUM_SAMPLES = 10
+            float voltageIn  = readMCP3208Average(2, 10);
+            float voltageOut = readMCP3208Average(1, 10);
+
+            float rawPressureIn  = (voltageIn  - 0.5) * 1.25;
+            float rawPressureOut = (voltageOut - 0.5) * 1.25;
+
+            Config next = configCopy();
+            next.pressure_in_offset  = -(rawPressureIn  + next.pressure_offset);
+            next.pressure_out_offset = -(rawPressureOut + next.pressure_offset);
+            next.pressure_calibrated = true;
+
+            if (configCommit(next)) {
+                LOGI("Pressure calibration successful: inlet offset %.3f bar, outlet offset %.3f bar",
+                     next.pressure_in_offset, next.pressure_out_offset);
+
+                DynamicJsonDocument doc(256);
+                doc["status"] = "success";
+                doc["offset_in"] = next.pressure_in_offset;
+                doc["offset_out"] = next.pressure_out_offset;
+                doc["raw_in"] = rawPressureIn;
+                doc["raw_out"] = rawPressureOut;
+
+                String response;
+                serializeJson(doc, response);
+                request->send(200, "application/json", response);
+            } else {
+                request->send(500, "application/json",
+                    "{\"error\":\"Failed to save calibration to config\"}");
+            }
+        });
     });
 
     // Diagnostics JSON endpoint (for backward compatibility)
@@ -381,23 +438,24 @@ void webRoutes() {
 
     server.on("/command", HTTP_POST, [](AsyncWebServerRequest *request) {
     }, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+        uint32_t receivedUs = micros();
         DynamicJsonDocument doc(128);
         DeserializationError jsonError = deserializeJson(doc, data, len);
 
         if (!jsonError) {
             if (doc.containsKey("command")) {
                 String command = doc["command"];
+                bool known = true;
                 if (command == "toggle") {
-                    manualOverride = true;
-                    manualMotorState = !manualMotorState;
+                    setManualMotor(!manualMotorState);
                 } else if (command == "override") {
-                    manualOverride = !manualOverride;
+                    setManualOverride(!manualOverride);
                 } else if (command == "mainSwitch") {
-                    mainSwitch = !mainSwitch;
-                    if (mainSwitch) {
-                        error = false;
-                    }
+                    setMainSwitch(!mainSwitch);
+                } else if (command != "ping") {     // ping: timed and acked, changes nothing
+                    known = false;
                 }
+                if (known) commandReceived(PATH_CMD_HTTP, receivedUs, doc["cid"]);
 
                 notifyClients();
                 request->send(200, "application/json", "{\"status\":\"ok\"}");
@@ -409,24 +467,9 @@ void webRoutes() {
 
     // Debug page route - serve debug.html or fallback to simple debug info
     server.on("/debug", HTTP_GET, [](AsyncWebServerRequest *request) {
-        if (SD.exists("/debug.html")) {
-            request->send(SD, "/debug.html", "text/html");
-        } else {
-            String html = "<html><body><h1>SD Card Files:</h1><ul>";
-
-            File root = SD.open("/");
-            if (root) {
-                File file = root.openNextFile();
-                while (file) {
-                    html += "<li>" + String(file.name()) + " (" + String(file.size()) + " bytes)</li>";
-                    file = root.openNextFile();
-                }
-                root.close();
-            } else {
-                html += "<li>Could not open root directory</li>";
-            }
-
-            html += "</ul>";
+        if (!sendStaticAsset(request, "/debug.html")) {
+            String html = "<html><body><h1>SD Card Files:</h1>";
+            html += "<p>" + String(getSdFileCount()) + " entries in / (<a href=\"/list_files\">list</a>)</p>";
             html += "<h2>Current Config:</h2><pre>" + getConfigJson() + "</pre>";
             html += "<h2>Device Info:</h2><pre>";
             html += "Device Name: " + String(DEVICE_NAME) + "\n";
@@ -452,7 +495,7 @@ void webRoutes() {
     });
 
     events.onConnect([](AsyncEventSourceClient *client) {
-        Serial.println("Client connected to /events");
+        LOGI("Client connected to /events");
         // Do NOT call publishDebugData/publishDiagnostics/notifyClients here.
         // This callback runs in the async_tcp task, which shares the SPI bus
         // with loop(). Calling SPI-heavy functions (SD directory scan, ADC reads)
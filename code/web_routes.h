@@ -6,4 +6,10 @@ void notifyClients();
 void publishDiagnostics();
 void publishDebugData();
 
+// Operator controls behind /command, shared with the Modbus coils.
+// Callers follow up with notifyClients().
+void setManualMotor(bool on);
+void setManualOverride(bool on);
+void setMainSwitch(bool on);
+
 #endif
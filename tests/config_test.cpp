@@ -0,0 +1,210 @@
+// Host tests for config_manager: config.json and NVS snapshot round trips,
+// /api/config updates and schema migration.
+//
+//   cmake -S tests -B build/tests && cmake --build build/tests && ctest --test-dir build/tests
+
+#include <Preferences.h>
+#include "config_manager.h"
+#include "logger.h"
+
+volatile uint8_t logLevel = LOG_LEVEL_WARN;
+
+void logWrite(uint8_t level, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    printf("    log: ");
+    vprintf(fmt, args);
+    printf("\n");
+    va_end(args);
+}
+
+unsigned long millis() { return 0; }
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); failures++; } \
+    } while (0)
+
+// ─── Helpers ────────────────────────────────────────────────────────────────
+
+static void resetStorage() {
+    SD.files.clear();
+    Preferences::storage.clear();
+}
+
+static bool sameConfig(const Config& a, const Config& b) {
+    bool same = true;
+#define X(type, name, def, lo, hi, flags, sect) \
+    if (!(a.name == b.name)) { printf("    %s differs\n", #name); same = false; }
+    CONFIG_FIELDS(X)
+#undef X
+    return same;
+}
+
+// Parse config.json again, without the snapshot
+static Config loadFromJson() {
+    Preferences::storage.clear();
+    CHECK(loadConfig());
+    return configCopy();
+}
+
+// Load through the snapshot only: config.json is replaced by garbage of the
+// same size and mtime, which only a snapshot hit can get past
+static Config loadFromSnapshot() {
+    SDEntry& file = SD.files.at("/config.json");
+    std::string original = file.data;
+    file.data.assign(original.size(), '#');
+    CHECK(loadConfig());
+    file.data = original;
+    return configCopy();
+}
+
+static void editField(String& value) { value += "x"; }
+static void editField(int& value)    { value += 1; }
+static void editField(float& value)  { value += 0.25f; }
+static void editField(bool& value)   { value = !value; }
+
+// Every updatable field moved off its default, still within range
+static Config editedConfig() {
+    Config cfg;
+#define X(type, name, def, lo, hi, flags, sect) if (!((flags) & CFG_INTERNAL)) editField(cfg.name);
+    CONFIG_FIELDS(X)
+#undef X
+    cfg.wifi_password = "p\"a\\ss word";
+    return cfg;
+}
+
+static String updateJson(const Config& cfg) {
+    DynamicJsonDocument doc(2048);
+#define X(type, name, def, lo, hi, flags, sect) if (!((flags) & CFG_INTERNAL)) doc[#name] = cfg.name;
+    CONFIG_FIELDS(X)
+#undef X
+    String json;
+    serializeJson(doc, json);
+    return json;
+}
+
+static bool contains(const String& haystack, const char* needle) {
+    return strstr(haystack.c_str(), needle) != nullptr;
+}
+
+// ─── Tests ──────────────────────────────────────────────────────────────────
+
+static void testDefaultsRoundTrip() {
+    resetStorage();
+    CHECK(loadConfig());
+    CHECK(SD.exists("/config.json"));
+    CHECK(sameConfig(configCopy(), Config()));
+    CHECK(configCopy().config_version == CONFIG_VERSION);
+
+    CHECK(sameConfig(loadFromJson(), Config()));
+    CHECK(sameConfig(loadFromSnapshot(), Config()));
+
+    // A config.json changed behind the snapshot's back is parsed again
+    SDEntry& file = SD.files.at("/config.json");
+    file.data.assign(file.data.size(), '#');
+    file.mtime++;
+    CHECK(!loadConfig());
+}
+
+static void testEditedRoundTrip() {
+    resetStorage();
+    CHECK(loadConfig());
+
+    Config expected = editedConfig();
+    uint32_t changed = 0;
+    CHECK(updateConfigFromJson(updateJson(expected), &changed));
+    CHECK(changed == (CFG_SECT_WIFI | CFG_SECT_MQTT | CFG_SECT_CONTROL |
+                      CFG_SECT_CALIBRATION | CFG_SECT_LOGGING));
+    CHECK(sameConfig(configCopy(), expected));
+
+    CHECK(sameConfig(loadFromJson(), expected));
+    CHECK(sameConfig(loadFromSnapshot(), expected));
+
+    // Secrets and internal fields stay out of /api/config
+    String json = getConfigJson();
+    CHECK(contains(json, "\"wifi_ssid\":\"x\""));
+    CHECK(!contains(json, "wifi_password"));
+    CHECK(!contains(json, "mqtt_password"));
+    CHECK(!contains(json, "influx_token"));
+    CHECK(!contains(json, "config_version"));
+
+    // An empty secret keeps the stored one; nothing changed, nothing notified
+    CHECK(updateConfigFromJson("{\"wifi_password\":\"\",\"config_version\":1}", &changed));
+    CHECK(changed == 0);
+    CHECK(sameConfig(configCopy(), expected));
+}
+
+static void testUpdateClamps() {
+    resetStorage();
+    CHECK(loadConfig());
+
+    CHECK(updateConfigFromJson("{\"mqtt_port\":70000,\"max_pressure\":-1,"
+                               "\"cluster_name\":\"abcdefghijklmnopqrstuvwxyz0123\"}"));
+    Config cfg = configCopy();
+    CHECK(cfg.mqtt_port == 65535);
+    CHECK(cfg.max_pressure == 0.0f);
+    CHECK(cfg.cluster_name == "abcdefghijklmnopqrstuvwx");
+    CHECK(sameConfig(loadFromJson(), cfg));
+
+    CHECK(!updateConfigFromJson("{\"mqtt_port\":"));
+}
+
+static void testMigrateV1() {
+    // Written by v1 firmware: no config_version, offsets without their flags
+    resetStorage();
+    SD.files["/config.json"] = { "{\"wifi_ssid\":\"pumphouse\",\"mqtt_port\":1884,"
+                                 "\"current_offset_l2\":12.5,\"pressure_out_offset\":-0.1,"
+                                 "\"current_calibrated\":false,\"pressure_calibrated\":false}", 1 };
+    CHECK(loadConfig());
+    Config cfg = configCopy();
+    CHECK(cfg.config_version == 2);
+    CHECK(cfg.current_calibrated);
+    CHECK(cfg.pressure_calibrated);
+    CHECK(cfg.current_offset_l2 == 12.5f);
+    CHECK(cfg.pressure_out_offset == -0.1f);
+    CHECK(cfg.wifi_ssid == "pumphouse");
+    CHECK(cfg.mqtt_port == 1884);
+    CHECK(cfg.max_current == Config().max_current);
+
+    // The migrated version is written back, so it is not migrated again
+    CHECK(contains(String(SD.files.at("/config.json").data), "\"config_version\": 2"));
+    CHECK(sameConfig(loadFromJson(), cfg));
+    CHECK(sameConfig(loadFromSnapshot(), cfg));
+
+    // Uncalibrated v1 units keep their flags cleared
+    resetStorage();
+    SD.files["/config.json"] = { "{\"mqtt_server\":\"10.0.0.2\"}", 1 };
+    CHECK(loadConfig());
+    cfg = configCopy();
+    CHECK(cfg.config_version == 2);
+    CHECK(!cfg.current_calibrated);
+    CHECK(!cfg.pressure_calibrated);
+    CHECK(cfg.mqtt_server == "10.0.0.2");
+
+    // Newer than this firmware: left alone
+    Config newer;
+    newer.config_version = CONFIG_VERSION + 1;
+    newer.current_offset_l1 = 5.0f;
+    migrateConfig(newer);
+    CHECK(newer.config_version == CONFIG_VERSION + 1);
+    CHECK(!newer.current_calibrated);
+}
+
+int main() {
+    struct { const char* name; void (*run)(); } tests[] = {
+        { "defaults round trip", testDefaultsRoundTrip },
+        { "edited round trip",   testEditedRoundTrip },
+        { "update clamps",       testUpdateClamps },
+        { "migrate v1",          testMigrateV1 },
+    };
+
+    for (auto& test : tests) {
+        int before = failures;
+        printf("%s\n", test.name);
+        test.run();
+        printf("  %s\n", failures == before ? "ok" : "FAILED");
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,40 @@
+// Host stand-in for the parts of the Arduino core the tested sources use
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+using std::isnan;
+
+class String {
+private:
+    std::string s;
+
+public:
+    String() {}
+    String(const char* str) : s(str ? str : "") {}
+    String(const std::string& str) : s(str) {}
+
+    unsigned int length() const { return s.size(); }
+    const char* c_str() const { return s.c_str(); }
+
+    String substring(unsigned int from) const { return from < s.size() ? s.substr(from) : ""; }
+    String substring(unsigned int from, unsigned int to) const {
+        return from < s.size() && to > from ? s.substr(from, to - from) : "";
+    }
+
+    bool concat(const char* str, unsigned int len) { s.append(str, len); return true; }
+    String& operator+=(const String& other) { s += other.s; return *this; }
+
+    bool operator==(const String& other) const { return s == other.s; }
+    bool operator!=(const String& other) const { return s != other.s; }
+};
+
+unsigned long millis();
+
+#endif
@@ -0,0 +1,261 @@
+// Host stand-in for ArduinoJson 6, limited to flat objects of scalars —
+// the shape of config.json and /api/config. Nested values fail to parse.
+#ifndef ARDUINOJSON_H
+#define ARDUINOJSON_H
+
+#include <Arduino.h>
+#include <SD.h>
+#include <utility>
+#include <vector>
+
+struct JsonValue {
+    enum Type { NUL, BOOL, INT, FLOAT, STR } type = NUL;
+    bool b = false;
+    long long i = 0;
+    double f = 0;
+    std::string s;
+};
+
+typedef std::vector<std::pair<std::string, JsonValue>> JsonMembers;
+
+class JsonVariant {
+private:
+    JsonMembers* members;
+    std::string key;
+
+    const JsonValue* find() const {
+        for (auto& m : *members)
+            if (m.first == key) return &m.second;
+        return nullptr;
+    }
+
+    JsonValue& slot() {
+        for (auto& m : *members)
+            if (m.first == key) return m.second;
+        members->push_back({ key, JsonValue() });
+        return members->back().second;
+    }
+
+    template <typename T> bool is() const;
+
+public:
+    JsonVariant(JsonMembers* members, const char* key) : members(members), key(key) {}
+
+    JsonVariant& operator=(bool value)          { JsonValue& v = slot(); v = JsonValue(); v.type = JsonValue::BOOL; v.b = value; return *this; }
+    JsonVariant& operator=(int value)           { JsonValue& v = slot(); v = JsonValue(); v.type = JsonValue::INT; v.i = value; return *this; }
+    JsonVariant& operator=(double value)        { JsonValue& v = slot(); v = JsonValue(); v.type = JsonValue::FLOAT; v.f = value; return *this; }
+    JsonVariant& operator=(float value)         { return *this = (double)value; }
+    JsonVariant& operator=(const char* value)   { JsonValue& v = slot(); v = JsonValue(); v.type = JsonValue::STR; v.s = value; return *this; }
+    JsonVariant& operator=(const String& value) { return *this = value.c_str(); }
+
+    template <typename T> T as() const;
+
+    // Stored value if it has a compatible type, otherwise the default
+    template <typename T> T operator|(const T& def) const;
+};
+
+template <> inline bool JsonVariant::is<String>() const { const JsonValue* v = find(); return v && v->type == JsonValue::STR; }
+template <> inline bool JsonVariant::is<bool>() const   { const JsonValue* v = find(); return v && v->type == JsonValue::BOOL; }
+template <> inline bool JsonVariant::is<int>() const    { const JsonValue* v = find(); return v && v->type == JsonValue::INT; }
+template <> inline bool JsonVariant::is<float>() const {
+    const JsonValue* v = find();
+    return v && (v->type == JsonValue::INT || v->type == JsonValue::FLOAT);
+}
+
+template <> inline String JsonVariant::as<String>() const {
+    const JsonValue* v = find();
+    return v && v->type == JsonValue::STR ? String(v->s) : String();
+}
+
+template <> inline double JsonVariant::as<double>() const {
+    const JsonValue* v = find();
+    if (!v) return 0;
+    switch (v->type) {
+        case JsonValue::BOOL:  return v->b;
+        case JsonValue::INT:   return (double)v->i;
+        case JsonValue::FLOAT: return v->f;
+        default:               return 0;
+    }
+}
+
+template <> inline float JsonVariant::as<float>() const { return (float)as<double>(); }
+template <> inline int JsonVariant::as<int>() const     { return (int)as<double>(); }
+template <> inline bool JsonVariant::as<bool>() const   { return as<double>() != 0; }
+
+template <typename T> inline T JsonVariant::operator|(const T& def) const { return is<T>() ? as<T>() : def; }
+
+class JsonObject {
+private:
+    JsonMembers* members;
+
+public:
+    explicit JsonObject(JsonMembers* members) : members(members) {}
+    JsonVariant operator[](const char* key) { return JsonVariant(members, key); }
+};
+
+class DynamicJsonDocument {
+public:
+    JsonMembers members;
+
+    explicit DynamicJsonDocument(size_t) {}
+
+    JsonVariant operator[](const char* key) { return JsonVariant(&members, key); }
+
+    bool containsKey(const char* key) const {
+        for (auto& m : members)
+            if (m.first == key) return true;
+        return false;
+    }
+
+    template <typename T> T to() { members.clear(); return T(&members); }
+};
+
+class DeserializationError {
+private:
+    const char* code;
+
+public:
+    explicit DeserializationError(const char* code = nullptr) : code(code) {}
+    explicit operator bool() const { return code != nullptr; }
+    const char* c_str() const { return code ? code : "Ok"; }
+};
+
+// ─── Serialization ──────────────────────────────────────────────────────────
+
+inline std::string jsonQuote(const std::string& s) {
+    std::string out = "\"";
+    for (unsigned char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (c < 0x20) {
+            char esc[8];
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+            out += esc;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+inline std::string jsonText(const DynamicJsonDocument& doc, bool pretty) {
+    std::string out = "{";
+    for (size_t n = 0; n < doc.members.size(); n++) {
+        const JsonValue& v = doc.members[n].second;
+        char num[32];
+        out += n ? "," : "";
+        out += pretty ? "\n  " : "";
+        out += jsonQuote(doc.members[n].first) + (pretty ? ": " : ":");
+        switch (v.type) {
+            case JsonValue::NUL:   out += "null"; break;
+            case JsonValue::BOOL:  out += v.b ? "true" : "false"; break;
+            case JsonValue::INT:   snprintf(num, sizeof(num), "%lld", v.i); out += num; break;
+            case JsonValue::FLOAT: snprintf(num, sizeof(num), "%.9g", v.f); out += num; break;
+            case JsonValue::STR:   out += jsonQuote(v.s); break;
+        }
+    }
+    return out + (pretty && !doc.members.empty() ? "\n}" : "}");
+}
+
+inline size_t serializeJson(const DynamicJsonDocument& doc, String& output) {
+    std::string text = jsonText(doc, false);
+    output = String(text);
+    return text.size();
+}
+
+inline size_t serializeJsonPretty(const DynamicJsonDocument& doc, File& file) {
+    std::string text = jsonText(doc, true);
+    return file.write((const uint8_t*)text.data(), text.size());
+}
+
+// ─── Deserialization ────────────────────────────────────────────────────────
+
+class JsonParser {
+private:
+    const std::string& in;
+    size_t pos = 0;
+
+    void skipSpace() { while (pos < in.size() && isspace((unsigned char)in[pos])) pos++; }
+    bool take(char c) { skipSpace(); if (pos < in.size() && in[pos] == c) { pos++; return true; } return false; }
+
+    bool word(const char* w) {
+        size_t len = strlen(w);
+        if (in.compare(pos, len, w) != 0) return false;
+        pos += len;
+        return true;
+    }
+
+    bool string(std::string& out) {
+        if (!take('"')) return false;
+        while (pos < in.size() && in[pos] != '"') {
+            char c = in[pos++];
+            if (c == '\\' && pos < in.size()) {
+                char e = in[pos++];
+                if (e == 'u' && pos + 4 <= in.size()) {
+                    out += (char)strtol(in.substr(pos, 4).c_str(), nullptr, 16);
+                    pos += 4;
+                } else {
+                    out += e == 'n' ? '\n' : e == 't' ? '\t' : e == 'r' ? '\r' : e;
+                }
+            } else {
+                out += c;
+            }
+        }
+        return take('"');
+    }
+
+    bool value(JsonValue& v) {
+        skipSpace();
+        if (pos >= in.size()) return false;
+        char c = in[pos];
+        if (c == '"') { v.type = JsonValue::STR; return string(v.s); }
+        if (word("true"))  { v.type = JsonValue::BOOL; v.b = true; return true; }
+        if (word("false")) { v.type = JsonValue::BOOL; v.b = false; return true; }
+        if (word("null"))  return true;
+
+        const char* start = in.c_str() + pos;
+        char* end;
+        double number = strtod(start, &end);
+        if (end == start) return false;
+        std::string text(start, end - start);
+        pos += end - start;
+        if (text.find_first_of(".eE") == std::string::npos) {
+            v.type = JsonValue::INT;
+            v.i = strtoll(text.c_str(), nullptr, 10);
+        } else {
+            v.type = JsonValue::FLOAT;
+            v.f = number;
+        }
+        return true;
+    }
+
+public:
+    explicit JsonParser(const std::string& in) : in(in) {}
+
+    DeserializationError parse(JsonMembers& members) {
+        members.clear();
+        skipSpace();
+        if (pos >= in.size()) return DeserializationError("EmptyInput");
+        if (!take('{')) return DeserializationError("InvalidInput");
+        if (take('}')) return DeserializationError();
+        do {
+            std::string key;
+            JsonValue v;
+            if (!string(key) || !take(':') || !value(v)) return DeserializationError("InvalidInput");
+            members.push_back({ key, v });
+        } while (take(','));
+        return take('}') ? DeserializationError() : DeserializationError("InvalidInput");
+    }
+};
+
+inline DeserializationError deserializeJson(DynamicJsonDocument& doc, const String& input) {
+    std::string text = input.c_str();
+    return JsonParser(text).parse(doc.members);
+}
+
+inline DeserializationError deserializeJson(DynamicJsonDocument& doc, File& file) {
+    return deserializeJson(doc, file.readString());
+}
+
+#endif
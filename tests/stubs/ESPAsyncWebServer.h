@@ -0,0 +1,7 @@
+// Host stand-in: only named in declarations the tests never call
+#ifndef ESPASYNCWEBSERVER_H
+#define ESPASYNCWEBSERVER_H
+
+class AsyncWebServer;
+
+#endif
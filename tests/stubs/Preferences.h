@@ -0,0 +1,40 @@
+// Host stand-in for ESP32 NVS preferences: namespaces of byte blobs in memory
+#ifndef PREFERENCES_H
+#define PREFERENCES_H
+
+#include <Arduino.h>
+#include <map>
+#include <vector>
+
+class Preferences {
+private:
+    std::string space;
+
+public:
+    static inline std::map<std::string, std::map<std::string, std::vector<uint8_t>>> storage;
+
+    bool begin(const char* name, bool readOnly = false) {
+        if (readOnly && !storage.count(name)) return false;
+        space = name;
+        storage[space];
+        return true;
+    }
+
+    void end() { space.clear(); }
+
+    size_t getBytes(const char* key, void* buf, size_t maxLen) {
+        auto& keys = storage[space];
+        auto it = keys.find(key);
+        if (it == keys.end() || it->second.size() > maxLen) return 0;
+        memcpy(buf, it->second.data(), it->second.size());
+        return it->second.size();
+    }
+
+    size_t putBytes(const char* key, const void* value, size_t len) {
+        const uint8_t* bytes = (const uint8_t*)value;
+        storage[space][key].assign(bytes, bytes + len);
+        return len;
+    }
+};
+
+#endif
@@ -0,0 +1,78 @@
+// Host stand-in for the SD card: an in-memory filesystem
+#ifndef SD_H
+#define SD_H
+
+#include <Arduino.h>
+#include <ctime>
+#include <map>
+
+#define FILE_READ  "r"
+#define FILE_WRITE "w"
+
+struct SDEntry {
+    std::string data;
+    uint32_t mtime;
+};
+
+class File {
+private:
+    std::map<std::string, SDEntry>* files;
+    std::string path;
+    bool writing;
+    std::string buffer;
+
+public:
+    File() : files(nullptr), writing(false) {}
+    File(std::map<std::string, SDEntry>* files, const std::string& path, bool writing)
+        : files(files), path(path), writing(writing) {}
+
+    explicit operator bool() const { return files != nullptr; }
+
+    size_t size() const { return files->at(path).data.size(); }
+    time_t getLastWrite() const { return files->at(path).mtime; }
+    String readString() const { return String(files->at(path).data); }
+
+    size_t write(const uint8_t* buf, size_t len) {
+        buffer.append((const char*)buf, len);
+        return len;
+    }
+
+    void close();
+};
+
+class SDClass {
+public:
+    std::map<std::string, SDEntry> files;
+    uint32_t clock = 1;     // mtime of the next write
+
+    bool exists(const char* path) { return files.count(path) != 0; }
+    bool remove(const char* path) { return files.erase(path) != 0; }
+
+    bool rename(const char* from, const char* to) {
+        auto it = files.find(from);
+        if (it == files.end()) return false;
+        files[to] = it->second;
+        files.erase(from);
+        return true;
+    }
+
+    File open(const char* path, const char* mode = FILE_READ) {
+        bool writing = strcmp(mode, FILE_WRITE) == 0;
+        if (!writing && !exists(path)) return File();
+        if (writing) files[path] = { "", clock++ };
+        return File(&files, path, writing);
+    }
+};
+
+// Written to the "card" when closed, like a flushed FAT file
+inline void File::close() {
+    if (files && writing) {
+        (*files)[path].data = buffer;
+        writing = false;
+    }
+    files = nullptr;
+}
+
+inline SDClass SD;
+
+#endif
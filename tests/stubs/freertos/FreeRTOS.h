@@ -0,0 +1,16 @@
+// Host stand-in: the tests are single-threaded
+#ifndef FREERTOS_H
+#define FREERTOS_H
+
+#include <cstdint>
+
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE         1
+#define pdFALSE        0
+#define portMAX_DELAY  0xFFFFFFFF
+
+inline void vTaskDelay(TickType_t) {}
+
+#endif
@@ -0,0 +1,18 @@
+// Host stand-in for the ESP32 ROM CRC routine
+#ifndef ROM_CRC_H
+#define ROM_CRC_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Same result as the ROM's little-endian CRC-32 (IEEE 802.3)
+inline uint32_t crc32_le(uint32_t crc, const uint8_t* buf, size_t len) {
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int i = 0; i < 8; i++) crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+#endif
@@ -0,0 +1,456 @@
+#!/usr/bin/env python3
+"""
+Simulate AquaSensys units running lead/lag cluster mode against an MQTT broker.
+
+Each simulated node speaks the protocol in code/pump_cluster.h and runs the
+same election and staging rules, on one modelled manifold: every running
+pump adds flow, the load draws it off, and all nodes read the same pressure.
+Real units configured with the same cluster_name join in as peers.
+
+    mosquitto -p 1883 &
+    ./cluster_sim.py --nodes 3 --duration 120
+    ./cluster_sim.py --nodes 3 --kill sim-1@40 --rejoin sim-1@70 --load 0:20,30:70,90:10
+
+Node IDs are sim-1, sim-2, ...; --kill drops a node's connection without a
+DISCONNECT, so the broker sends its last will. State changes are printed as
+they happen, with a summary line every --report seconds.
+
+The exit status is 1 if two coordinators were in charge at once for longer
+than a heartbeat round, or if pressure stayed below min_pressure with no
+pump running for longer than a takeover can take. Standard library only.
+"""
+
+import argparse
+import json
+import socket
+import struct
+import sys
+import threading
+import time
+
+HEARTBEAT = 2.0
+NODE_TIMEOUT = 7.0
+JOIN_GRACE = NODE_TIMEOUT
+PLAN_TIMEOUT = 10.0
+MAX_NODES = 4
+
+
+# ─── Minimal MQTT 3.1.1 client (QoS 0) ──────────────────────────────────────
+
+def encode_str(s):
+    b = s.encode()
+    return struct.pack("!H", len(b)) + b
+
+
+def encode_len(n):
+    out = bytearray()
+    while True:
+        byte, n = n % 128, n // 128
+        out.append(byte | (0x80 if n else 0))
+        if not n:
+            return bytes(out)
+
+
+class MqttClient:
+    def __init__(self, host, port, client_id, will_topic, will_message, on_message):
+        self.sock = socket.create_connection((host, port), timeout=5)
+        self.lock = threading.Lock()
+        self.on_message = on_message
+        self.alive = True
+
+        flags = 0x02 | 0x04         # clean session, will (QoS 0, not retained)
+        body = encode_str("MQTT") + bytes([4, flags]) + struct.pack("!H", 15)
+        body += encode_str(client_id) + encode_str(will_topic) + encode_str(will_message)
+        self.sock.sendall(b"\x10" + encode_len(len(body)) + body)
+        kind, payload = self.read_packet()
+        if kind != 0x20 or payload[1] != 0:
+            raise ConnectionError("CONNACK refused")
+        self.sock.settimeout(None)
+        threading.Thread(target=self.reader, daemon=True).start()
+        threading.Thread(target=self.pinger, daemon=True).start()
+
+    def recv_exact(self, n):
+        data = b""
+        while len(data) < n:
+            chunk = self.sock.recv(n - len(data))
+            if not chunk:
+                raise ConnectionError("closed")
+            data += chunk
+        return data
+
+    def read_packet(self):
+        header = self.recv_exact(1)[0]
+        length, shift = 0, 0
+        while True:
+            byte = self.recv_exact(1)[0]
+            length += (byte & 0x7F) << shift
+            shift += 7
+            if not byte & 0x80:
+                break
+        return header & 0xF0, self.recv_exact(length)
+
+    def reader(self):
+        try:
+            while self.alive:
+                kind, payload = self.read_packet()
+                if kind == 0x30:
+                    n = struct.unpack("!H", payload[:2])[0]
+                    self.on_message(payload[2:2 + n].decode(), payload[2 + n:].decode())
+        except (OSError, ConnectionError):
+            self.alive = False
+
+    def pinger(self):
+        while self.alive:
+            time.sleep(5)
+            self.send(b"\xc0\x00")
+
+    def send(self, packet):
+        with self.lock:
+            try:
+                self.sock.sendall(packet)
+            except OSError:
+                self.alive = False
+
+    def subscribe(self, topic_filter):
+        body = struct.pack("!H", 1) + encode_str(topic_filter) + b"\x00"
+        self.send(b"\x82" + encode_len(len(body)) + body)
+
+    def publish(self, topic, message):
+        body = encode_str(topic) + message.encode()
+        self.send(b"\x30" + encode_len(len(body)) + body)
+
+    def crash(self):
+        """Drop the TCP connection without DISCONNECT: the broker sends the will."""
+        self.alive = False
+        try:
+            self.sock.shutdown(socket.SHUT_RDWR)
+        except OSError:
+            pass
+        self.sock.close()
+
+
+# ─── Simulated unit ─────────────────────────────────────────────────────────
+
+class Node:
+    """One unit; mirrors the election and staging in code/pump_cluster.cpp."""
+
+    def __init__(self, node_id, args, manifold):
+        self.id = node_id
+        self.args = args
+        self.manifold = manifold
+        self.prefix = "aquasensys/cluster/%s/" % args.cluster
+        self.lock = threading.Lock()
+        self.client = None
+        self.runtime = 0.0
+        self.motor = False
+
+    def start(self, now):
+        self.peers = {}
+        self.plan = {"coord": "", "term": 0, "run": 0, "order": []}
+        self.plan_at = 0.0
+        self.staged_at = now
+        self.last_stage_up = False
+        self.last_plan_sent = 0.0
+        self.joined_at = now
+        self.last_heartbeat = now - HEARTBEAT
+        self.role = "standalone"
+        will = json.dumps({"id": self.id, "up": False})
+        self.client = MqttClient(self.args.host, self.args.port, self.id,
+                                 self.prefix + "node/" + self.id, will, self.on_message)
+        self.client.subscribe(self.prefix + "#")
+
+    def online(self):
+        return self.client is not None and self.client.alive
+
+    def crash(self):
+        self.client.crash()
+        self.client = None
+        self.role = "offline"
+        self.motor = False
+
+    def on_message(self, topic, payload):
+        try:
+            doc = json.loads(payload)
+        except ValueError:
+            return
+        sub = topic[len(self.prefix):]
+        with self.lock:
+            if sub.startswith("node/"):
+                self.on_status(doc)
+            elif sub == "plan":
+                self.on_plan(doc)
+
+    def on_status(self, doc):
+        node_id = doc.get("id")
+        if not node_id or node_id == self.id:
+            return
+        if not doc.get("up"):
+            if self.peers.pop(node_id, None) is not None:
+                log(self, "%s left" % node_id)
+            return
+        if node_id not in self.peers:
+            if len(self.peers) >= MAX_NODES - 1:
+                return
+            log(self, "%s joined" % node_id)
+        doc["seen_at"] = time.monotonic()
+        self.peers[node_id] = doc
+
+    def on_plan(self, doc):
+        coord, term = doc.get("coord"), doc.get("term", 0)
+        if not coord or coord == self.id:
+            return
+        current = self.plan
+        wins = term > current["term"] or (term == current["term"] and
+                                          (not current["coord"] or coord <= current["coord"]))
+        if not wins:
+            return
+        if coord != current["coord"]:
+            log(self, "%s coordinates (term %d)" % (coord, term))
+        self.plan = {"coord": coord, "term": term, "run": doc.get("run", 0),
+                     "order": list(doc.get("order", []))[:MAX_NODES]}
+        self.plan_at = time.monotonic()
+
+    def status(self):
+        return {"id": self.id, "up": True, "eligible": True, "motor": self.motor,
+                "runtime_s": int(self.runtime), "flow": round(self.manifold.pump_flow if self.motor else 0.0, 1)}
+
+    def should_coordinate(self, now):
+        if now - self.joined_at < JOIN_GRACE:
+            return False
+        coord = self.plan["coord"]
+        if coord == self.id:
+            return True
+        if coord and coord in self.peers and now - self.plan_at < PLAN_TIMEOUT:
+            return False
+        if any(peer < self.id for peer in self.peers):
+            return False
+        self.plan["term"] += 1
+        self.plan["coord"] = self.id
+        self.staged_at = now
+        self.last_stage_up = False
+        self.last_plan_sent = 0.0
+        log(self, "taking over as coordinator (term %d)" % self.plan["term"])
+        return True
+
+    def coordinate(self, now):
+        a = self.args
+        nodes = dict(self.peers)
+        nodes[self.id] = self.status()
+        eligible = {k: v for k, v in nodes.items() if v.get("eligible")}
+        ranked = [k for k in self.plan["order"] if k in eligible]
+        ranked += [k for k in sorted(eligible) if k not in ranked]
+        n = len(ranked)
+
+        run = min(self.plan["run"], n)
+        running_flow = sum(eligible[k].get("flow", 0.0) for k in ranked[:run])
+        settled = now - self.staged_at >= a.delay
+        pressure = self.manifold.pressure
+
+        nxt = run
+        if run == 0:
+            if n and pressure <= a.min_pressure:
+                ranked.sort(key=lambda k: (eligible[k].get("runtime_s", 0), k))
+                nxt = 1
+        elif pressure >= a.max_pressure + a.deficit:
+            nxt = 0
+        elif pressure >= a.max_pressure:
+            if settled or self.last_stage_up:
+                nxt = run - 1
+        elif run < n and settled:
+            if pressure <= a.min_pressure - a.deficit or (a.pump_flow > 0 and running_flow >= run * a.pump_flow):
+                nxt = run + 1
+
+        changed = nxt != self.plan["run"] or ranked != self.plan["order"]
+        if nxt != self.plan["run"]:
+            self.last_stage_up = nxt > self.plan["run"]
+            self.staged_at = now
+            log(self, "running %d of %d, lead %s" % (nxt, n, ranked[0]) if nxt else "all units standing by")
+        self.plan["run"] = nxt
+        self.plan["order"] = ranked
+        self.plan_at = now
+        if changed or now - self.last_plan_sent >= HEARTBEAT:
+            self.client.publish(self.prefix + "plan", json.dumps(
+                {"coord": self.id, "term": self.plan["term"], "run": nxt, "order": ranked}))
+            self.last_plan_sent = now
+
+    def tick(self, now, dt):
+        if not self.online():
+            if self.client is not None:
+                log(self, "broker lost")
+                self.crash()
+            return
+        with self.lock:
+            for peer in [k for k, v in self.peers.items() if now - v["seen_at"] > NODE_TIMEOUT]:
+                del self.peers[peer]
+                log(self, "%s timed out" % peer)
+            if now - self.last_heartbeat >= HEARTBEAT:
+                self.last_heartbeat = now
+                self.client.publish(self.prefix + "node/" + self.id, json.dumps(self.status()))
+            if self.should_coordinate(now):
+                self.coordinate(now)
+
+            plan = self.plan
+            if not plan["coord"] or now - self.plan_at >= PLAN_TIMEOUT:
+                role = "standalone"
+                # The unit's own hysteresis
+                if self.manifold.pressure <= self.args.min_pressure:
+                    self.motor = True
+                elif self.manifold.pressure >= self.args.max_pressure:
+                    self.motor = False
+            else:
+                role = "coordinator" if plan["coord"] == self.id else "follower"
+                self.motor = self.id in plan["order"][:plan["run"]]
+        if role != self.role:
+            log(self, "now %s" % role)
+            self.role = role
+        if self.motor:
+            self.runtime += dt
+
+
+# ─── Manifold ───────────────────────────────────────────────────────────────
+
+class Manifold:
+    """Pressure rises with pump flow in and falls with the load drawn off."""
+
+    def __init__(self, args):
+        self.pressure = args.min_pressure
+        self.pump_flow = 0.0
+        self.load = 0.0
+        self.args = args
+
+    def step(self, running, dt):
+        # Pump curve: full flow at 0 bar, none at the shut-off head
+        self.pump_flow = max(0.0, self.args.pump_rate * (1.0 - self.pressure / self.args.head))
+        inflow = running * self.pump_flow
+        self.pressure = max(0.0, self.pressure + (inflow - self.load) * self.args.stiffness * dt)
+
+
+# ─── Driver ─────────────────────────────────────────────────────────────────
+
+START = time.monotonic()
+
+
+def log(node, message):
+    print("%7.1f  %-10s %s" % (time.monotonic() - START, node.id if node else "", message), flush=True)
+
+
+def parse_events(specs, parser):
+    events = []
+    for spec in specs:
+        node_id, _, at = spec.partition("@")
+        try:
+            events.append((float(at), node_id))
+        except ValueError:
+            parser.error("bad event %r, expected NODE@SECONDS" % spec)
+    return sorted(events)
+
+
+def parse_load(spec, parser):
+    steps = []
+    for part in spec.split(","):
+        at, _, lpm = part.partition(":")
+        try:
+            steps.append((float(at), float(lpm)))
+        except ValueError:
+            parser.error("bad --load step %r, expected SECONDS:L/MIN" % part)
+    return sorted(steps)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[1])
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--cluster", default="manifold", help="cluster_name")
+    parser.add_argument("--nodes", type=int, default=3)
+    parser.add_argument("--duration", type=float, default=120.0, metavar="SECONDS")
+    parser.add_argument("--kill", action="append", default=[], metavar="NODE@SECONDS")
+    parser.add_argument("--rejoin", action="append", default=[], metavar="NODE@SECONDS")
+    parser.add_argument("--load", default="0:30,40:70,80:15", metavar="SECONDS:L/MIN,...",
+                        help="water drawn from the manifold over time")
+    parser.add_argument("--report", type=float, default=5.0, metavar="SECONDS")
+    # Same meaning and defaults as the device config
+    parser.add_argument("--min-pressure", type=float, default=2.5)
+    parser.add_argument("--max-pressure", type=float, default=3.5)
+    parser.add_argument("--deficit", type=float, default=0.3, help="cluster_deficit (bar)")
+    parser.add_argument("--delay", type=float, default=15.0, help="cluster_delay_s")
+    parser.add_argument("--pump-flow", type=float, default=0.0, help="cluster_pump_flow (L/min)")
+    # Manifold model
+    parser.add_argument("--pump-rate", type=float, default=60.0, help="pump flow at 0 bar (L/min)")
+    parser.add_argument("--head", type=float, default=5.0, help="pump shut-off pressure (bar)")
+    parser.add_argument("--stiffness", type=float, default=0.004, help="bar per litre of imbalance")
+    args = parser.parse_args()
+
+    kills = parse_events(args.kill, parser)
+    rejoins = parse_events(args.rejoin, parser)
+    load = parse_load(args.load, parser)
+
+    manifold = Manifold(args)
+    nodes = {}
+    now = time.monotonic()
+    for i in range(1, args.nodes + 1):
+        node = Node("sim-%d" % i, args, manifold)
+        node.start(now)
+        nodes[node.id] = node
+
+    dt = 0.05
+    last_report = 0.0
+    split_since = None
+    dry_since = None
+    failures = []
+    while True:
+        now = time.monotonic()
+        t = now - START
+        if t >= args.duration:
+            break
+        while kills and kills[0][0] <= t:
+            node = nodes.get(kills.pop(0)[1])
+            if node and node.online():
+                log(node, "killed")
+                node.crash()
+        while rejoins and rejoins[0][0] <= t:
+            node = nodes.get(rejoins.pop(0)[1])
+            if node and not node.online():
+                log(node, "rejoining")
+                node.start(now)
+        while load and load[0][0] <= t:
+            manifold.load = load.pop(0)[1]
+            log(None, "load %.0f L/min" % manifold.load)
+
+        for node in nodes.values():
+            node.tick(now, dt)
+        running = sum(1 for node in nodes.values() if node.motor)
+        manifold.step(running, dt)
+
+        coords = sorted(n.id for n in nodes.values() if n.role == "coordinator")
+        if len(coords) > 1:
+            split_since = split_since or now
+            if now - split_since > 2 * HEARTBEAT and "split" not in failures:
+                failures.append("split")
+                log(None, "FAIL: %s all coordinating" % ", ".join(coords))
+        else:
+            split_since = None
+        if running == 0 and manifold.pressure < args.min_pressure:
+            dry_since = dry_since or now
+            if now - dry_since > JOIN_GRACE + NODE_TIMEOUT and "starved" not in failures:
+                failures.append("starved")
+                log(None, "FAIL: %.2f bar and no pump running" % manifold.pressure)
+        else:
+            dry_since = None
+
+        if t - last_report >= args.report:
+            last_report = t
+            log(None, "%.2f bar, load %.0f L/min, running %s, coordinator %s" % (
+                manifold.pressure, manifold.load,
+                ",".join(n.id for n in nodes.values() if n.motor) or "-",
+                ",".join(coords) or "-"))
+        time.sleep(dt)
+
+    print()
+    for node in nodes.values():
+        print("%-8s runtime %5.1f s  %s" % (node.id, node.runtime, node.role))
+    print("FAILED: " + ", ".join(failures) if failures else "OK")
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
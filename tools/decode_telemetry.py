@@ -0,0 +1,168 @@
+#!/usr/bin/env python3
+"""
+Decode AquaSensys batched MQTT telemetry (homeassistant/<device>/telemetry).
+
+Each message is one MessagePack map, see code/telemetry_batch.h. Reads
+messages back to back from files or stdin and prints one CSV row per sample:
+
+    mosquitto_sub -h <broker> -t 'homeassistant/+/telemetry' -N | ./decode_telemetry.py
+    ./decode_telemetry.py batch1.bin batch2.bin
+
+Sequence gaps (dropped batches) and malformed batches are reported on
+stderr; the exit status is 1 if any batch failed validation.
+
+No dependencies beyond the standard library.
+"""
+
+import argparse
+import struct
+import sys
+
+FORMAT_VERSION = 1
+
+
+class Truncated(Exception):
+    pass
+
+
+class Reader:
+    """Pulls bytes from a binary stream; blocks on pipes until data arrives."""
+
+    def __init__(self, stream):
+        self.stream = stream
+
+    def take(self, n):
+        data = self.stream.read(n)
+        if len(data) != n:
+            raise Truncated()
+        return data
+
+    def at_eof(self):
+        peek = self.stream.peek(1) if hasattr(self.stream, "peek") else b"?"
+        return len(peek) == 0
+
+
+def unpack(r):
+    """Decode one MessagePack value (the subset plus common types)."""
+    b = r.take(1)[0]
+    if b <= 0x7F:
+        return b
+    if b >= 0xE0:
+        return b - 0x100
+    if 0x80 <= b <= 0x8F:
+        return unpack_map(r, b & 0x0F)
+    if 0x90 <= b <= 0x9F:
+        return [unpack(r) for _ in range(b & 0x0F)]
+    if 0xA0 <= b <= 0xBF:
+        return r.take(b & 0x1F).decode()
+
+    simple = {
+        0xC0: lambda: None,
+        0xC2: lambda: False,
+        0xC3: lambda: True,
+        0xCA: lambda: struct.unpack(">f", r.take(4))[0],
+        0xCB: lambda: struct.unpack(">d", r.take(8))[0],
+        0xCC: lambda: r.take(1)[0],
+        0xCD: lambda: struct.unpack(">H", r.take(2))[0],
+        0xCE: lambda: struct.unpack(">I", r.take(4))[0],
+        0xCF: lambda: struct.unpack(">Q", r.take(8))[0],
+        0xD0: lambda: struct.unpack(">b", r.take(1))[0],
+        0xD1: lambda: struct.unpack(">h", r.take(2))[0],
+        0xD2: lambda: struct.unpack(">i", r.take(4))[0],
+        0xD3: lambda: struct.unpack(">q", r.take(8))[0],
+        0xD9: lambda: r.take(r.take(1)[0]).decode(),
+        0xDA: lambda: r.take(struct.unpack(">H", r.take(2))[0]).decode(),
+        0xDC: lambda: [unpack(r) for _ in range(struct.unpack(">H", r.take(2))[0])],
+        0xDE: lambda: unpack_map(r, struct.unpack(">H", r.take(2))[0]),
+    }
+    if b not in simple:
+        raise ValueError("unsupported MessagePack type 0x%02x" % b)
+    return simple[b]()
+
+
+def unpack_map(r, n):
+    out = {}
+    for _ in range(n):
+        key = unpack(r)
+        out[key] = unpack(r)
+    return out
+
+
+def validate(batch):
+    """Problems with one decoded batch, empty if it is well formed."""
+    if not isinstance(batch, dict):
+        return ["not a map"]
+    problems = []
+    for key in ("v", "seq", "t0", "hz", "ch", "s"):
+        if key not in batch:
+            problems.append("missing '%s'" % key)
+    if problems:
+        return problems
+    if batch["v"] != FORMAT_VERSION:
+        problems.append("version %r, expected %d" % (batch["v"], FORMAT_VERSION))
+    width = 2 + len(batch["ch"])
+    last_dt = -1
+    for i, sample in enumerate(batch["s"]):
+        if not isinstance(sample, list) or len(sample) != width:
+            problems.append("sample %d has %s values, expected %d" %
+                            (i, len(sample) if isinstance(sample, list) else "no", width))
+            continue
+        if sample[0] < last_dt:
+            problems.append("sample %d goes back in time" % i)
+        last_dt = sample[0]
+    return problems
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[1])
+    parser.add_argument("files", nargs="*", help="captured messages (default: stdin)")
+    parser.add_argument("--no-header", action="store_true", help="omit the CSV header")
+    parser.add_argument("--summary", action="store_true",
+                        help="print one line per batch instead of samples")
+    args = parser.parse_args()
+
+    streams = [open(f, "rb") for f in args.files] or [sys.stdin.buffer]
+    header_done = args.no_header
+    expected_seq = None
+    failed = False
+
+    for stream in streams:
+        r = Reader(stream)
+        while not r.at_eof():
+            try:
+                batch = unpack(r)
+            except Truncated:
+                print("truncated message at end of input", file=sys.stderr)
+                failed = True
+                break
+
+            problems = validate(batch)
+            if problems:
+                print("bad batch: " + "; ".join(problems), file=sys.stderr)
+                failed = True
+                continue
+
+            if expected_seq is not None and batch["seq"] != expected_seq:
+                print("gap: expected seq %d, got %d" % (expected_seq, batch["seq"]),
+                      file=sys.stderr)
+            expected_seq = batch["seq"] + len(batch["s"])
+
+            if args.summary:
+                span = batch["s"][-1][0] if batch["s"] else 0
+                print("seq=%d t0=%d hz=%d samples=%d span=%dms" %
+                      (batch["seq"], batch["t0"], batch["hz"], len(batch["s"]), span))
+                continue
+
+            if not header_done:
+                print(",".join(["seq", "t_ms", "flags"] + batch["ch"]))
+                header_done = True
+            for i, sample in enumerate(batch["s"]):
+                values = ["%.4g" % v for v in sample[2:]]
+                print(",".join([str(batch["seq"] + i), str(batch["t0"] + sample[0]),
+                                str(sample[1])] + values))
+
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
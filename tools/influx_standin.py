@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+"""
+Stand-in for an InfluxDB write endpoint, for testing the exporter.
+
+    ./influx_standin.py --port 8086
+    ./influx_standin.py --port 8086 --fail 0.3 --delay 2
+
+Then set influx_url to http://<this host>:8086/api/v2/write?org=o&bucket=b.
+Accepts POST /api/v2/write and /write over keep-alive connections and
+handles gzip bodies. Every line is checked as line protocol, and
+timestamps must be seconds (precision=s). It prints one line per batch:
+connection, compression ratio, points and time span. --fail answers that
+fraction of requests with 503, to exercise backoff and the SD spool.
+--reject answers with 400. Standard library only.
+"""
+
+import argparse
+import gzip
+import random
+import re
+import sys
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import parse_qs, urlparse
+
+LINE = re.compile(r"^([^, ]+)((?:,[^=, ]+=[^, ]+)*) ([^= ]+=[^, ]+(?:,[^= ]+=[^, ]+)*) (\d+)$")
+FIELD = re.compile(r"^-?\d+i$|^-?\d+(\.\d+)?([eE][-+]?\d+)?$|^(t|f|true|false)$|^\".*\"$")
+
+stats = {"batches": 0, "points": 0, "failed": 0, "bad": 0}
+seen = set()
+
+
+def check_lines(text):
+    """(points, problems, first_ts, last_ts) for one body."""
+    points, problems, stamps = 0, [], []
+    for n, line in enumerate(text.split("\n"), 1):
+        if not line:
+            continue
+        m = LINE.match(line)
+        if not m:
+            problems.append("line %d: not line protocol: %.60s" % (n, line))
+            continue
+        for field in m.group(3).split(","):
+            key, _, value = field.partition("=")
+            if not FIELD.match(value):
+                problems.append("line %d: bad value for %s: %s" % (n, key, value))
+        ts = int(m.group(4))
+        if not 1_500_000_000 <= ts <= 4_000_000_000:
+            problems.append("line %d: timestamp %d is not in seconds" % (n, ts))
+        stamps.append(ts)
+        points += 1
+    return points, problems, min(stamps, default=0), max(stamps, default=0)
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"   # keep-alive
+
+    def log_message(self, fmt, *args):
+        pass
+
+    def reply(self, code, body=b""):
+        self.send_response(code)
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def do_POST(self):
+        url = urlparse(self.path)
+        length = int(self.headers.get("Content-Length", 0))
+        raw = self.rfile.read(length)
+        conn = "%s:%d" % self.client_address
+        reused = conn in seen
+        seen.add(conn)
+
+        if url.path not in ("/api/v2/write", "/write"):
+            return self.reply(404, b"not found")
+        if self.server.delay:
+            time.sleep(self.server.delay)
+        if random.random() < self.server.fail:
+            stats["failed"] += 1
+            print("%s 503 (simulated)" % conn, flush=True)
+            return self.reply(503, b"unavailable")
+        if random.random() < self.server.reject:
+            print("%s 400 (simulated)" % conn, flush=True)
+            return self.reply(400, b'{"code":"invalid","message":"simulated"}')
+
+        body = raw
+        if self.headers.get("Content-Encoding") == "gzip":
+            try:
+                body = gzip.decompress(raw)
+            except (OSError, EOFError) as e:
+                stats["bad"] += 1
+                print("%s bad gzip: %s" % (conn, e), flush=True)
+                return self.reply(400, b"bad gzip")
+
+        precision = parse_qs(url.query).get("precision", ["ns"])[0]
+        points, problems, first, last = check_lines(body.decode("utf-8", "replace"))
+        if precision != "s":
+            problems.append("precision=%s, expected s" % precision)
+        if problems:
+            stats["bad"] += 1
+            print("%s rejected: %s" % (conn, "; ".join(problems[:3])), flush=True)
+            return self.reply(400, ("\n".join(problems)).encode())
+
+        stats["batches"] += 1
+        stats["points"] += points
+        auth = "token" if self.headers.get("Authorization", "").startswith("Token ") else "no auth"
+        print("%s %s %d -> %d bytes (%.1fx), %d points, %s..%s, %s" % (
+            conn, "reused" if reused else "new   ", len(raw), len(body),
+            len(body) / max(len(raw), 1), points,
+            time.strftime("%H:%M:%S", time.gmtime(first)), time.strftime("%H:%M:%S", time.gmtime(last)),
+            auth), flush=True)
+        self.reply(204)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[1])
+    parser.add_argument("--port", type=int, default=8086)
+    parser.add_argument("--fail", type=float, default=0.0, help="fraction answered 503")
+    parser.add_argument("--reject", type=float, default=0.0, help="fraction answered 400")
+    parser.add_argument("--delay", type=float, default=0.0, help="seconds before answering")
+    args = parser.parse_args()
+
+    server = ThreadingHTTPServer(("", args.port), Handler)
+    server.fail, server.reject, server.delay = args.fail, args.reject, args.delay
+    print("listening on :%d" % args.port, flush=True)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    print("batches=%(batches)d points=%(points)d failed=%(failed)d bad=%(bad)d" % stats, file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""
+Measure AquaSensys command round-trip time with correlation IDs.
+
+Sends POST /command with a "cid" and waits for the matching "ack" event on
+the diagnostics SSE stream (see code/latency_trace.h). For each probe prints
+the round trip seen here next to the device's own receipt-to-actuation time:
+
+    ./latency_probe.py 192.168.1.50
+    ./latency_probe.py 192.168.1.50 --count 50 --interval 0.2
+
+The default "ping" command changes nothing; --command toggle really flips
+the manual motor state, so use it only on a bench rig. Exits 1 if any probe
+went unacknowledged. Standard library only.
+"""
+
+import argparse
+import http.client
+import json
+import os
+import queue
+import sys
+import threading
+import time
+
+
+def listen(host, port, acks, ready):
+    """Feed ack events from /events?topics=diagnostics into the queue."""
+    conn = http.client.HTTPConnection(host, port)
+    conn.request("GET", "/events?topics=diagnostics", headers={"Accept": "text/event-stream"})
+    resp = conn.getresponse()
+    ready.set()
+    event = None
+    while True:
+        line = resp.readline()
+        if not line:
+            return
+        line = line.decode(errors="replace").rstrip("\r\n")
+        if line.startswith("event:"):
+            event = line[6:].strip()
+        elif line.startswith("data:") and event == "ack":
+            try:
+                acks.put((time.perf_counter(), json.loads(line[5:])))
+            except ValueError:
+                pass
+        elif not line:
+            event = None
+
+
+def percentile(values, q):
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(q * len(ordered)))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[1])
+    parser.add_argument("host")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--count", type=int, default=10)
+    parser.add_argument("--interval", type=float, default=1.0, metavar="SECONDS")
+    parser.add_argument("--timeout", type=float, default=3.0)
+    parser.add_argument("--command", default="ping", choices=["ping", "toggle", "override", "mainSwitch"])
+    args = parser.parse_args()
+
+    acks = queue.Queue()
+    ready = threading.Event()
+    threading.Thread(target=listen, args=(args.host, args.port, acks, ready), daemon=True).start()
+    if not ready.wait(args.timeout):
+        print("error: no event stream from %s" % args.host, file=sys.stderr)
+        return 1
+    # The device only sends what a subscriber is there for; let it register us
+    time.sleep(0.5)
+
+    rtts, device, lost = [], [], 0
+    for i in range(args.count):
+        cid = "probe-%d-%d" % (os.getpid(), i)
+        body = json.dumps({"command": args.command, "cid": cid})
+        conn = http.client.HTTPConnection(args.host, args.port, timeout=args.timeout)
+        start = time.perf_counter()
+        conn.request("POST", "/command", body, {"Content-Type": "application/json"})
+        status = conn.getresponse().status
+        conn.close()
+        if status != 200:
+            print("%s: HTTP %d" % (cid, status))
+            lost += 1
+            continue
+
+        deadline = start + args.timeout
+        ack = None
+        while ack is None:
+            remaining = deadline - time.perf_counter()
+            if remaining <= 0:
+                break
+            try:
+                at, msg = acks.get(timeout=remaining)
+            except queue.Empty:
+                break
+            if msg.get("cid") == cid:
+                ack = (at, msg)
+
+        if ack is None:
+            print("%s: no ack within %.1f s" % (cid, args.timeout))
+            lost += 1
+        else:
+            rtt_ms = (ack[0] - start) * 1000
+            device_ms = ack[1].get("latency_us", 0) / 1000
+            rtts.append(rtt_ms)
+            device.append(device_ms)
+            print("%s: round trip %.1f ms, device %.2f ms" % (cid, rtt_ms, device_ms))
+
+        if i + 1 < args.count:
+            time.sleep(args.interval)
+
+    if rtts:
+        print()
+        for name, values in (("round trip", rtts), ("device", device)):
+            print("%-10s  min %.2f  p50 %.2f  p95 %.2f  max %.2f ms" % (
+                name, min(values), percentile(values, 0.5), percentile(values, 0.95), max(values)))
+    print("%d/%d acknowledged" % (len(rtts), args.count))
+    return 1 if lost else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+"""
+Read the AquaSensys Modbus/TCP register map and print it decoded.
+
+    ./modbus_probe.py 192.168.1.50
+    ./modbus_probe.py 192.168.1.50 --coil main=on
+    ./modbus_probe.py 192.168.1.50 --watch 1
+
+The map is documented in code/modbus_server.h. Exits 1 if the device
+answers a request with a Modbus exception. Standard library only.
+"""
+
+import argparse
+import socket
+import struct
+import sys
+import time
+
+CHANNELS = [
+    ("pressure_in", "bar", 100), ("pressure_out", "bar", 100), ("flow", "L/min", 10),
+    ("temp_water", "°C", 10), ("temp_ambient", "°C", 10), ("current_l1", "A", 100),
+    ("current_l2", "A", 100), ("current_l3", "A", 100), ("current_total", "A", 100),
+]
+STATUS_BITS = ["motor", "override", "manual_motor", "main_switch", "error"]
+COUNTERS = ["motor_runtime_s", "motor_starts", "pumped_volume_ml", "trips_dry_run",
+            "trips_overcurrent", "trips_imbalance", "trips_pressure", "power_cycles"]
+THRESHOLDS = ["min_pressure", "max_pressure", "max_current", "max_phase_imbalance"]
+DISCRETE = ["motor", "error", "main_switch", "override", "sd_present"]
+COILS = {"main": 0, "override": 1, "motor": 2}
+
+
+class ModbusError(Exception):
+    pass
+
+
+class Client:
+    def __init__(self, host, port, unit, timeout):
+        self.sock = socket.create_connection((host, port), timeout=timeout)
+        self.unit = unit
+        self.tid = 0
+
+    def request(self, pdu):
+        self.tid = (self.tid + 1) & 0xFFFF
+        self.sock.sendall(struct.pack(">HHHB", self.tid, 0, len(pdu) + 1, self.unit) + pdu)
+        header = self._recv(7)
+        tid, proto, length, _ = struct.unpack(">HHHB", header)
+        body = self._recv(length - 1)
+        if tid != self.tid or proto != 0:
+            raise ModbusError("mismatched reply (tid %d, protocol %d)" % (tid, proto))
+        if body[0] & 0x80:
+            raise ModbusError("function 0x%02x: exception %d" % (body[0] & 0x7F, body[1]))
+        return body
+
+    def _recv(self, n):
+        data = b""
+        while len(data) < n:
+            chunk = self.sock.recv(n - len(data))
+            if not chunk:
+                raise ModbusError("connection closed")
+            data += chunk
+        return data
+
+    def read_registers(self, start, count, function=4):
+        body = self.request(struct.pack(">BHH", function, start, count))
+        return list(struct.unpack(">%dH" % count, body[2:2 + 2 * count]))
+
+    def read_bits(self, start, count, function):
+        body = self.request(struct.pack(">BHH", function, start, count))
+        return [bool(body[2 + i // 8] & (1 << (i % 8))) for i in range(count)]
+
+    def write_coil(self, addr, on):
+        self.request(struct.pack(">BHH", 5, addr, 0xFF00 if on else 0))
+
+
+def words_to_float(hi, lo):
+    return struct.unpack(">f", struct.pack(">HH", hi, lo))[0]
+
+
+def to_int16(v):
+    return v - 0x10000 if v & 0x8000 else v
+
+
+def dump(c):
+    scaled = c.read_registers(0, 10)
+    floats = c.read_registers(100, 18)
+    print("%-20s %12s %12s" % ("channel", "int16", "float32"))
+    for i, (name, unit, scale) in enumerate(CHANNELS):
+        f = words_to_float(floats[2 * i], floats[2 * i + 1])
+        s = to_int16(scaled[i]) / scale
+        mark = "" if abs(s - f) <= 1.0 / scale else "  (mismatch)"
+        print("%-20s %12.2f %12.4f %s%s" % (name, s, f, unit, mark))
+    status = scaled[9]
+    print("status: " + ", ".join("%s=%d" % (n, (status >> i) & 1) for i, n in enumerate(STATUS_BITS)))
+
+    counters = c.read_registers(200, 20, function=3)
+    for i, name in enumerate(COUNTERS):
+        print("%-20s %12d" % (name, (counters[2 * i] << 16) | counters[2 * i + 1]))
+    print("%-20s %12d" % ("uptime_s", (counters[16] << 16) | counters[17]))
+    print("%-20s %12d" % ("free_heap", (counters[18] << 16) | counters[19]))
+
+    config = c.read_registers(300, 8, function=3)
+    for i, name in enumerate(THRESHOLDS):
+        print("%-20s %12.2f" % (name, words_to_float(config[2 * i], config[2 * i + 1])))
+
+    inputs = c.read_bits(0, len(DISCRETE), function=2)
+    print("inputs: " + ", ".join("%s=%d" % (n, v) for n, v in zip(DISCRETE, inputs)))
+    coils = c.read_bits(0, len(COILS), function=1)
+    print("coils:  " + ", ".join("%s=%d" % (n, coils[a]) for n, a in COILS.items()))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[1])
+    parser.add_argument("host")
+    parser.add_argument("--port", type=int, default=502)
+    parser.add_argument("--unit", type=int, default=1)
+    parser.add_argument("--timeout", type=float, default=3.0)
+    parser.add_argument("--coil", action="append", default=[], metavar="NAME=on|off",
+                        help="write a coil first: " + ", ".join(COILS))
+    parser.add_argument("--watch", type=float, metavar="SECONDS",
+                        help="poll repeatedly at this interval")
+    args = parser.parse_args()
+
+    try:
+        c = Client(args.host, args.port, args.unit, args.timeout)
+        for spec in args.coil:
+            name, _, value = spec.partition("=")
+            if name not in COILS or value not in ("on", "off"):
+                parser.error("bad --coil %r" % spec)
+            c.write_coil(COILS[name], value == "on")
+        while True:
+            dump(c)
+            if not args.watch:
+                break
+            time.sleep(args.watch)
+            print()
+    except ModbusError as e:
+        print("error: %s" % e, file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,285 @@
+#!/usr/bin/env python3
+"""
+MQTT broker stand-in that crashes on schedule, for testing the outbox spool.
+
+Accepts the device like a broker would (MQTT 3.1.1, QoS 0/1, no auth
+checks), records every PUBLISH, and at each --outage closes every
+connection with a TCP reset and stops listening for the given time, as a
+crashed broker would. Afterwards it checks what the device delivered:
+
+    ./mqtt_standin.py --outage 120:300 --duration 900
+    ./mqtt_standin.py --port 18830 --outage 60:180 --outage 400:60 --period 60
+
+Point the device's mqtt_server at this host. The checks use values that
+carry the device's own clock:
+  - homeassistant/<id>/uptime/state (published every --period seconds)
+  - "uptime" in homeassistant/<id>/event (fault events)
+Per topic, values must arrive in non-decreasing order. Uptime states more
+than --period + --slack apart mean a message went missing.
+
+A gap across the moment an outage began is reported separately. It covers
+messages that publish() handed to TCP before the device saw the connection
+drop, and that the spool cannot recover (see code/mqtt_outbox.h). Exits 1
+on out-of-order delivery or any other gap. Standard library only.
+"""
+
+import argparse
+import json
+import re
+import select
+import socket
+import struct
+import sys
+import threading
+import time
+
+START = time.monotonic()
+
+
+def now():
+    return time.monotonic() - START
+
+
+def log(message):
+    print("%8.1f  %s" % (now(), message), flush=True)
+
+
+def encode_len(n):
+    out = bytearray()
+    while True:
+        byte, n = n % 128, n // 128
+        out.append(byte | (0x80 if n else 0))
+        if not n:
+            return bytes(out)
+
+
+def topic_matches(pattern, topic):
+    parts, names = pattern.split("/"), topic.split("/")
+    for i, part in enumerate(parts):
+        if part == "#":
+            return True
+        if i >= len(names) or (part != "+" and part != names[i]):
+            return False
+    return len(parts) == len(names)
+
+
+class Broker:
+    def __init__(self, port):
+        self.port = port
+        self.lock = threading.Lock()
+        self.clients = {}           # socket -> subscriptions
+        self.listener = None
+        self.received = []          # (time, topic, payload)
+
+    def start(self):
+        self.listener = socket.socket()
+        self.listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.listener.bind(("0.0.0.0", self.port))
+        self.listener.listen(8)
+        threading.Thread(target=self.accept, args=(self.listener,), daemon=True).start()
+        log("listening on port %d" % self.port)
+
+    def crash(self):
+        try:
+            self.listener.shutdown(socket.SHUT_RDWR)    # wakes the blocked accept()
+        except OSError:
+            pass
+        self.listener.close()
+        with self.lock:
+            clients = list(self.clients)
+            self.clients.clear()
+        for sock in clients:
+            # RST rather than FIN, like a killed process on another host
+            sock.setsockopt(socket.SOL_SOCKET, socket.SO_LINGER, struct.pack("ii", 1, 0))
+            sock.close()
+        log("broker down (%d connection(s) reset)" % len(clients))
+
+    def accept(self, listener):
+        while True:
+            try:
+                sock, addr = listener.accept()
+            except OSError:
+                return
+            threading.Thread(target=self.serve, args=(sock, addr), daemon=True).start()
+
+    def serve(self, sock, addr):
+        try:
+            self.session(sock, addr)
+        except (OSError, ConnectionError, struct.error):
+            pass
+        with self.lock:
+            self.clients.pop(sock, None)
+
+    @staticmethod
+    def recv_exact(sock, n):
+        data = b""
+        while len(data) < n:
+            chunk = sock.recv(n - len(data))
+            if not chunk:
+                raise ConnectionError()
+            data += chunk
+        return data
+
+    def session(self, sock, addr):
+        while True:
+            header = self.recv_exact(sock, 1)[0]
+            length, shift = 0, 0
+            while True:
+                byte = self.recv_exact(sock, 1)[0]
+                length += (byte & 0x7F) << shift
+                shift += 7
+                if not byte & 0x80:
+                    break
+            body = self.recv_exact(sock, length)
+            kind = header & 0xF0
+
+            if kind == 0x10:        # CONNECT
+                n = struct.unpack("!H", body[10:12])[0]
+                log("client %s connected from %s" % (body[12:12 + n].decode(errors="replace"), addr[0]))
+                with self.lock:
+                    self.clients[sock] = []
+                sock.sendall(b"\x20\x02\x00\x00")
+            elif kind == 0x30:      # PUBLISH
+                qos = (header >> 1) & 3
+                n = struct.unpack("!H", body[:2])[0]
+                topic = body[2:2 + n].decode(errors="replace")
+                rest = body[2 + n:]
+                if qos:
+                    sock.sendall(b"\x40\x02" + rest[:2])
+                    rest = rest[2:]
+                self.received.append((now(), topic, rest.decode(errors="replace")))
+                self.forward(topic, rest)
+            elif kind == 0x80:      # SUBSCRIBE
+                packet_id, i, granted = body[:2], 2, b""
+                while i < len(body):
+                    n = struct.unpack("!H", body[i:i + 2])[0]
+                    with self.lock:
+                        self.clients.setdefault(sock, []).append(body[i + 2:i + 2 + n].decode())
+                    i += 3 + n
+                    granted += b"\x00"
+                sock.sendall(b"\x90" + encode_len(2 + len(granted)) + packet_id + granted)
+            elif kind == 0xC0:      # PINGREQ
+                sock.sendall(b"\xd0\x00")
+            elif kind == 0xE0:      # DISCONNECT
+                return
+
+    def forward(self, topic, payload):
+        body = struct.pack("!H", len(topic.encode())) + topic.encode() + payload
+        packet = b"\x30" + encode_len(len(body)) + body
+        with self.lock:
+            targets = [s for s, subs in self.clients.items() if any(topic_matches(p, topic) for p in subs)]
+        for sock in targets:
+            try:
+                sock.sendall(packet)
+            except OSError:
+                pass
+
+
+# ─── Checks ─────────────────────────────────────────────────────────────────
+
+def device_clock(topic, payload):
+    """Device uptime carried by a message, or None."""
+    if re.fullmatch(r"homeassistant/[^/]+/uptime/state", topic):
+        try:
+            return float(payload)
+        except ValueError:
+            return None
+    if re.fullmatch(r"homeassistant/[^/]+/event", topic):
+        try:
+            return float(json.loads(payload)["uptime"])
+        except (ValueError, KeyError, TypeError):
+            return None
+    return None
+
+
+def check(received, outages, period, slack):
+    streams = {}
+    for at, topic, payload in received:
+        value = device_clock(topic, payload)
+        if value is not None:
+            streams.setdefault(topic, []).append((at, value))
+
+    failures = 0
+    if not streams:
+        print("no uptime states or fault events received")
+        return 1
+    for topic, items in sorted(streams.items()):
+        print("%s: %d message(s)" % (topic, len(items)))
+        values = [v for _, v in items]
+        for (at_a, a), (at_b, b) in zip(items, items[1:]):
+            if b < a:
+                print("  out of order: %.0f after %.0f (received at %.1f s)" % (b, a, at_b))
+                failures += 1
+        if not topic.endswith("/uptime/state"):
+            continue
+
+        # Device time ≈ stand-in time - offset while the connection is live
+        offset = items[0][0] - items[0][1]
+        ordered = sorted(set(values))
+        for a, b in zip(ordered, ordered[1:]):
+            if b - a <= period + slack:
+                continue
+            missing = round((b - a) / period) - 1
+            kill = next((s for s, _ in outages if a - slack <= s - offset <= b + slack), None)
+            if kill is not None:
+                print("  %d lost at the disconnect (%.0f..%.0f s uptime, outage at %.0f s)"
+                      % (missing, a, b, kill))
+            else:
+                print("  gap: about %d missing between %.0f and %.0f s uptime" % (missing, a, b))
+                failures += 1
+        duplicates = len(values) - len(set(values))
+        if duplicates:
+            print("  %d duplicate(s) (replay resumed from a saved position)" % duplicates)
+    return failures
+
+
+def parse_outage(spec, parser):
+    at, _, length = spec.partition(":")
+    try:
+        return float(at), float(length)
+    except ValueError:
+        parser.error("bad --outage %r, expected START:SECONDS" % spec)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[1])
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--outage", action="append", default=[], metavar="START:SECONDS",
+                        help="crash at START seconds and stay down for SECONDS")
+    parser.add_argument("--duration", type=float, default=600.0, metavar="SECONDS")
+    parser.add_argument("--period", type=float, default=60.0,
+                        help="uptime state interval on the device (s)")
+    parser.add_argument("--slack", type=float, default=5.0, metavar="SECONDS")
+    parser.add_argument("--verbose", action="store_true", help="print every publish")
+    args = parser.parse_args()
+    outages = sorted(parse_outage(s, parser) for s in args.outage)
+
+    broker = Broker(args.port)
+    broker.start()
+    pending = list(outages)
+    down_until = None
+    seen = 0
+    try:
+        while now() < args.duration:
+            if down_until is None and pending and now() >= pending[0][0]:
+                down_until = now() + pending.pop(0)[1]
+                broker.crash()
+            elif down_until is not None and now() >= down_until:
+                down_until = None
+                broker.start()
+            if args.verbose:
+                for at, topic, payload in broker.received[seen:]:
+                    log("%s %s" % (topic, payload[:80]))
+                seen = len(broker.received)
+            select.select([], [], [], 0.2)
+    except KeyboardInterrupt:
+        pass
+
+    print()
+    failures = check(broker.received, outages, args.period, args.slack)
+    print("FAILED" if failures else "OK")
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+"""
+Receive AquaSensys UDP multicast telemetry and print it.
+
+    ./multicast_listen.py                       # default group and port
+    ./multicast_listen.py --group 239.255.42.1 --port 45454 --csv
+
+The datagram layout is MulticastDatagram in code/multicast_telemetry.h.
+Datagrams with a bad magic, version, size or CRC are counted and skipped;
+sequence gaps are reported per sender. Ctrl-C prints a summary.
+Standard library only.
+"""
+
+import argparse
+import socket
+import struct
+import sys
+import zlib
+
+MAGIC = 0x4D545141
+VERSION = 1
+LAYOUT = struct.Struct("<IBB6sII9fI")
+CHANNELS = ["p_in", "p_out", "flow", "t_water", "t_amb", "i_l1", "i_l2", "i_l3", "i_total"]
+FLAGS = ["motor", "error", "main", "manual"]
+
+
+def open_socket(group, port, iface):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    if hasattr(socket, "SO_REUSEPORT"):
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEPORT, 1)
+    sock.bind(("", port))
+    mreq = struct.pack("4s4s", socket.inet_aton(group), socket.inet_aton(iface))
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, mreq)
+    return sock
+
+
+def decode(data):
+    """(fields, None) for a valid datagram, else (None, reason)."""
+    if len(data) != LAYOUT.size:
+        return None, "size %d, expected %d" % (len(data), LAYOUT.size)
+    fields = LAYOUT.unpack(data)
+    magic, version, flags, mac, seq, uptime = fields[:6]
+    values, crc = fields[6:15], fields[15]
+    if magic != MAGIC:
+        return None, "bad magic 0x%08x" % magic
+    if version != VERSION:
+        return None, "version %d, expected %d" % (version, VERSION)
+    if zlib.crc32(data[:-4]) != crc:
+        return None, "CRC mismatch"
+    return {
+        "mac": ":".join("%02x" % b for b in mac),
+        "seq": seq,
+        "uptime_ms": uptime,
+        "flags": flags,
+        "values": values,
+    }, None
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[1])
+    parser.add_argument("--group", default="239.255.42.1")
+    parser.add_argument("--port", type=int, default=45454)
+    parser.add_argument("--iface", default="0.0.0.0", help="local address to join on")
+    parser.add_argument("--csv", action="store_true", help="CSV rows instead of text")
+    parser.add_argument("--count", type=int, default=0, help="stop after N valid datagrams")
+    args = parser.parse_args()
+
+    sock = open_socket(args.group, args.port, args.iface)
+    last_seq = {}
+    stats = {"valid": 0, "invalid": 0, "lost": 0}
+    if args.csv:
+        print(",".join(["sender", "seq", "uptime_ms", "flags"] + CHANNELS))
+
+    try:
+        while not args.count or stats["valid"] < args.count:
+            data, addr = sock.recvfrom(1500)
+            d, reason = decode(data)
+            if d is None:
+                stats["invalid"] += 1
+                print("%s: dropped (%s)" % (addr[0], reason), file=sys.stderr)
+                continue
+            stats["valid"] += 1
+
+            prev = last_seq.get(d["mac"])
+            if prev is not None and d["seq"] != prev + 1:
+                if d["seq"] > prev:
+                    stats["lost"] += d["seq"] - prev - 1
+                    print("%s: %d lost before seq %d" % (d["mac"], d["seq"] - prev - 1, d["seq"]),
+                          file=sys.stderr)
+                else:
+                    print("%s: seq restarted at %d (reboot?)" % (d["mac"], d["seq"]), file=sys.stderr)
+            last_seq[d["mac"]] = d["seq"]
+
+            if args.csv:
+                print(",".join([d["mac"], str(d["seq"]), str(d["uptime_ms"]), str(d["flags"])] +
+                               ["%.4g" % v for v in d["values"]]), flush=True)
+            else:
+                flags = " ".join(n for i, n in enumerate(FLAGS) if d["flags"] & (1 << i)) or "-"
+                values = " ".join("%s=%.2f" % (n, v) for n, v in zip(CHANNELS, d["values"]))
+                print("%s #%d [%s] %s" % (d["mac"], d["seq"], flags, values), flush=True)
+    except KeyboardInterrupt:
+        pass
+
+    print("valid=%d invalid=%d lost=%d senders=%d" %
+          (stats["valid"], stats["invalid"], stats["lost"], len(last_seq)), file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
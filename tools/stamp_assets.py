@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+"""
+Stamp the web UI's local CSS/JS references with a content version.
+
+Rewrites href="style.css" / src="app.js" in every .html under the SD
+directory to "style.css?v=<hash>", where the hash is the FNV-1a of the
+file. The firmware sends "?v=" requests with a year-long max-age (see
+code/static_handler.h), so run this after editing any CSS or JS and
+upload the pages together with the assets:
+
+    ./stamp_assets.py            # code/sd
+    ./stamp_assets.py path/to/sd --check
+
+--check changes nothing and exits 1 if a page is out of date.
+Standard library only.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+REF = re.compile(r'((?:href|src)=")([^":?#]+\.(?:css|js))(\?v=[0-9a-f]*)?(")')
+
+
+def fnv1a(data):
+    h = 2166136261
+    for b in data:
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def stamp(page, root):
+    with open(page, encoding="utf-8") as f:
+        text = f.read()
+    base = os.path.dirname(page)
+
+    def replace(m):
+        asset = os.path.normpath(os.path.join(base if not m.group(2).startswith("/") else root,
+                                              m.group(2).lstrip("/")))
+        if not os.path.isfile(asset):
+            return m.group(0)
+        with open(asset, "rb") as f:
+            version = "%08x" % fnv1a(f.read())
+        return m.group(1) + m.group(2) + "?v=" + version + m.group(4)
+
+    return text, REF.sub(replace, text)
+
+
+def main():
+    default = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "code", "sd")
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[1])
+    parser.add_argument("sd_dir", nargs="?", default=default)
+    parser.add_argument("--check", action="store_true")
+    args = parser.parse_args()
+
+    stale = 0
+    for name in sorted(os.listdir(args.sd_dir)):
+        if not name.endswith(".html"):
+            continue
+        page = os.path.join(args.sd_dir, name)
+        old, new = stamp(page, args.sd_dir)
+        if old == new:
+            continue
+        stale += 1
+        if args.check:
+            print("%s: out of date" % name)
+        else:
+            with open(page, "w", encoding="utf-8") as f:
+                f.write(new)
+            print("%s: stamped" % name)
+    return 1 if args.check and stale else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())